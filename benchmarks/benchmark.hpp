@@ -0,0 +1,53 @@
+#ifndef JETBEEP_BENCHMARK__H
+#define JETBEEP_BENCHMARK__H
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace JetBeep {
+  namespace Benchmark {
+    // prevents the compiler from optimizing away results of the measured code
+    template <class T>
+    inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+      asm volatile("" : : "r,m"(value) : "memory");
+#else
+      volatile char sink = *reinterpret_cast<const volatile char*>(&value);
+      (void)sink;
+#endif
+    }
+
+    // runs body (which performs batchSize operations per call) until at least minDuration elapsed and prints the
+    // average time of a single operation
+    template <class Body>
+    double run(const std::string& name,
+               Body body,
+               uint64_t batchSize = 1,
+               std::chrono::milliseconds minDuration = std::chrono::milliseconds(500)) {
+      using Clock = std::chrono::steady_clock;
+      uint64_t operations = 0;
+
+      body(); // warm up
+      auto start = Clock::now();
+      auto elapsed = Clock::duration::zero();
+
+      do {
+        body();
+        operations += batchSize;
+        elapsed = Clock::now() - start;
+      } while (elapsed < minDuration);
+
+      double nsPerOperation = std::chrono::duration<double, std::nano>(elapsed).count() / operations;
+
+      std::cout << std::left << std::setw(48) << name << std::right << std::setw(12) << std::fixed
+                << std::setprecision(2) << nsPerOperation << " ns/op" << std::setw(14) << operations << " ops"
+                << std::endl;
+      return nsPerOperation;
+    }
+  } // namespace Benchmark
+} // namespace JetBeep
+
+#endif
@@ -0,0 +1,214 @@
+#include "../lib/device/device_responses.hpp"
+#include "../lib/utils/string_tokens.hpp"
+#include "benchmark.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace JetBeep;
+using namespace std;
+
+// stream of lines recorded from a device at a busy lane: events dominate, interleaved with command results
+static const vector<string> recordedStream = {"MOBILE_CONNECTED",
+                                              "BARCODES 4820000000017 4 0011223344 1",
+                                              "MOBILE_DISCONNECTED",
+                                              "NFC_DETECTED 2 04A1B2C3D4E5F6",
+                                              "NFC_REMOVED",
+                                              "GET ok 1.4.2",
+                                              "SET ok",
+                                              "MOBILE_CONNECTED",
+                                              "PAYMENT_TOKEN 00112233445566778899aabbccddeeff",
+                                              "CREATE_PAYMENT_TOKEN ok",
+                                              "MOBILE_DISCONNECTED",
+                                              "GETSTATE ok 1 0 0 0 0",
+                                              "NFC_DETECTION_ERROR multiple_cards",
+                                              "PAYMENT_SUCCESSFUL",
+                                              "SYSTEM_RESET",
+                                              "OPEN_SESSION ok"};
+
+// the if/else chain used by SerialDevice before the dispatch table: handleResult, handleResultWithParams,
+// handleEvent and handleSystemEvent are tried in sequence with std::string comparisons, each one checking the state
+// of the device first
+namespace ChainDispatch {
+  const string get = "GET";
+  const string getState = "GETSTATE";
+  const string nfcReadMFC = "NFC_READ_MFC";
+  const string nfcSecureReadMFC = "NFC_SECURE_READ_MFC";
+  const string mobileConnected = "MOBILE_CONNECTED";
+  const string mobileDisconnected = "MOBILE_DISCONNECTED";
+  const string barcodes = "BARCODES";
+  const string paymentToken = "PAYMENT_TOKEN";
+  const string paymentError = "PAYMENT_ERROR";
+  const string paymentSuccessful = "PAYMENT_SUCCESSFUL";
+  const string nfcDetected = "NFC_DETECTED";
+  const string nfcRemoved = "NFC_REMOVED";
+  const string nfcDetectionError = "NFC_DETECTION_ERROR";
+  const string systemReset = "SYSTEM_RESET";
+
+  // what the handlers looked at besides the command: m_state, m_executedCommand and the pending promises. Only the
+  // promise of the executed command is pending, m_executePromise for commands without a value
+  typedef struct DeviceState {
+    bool isExecuteInProgress;
+    string executedCommand;
+    bool isExecutePromisePending;
+    bool isGetStatePromisePending;
+  } DeviceState;
+
+  static bool handleResult(const string& command, const DeviceState& state) {
+    if (!state.isExecuteInProgress) {
+      return false;
+    }
+    if (command != state.executedCommand) {
+      return false;
+    }
+    return state.isExecutePromisePending;
+  }
+
+  static int handleResultWithParams(const string& command, const DeviceState& state) {
+    if (!state.isExecuteInProgress) {
+      return 0;
+    }
+    if (command != state.executedCommand) {
+      return 0;
+    }
+    if (command == get) {
+      return 2;
+    } else if (command == getState) {
+      return state.isGetStatePromisePending ? 3 : 0;
+    } else if (command == nfcReadMFC || command == nfcSecureReadMFC) {
+      return 4;
+    }
+    return 0;
+  }
+
+  static int handleEvent(const string& event) {
+    if (event == mobileConnected) {
+      return 5;
+    } else if (event == mobileDisconnected) {
+      return 6;
+    } else if (event == barcodes) {
+      return 7;
+    } else if (event == paymentToken) {
+      return 8;
+    } else if (event == paymentError) {
+      return 9;
+    } else if (event == paymentSuccessful) {
+      return 10;
+    } else if (event == nfcDetected) {
+      return 11;
+    } else if (event == nfcRemoved) {
+      return 12;
+    } else if (event == nfcDetectionError) {
+      return 13;
+    }
+    return 0;
+  }
+
+  static int handleSystemEvent(const string& event) {
+    if (event == systemReset) {
+      return 14;
+    }
+    return 0;
+  }
+
+  // SerialDevice::Impl::handleResponse after splitting the line
+  static int dispatch(const string& command, const DeviceState& state) {
+    if (handleResult(command, state)) {
+      return 1;
+    }
+    if (auto result = handleResultWithParams(command, state)) {
+      return result;
+    }
+    if (auto result = handleEvent(command)) {
+      return result;
+    }
+    return handleSystemEvent(command);
+  }
+
+  // Utils::splitString, which was used to tokenize every response
+  static vector<string> splitString(const string& str, const string& delimiter = " ") {
+    vector<string> return_value;
+    size_t start = 0;
+    auto end = str.find(delimiter);
+
+    while (end != string::npos) {
+      return_value.push_back(str.substr(start, end - start));
+      start = end + delimiter.length();
+      end = str.find(delimiter, start);
+    }
+    return_value.push_back(str.substr(start, end));
+    return return_value;
+  }
+} // namespace ChainDispatch
+
+int main() {
+  vector<string> commands;
+  vector<string_view> tokens;
+
+  for (const auto& line : recordedStream) {
+    commands.push_back(line.substr(0, line.find(' ')));
+  }
+  for (const auto& command : commands) {
+    tokens.push_back(command);
+  }
+
+  // a SET is executed, its result arrives among the events
+  const ChainDispatch::DeviceState state = {true, "SET", true, false};
+
+  Benchmark::run(
+    "dispatch/if-else chain",
+    [&]() {
+      int sum = 0;
+
+      for (const auto& command : commands) {
+        sum += ChainDispatch::dispatch(command, state);
+      }
+      Benchmark::doNotOptimize(sum);
+    },
+    commands.size());
+
+  Benchmark::run(
+    "dispatch/perfect hash table",
+    [&]() {
+      int sum = 0;
+
+      for (const auto& token : tokens) {
+        sum += static_cast<int>(DeviceResponses::lookup(token));
+      }
+      Benchmark::doNotOptimize(sum);
+    },
+    tokens.size());
+
+  // whole line: tokenizing and dispatching as done in SerialDevice::Impl::handleResponse
+  Benchmark::run(
+    "dispatch/splitString + if-else chain",
+    [&]() {
+      int sum = 0;
+
+      for (const auto& line : recordedStream) {
+        auto splitted = ChainDispatch::splitString(line);
+        auto command = splitted.at(0);
+
+        splitted.erase(splitted.begin());
+        sum += ChainDispatch::dispatch(command, state) + static_cast<int>(splitted.size());
+      }
+      Benchmark::doNotOptimize(sum);
+    },
+    recordedStream.size());
+
+  Benchmark::run(
+    "dispatch/tokenize + perfect hash table",
+    [&]() {
+      int sum = 0;
+
+      for (const auto& line : recordedStream) {
+        StringTokens<> splitted(line);
+
+        sum += static_cast<int>(DeviceResponses::lookup(splitted[0])) + static_cast<int>(splitted.size());
+      }
+      Benchmark::doNotOptimize(sum);
+    },
+    recordedStream.size());
+
+  return 0;
+}
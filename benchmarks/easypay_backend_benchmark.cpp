@@ -0,0 +1,197 @@
+#include "../lib/https/easypay_backend.hpp"
+#include "benchmark.hpp"
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http.hpp>
+#include <openssl/x509v3.h>
+
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace JetBeep;
+using namespace std;
+
+namespace ssl = boost::asio::ssl;
+namespace http = boost::beast::http;
+using tcp = boost::asio::ip::tcp;
+
+// the answer of EasyPay to an accepted payment, see easypay_benchmark.cpp
+static const string paymentResponse = R"({
+  "Result": {
+    "Status": "Accepted",
+    "TransactionId": 1234567890,
+    "TransactionDatePost": "2020-06-26T06:53:03.691Z",
+    "PaymentRequestUid": "fd3034b0-0940-4f54-911b-c86f2d5490e4",
+    "MerchantTransactionId": "tx-000042"
+  },
+  "Uid": "5b1f6e2a-3f1c-4cde-9d5c-1f0f7f1a2b3c",
+  "Errors": null
+})";
+
+// blocks until the promise settles, the same way dfu_main waits for device commands
+template <typename T>
+static T wait(Promise<T> promise) {
+  std::promise<T> result;
+  auto future = result.get_future();
+
+  promise.then([&result](const T& value) { result.set_value(value); })
+    .catchError([&result](const exception_ptr& error) { result.set_exception(error); });
+  return future.get();
+}
+
+// a certificate for 127.0.0.1 generated on start, the client accepts it as it's built with SKIP_PEER_VERIFICATION
+static void useSelfSignedCertificate(ssl::context& context) {
+  EVP_PKEY* key = nullptr;
+  auto keyContext = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, nullptr);
+
+  EVP_PKEY_keygen_init(keyContext);
+  EVP_PKEY_CTX_set_rsa_keygen_bits(keyContext, 2048);
+  EVP_PKEY_keygen(keyContext, &key);
+  EVP_PKEY_CTX_free(keyContext);
+
+  auto certificate = X509_new();
+  auto name = X509_get_subject_name(certificate);
+  X509V3_CTX extensionContext;
+
+  X509_set_version(certificate, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+  X509_gmtime_adj(X509_getm_notBefore(certificate), 0);
+  X509_gmtime_adj(X509_getm_notAfter(certificate), 24 * 60 * 60);
+  X509_set_pubkey(certificate, key);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("127.0.0.1"), -1, -1, 0);
+  X509_set_issuer_name(certificate, name);
+
+  X509V3_set_ctx(&extensionContext, certificate, certificate, nullptr, nullptr, 0);
+  auto subjectAltName = X509V3_EXT_conf_nid(nullptr, &extensionContext, NID_subject_alt_name, "IP:127.0.0.1");
+  X509_add_ext(certificate, subjectAltName, -1);
+  X509_EXTENSION_free(subjectAltName);
+  X509_sign(certificate, key, EVP_sha256());
+
+  SSL_CTX_use_certificate(context.native_handle(), certificate);
+  SSL_CTX_use_PrivateKey(context.native_handle(), key);
+  X509_free(certificate);
+  EVP_PKEY_free(key);
+}
+
+// a keep-alive connection to the stub, every request is answered with paymentResponse
+class StubSession : public enable_shared_from_this<StubSession> {
+public:
+  StubSession(tcp::socket socket, ssl::context& context) : m_stream(std::move(socket), context) {
+  }
+
+  void start() {
+    auto self = shared_from_this();
+    m_stream.async_handshake(ssl::stream_base::server, [self](const boost::system::error_code& error) {
+      if (!error) {
+        self->read();
+      }
+    });
+  }
+
+private:
+  ssl::stream<tcp::socket> m_stream;
+  boost::beast::flat_buffer m_buffer;
+  http::request<http::string_body> m_request;
+  http::response<http::string_body> m_response;
+
+  void read() {
+    auto self = shared_from_this();
+
+    m_request = {};
+    http::async_read(m_stream, m_buffer, m_request, [self](const boost::system::error_code& error, size_t) {
+      if (!error) {
+        self->write();
+      }
+    });
+  }
+
+  void write() {
+    auto self = shared_from_this();
+
+    m_response = {http::status::ok, m_request.version()};
+    m_response.set(http::field::content_type, "application/json");
+    m_response.keep_alive(m_request.keep_alive());
+    m_response.body() = paymentResponse;
+    m_response.prepare_payload();
+    http::async_write(m_stream, m_response, [self](const boost::system::error_code& error, size_t) {
+      if (!error && self->m_response.keep_alive()) {
+        self->read();
+      }
+    });
+  }
+};
+
+// an EasyPay server on a loopback port, served from its own thread
+class TlsStub {
+public:
+  TlsStub()
+    : m_context(ssl::context::tls_server),
+      m_acceptor(m_ioService, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)) {
+    useSelfSignedCertificate(m_context);
+    accept();
+    m_thread = thread([this] { m_ioService.run(); });
+  }
+
+  ~TlsStub() {
+    m_ioService.stop();
+    m_thread.join();
+  }
+
+  int port() const {
+    return m_acceptor.local_endpoint().port();
+  }
+
+private:
+  boost::asio::io_service m_ioService;
+  ssl::context m_context;
+  tcp::acceptor m_acceptor;
+  thread m_thread;
+
+  void accept() {
+    m_acceptor.async_accept([this](const boost::system::error_code& error, tcp::socket socket) {
+      if (!error) {
+        // the response goes out in several TLS records, Nagle would hold them back until the delayed ACK of the client
+        socket.set_option(tcp::no_delay(true));
+        make_shared<StubSession>(std::move(socket), m_context)->start();
+      }
+      accept();
+    });
+  }
+};
+
+int main() {
+  TlsStub stub;
+  EasyPayBackend backend("127.0.0.1", stub.port(), "merchant-secret-key");
+  const string paymentToken = "00112233445566778899aabbccddeeff;6699;c2lnbmF0dXJlLWJveA==";
+
+  // request signing, the curl transfer over a kept alive TLS connection and parsing of the response
+  Benchmark::run("easypay/makePayment loopback round trip", [&backend, &paymentToken] {
+    auto result = wait(backend.makePayment("tx-000042", paymentToken, 1500, 42, "cashier-1"));
+    Benchmark::doNotOptimize(result);
+  });
+
+  constexpr int concurrentPayments = 8;
+  Benchmark::run(
+    "easypay/makePayment loopback, 8 in flight",
+    [&backend, &paymentToken] {
+      vector<std::promise<EasyPayResult>> results(concurrentPayments);
+
+      for (auto& result : results) {
+        backend.makePayment("tx-000042", paymentToken, 1500, 42, "cashier-1")
+          .then([&result](const EasyPayResult& value) { result.set_value(value); })
+          .catchError([&result](const exception_ptr& error) { result.set_exception(error); });
+      }
+      for (auto& result : results) {
+        Benchmark::doNotOptimize(result.get_future().get());
+      }
+    },
+    concurrentPayments);
+
+  return 0;
+}
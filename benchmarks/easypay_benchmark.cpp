@@ -0,0 +1,78 @@
+#include "../lib/https/easypay_request.hpp"
+#include "../lib/https/easypay_response.hpp"
+#include "benchmark.hpp"
+
+#include <string>
+
+using namespace JetBeep;
+using namespace JetBeep::EasyPayAPI;
+using namespace std;
+
+// bodies in the shape EasyPayBackend::makePayment sends and receives, see easypay_response.cpp
+static const string paymentResponse = R"({
+  "Result": {
+    "Status": "Accepted",
+    "TransactionId": 1234567890,
+    "TransactionDatePost": "2020-06-26T06:53:03.691Z",
+    "PaymentRequestUid": "fd3034b0-0940-4f54-911b-c86f2d5490e4",
+    "MerchantTransactionId": "tx-000042"
+  },
+  "Uid": "5b1f6e2a-3f1c-4cde-9d5c-1f0f7f1a2b3c",
+  "Errors": null
+})";
+
+static const string errorResponse = R"({
+  "Result": null,
+  "Uid": "fd3034b0-0940-4f54-911b-c86f2d5490e4",
+  "Errors": [
+    {
+      "Error": "service",
+      "CodeId": 11021,
+      "CodeName": "WebApi_Invalid_Field_SignatureMerchant",
+      "ErrorMessage": null,
+      "UserMessage": "SignatureMerchant verification error",
+      "Reason": null
+    }
+  ]
+})";
+
+static TokenPaymentRequest makeRequest() {
+  TokenPaymentRequest request;
+
+  request.AmountInCoin = 1500;
+  request.SignatureMerchant = "f2ca1bb6c7e907d06dafe4687e579fce76b37e4e93b7605022da52e6ccc26fd2";
+  request.PaymentTokenFull = "00112233445566778899aabbccddeeff;6699;c2lnbmF0dXJlLWJveA==";
+  request.DateRequest = "2020-06-26T06:53:03Z";
+  request.MerchantCashboxId = "cashier-1";
+  request.MerchantTransactionId = "tx-000042";
+  return request;
+}
+
+int main() {
+  auto request = makeRequest();
+  auto partialsRequest = makeRequest();
+
+  partialsRequest.Metadata = {{"item1", "500"}, {"item2", "1000"}};
+
+  Benchmark::run("easypay/payment request to json", [&request] {
+    auto json = tokenPaymentReqToJSON(request);
+    Benchmark::doNotOptimize(json);
+  });
+
+  Benchmark::run("easypay/partials request to json", [&partialsRequest] {
+    auto json = tokenPaymentReqToJSON(partialsRequest);
+    Benchmark::doNotOptimize(json);
+  });
+
+  Benchmark::run("easypay/parse payment result", [] {
+    auto result = parseTokenPaymentResult(paymentResponse);
+    Benchmark::doNotOptimize(result);
+  });
+
+  Benchmark::run("easypay/parse error result", [] {
+    auto result = parseTokenPaymentResult(errorResponse);
+    Benchmark::doNotOptimize(result);
+  });
+
+  return 0;
+}
@@ -0,0 +1,54 @@
+#include "../lib/utils/logger.hpp"
+#include "benchmark.hpp"
+
+#include <string>
+
+using namespace JetBeep;
+using namespace std;
+
+// the debug line logged by SerialDevice for every device response
+static const string response = "GETSTATE ok 1 0 0 0 0";
+static const int batchSize = 1000;
+
+int main() {
+  Logger log("serial_device");
+  uint64_t lines = 0;
+
+  // output goes to a callback which doesn't do anything, so only the cost of the logger itself is measured
+  Logger::externalOutputEnabled = true;
+  Logger::outputCallback = [&lines](const string&) { lines++; };
+
+  Logger::level = LoggerLevel::debug;
+  Benchmark::run(
+    "logger/enabled level",
+    [&]() {
+      for (int i = 0; i < batchSize; i++) {
+        log.d() << "nrf rx: " << response << Logger::endl;
+      }
+    },
+    batchSize);
+
+  Logger::level = LoggerLevel::info;
+  Benchmark::run(
+    "logger/disabled level",
+    [&]() {
+      for (int i = 0; i < batchSize; i++) {
+        log.d() << "nrf rx: " << response << Logger::endl;
+      }
+    },
+    batchSize);
+
+  // what every statement of a level below JETBEEP_LOG_MIN_LEVEL is compiled to
+  Benchmark::run(
+    "logger/compiled out level",
+    [&]() {
+      for (int i = 0; i < batchSize; i++) {
+        LoggerNullStream() << "nrf rx: " << response << Logger::endl;
+        Benchmark::doNotOptimize(lines);
+      }
+    },
+    batchSize);
+
+  Benchmark::doNotOptimize(lines);
+  return 0;
+}
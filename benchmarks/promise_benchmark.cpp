@@ -0,0 +1,119 @@
+#include "../lib/utils/promise.hpp"
+#include "benchmark.hpp"
+
+#include <cstdlib>
+#include <new>
+#include <string>
+
+using namespace JetBeep;
+using namespace std;
+
+// every allocation of the process is counted, so the benchmark reports allocations per chain next to the timings
+static uint64_t allocationsCount = 0;
+
+void* operator new(size_t size) {
+  allocationsCount++;
+  if (auto pointer = malloc(size == 0 ? 1 : size)) {
+    return pointer;
+  }
+  throw bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+  free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+  free(pointer);
+}
+
+// the shape of AutoDevice::Impl::writeDeviceConfig: a command promise followed by 15 steps, each one starting the next
+// command of the device
+static constexpr int chainLength = 15;
+
+static Promise<void> buildThenPromiseChain(Promise<void> first) {
+  auto promise = first;
+
+  for (int i = 0; i < chainLength; i++) {
+    promise = promise.thenPromise([] {
+      Promise<void> command;
+
+      command.resolve();
+      return command;
+    });
+  }
+  return promise;
+}
+
+static Promise<int> buildThenChain(Promise<int> first) {
+  auto promise = first;
+
+  for (int i = 0; i < chainLength; i++) {
+    promise = promise.then<int>([](int value) { return value + 1; });
+  }
+  return promise;
+}
+
+template <class Body>
+static void measure(const string& name, Body body) {
+  auto before = allocationsCount;
+
+  body();
+  cout << "  allocations per chain: " << allocationsCount - before << endl;
+  Benchmark::run(name, body);
+}
+
+int main() {
+  measure("promise/15 x thenPromise, build + resolve", [] {
+    Promise<void> first;
+    auto last = buildThenPromiseChain(first);
+    bool done = false;
+
+    last.then([&done] { done = true; });
+    first.resolve();
+    Benchmark::doNotOptimize(done);
+  });
+
+  measure("promise/15 x thenPromise on resolved promise", [] {
+    Promise<void> first;
+
+    first.resolve();
+    auto last = buildThenPromiseChain(first);
+    Benchmark::doNotOptimize(last);
+  });
+
+  measure("promise/15 x then<int>, build + resolve", [] {
+    Promise<int> first;
+    auto last = buildThenChain(first);
+    int result = 0;
+
+    last.then([&result](int value) { result = value; });
+    first.resolve(0);
+    Benchmark::doNotOptimize(result);
+  });
+
+  // a response body passing promises which only forward it, as the results of EasyPayBackend requests do
+  const string body(4096, 'x');
+  measure("promise/4 KiB payload, 5 forwarding hops", [&body] {
+    Promise<string> first;
+    size_t size = 0;
+    auto promise = first;
+
+    for (int i = 0; i < 5; i++) {
+      promise = promise.recover([](const exception_ptr&) { return string(); });
+    }
+    promise.then([&size](const string& value) { size = value.size(); });
+    promise = Promise<string>();
+    first.resolve(string(body));
+    Benchmark::doNotOptimize(size);
+  });
+
+  measure("promise/create + resolve", [] {
+    Promise<string> promise;
+
+    promise.resolve("ok");
+    Benchmark::doNotOptimize(promise);
+  });
+
+  return 0;
+}
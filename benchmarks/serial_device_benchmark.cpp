@@ -0,0 +1,137 @@
+#include "../lib/device/auto_device_impl.hpp"
+#include "../lib/device/serial_device.hpp"
+#include "../lib/io/iocontext_impl.hpp"
+#include "../simulator/include/simulated_device.hpp"
+#include "benchmark.hpp"
+
+#include <future>
+#include <thread>
+
+using namespace JetBeep;
+using namespace Simulator;
+using namespace std;
+
+// blocks until the promise settles, the same way dfu_main waits for device commands
+template <typename T>
+static T wait(Promise<T> promise) {
+  std::promise<T> result;
+  auto future = result.get_future();
+
+  promise.then([&result](const T& value) { result.set_value(value); })
+    .catchError([&result](const exception_ptr& error) { result.set_exception(error); });
+  return future.get();
+}
+
+static void wait(Promise<void> promise) {
+  std::promise<void> result;
+  auto future = result.get_future();
+
+  promise.then([&result] { result.set_value(); }).catchError([&result](const exception_ptr& error) {
+    result.set_exception(error);
+  });
+  future.get();
+}
+
+namespace JetBeep {
+  // a managed AutoDevice, attached to the pty the way AutoDeviceManager attaches a detected reader
+  struct AutoDeviceBenchmark {
+    // returns once the device is initialized
+    static shared_ptr<AutoDevice> attach(const string& path) {
+      auto device = shared_ptr<AutoDevice>(new AutoDevice(IOContext::context, true));
+      auto ready = make_shared<std::promise<void>>();
+      auto isReady = make_shared<bool>(false);
+      auto readyFuture = ready->get_future();
+
+      // state callbacks run on the strand of the device, also after this returns
+      device->stateCallback = [ready, isReady](AutoDeviceState state, exception_ptr) {
+        if (state == AutoDeviceState::sessionClosed && !*isReady) {
+          *isReady = true;
+          ready->set_value();
+        }
+      };
+      device->m_impl->start();
+      device->m_impl->attach({0, 0, path});
+      readyFuture.get();
+      return device;
+    }
+
+    static shared_ptr<IOStrand> strand(AutoDevice& device) {
+      return device.m_impl->strand();
+    }
+  };
+} // namespace JetBeep
+
+int main() {
+  // the simulated device answers on its own thread, so each round trip crosses the pty twice like with a reader
+  boost::asio::io_service ioService;
+  SimulatorOptions options;
+
+  options.scenario.commandActions.insert({"CREATE_PAYMENT_TOKEN", {chrono::milliseconds(0), "PAYMENT_TOKEN c2ltdWxhdGVk"}});
+
+  SimulatedDevice simulatedDevice(ioService, options);
+  simulatedDevice.start();
+  thread simulatorThread([&ioService] { ioService.run(); });
+
+  SerialDevice device;
+  device.open(simulatedDevice.path());
+
+  Benchmark::run("serial/get round trip", [&device] {
+    auto value = wait(device.get(DeviceParameter::version));
+    Benchmark::doNotOptimize(value);
+  });
+
+  // the command sequence of an AutoDevice token payment: openSession -> createPaymentToken -> closeSession
+  std::promise<string>* token = nullptr;
+  device.paymentTokenCallback = [&token](const string& value) { token->set_value(value); };
+  Benchmark::run("serial/token payment cycle", [&device, &token] {
+    std::promise<string> tokenReceived;
+
+    token = &tokenReceived;
+    wait(device.openSession());
+    wait(device.createPaymentToken(1500, "tx-000042"));
+    Benchmark::doNotOptimize(tokenReceived.get_future().get());
+    wait(device.closeSession());
+  });
+
+  constexpr int pipelineDepth = 100;
+  device.setPipelined(true);
+  Benchmark::run(
+    "serial/pipelined get, 100 in flight",
+    [&device] {
+      vector<Promise<string>> values;
+
+      values.reserve(pipelineDepth);
+      for (int i = 0; i < pipelineDepth; i++) {
+        values.push_back(device.get(DeviceParameter::deviceId));
+      }
+      Benchmark::doNotOptimize(wait(Promise<string>::all(values)));
+    },
+    pipelineDepth);
+
+  device.close();
+
+  // the same cycle through AutoDevice. Operations are started on the strand of the device, as its promises are
+  // settled there
+  auto autoDevice = AutoDeviceBenchmark::attach(simulatedDevice.path());
+  auto strand = AutoDeviceBenchmark::strand(*autoDevice);
+
+  Benchmark::run("autodevice/token payment cycle", [&autoDevice, &strand] {
+    std::promise<string> token;
+
+    strand->post([&autoDevice, &token] {
+      autoDevice->openSession();
+      autoDevice->createPaymentToken(1500, "tx-000042")
+        .then([&autoDevice, &token](const string& value) {
+          autoDevice->closeSession();
+          token.set_value(value);
+        })
+        .catchError([&token](const exception_ptr& error) { token.set_exception(error); });
+    });
+    Benchmark::doNotOptimize(token.get_future().get());
+  });
+
+  autoDevice->stop();
+  ioService.stop();
+  simulatorThread.join();
+  return 0;
+}
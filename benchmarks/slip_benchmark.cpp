@@ -0,0 +1,70 @@
+#include "../dfu-module/include/slip_enc.h"
+#include "benchmark.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace JetBeep;
+using namespace std;
+
+static vector<uint8_t> encodedFrame(size_t size) {
+  vector<uint8_t> frame(size);
+  vector<uint8_t> encoded(size * 2 + 1);
+  uint32_t encodedSize = 0;
+
+  for (size_t i = 0; i < size; i++) {
+    frame[i] = (uint8_t)(i * 7);
+  }
+  encode_slip(encoded.data(), &encodedSize, frame.data(), (uint32_t)frame.size());
+  encoded.resize(encodedSize);
+  return encoded;
+}
+
+// uart_slip_receive before the streaming decoder: a byte is read at a time and the whole frame received so far is
+// decoded once more after each of them
+static uint32_t receivePerByte(const vector<uint8_t>& encoded, uint8_t* decoded) {
+  uint32_t size = 0;
+
+  for (uint32_t received = 1; received <= encoded.size(); received++) {
+    if (!decode_slip(decoded, &size, encoded.data(), received)) {
+      break;
+    }
+  }
+  return size;
+}
+
+// the bytes arrive in chunks of the UART_SLIP_RX_BUFF_SIZE and every one of them is decoded once
+static uint32_t receiveStreaming(const vector<uint8_t>& encoded, uint8_t* decoded, uint32_t dataSize) {
+  static const uint32_t chunkSize = 512;
+  slip_decoder_t decoder;
+  uint32_t position = 0;
+  uint32_t consumed = 0;
+
+  slip_decoder_init(&decoder, decoded, dataSize);
+  while (position < encoded.size()) {
+    uint32_t chunk = min(chunkSize, (uint32_t)encoded.size() - position);
+
+    if (slip_decoder_feed(&decoder, encoded.data() + position, chunk, &consumed) != SLIP_DECODE_MORE) {
+      break;
+    }
+    position += consumed;
+  }
+  return decoder.size;
+}
+
+int main() {
+  // a CRC response and the biggest frame of UART_SLIP_SIZE_MAX
+  for (size_t size : {11, 4096}) {
+    auto encoded = encodedFrame(size);
+    vector<uint8_t> decoded(size * 2);
+    auto suffix = " (" + to_string(size) + " bytes)";
+
+    Benchmark::run("slip/per byte re-decode" + suffix, [&] {
+      Benchmark::doNotOptimize(receivePerByte(encoded, decoded.data()));
+    });
+    Benchmark::run("slip/streaming decoder" + suffix, [&] {
+      Benchmark::doNotOptimize(receiveStreaming(encoded, decoded.data(), (uint32_t)decoded.size()));
+    });
+  }
+  return 0;
+}
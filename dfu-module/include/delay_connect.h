@@ -43,6 +43,8 @@
 #ifndef _INC_DELAY_CONNECT
 #define _INC_DELAY_CONNECT
 
+#include <stdint.h>
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -52,6 +54,9 @@ int delay_connect(void);
 void delay_boot(void);
 void delay_flash_write(void);
 
+// milliseconds of a monotonic clock, to measure intervals only
+uint32_t delay_get_tick_ms(void);
+
 
 #ifdef __cplusplus
 }   /* ... extern "C" */
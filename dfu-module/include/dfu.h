@@ -52,15 +52,32 @@ extern "C" {
 #endif  /* __cplusplus */
 
 
+// a firmware package opened once for all of the devices: the file is mapped to memory and its manifest is parsed,
+// the devices updated at the same time send it from there
+typedef struct dfu_package dfu_package_t;
+
+dfu_package_t *dfu_package_open(const char *p_pkg_file);
+
+void dfu_package_close(dfu_package_t *p_pkg);
+
 typedef struct
 {
 	uart_drv_t *p_uart;
 
-	char *p_pkg_file;
+	dfu_package_t *p_pkg;
 } dfu_param_t;
 	
 int dfu_send_package(dfu_param_t *p_dfu);
 
+typedef struct
+{
+	uint32_t app_version;               //!< Version of the application image from its init packet, 0 if unknown.
+	uint32_t app_size;                  //!< Size of the application image from its init packet.
+} dfu_package_info_t;
+
+// what the package installs, read without sending it
+void dfu_get_package_info(const dfu_package_t *p_pkg, dfu_package_info_t *p_info);
+
 #ifdef __cplusplus
 }   /* ... extern "C" */
 #endif  /* __cplusplus */
@@ -0,0 +1,61 @@
+#ifndef _INC_DFU_CTX
+#define _INC_DFU_CTX
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  /* __cplusplus */
+
+#include "uart_slip.h"
+
+
+// SLIP data log buffer size
+#define DFU_CTX_LOGGER_BUFF_SIZE	1024
+
+// largest data object of the bootloader, the flash page size of the nRF52
+#define DFU_CTX_OBJECT_SIZE_MAX		4096
+
+// state of the DFU procedure of a single device, referenced by uart_drv_t::p_ctx. Every device updated at the same
+// time needs its own one, zero initialized
+typedef struct dfu_ctx {
+	// uart_slip.c
+	uint8_t  slip_buff[UART_SLIP_BUFF_SIZE];
+	uint8_t  slip_rx_buff[UART_SLIP_RX_BUFF_SIZE];
+	uint32_t slip_rx_pos;
+	uint32_t slip_rx_len;
+
+	// dfu_serial.c
+	uint8_t  ping_id;
+	uint16_t prn;               // packet receipt notification interval the bootloader is set to
+	uint16_t mtu;
+	uint16_t prn_checkpoints;   // receipts per data object, grows with CRC errors
+	uint16_t prn_window;        // receipts which may be outstanding while the writes go on
+	uint16_t clean_objects;     // data objects sent without an error since the last checkpoints change
+	uint32_t object_ms;         // time to stream the last data object
+	uint32_t rtt_ms;            // smoothed time from the last write of an object to its CRC
+	uint32_t fw_size;           // size of the firmware image being sent
+	uint32_t fw_max_size;       // data object size of the bootloader
+	uint32_t fw_pos;            // offset of the next data object
+	uint32_t fw_crc;            // CRC of the image up to fw_pos
+	uint32_t fw_recover_offset; // data the bootloader has got before, 0 if it starts over
+	uint32_t fw_recover_crc;
+	uint8_t  fw_pending;        // responses to the execute and the create of the next object are not read yet
+	uint8_t  send_data[UART_SLIP_SIZE_MAX];
+	uint8_t  receive_data[UART_SLIP_SIZE_MAX];
+	char     logger_buff[DFU_CTX_LOGGER_BUFF_SIZE];
+
+	// dfu.c
+	uint8_t  object_buff[DFU_CTX_OBJECT_SIZE_MAX];   // data object being inflated from the package
+
+	// extended error code of the last failed response, see ext_error.h
+	int      ext_error_code;
+} dfu_ctx_t;
+
+
+#ifdef __cplusplus
+}   /* ... extern "C" */
+#endif  /* __cplusplus */
+
+
+#endif // _INC_DFU_CTX
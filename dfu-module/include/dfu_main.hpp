@@ -11,13 +11,25 @@ enum class DeviceConfigState { CONFIGURED, PARTIAL, BLANK, UNKNOWN };
 struct DeviceInfo {
   DeviceBootState bootState = DeviceBootState::UNKNOWN;
   DeviceConfigState configState = DeviceConfigState::UNKNOWN;
-  uint32_t deviceId;
+  uint32_t deviceId = 0;
   string pubKey;
   string version;
   string revision;
   string chipId;
   string systemPath;
-  bool nativeUSBSupport;
+  bool nativeUSBSupport = false;
+};
+
+// one of the devices updated at the same time
+struct DeviceUpdate {
+  DeviceInfo deviceInfo;
+  string name;
+  string prevFwVersion;
+  bool isFwUpToDate = false;  // none of the packages has to be sent
+  bool isAppUpToDate = false; // the application package does not have to be sent
+  bool updateFwDone = false;
+  bool updateConfigDone = false;
+  string error;
 };
 
 
@@ -57,10 +57,17 @@ int dfu_serial_close(uart_drv_t *p_uart);
 
 int dfu_serial_send_init_packet(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size);
 
-int dfu_serial_send_firmware(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size);
+// selects the firmware image of data_size bytes, it is sent in data objects of *p_max_size bytes
+int dfu_serial_begin_firmware(uart_drv_t *p_uart, uint32_t data_size, uint32_t *p_max_size);
+
+// sends the next data object of the image: max_size bytes, or the rest of the image for the last one
+int dfu_serial_send_firmware_object(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t obj_size);
 
 int dfu_serial_ping(uart_drv_t *p_uart, uint8_t id);
 
+// ends the DFU procedure, the bootloader resets and starts the application if it is valid
+int dfu_serial_abort(uart_drv_t *p_uart);
+
 #ifdef __cplusplus
 }   /* ... extern "C" */
 #endif  /* __cplusplus */
@@ -2,15 +2,17 @@
 #define _INC_EXT_ERROR_H
 
 #include <stdint.h>
+#include "uart_drv.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif  /* __cplusplus */
 
 
-void set_ext_error_code(int code);
+void set_ext_error_code(uart_drv_t *p_uart, int code);
 
-int get_ext_error_code();
+// the code of the last failed response of the device, it is reset once read
+int get_ext_error_code(uart_drv_t *p_uart);
 
 #ifdef __cplusplus
 }   /* ... extern "C" */
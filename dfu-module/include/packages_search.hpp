@@ -1,6 +1,7 @@
 #ifndef PACKAGES_SEARCH_HPP
 #define PACKAGES_SEARCH_HPP
 
+#include <cstdint>
 #include <vector>
 #include <string>
 
@@ -21,6 +22,7 @@ struct PackageInfo {
     std::string path = "";
     PackageType type = PackageType::UNKNOWN;
     PackageDFUStyle dfuStyle = PackageDFUStyle::UNKNOWN;
+    uint32_t appVersion = 0; // from the init packet of the application image, 0 if there is none
 };
 
 inline PackageDFUStyle stringToDFUStyle(std::string str) {
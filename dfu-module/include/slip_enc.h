@@ -43,6 +43,7 @@
 #ifndef _INC_SLIP_ENC
 #define _INC_SLIP_ENC
 
+#include <stdbool.h>
 #include <stdint.h>
 
 
@@ -56,6 +57,25 @@ void encode_slip(uint8_t *pDestData, uint32_t *pDestSize, const uint8_t *pSrcDat
 int  decode_slip(uint8_t *pDestData, uint32_t *pDestSize, const uint8_t *pSrcData, uint32_t nSrcSize);
 
 
+#define SLIP_DECODE_DONE		0
+#define SLIP_DECODE_MORE		1
+#define SLIP_DECODE_ERROR		2
+
+// state of a frame which is decoded while its bytes arrive
+typedef struct {
+    uint8_t  *p_dest;
+    uint32_t dest_size;
+    uint32_t size;
+    bool     is_escaped;
+} slip_decoder_t;
+
+void slip_decoder_init(slip_decoder_t *p_decoder, uint8_t *pDestData, uint32_t nDestSize);
+
+// decodes the received bytes up to the end of the frame, *pConsumed bytes are used. Returns SLIP_DECODE_DONE with
+// p_decoder->size bytes decoded, SLIP_DECODE_MORE if the frame continues in the next bytes or SLIP_DECODE_ERROR
+int  slip_decoder_feed(slip_decoder_t *p_decoder, const uint8_t *pSrcData, uint32_t nSrcSize, uint32_t *pConsumed);
+
+
 #ifdef __cplusplus
 }   /* ... extern "C" */
 #endif  /* __cplusplus */
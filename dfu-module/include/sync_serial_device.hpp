@@ -2,6 +2,7 @@
 #define DFU_SERIAL_DEVICE__HPP
 
 #include "../lib/libjetbeep.hpp"
+#include <chrono>
 #include <iterator>
 #include <mutex>
 #include <thread>
@@ -26,6 +27,7 @@ namespace DFU {
     void enterDFUMode();
     void reset();
 
+    // reads whatever is received up to the size, waits for at least one byte until the read timeout
     size_t readBytes(void * p_data, size_t size);
     void writeBytes(void * p_data, size_t size);
 
@@ -33,6 +35,8 @@ namespace DFU {
     string getResponseStr();
     string getCmd(string prop);
 
+    static const std::chrono::milliseconds readTimeout;
+
     boost::asio::streambuf m_readBuffer;
     JetBeep::Logger m_log;
     boost::asio::io_service m_io_service;
@@ -53,8 +53,11 @@ extern "C" {
 #endif  /* __cplusplus */
 
 
+struct dfu_ctx;
+
 typedef struct {
     void * p_serial_device;
+    struct dfu_ctx * p_ctx;
 } uart_drv_t;
 
 int uart_drv_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize);
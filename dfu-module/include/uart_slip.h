@@ -48,6 +48,8 @@
 
 
 #define UART_SLIP_SIZE_MAX		4096
+#define UART_SLIP_BUFF_SIZE		(UART_SLIP_SIZE_MAX * 2 + 1)
+#define UART_SLIP_RX_BUFF_SIZE	512
 
 int uart_slip_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize);
 
@@ -41,6 +41,7 @@
 #ifdef WIN32
 #include <windows.h>
 #else
+#include <time.h>
 #include <unistd.h>
 #endif
 #include "delay_connect.h"
@@ -80,3 +81,13 @@ void delay_flash_write(void) {
 #endif
 }
 
+uint32_t delay_get_tick_ms(void) {
+#ifdef WIN32
+  return (uint32_t)GetTickCount();
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+#endif
+}
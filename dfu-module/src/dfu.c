@@ -41,19 +41,50 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "dfu.h"
+#include "dfu_ctx.h"
 #include "dfu_serial.h"
 #include "delay_connect.h"
 #include "logging.h"
-#include "zip.h"
 #include "jsmn.h"
 
+// the implementation is built with zip.c
+#define MINIZ_HEADER_FILE_ONLY
+#include "miniz.h"
+
 // maximum number of JSON tokens to process
 #define JSON_TOKEN_NUM_MAX              30
 
 // maximum number of DFU objects to process
 #define DFU_OBJECT_NUM_MAX              3
 
+#define MIN(a,b) (((a) < (b)) ? (a) : (b))
+
+// maximum init packet size, see INIT_COMMAND_MAX_SIZE of the nRF5 SDK bootloader
+#define DFU_INIT_PACKET_SIZE_MAX        512
+
+// protobuf wire types
+#define PB_WIRE_VARINT                  0
+#define PB_WIRE_FIXED64                 1
+#define PB_WIRE_BYTES                   2
+#define PB_WIRE_FIXED32                 5
+
+// fields of the init packet messages, see dfu-cc.proto of the nRF5 SDK
+#define DFU_PB_PACKET_COMMAND           1
+#define DFU_PB_PACKET_SIGNED_COMMAND    2
+#define DFU_PB_SIGNED_COMMAND_COMMAND   1
+#define DFU_PB_COMMAND_INIT             2
+#define DFU_PB_INIT_FW_VERSION          1
+#define DFU_PB_INIT_APP_SIZE            7
+
 typedef enum {
 	DFU_IMG_NIL = 0,                    //!< DFU image invalid
 	DFU_IMG_APP = 1,                    //!< DFU application image
@@ -94,15 +125,33 @@ typedef struct
 
 	uint8_t *p_img_dat;                 //!< Image DAT pointer.
 	uint32_t n_dat_size;                //!< Image DAT size.
-	uint8_t *p_img_bin;                 //!< Image BIN pointer.
+	mz_zip_archive *p_zip;              //!< Package of the image BIN.
+	mz_uint n_bin_index;                //!< Image BIN index in the package.
 	uint32_t n_bin_size;                //!< Image BIN size.
 } dfu_img_param_t;
 
-// JSON tokens
-static jsmntok_t json_tokens[JSON_TOKEN_NUM_MAX];
+// image BIN inflated into the data object buffer of the device
+typedef struct
+{
+	uart_drv_t *p_uart;
 
-// DFU objects
-static dfu_json_object_t dfu_objects[DFU_OBJECT_NUM_MAX];
+	uint32_t n_bin_size;                //!< Image BIN size.
+	uint32_t max_size;                  //!< Data object size.
+	uint32_t pos;                       //!< Offset of the data object in the buffer.
+	uint32_t buff_len;                  //!< Bytes in the buffer.
+	int err_code;
+} dfu_bin_stream_t;
+
+struct dfu_package
+{
+	uint8_t *p_map;                     //!< Package file mapped to memory.
+	size_t map_size;                    //!< Package file size.
+	mz_zip_archive zip;                 //!< Reader of the mapped file, only read while the images are sent.
+
+	int num_images;                     //!< Number of DFU images of the manifest.
+	dfu_json_object_t dfu_objects[DFU_OBJECT_NUM_MAX];
+	dfu_package_info_t info;
+};
 
 // JSMN token pattern for Manifest
 static const jsmn_entity_t dfu_mft_pattern[] =
@@ -295,6 +344,100 @@ static void free_dfu_json_obj(dfu_json_object_t *p_dfu_obj)
 	}
 }
 
+// the objects go out as soon as they are inflated: the compressed data is read right from the mapped package and
+// only a data object of it is held per device. Whole objects of the inflated data are sent without a copy, the last
+// one waits in the buffer until the CRC of the entry is checked
+static size_t dfu_bin_stream_write(void *p_opaque, mz_uint64 file_ofs, const void *p_buf, size_t n)
+{
+	dfu_bin_stream_t *p_stream = (dfu_bin_stream_t *)p_opaque;
+	uint8_t *object_buff = p_stream->p_uart->p_ctx->object_buff;
+	const uint8_t *p_data = (const uint8_t *)p_buf;
+	size_t n_left = n;
+	uint32_t obj_size, stp;
+
+	// the entry is inflated in order, so its data goes on right after the bytes taken already
+	if (file_ofs != p_stream->pos + p_stream->buff_len)
+	{
+		logger_error("Invalid package BIN file offset!");
+
+		p_stream->err_code = 1;
+	}
+	else if (n > p_stream->n_bin_size - p_stream->pos - p_stream->buff_len)
+	{
+		logger_error("Invalid package BIN file size!");
+
+		p_stream->err_code = 1;
+	}
+
+	while (!p_stream->err_code && n_left)
+	{
+		obj_size = MIN(p_stream->n_bin_size - p_stream->pos, p_stream->max_size);
+
+		if (!p_stream->buff_len && n_left >= obj_size && p_stream->pos + obj_size < p_stream->n_bin_size)
+		{
+			stp = obj_size;
+			p_stream->err_code = dfu_serial_send_firmware_object(p_stream->p_uart, p_data, obj_size);
+			p_stream->pos += obj_size;
+		}
+		else
+		{
+			stp = (uint32_t)MIN(n_left, obj_size - p_stream->buff_len);
+			memcpy(object_buff + p_stream->buff_len, p_data, stp);
+			p_stream->buff_len += stp;
+
+			if (p_stream->buff_len == obj_size && p_stream->pos + obj_size < p_stream->n_bin_size)
+			{
+				p_stream->err_code = dfu_serial_send_firmware_object(p_stream->p_uart, object_buff, obj_size);
+				p_stream->pos += obj_size;
+				p_stream->buff_len = 0;
+			}
+		}
+
+		p_data += stp;
+		n_left -= stp;
+	}
+
+	return p_stream->err_code ? 0 : n;
+}
+
+static int dfu_send_bin(dfu_img_param_t *p_dfu_img)
+{
+	int err_code;
+	dfu_bin_stream_t stream;
+
+	stream.p_uart = p_dfu_img->p_uart;
+	stream.n_bin_size = p_dfu_img->n_bin_size;
+	stream.pos = 0;
+	stream.buff_len = 0;
+	stream.err_code = 0;
+
+	err_code = dfu_serial_begin_firmware(p_dfu_img->p_uart, p_dfu_img->n_bin_size, &stream.max_size);
+
+	if (!err_code)
+	{
+		if (!mz_zip_reader_extract_to_callback(p_dfu_img->p_zip, p_dfu_img->n_bin_index, dfu_bin_stream_write, &stream, 0))
+		{
+			if (!stream.err_code)
+				logger_error("Cannot read package BIN file!");
+
+			err_code = 1;
+		}
+		else if (stream.pos + stream.buff_len != stream.n_bin_size)
+		{
+			logger_error("Invalid package BIN file size!");
+
+			err_code = 1;
+		}
+	}
+
+	if (!err_code)
+	{
+		err_code = dfu_serial_send_firmware_object(p_dfu_img->p_uart, p_dfu_img->p_uart->p_ctx->object_buff, stream.buff_len);
+	}
+
+	return err_code;
+}
+
 static int dfu_send_image(dfu_img_param_t *p_dfu_img)
 {
 	int err_code;
@@ -308,7 +451,7 @@ static int dfu_send_image(dfu_img_param_t *p_dfu_img)
 
 	if (!err_code)
 	{
-		err_code = dfu_serial_send_firmware(p_dfu_img->p_uart, p_dfu_img->p_img_bin, p_dfu_img->n_bin_size);
+		err_code = dfu_send_bin(p_dfu_img);
 	}
 
 	if (!err_code)
@@ -319,72 +462,76 @@ static int dfu_send_image(dfu_img_param_t *p_dfu_img)
 	return err_code;
 }
 
-static int dfu_send_object(uart_drv_t *p_uart, dfu_json_object_t *p_dfu_obj, struct zip_t *p_zip_pkg)
+// find a file of the package, its size has to fit the DFU protocol
+static int dfu_locate_file(mz_zip_archive *p_zip, const char *p_name, mz_uint *p_index, uint32_t *p_size)
+{
+	int index;
+	mz_zip_archive_file_stat file_stat;
+
+	index = mz_zip_reader_locate_file(p_zip, p_name, NULL, 0);
+
+	if (index < 0 || !mz_zip_reader_file_stat(p_zip, (mz_uint)index, &file_stat) || file_stat.m_uncomp_size > UINT32_MAX)
+		return 1;
+
+	*p_index = (mz_uint)index;
+	*p_size = (uint32_t)file_stat.m_uncomp_size;
+
+	return 0;
+}
+
+static int dfu_read_dat(mz_zip_archive *p_zip, const char *p_file_dat, uint8_t *p_dat, uint32_t *p_dat_size)
 {
 	int err_code = 0;
-	uint8_t *buf_dat = NULL;
-	size_t buf_dat_size;
-	uint8_t *buf_bin = NULL;
-	size_t buf_bin_size;
-	dfu_img_param_t dfu_img;
+	mz_uint index;
 
-	if (zip_entry_open(p_zip_pkg, p_dfu_obj->file_dat))
+	if (dfu_locate_file(p_zip, p_file_dat, &index, p_dat_size))
 	{
 		logger_error("Cannot open package DAT file!");
 
 		err_code = 1;
 	}
-	else
+	else if (*p_dat_size > DFU_INIT_PACKET_SIZE_MAX)
 	{
-		if (zip_entry_read(p_zip_pkg, (void **)&buf_dat, &buf_dat_size))
-		{
-			logger_error("Cannot read package DAT file!");
+		logger_error("Init packet too big!");
 
-			err_code = 1;
-		}
+		err_code = 1;
+	}
+	else if (!mz_zip_reader_extract_to_mem(p_zip, index, p_dat, DFU_INIT_PACKET_SIZE_MAX, 0))
+	{
+		logger_error("Cannot read package DAT file!");
 
-		zip_entry_close(p_zip_pkg);
+		err_code = 1;
 	}
 
-	if (!err_code)
-	{
-		if (zip_entry_open(p_zip_pkg, p_dfu_obj->file_bin))
-		{
-			logger_error("Cannot open package BIN file!");
+	return err_code;
+}
 
-			err_code = 1;
-		}
-		else
-		{
-			if (zip_entry_read(p_zip_pkg, (void **)&buf_bin, &buf_bin_size))
-			{
-				logger_error("Cannot read package BIN file!");
+static int dfu_send_object(uart_drv_t *p_uart, const dfu_json_object_t *p_dfu_obj, mz_zip_archive *p_zip)
+{
+	int err_code = 0;
+	uint8_t buf_dat[DFU_INIT_PACKET_SIZE_MAX];
+	dfu_img_param_t dfu_img;
 
-				err_code = 1;
-			}
+	dfu_img.p_uart = p_uart;
+	dfu_img.p_img_dat = buf_dat;
+	dfu_img.p_zip = p_zip;
 
-			zip_entry_close(p_zip_pkg);
-		}
+	err_code = dfu_read_dat(p_zip, p_dfu_obj->file_dat, buf_dat, &dfu_img.n_dat_size);
+
+	if (!err_code && dfu_locate_file(p_zip, p_dfu_obj->file_bin, &dfu_img.n_bin_index, &dfu_img.n_bin_size))
+	{
+		logger_error("Cannot open package BIN file!");
+
+		err_code = 1;
 	}
 
 	if (!err_code)
 	{
-		dfu_img.p_uart = p_uart;
-		dfu_img.p_img_dat = buf_dat;
-		dfu_img.n_dat_size = buf_dat_size;
-		dfu_img.p_img_bin = buf_bin;
-		dfu_img.n_bin_size = buf_bin_size;
 		logger_progress_start();
 		err_code = dfu_send_image(&dfu_img);
 		logger_progress_end(err_code);
 	}
 
-	if (buf_dat != NULL)
-		free(buf_dat);
-
-	if (buf_bin != NULL)
-		free(buf_bin);
-
 	return err_code;
 }
 
@@ -405,66 +552,25 @@ static dfu_json_object_t *find_dfu_object(dfu_json_object_t *p_dfu_obj, int num_
 	return p_obj;
 }
 
-int dfu_send_package(dfu_param_t *p_dfu)
+// read the DFU images of the package manifest, their file names are allocated in dfu_objects
+static int dfu_read_manifest(const uint8_t *buf_json, size_t bufsize, dfu_json_object_t *dfu_objects, int *p_num_images)
 {
 	int err_code = 0;
-	struct zip_t *zip_pkg;
-	uint8_t *buf_json = NULL;
-	size_t bufsize;
 	jsmn_parser parser;
 	int num_tokens;
-	int num_images, img_n = 0;
-	dfu_json_object_t *p_dfu_object;
+	int num_images = 0, img_n = 0;
 	int i, n;
+	jsmntok_t json_tokens[JSON_TOKEN_NUM_MAX];
 
-	zip_pkg = zip_open(p_dfu->p_pkg_file, 0, 'r');
-	if (zip_pkg == NULL)
-	{
-		logger_error("Cannot open ZIP package file!");
-
-		err_code = 1;
-	}
-	else
-	{
-		if (zip_entry_open(zip_pkg, "manifest.json"))
-		{
-			logger_error("Cannot open package manifest file!");
-
-			err_code = 1;
-		}
-		else
-		{
-			if (zip_entry_read(zip_pkg, (void **)&buf_json, &bufsize))
-			{
-				logger_error("Cannot read package manifest file!");
+	jsmn_init(&parser);
 
-				err_code = 1;
-			}
-			else
-			{
-				zip_entry_close(zip_pkg);
-			}
-		}
-	}
+	num_tokens = jsmn_parse(&parser, (const char *)buf_json, bufsize, json_tokens, JSON_TOKEN_NUM_MAX);
 
-	if (!err_code)
+	if (num_tokens < 0)
 	{
-		jsmn_init(&parser);
-
-		num_tokens = jsmn_parse(&parser, (char *)buf_json, bufsize, json_tokens, JSON_TOKEN_NUM_MAX);
+		logger_error("Cannot parse package manifest json (%d)!", num_tokens);
 
-		if (num_tokens < 0)
-		{
-			logger_error("Cannot parse package manifest json (%d)!", num_tokens);
-
-			err_code = 1;
-		}
-	}
-
-	for (i = 0; i < DFU_OBJECT_NUM_MAX; i++)
-	{
-		dfu_objects[i].file_bin = NULL;
-		dfu_objects[i].file_dat = NULL;
+		err_code = 1;
 	}
 
 	if (!err_code)
@@ -552,6 +658,19 @@ int dfu_send_package(dfu_param_t *p_dfu)
 		}
 	}
 
+	*p_num_images = num_images;
+
+	return err_code;
+}
+
+int dfu_send_package(dfu_param_t *p_dfu)
+{
+	int err_code = 0;
+	dfu_package_t *p_pkg = p_dfu->p_pkg;
+	dfu_json_object_t *dfu_objects = p_pkg->dfu_objects;
+	int num_images = p_pkg->num_images;
+	dfu_json_object_t *p_dfu_object;
+
 	if (!err_code)
 	{
 		// send SoftDevice & bootloader image, if any
@@ -560,7 +679,7 @@ int dfu_send_package(dfu_param_t *p_dfu)
 		{
 			logger_info_1("Sending SoftDevice+Bootloader image.");
 
-			err_code = dfu_send_object(p_dfu->p_uart, p_dfu_object, zip_pkg);
+			err_code = dfu_send_object(p_dfu->p_uart, p_dfu_object, &p_pkg->zip);
 
 			if (!err_code && num_images > 1)
 				err_code = delay_connect();
@@ -575,7 +694,7 @@ int dfu_send_package(dfu_param_t *p_dfu)
 		{
 			logger_info_1("Sending SoftDevice image.");
 
-			err_code = dfu_send_object(p_dfu->p_uart, p_dfu_object, zip_pkg);
+			err_code = dfu_send_object(p_dfu->p_uart, p_dfu_object, &p_pkg->zip);
 
 			if (!err_code && num_images > 1)
 				err_code = delay_connect();
@@ -590,7 +709,7 @@ int dfu_send_package(dfu_param_t *p_dfu)
 		{
 			logger_info_1("Sending Bootloader image.");
 
-			err_code = dfu_send_object(p_dfu->p_uart, p_dfu_object, zip_pkg);
+			err_code = dfu_send_object(p_dfu->p_uart, p_dfu_object, &p_pkg->zip);
 
 			if (!err_code && num_images > 1)
 				err_code = delay_connect();
@@ -605,18 +724,261 @@ int dfu_send_package(dfu_param_t *p_dfu)
 		{
 			logger_info_1("Sending Application image.");
 
-			err_code = dfu_send_object(p_dfu->p_uart, p_dfu_object, zip_pkg);
+			err_code = dfu_send_object(p_dfu->p_uart, p_dfu_object, &p_pkg->zip);
 		}
 	}
 
-	for (i = 0; i < DFU_OBJECT_NUM_MAX; i++)
-		free_dfu_json_obj(dfu_objects + i);
+	return err_code;
+}
+
+// read a protobuf varint, returns the number of bytes it takes or 0 if it is broken
+static uint32_t pb_read_varint(const uint8_t *p_data, uint32_t size, uint32_t *p_value)
+{
+	uint32_t n;
+	uint32_t value = 0;
+
+	for (n = 0; n < size && n < 5; n++)
+	{
+		value |= (uint32_t)(p_data[n] & 0x7F) << (7 * n);
+
+		if (!(p_data[n] & 0x80))
+		{
+			*p_value = value;
+			return n + 1;
+		}
+	}
+
+	return 0;
+}
+
+// find a field of a protobuf message: the value of a varint field, or the bytes of a length delimited one
+static int pb_find_field(const uint8_t *p_msg, uint32_t msg_size, uint32_t field,
+						 uint32_t *p_value, const uint8_t **pp_bytes)
+{
+	uint32_t pos = 0, n, key, value;
+
+	while (pos < msg_size)
+	{
+		n = pb_read_varint(p_msg + pos, msg_size - pos, &key);
+		if (!n)
+			break;
+		pos += n;
+
+		switch (key & 0x07)
+		{
+		case PB_WIRE_VARINT:
+		case PB_WIRE_BYTES:
+			n = pb_read_varint(p_msg + pos, msg_size - pos, &value);
+			if (!n)
+				return 1;
+			pos += n;
+
+			if ((key & 0x07) == PB_WIRE_BYTES)
+			{
+				if (value > msg_size - pos)
+					return 1;
+
+				if ((key >> 3) == field && pp_bytes != NULL)
+				{
+					*pp_bytes = p_msg + pos;
+					*p_value = value;
+					return 0;
+				}
+				pos += value;
+			}
+			else if ((key >> 3) == field && pp_bytes == NULL)
+			{
+				*p_value = value;
+				return 0;
+			}
+			break;
+		case PB_WIRE_FIXED32:
+			pos += 4;
+			break;
+		case PB_WIRE_FIXED64:
+			pos += 8;
+			break;
+		default:
+			return 1;
+		}
+	}
+
+	return 1;
+}
+
+// get the init command of an init packet, plain or signed
+static int dfu_get_init_command(const uint8_t *p_dat, uint32_t dat_size, const uint8_t **pp_init, uint32_t *p_init_size)
+{
+	const uint8_t *p_signed, *p_command;
+	uint32_t signed_size, command_size;
+
+	if (!pb_find_field(p_dat, dat_size, DFU_PB_PACKET_SIGNED_COMMAND, &signed_size, &p_signed))
+	{
+		if (pb_find_field(p_signed, signed_size, DFU_PB_SIGNED_COMMAND_COMMAND, &command_size, &p_command))
+			return 1;
+	}
+	else if (pb_find_field(p_dat, dat_size, DFU_PB_PACKET_COMMAND, &command_size, &p_command))
+	{
+		return 1;
+	}
+
+	return pb_find_field(p_command, command_size, DFU_PB_COMMAND_INIT, p_init_size, pp_init);
+}
+
+// map the package file to memory: the devices read the same pages of it, which are loaded only as they are inflated
+static int dfu_map_package(dfu_package_t *p_pkg, const char *p_pkg_file)
+{
+#ifdef WIN32
+	HANDLE h_file, h_mapping;
+	LARGE_INTEGER file_size;
+
+	h_file = CreateFileA(p_pkg_file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h_file == INVALID_HANDLE_VALUE)
+		return 1;
+
+	if (GetFileSizeEx(h_file, &file_size) && file_size.QuadPart > 0 && (ULONGLONG)file_size.QuadPart <= SIZE_MAX)
+	{
+		h_mapping = CreateFileMappingA(h_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (h_mapping != NULL)
+		{
+			p_pkg->p_map = (uint8_t *)MapViewOfFile(h_mapping, FILE_MAP_READ, 0, 0, 0);
+			p_pkg->map_size = (size_t)file_size.QuadPart;
+
+			CloseHandle(h_mapping);
+		}
+	}
+
+	CloseHandle(h_file);
+
+	return p_pkg->p_map == NULL;
+#else
+	int fd;
+	struct stat file_stat;
+	void *p_map = MAP_FAILED;
+
+	fd = open(p_pkg_file, O_RDONLY);
+	if (fd < 0)
+		return 1;
+
+	if (!fstat(fd, &file_stat) && file_stat.st_size > 0)
+	{
+		p_map = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+
+	close(fd);
+
+	if (p_map == MAP_FAILED)
+		return 1;
+
+	p_pkg->p_map = (uint8_t *)p_map;
+	p_pkg->map_size = (size_t)file_stat.st_size;
+
+	return 0;
+#endif
+}
+
+static void dfu_unmap_package(dfu_package_t *p_pkg)
+{
+	if (p_pkg->p_map == NULL)
+		return;
+
+#ifdef WIN32
+	UnmapViewOfFile(p_pkg->p_map);
+#else
+	munmap(p_pkg->p_map, p_pkg->map_size);
+#endif
+	p_pkg->p_map = NULL;
+}
+
+// the version of the application image, only it is reported by the device
+static void dfu_read_app_info(dfu_package_t *p_pkg)
+{
+	dfu_json_object_t *p_dfu_object;
+	uint8_t buf_dat[DFU_INIT_PACKET_SIZE_MAX];
+	uint32_t dat_size;
+	const uint8_t *p_init;
+	uint32_t init_size;
+
+	p_dfu_object = find_dfu_object(p_pkg->dfu_objects, p_pkg->num_images, DFU_IMG_APP);
+
+	if (p_dfu_object != NULL &&
+		!dfu_read_dat(&p_pkg->zip, p_dfu_object->file_dat, buf_dat, &dat_size) &&
+		!dfu_get_init_command(buf_dat, dat_size, &p_init, &init_size))
+	{
+		pb_find_field(p_init, init_size, DFU_PB_INIT_FW_VERSION, &p_pkg->info.app_version, NULL);
+		pb_find_field(p_init, init_size, DFU_PB_INIT_APP_SIZE, &p_pkg->info.app_size, NULL);
+	}
+}
+
+dfu_package_t *dfu_package_open(const char *p_pkg_file)
+{
+	int err_code = 0;
+	dfu_package_t *p_pkg;
+	void *buf_json = NULL;
+	size_t bufsize;
+
+	p_pkg = (dfu_package_t *)calloc(1, sizeof(dfu_package_t));
+	if (p_pkg == NULL)
+		return NULL;
+
+	if (dfu_map_package(p_pkg, p_pkg_file) ||
+		!mz_zip_reader_init_mem(&p_pkg->zip, p_pkg->p_map, p_pkg->map_size, 0))
+	{
+		logger_error("Cannot open ZIP package file!");
+
+		err_code = 1;
+	}
+
+	if (!err_code)
+	{
+		buf_json = mz_zip_reader_extract_file_to_heap(&p_pkg->zip, "manifest.json", &bufsize, 0);
+
+		if (buf_json == NULL)
+		{
+			logger_error("Cannot read package manifest file!");
+
+			err_code = 1;
+		}
+	}
+
+	if (!err_code)
+	{
+		err_code = dfu_read_manifest((const uint8_t *)buf_json, bufsize, p_pkg->dfu_objects, &p_pkg->num_images);
+	}
+
+	if (!err_code)
+	{
+		dfu_read_app_info(p_pkg);
+	}
 
 	if (buf_json != NULL)
-		free(buf_json);
+		mz_free(buf_json);
+
+	if (err_code)
+	{
+		dfu_package_close(p_pkg);
+		p_pkg = NULL;
+	}
 
-	if (zip_pkg != NULL)
-		zip_close(zip_pkg);
+	return p_pkg;
+}
 
-	return err_code;
+void dfu_package_close(dfu_package_t *p_pkg)
+{
+	int i;
+
+	if (p_pkg == NULL)
+		return;
+
+	for (i = 0; i < DFU_OBJECT_NUM_MAX; i++)
+		free_dfu_json_obj(p_pkg->dfu_objects + i);
+
+	mz_zip_reader_end(&p_pkg->zip);
+	dfu_unmap_package(p_pkg);
+	free(p_pkg);
+}
+
+void dfu_get_package_info(const dfu_package_t *p_pkg, dfu_package_info_t *p_info)
+{
+	*p_info = p_pkg->info;
 }
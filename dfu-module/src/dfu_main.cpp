@@ -4,12 +4,17 @@
 #include <string.h>
 #include <iostream>
 #include "uart_drv.h"
+#include "dfu_ctx.h"
 #include "delay_connect.h"
 #include "uart_slip.h"
 #include "dfu.h"
 #include "dfu_serial.h"
 #include "logging.h"
+#include <algorithm>
+#include <condition_variable>
 #include <future>
+#include <sstream>
+#include <thread>
 #include "libjetbeep.hpp"
 #include "sync_serial_device.hpp"
 #include "packages_search.hpp"
@@ -23,25 +28,55 @@ using namespace JetBeep;
 
 Logger l("main");
 
-static DeviceCandidate findJetBeepDeviceCandidate() {
-  l.i() << "Waiting for a JetBeep device ..." << Logger::endl;
-  std::promise<DeviceCandidate> detectionPromise;
+// devices which are connected already are reported at once, the lookup is over when no more of them show up
+static const chrono::milliseconds candidatesSettleTime(500);
+// time for the devices to come back after a reboot
+static const chrono::seconds candidatesLookupTimeout(10);
+
+// waits for the first device and returns all of the connected ones, or for the expectedCount of devices if it is set
+static vector<DeviceCandidate> findJetBeepDeviceCandidates(size_t expectedCount = 0) {
+  l.i() << "Waiting for JetBeep devices ..." << Logger::endl;
+  std::mutex candidatesMutex;
+  std::condition_variable candidatesChanged;
+  vector<DeviceCandidate> candidates;
   DeviceDetection deviceDetection;
-  deviceDetection.callback = [&detectionPromise](const DeviceDetectionEvent& event, const DeviceCandidate& candidate) {
+  deviceDetection.callback = [&](const DeviceDetectionEvent& event, const DeviceCandidate& candidate) {
+    std::lock_guard<std::mutex> lock(candidatesMutex);
+    auto path = candidate.path;
+
+    candidates.erase(remove_if(candidates.begin(), candidates.end(), [&path](const DeviceCandidate& c) { return c.path == path; }),
+                     candidates.end());
     if (event == DeviceDetectionEvent::added) {
-      detectionPromise.set_value(candidate);
-    } else {
-      detectionPromise.set_exception(make_exception_ptr(std::runtime_error("device removed")));
+      candidates.push_back(candidate);
     }
+    candidatesChanged.notify_all();
   };
-  auto detectionReady = detectionPromise.get_future();
   deviceDetection.start();
-  detectionReady.wait();
+  {
+    std::unique_lock<std::mutex> lock(candidatesMutex);
+
+    if (expectedCount == 0) {
+      candidatesChanged.wait(lock, [&candidates] { return !candidates.empty(); });
+      for (auto count = candidates.size();
+           candidatesChanged.wait_for(lock, candidatesSettleTime, [&] { return candidates.size() != count; });
+           count = candidates.size()) {
+      }
+    } else {
+      candidatesChanged.wait_for(lock, candidatesLookupTimeout, [&] { return candidates.size() >= expectedCount; });
+    }
+  }
   deviceDetection.stop();
-  const DeviceCandidate& candidate = detectionReady.get();
-  l.i() << "Found JetBeep device:" << candidate.path << " vid: " << candidate.vid << " pid: " << candidate.pid << Logger::endl;
+
+  vector<DeviceCandidate> found;
+  {
+    std::lock_guard<std::mutex> lock(candidatesMutex);
+    found = candidates;
+  }
+  for (auto& candidate : found) {
+    l.i() << "Found JetBeep device:" << candidate.path << " vid: " << candidate.vid << " pid: " << candidate.pid << Logger::endl;
+  }
   delay_boot(); //to handle case when device is just connected but not ready yet (win) 
-  return candidate;
+  return found;
 }
 
 static void resolveMcp2200Issue(JetBeep::SerialDevice& serial) {
@@ -62,22 +97,11 @@ static bool isValidDeviceInfo(DeviceInfo &deviceInfo) {
   return deviceInfo.bootState == DeviceBootState::APP && deviceInfo.chipId.length() == 16;
 }
 
-//on 52840 path may change after each device reboot
-static string updateDeviceSystemPath(DeviceInfo &deviceInfo) {
-  auto candidate = findJetBeepDeviceCandidate();
-  deviceInfo.nativeUSBSupport = candidate.isNativeUSB();
-  return deviceInfo.systemPath = candidate.path;
-}
-
-static DeviceInfo getDeviceInfo(bool updateSystemPath = false) {
+static DeviceInfo getDeviceInfo(DeviceCandidate candidate) {
   l.v() << "getDeviceInfo call" << Logger::endl;
-  static string systemPath;
   DeviceInfo deviceInfo;
-  if (updateSystemPath || systemPath.empty()) {
-    systemPath = updateDeviceSystemPath(deviceInfo);
-  } else {
-    deviceInfo.systemPath = systemPath;
-  }
+  deviceInfo.systemPath = candidate.path;
+  deviceInfo.nativeUSBSupport = candidate.isNativeUSB();
   
   JetBeep::SerialDevice serial;
   serial.open(deviceInfo.systemPath);
@@ -120,66 +144,310 @@ static DeviceInfo getDeviceInfo(bool updateSystemPath = false) {
   return deviceInfo;
 }
 
-static void updateFirmwareProcedure(DeviceInfo& deviceInfo, vector<PackageInfo>& zipPackages) {
-  int err_code = 0;
-  Logger dfuLogger("dfu");
-  logger_set_backend(&dfuLogger);
+// runs the step for every device without an error at the same time, each one in its own thread and with its own
+// logger. An exception is the error of its device only, the other devices go on
+static void forEachDevice(vector<DeviceUpdate>& updates, const function<void(DeviceUpdate&, Logger&)>& step) {
+  vector<thread> threads;
 
-  DFU::SyncSerialDevice syncSerialDevice = DFU::SyncSerialDevice();
-  uart_drv_t uart_drv = {&syncSerialDevice};
+  for (auto& update : updates) {
+    if (!update.error.empty()) {
+      continue;
+    }
+    threads.emplace_back([&update, &step]() {
+      Logger deviceLogger(update.name.c_str());
+      logger_set_backend(&deviceLogger);
+      try {
+        step(update, deviceLogger);
+      } catch (const exception& e) {
+        update.error = e.what();
+      } catch (...) {
+        update.error = "Unknown error";
+      }
+      if (!update.error.empty()) {
+        deviceLogger.e() << update.error << Logger::endl;
+      }
+      logger_set_backend(nullptr);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
 
-  syncSerialDevice.open(deviceInfo.systemPath);
+static void failLostDevice(DeviceUpdate& update) {
+  update.error = "Device is lost after reboot. Try to reconnect the device.";
+  l.e() << update.name << ": " << update.error << Logger::endl;
+}
 
-  if (deviceInfo.bootState == DeviceBootState::APP) {
-    l.v() << "Entering DFU mode..." << Logger::endl;
-    syncSerialDevice.enterDFUMode();
-    syncSerialDevice.close();
-    delay_boot();
-    updateDeviceSystemPath(deviceInfo);
-    syncSerialDevice.open(deviceInfo.systemPath);
+// on 52840 path may change after each device reboot. A device in the bootloader can't report its chipId, so a device
+// keeps its path if it is still there and a new path is only given when it can't be anybody else's: to the one device
+// without a path, if it is updated and the only new path is left. A failed device may have come back in the bootloader
+// under a new path too, a device which is not updated anymore and has lost its path makes the new paths ambiguous
+static void locateDevicesInBootloader(vector<DeviceUpdate>& updates, size_t devicesCount) {
+  auto candidates = findJetBeepDeviceCandidates(devicesCount);
+  auto isUpdated = [](const DeviceUpdate& update) { return update.error.empty() && !update.isFwUpToDate; };
+  vector<DeviceUpdate*> unmatchedUpdates;
+  size_t unmatchedCount = 0;
+
+  // the paths of all of the devices are out of the pool, also of the failed and finished ones
+  for (auto& update : updates) {
+    auto isTaken = [&update](const DeviceCandidate& c) { return c.path == update.deviceInfo.systemPath; };
+    auto taken = find_if(candidates.begin(), candidates.end(), isTaken);
+
+    if (taken != candidates.end()) {
+      if (isUpdated(update)) {
+        update.deviceInfo.nativeUSBSupport = taken->isNativeUSB();
+        l.d() << update.name << ": keeps " << taken->path << Logger::endl;
+      }
+      candidates.erase(taken);
+      continue;
+    }
+    unmatchedCount++;
+    if (isUpdated(update)) {
+      update.deviceInfo.systemPath.clear();
+      unmatchedUpdates.push_back(&update);
+    }
   }
 
-  l.i() << "Starting firmware update procedure." << Logger::endl;
+  if (unmatchedCount == 1 && unmatchedUpdates.size() == 1 && candidates.size() == 1) {
+    auto& update = *unmatchedUpdates.front();
+    auto& candidate = candidates.front();
 
-  auto onError = []() { throw runtime_error("Unable to complete firmware update procedure."); };
+    update.deviceInfo.systemPath = candidate.path;
+    update.deviceInfo.nativeUSBSupport = candidate.isNativeUSB();
+    l.i() << update.name << ": takes " << candidate.path << Logger::endl;
+    return;
+  }
+  for (auto update : unmatchedUpdates) {
+    failLostDevice(*update);
+  }
+}
 
-  int pkgInx = 0;
-  for (PackageInfo pkg : zipPackages) {
-    if (pkgInx > 0) {
-      //52840 may change port after reboot
-      syncSerialDevice.close();
-      delay_boot();
-      updateDeviceSystemPath(deviceInfo);
-      syncSerialDevice.open(deviceInfo.systemPath);
+// a device in the application is told by its chipId, a device which had none when the update started (it was in the
+// bootloader) takes any of the remaining ones
+static void locateDevicesByChipId(vector<DeviceUpdate>& updates, size_t devicesCount) {
+  auto candidates = findJetBeepDeviceCandidates(devicesCount);
+  vector<future<DeviceInfo>> infoReads;
+  vector<DeviceInfo> deviceInfos;
+
+  for (auto& candidate : candidates) {
+    infoReads.push_back(async(launch::async, getDeviceInfo, candidate));
+  }
+  for (auto& infoRead : infoReads) {
+    try {
+      auto deviceInfo = infoRead.get();
+      if (isValidDeviceInfo(deviceInfo)) {
+        deviceInfos.push_back(deviceInfo);
+      }
+    } catch (const exception& e) {
+      l.w() << e.what() << Logger::endl;
     }
-    // test that device in bootloader mode
-    err_code = dfu_serial_ping(&uart_drv, 0x04 /* any value */);
-    if (err_code == 0) {
-      deviceInfo.bootState = DeviceBootState::BOOTLOADER;
+  }
+
+  auto take = [&deviceInfos](DeviceUpdate& update, const function<bool(const DeviceInfo&)>& isMatching) {
+    auto found = find_if(deviceInfos.begin(), deviceInfos.end(), isMatching);
+    if (found == deviceInfos.end()) {
+      return false;
+    }
+    update.deviceInfo = *found;
+    deviceInfos.erase(found);
+    return true;
+  };
+  vector<DeviceUpdate*> unknownUpdates;
+
+  for (auto& update : updates) {
+    if (!update.error.empty()) {
+      continue;
+    }
+    auto chipId = update.deviceInfo.chipId;
+    if (chipId.empty()) {
+      unknownUpdates.push_back(&update);
+    } else if (!take(update, [&chipId](const DeviceInfo& info) { return info.chipId == chipId; })) {
+      failLostDevice(update);
+    }
+  }
+  for (auto update : unknownUpdates) {
+    // not one of the devices of the other updates
+    auto isFree = [&updates](const DeviceInfo& info) {
+      return none_of(updates.begin(), updates.end(), [&info](const DeviceUpdate& u) { return u.deviceInfo.chipId == info.chipId; });
+    };
+    if (!take(*update, isFree)) {
+      failLostDevice(*update);
+    }
+  }
+}
+
+// a package opened for all of the devices, the threads only read it while they send it
+typedef unique_ptr<dfu_package_t, decltype(&dfu_package_close)> DfuPackage;
+
+static void sendFirmwarePackage(
+  DeviceUpdate& update, const PackageInfo& pkg, dfu_package_t* dfuPackage, size_t packagesCount, Logger& log) {
+  int err_code = 0;
+  auto dfuContext = make_unique<dfu_ctx_t>();
+  DFU::SyncSerialDevice syncSerialDevice;
+  uart_drv_t uart_drv = {&syncSerialDevice, dfuContext.get()};
+  auto onError = []() { throw runtime_error("Unable to complete firmware update procedure."); };
+
+  syncSerialDevice.open(update.deviceInfo.systemPath);
+
+  // test that device in bootloader mode
+  err_code = dfu_serial_ping(&uart_drv, 0x04 /* any value */);
+  if (err_code == 0) {
+    update.deviceInfo.bootState = DeviceBootState::BOOTLOADER;
+  } else {
+    onError();
+  }
+
+  log.d() << "Processing firmware package: " << pkg.name << Logger::endl;
+
+  dfu_param_t dfu_param;
+  dfu_param.p_uart = &uart_drv;
+  dfu_param.p_pkg = dfuPackage;
+  err_code = dfu_send_package(&dfu_param);
+
+  if (err_code != 0) {
+    int extErrorCode = get_ext_error_code(&uart_drv);
+    if (pkg.type == PackageType::BOOTLOADER_SD_FW && packagesCount != 1 &&
+        extErrorCode == (int)NRF_DFU_EXT_ERROR::FW_VERSION_FAILURE) {
+      err_code = 0; // continue to app update assuming that bootloader and soft device are up to date already
+      log.i() << "Bootloader and SD are up to date" << Logger::endl;
+    } else if (extErrorCode != (int)NRF_DFU_EXT_ERROR::NO_ERROR_CODE) {
+      throw DFU::ExtendedError(extErrorCode);
     } else {
       onError();
     }
+  }
+}
 
-    l.d() << "Processing firmware package: " << pkg.name << Logger::endl;
-
-    dfu_param_t dfu_param;
-    dfu_param.p_uart = &uart_drv;
-    dfu_param.p_pkg_file = (char*)pkg.path.c_str();
-    err_code = dfu_send_package(&dfu_param);
-
-    if (err_code != 0) {
-      int extErrorCode = get_ext_error_code();
-      if (pkg.type == PackageType::BOOTLOADER_SD_FW && zipPackages.size() != 1 &&
-          extErrorCode == (int)NRF_DFU_EXT_ERROR::FW_VERSION_FAILURE) {
-        err_code = 0; // continue to app update assuming that bootloader and soft device are up to date already
-        l.i() << "Bootloader and SD are up to date" << Logger::endl;
-      } else if (extErrorCode != (int)NRF_DFU_EXT_ERROR::NO_ERROR_CODE) {
-        throw DFU::ExtendedError(extErrorCode);
-      } else {
-        onError();
+// the version of an init packet made by nrfutil from a "MAJOR.MINOR.PATCH" version string, 0 if it is not one
+static uint32_t toInitPacketVersion(const string& version) {
+  unsigned major, minor, patch;
+  char rest;
+
+  if (sscanf(version.c_str(), "%u.%u.%u%c", &major, &minor, &patch, &rest) != 3) {
+    return 0;
+  }
+  return major * 10000 + minor * 100 + patch;
+}
+
+static vector<DfuPackage> openPackages(vector<PackageInfo>& zipPackages) {
+  vector<DfuPackage> dfuPackages;
+
+  logger_set_backend(&l);
+  for (auto& pkg : zipPackages) {
+    DfuPackage dfuPackage(dfu_package_open(pkg.path.c_str()), &dfu_package_close);
+    dfu_package_info_t info;
+
+    if (!dfuPackage) {
+      logger_set_backend(nullptr);
+      throw runtime_error("Unable to read firmware package " + pkg.name);
+    }
+    dfu_get_package_info(dfuPackage.get(), &info);
+    if (info.app_version != 0) {
+      pkg.appVersion = info.app_version;
+      l.d() << pkg.name << ": application version " << info.app_version << ", " << info.app_size << " bytes" << Logger::endl;
+    }
+    dfuPackages.push_back(move(dfuPackage));
+  }
+  logger_set_backend(nullptr);
+  return dfuPackages;
+}
+
+// a device which runs the application of the application package doesn't get it again. Its bootloader and SoftDevice
+// versions can't be read in the application, so the bootloader package is still sent: the bootloader refuses it
+// quickly when it is installed already. Only when there is no such package the device is left out without a reboot
+static void checkFirmwareUpToDate(vector<DeviceUpdate>& updates, const vector<PackageInfo>& zipPackages) {
+  auto appPackage = find_if(zipPackages.begin(), zipPackages.end(), [](const PackageInfo& pkg) {
+    return pkg.type == PackageType::APP_FW && pkg.appVersion != 0;
+  });
+
+  if (appPackage == zipPackages.end()) {
+    return;
+  }
+  auto isAppOnly = all_of(zipPackages.begin(), zipPackages.end(), [](const PackageInfo& pkg) { return pkg.type == PackageType::APP_FW; });
+
+  for (auto& update : updates) {
+    if (!update.error.empty() || update.deviceInfo.bootState != DeviceBootState::APP) {
+      continue;
+    }
+    update.isAppUpToDate = toInitPacketVersion(update.deviceInfo.version) == appPackage->appVersion;
+    update.isFwUpToDate = update.isAppUpToDate && isAppOnly;
+    if (update.isFwUpToDate) {
+      l.i() << update.name << ": The firmware " << update.deviceInfo.version << " is up to date" << Logger::endl;
+    } else if (update.isAppUpToDate) {
+      l.i() << update.name << ": The application " << update.deviceInfo.version << " is up to date, checking the bootloader"
+            << Logger::endl;
+    }
+  }
+}
+
+// restarts a device which is in the bootloader into its application instead of sending the application again. False
+// if the bootloader doesn't support it, the application package has to be sent then
+static bool restartApplication(DeviceUpdate& update, Logger& log) {
+  auto dfuContext = make_unique<dfu_ctx_t>();
+  DFU::SyncSerialDevice syncSerialDevice;
+  uart_drv_t uart_drv = {&syncSerialDevice, dfuContext.get()};
+
+  syncSerialDevice.open(update.deviceInfo.systemPath);
+  if (dfu_serial_ping(&uart_drv, 0x04 /* any value */) != 0 || dfu_serial_abort(&uart_drv) != 0) {
+    log.w() << "Unable to leave the bootloader, sending the application package" << Logger::endl;
+    return false;
+  }
+  log.i() << "The application is up to date, restarting it" << Logger::endl;
+  return true;
+}
+
+// the devices go through the reboots together: every step runs on all of them at the same time and the next one
+// starts once all of them are done, so updating a whole store takes the time of a single device
+static void updateFirmwareProcedure(vector<DeviceUpdate>& updates,
+                                    vector<PackageInfo>& zipPackages,
+                                    const vector<DfuPackage>& dfuPackages,
+                                    size_t devicesCount) {
+  checkFirmwareUpToDate(updates, zipPackages);
+  if (all_of(updates.begin(), updates.end(), [](DeviceUpdate& update) { return !update.error.empty() || update.isFwUpToDate; })) {
+    return;
+  }
+  l.i() << "Starting firmware update procedure." << Logger::endl;
+
+  forEachDevice(updates, [](DeviceUpdate& update, Logger& log) {
+    update.prevFwVersion = update.deviceInfo.version;
+    if (update.deviceInfo.bootState == DeviceBootState::APP && !update.isFwUpToDate) {
+      DFU::SyncSerialDevice syncSerialDevice;
+
+      log.v() << "Entering DFU mode..." << Logger::endl;
+      syncSerialDevice.open(update.deviceInfo.systemPath);
+      syncSerialDevice.enterDFUMode();
+      syncSerialDevice.close();
+    }
+  });
+
+  for (size_t i = 0; i < zipPackages.size(); i++) {
+    auto& pkg = zipPackages[i];
+    auto dfuPackage = dfuPackages[i].get();
+
+    delay_boot();
+    locateDevicesInBootloader(updates, devicesCount);
+    forEachDevice(updates, [&pkg, dfuPackage, &zipPackages](DeviceUpdate& update, Logger& log) {
+      if (update.isFwUpToDate) {
+        return;
+      }
+      if (pkg.type == PackageType::APP_FW && update.isAppUpToDate && restartApplication(update, log)) {
+        return;
       }
+      sendFirmwarePackage(update, pkg, dfuPackage, zipPackages.size(), log);
+    });
+  }
+
+  delay_boot();
+  locateDevicesByChipId(updates, devicesCount);
+  for (auto& update : updates) {
+    if (!update.error.empty() || update.isFwUpToDate) {
+      continue;
+    }
+    update.updateFwDone = update.prevFwVersion != update.deviceInfo.version;
+    if (!update.updateFwDone && !update.isAppUpToDate) {
+      l.i() << update.name << ": The firmware version was not changed" << Logger::endl;
     }
-    pkgInx++;
   }
 }
 
@@ -190,7 +458,7 @@ static DeviceConfig getDevicePortalConfig(PortalBackend& backend, DeviceInfo& de
   request.chipId = deviceInfo.chipId;
 
   backend.getDeviceConfig(request)
-    .then([&reqPromise](DeviceConfigResponse res) { reqPromise.set_value(res.config); })
+    .then([&reqPromise](const DeviceConfigResponse& res) { reqPromise.set_value(res.config); })
     .catchError([&reqPromise](const exception_ptr& ex) { reqPromise.set_exception(ex); });
 
   reqFuture.wait();
@@ -217,6 +485,8 @@ static void updateDevicePortalConfig(PortalBackend& backend, DeviceInfo& deviceI
 static void writeDeviceConfig(DeviceConfig& config, JetBeep::SerialDevice& serial, DeviceInfo& deviceInfo) {
   std::promise<void> writePromise;
   auto writeDone = writePromise.get_future();
+  exception_ptr writeError = nullptr;
+  exception_ptr issueError = nullptr;
 
   auto makeResolved = []() {
     auto resolved = Promise<void>();
@@ -226,71 +496,81 @@ static void writeDeviceConfig(DeviceConfig& config, JetBeep::SerialDevice& seria
 
   SerialBeginPrivateMode configMode = config.signatureType == "setup" ? SerialBeginPrivateMode::setup : SerialBeginPrivateMode::config;
 
-  serial.beginPrivate(SerialBeginPrivateMode::config)
-    .thenPromise([&]() {
-      return serial.set(DeviceParameter::shopId,  Utils::numberToHexString(config.shopId));
-    })
-    .thenPromise([&]() {
-      return serial.set(DeviceParameter::shopKey, config.shopKey);
-    })
-    .thenPromise([&]() {
-      return serial.set(DeviceParameter::domainShopId,  Utils::numberToHexString(config.domainShopId));
-    })
-    .thenPromise([&]() {
-      return serial.set(DeviceParameter::merchantId,  Utils::numberToHexString(config.merchantId));
-    })
-    .thenPromise([&]() {
-      if (config.cashierId.length()) {
-        return serial.set(DeviceParameter::cashierId,  config.cashierId);
-      }
-      return makeResolved();
-    })
-    .thenPromise([&]() {
-      return serial.set(DeviceParameter::devEnv,  DeviceUtils::boolToDeviceBoolStr(config.devEnv));
-    })
-    .thenPromise([&]() {
-      return serial.set(DeviceParameter::phoneConFeedback,  DeviceUtils::boolToDeviceBoolStr(config.phoneConFeedback));
-    })
-    .thenPromise([&]() {
-      return serial.set(DeviceParameter::logLevel,  Utils::numberToHexString(config.logLevel));
-    })
-    .thenPromise([&]() {
-      return serial.set(DeviceParameter::connectionRole, DeviceUtils::connectionRoleToString(config.connectionRole));
-    })
-    .thenPromise([&]() {
-      return serial.set(DeviceParameter::mode, DeviceUtils::operationModeToString(config.mode));
-    })
-    .thenPromise([&]() {
-      return serial.set(DeviceParameter::mobileAppsUUIDs, DeviceUtils::mobileAppsUUIDsToString(config.mobileAppsUUIDs));
-    })
-    .thenPromise([&]() {
-      return serial.set(DeviceParameter::txPower,  Utils::numberToHexString((uint8_t) config.txPower));
-    })
-    .thenPromise([&]() {
-      return serial.set(DeviceParameter::tapSensitivity,  Utils::numberToHexString((uint8_t) config.tapSensitivity));
-    })
-    .thenPromise([&]() {
-      if (Utils::deviceFWVerToNumber(deviceInfo.version) >= Utils::deviceFWVerToNumber("1.4.0-alpha")
-          && deviceInfo.nativeUSBSupport
-          && config.virtKeyboard.length()) {
-        return serial.set(DeviceParameter::virtKeyboard,  config.virtKeyboard);
+  // beginPrivate and all the sets are written without waiting for each response, the device answers them in order.
+  // Commit is sent only when every one of them succeeded
+  auto pipelined = [&writeError](Promise<void> promise) {
+    promise.catchError([&writeError](const exception_ptr& ex) {
+      if (!writeError) {
+        writeError = ex;
       }
-      return makeResolved();
-    })
-    .thenPromise([&]() {
-      return serial.commit(config.signature);
-    })
-    .then([&]() { 
-      writePromise.set_value();
-    })
-    .catchError([&writePromise](const exception_ptr& ex) { writePromise.set_exception(ex); });
+    });
+    return promise;
+  };
+  auto lastWrite = makeResolved();
+
+  serial.setPipelined(true);
+  try {
+    lastWrite = pipelined(serial.beginPrivate(SerialBeginPrivateMode::config));
+    lastWrite = pipelined(serial.set(DeviceParameter::shopId,  Utils::numberToHexString(config.shopId)));
+    lastWrite = pipelined(serial.set(DeviceParameter::shopKey, config.shopKey));
+    lastWrite = pipelined(serial.set(DeviceParameter::domainShopId,  Utils::numberToHexString(config.domainShopId)));
+    lastWrite = pipelined(serial.set(DeviceParameter::merchantId,  Utils::numberToHexString(config.merchantId)));
+    if (config.cashierId.length()) {
+      lastWrite = pipelined(serial.set(DeviceParameter::cashierId,  config.cashierId));
+    }
+    lastWrite = pipelined(serial.set(DeviceParameter::devEnv,  DeviceUtils::boolToDeviceBoolStr(config.devEnv)));
+    lastWrite = pipelined(serial.set(DeviceParameter::phoneConFeedback,  DeviceUtils::boolToDeviceBoolStr(config.phoneConFeedback)));
+    lastWrite = pipelined(serial.set(DeviceParameter::logLevel,  Utils::numberToHexString(config.logLevel)));
+    lastWrite = pipelined(serial.set(DeviceParameter::connectionRole, string(DeviceUtils::connectionRoleToString(config.connectionRole))));
+    lastWrite = pipelined(serial.set(DeviceParameter::mode, string(DeviceUtils::operationModeToString(config.mode))));
+    lastWrite = pipelined(serial.set(DeviceParameter::mobileAppsUUIDs, DeviceUtils::mobileAppsUUIDsToString(config.mobileAppsUUIDs)));
+    lastWrite = pipelined(serial.set(DeviceParameter::txPower,  Utils::numberToHexString((uint8_t) config.txPower)));
+    lastWrite = pipelined(serial.set(DeviceParameter::tapSensitivity,  Utils::numberToHexString((uint8_t) config.tapSensitivity)));
+    if (Utils::deviceFWVerToNumber(deviceInfo.version) >= Utils::deviceFWVerToNumber("1.4.0-alpha")
+        && deviceInfo.nativeUSBSupport
+        && config.virtKeyboard.length()) {
+      lastWrite = pipelined(serial.set(DeviceParameter::virtKeyboard,  config.virtKeyboard));
+    }
+  } catch (...) {
+    // commands which were already written still have to complete, their callbacks refer to this stack frame
+    issueError = std::current_exception();
+  }
+
+  auto commitConfig = [&]() {
+    if (issueError || writeError) {
+      writePromise.set_exception(issueError ? issueError : writeError);
+      return;
+    }
+
+    // commit throws right away when the device is gone, this runs in a callback of the read handler
+    try {
+      serial.commit(config.signature)
+        .then([&writePromise]() { writePromise.set_value(); })
+        .catchError([&writePromise](const exception_ptr& ex) { writePromise.set_exception(ex); });
+    } catch (...) {
+      writePromise.set_exception(std::current_exception());
+    }
+  };
+
+  // responses come in order, so the last command is completed after all the previous ones. Its error is already
+  // recorded in writeError, so commitConfig runs once whether it was resolved or rejected
+  lastWrite.recover([](const exception_ptr&) {}).then(commitConfig);
 
   writeDone.wait();
 
+  serial.setPipelined(false);
   writeDone.get(); //raise exception if is set_exception
 }
 
-static void updateDeviceConfig(DeviceInfo& deviceInfo, PortalHostEnv env) {
+static void resetDevice(DeviceInfo& deviceInfo) {
+  DFU::SyncSerialDevice syncSerialDevice;
+
+  syncSerialDevice.open(deviceInfo.systemPath);
+  syncSerialDevice.reset();
+  syncSerialDevice.close();
+}
+
+static void applyDeviceConfig(DeviceInfo& deviceInfo, PortalHostEnv env, Logger& log) {
   if (!isValidDeviceInfo(deviceInfo)) {
       throw runtime_error("Unable to get device info. Try to reconnect the device.");
   }
@@ -299,38 +579,47 @@ static void updateDeviceConfig(DeviceInfo& deviceInfo, PortalHostEnv env) {
   if (config.shopId == 0) {
     throw runtime_error("Shop is not defined for current device. Update device profile at https://[dev or prod].jetbeep.com/portal");
   }
-  Logger configLogger("config");
   JetBeep::SerialDevice serial;
-  DFU::SyncSerialDevice syncSerialDevice = DFU::SyncSerialDevice();
-  auto resetDevice = [&](){
-    syncSerialDevice.open(deviceInfo.systemPath);
-    syncSerialDevice.reset();
-    syncSerialDevice.close();
-  };
 
   serial.open(deviceInfo.systemPath);
-  configLogger.i() << "Applying new configuration ..." << Logger::endl;
+  log.i() << "Applying new configuration ..." << Logger::endl;
   try {
     writeDeviceConfig(config, serial, deviceInfo);
   } catch (...) {
     serial.close();
-    resetDevice();
+    resetDevice(deviceInfo);
     std::rethrow_exception(std::current_exception());
   }
-  
   serial.close();
-  configLogger.i() << "Reseting the device ..." << Logger::endl;
+}
+
+static void updateDevicesConfig(vector<DeviceUpdate>& updates, PortalHostEnv env, size_t devicesCount) {
+  auto isInfoMissing = [](DeviceUpdate& update) { return update.error.empty() && !isValidDeviceInfo(update.deviceInfo); };
+  if (any_of(updates.begin(), updates.end(), isInfoMissing)) {
+    locateDevicesByChipId(updates, devicesCount);
+  }
+
+  forEachDevice(updates, [env](DeviceUpdate& update, Logger& log) { applyDeviceConfig(update.deviceInfo, env, log); });
+  if (none_of(updates.begin(), updates.end(), [](DeviceUpdate& update) { return update.error.empty(); })) {
+    return;
+  }
+
+  l.i() << "Reseting the devices ..." << Logger::endl;
   delay_flash_write(); //wait until flash write is completed
-  updateDeviceSystemPath(deviceInfo);
-  resetDevice();
-  updateDevicePortalConfig(backend, deviceInfo);
+  locateDevicesByChipId(updates, devicesCount);
+
+  forEachDevice(updates, [env](DeviceUpdate& update, Logger&) {
+    PortalBackend backend(env);
+
+    resetDevice(update.deviceInfo);
+    updateDevicePortalConfig(backend, update.deviceInfo);
+    update.updateConfigDone = true;
+  });
 }
 
 int main(int argc, char* argv[]) {
   Logger::coutEnabled = true;
   PortalHostEnv env = PortalHostEnv::Production;
-  bool updateFwDone = false;
-  bool updateConfigDone = false;
   bool doFwUpdate = true;
   bool doConfiguration = true;
   bool waitOnExit = false;
@@ -377,8 +666,9 @@ int main(int argc, char* argv[]) {
     }
   }
 
-  DeviceInfo deviceInfo;
+  vector<DeviceUpdate> updates;
   vector<PackageInfo> zipPackages;
+  size_t devicesCount = 0;
 
   auto waitFunc = [&]() {
     if (waitOnExit) {
@@ -393,10 +683,39 @@ int main(int argc, char* argv[]) {
     return -1;
   };
   try {
-    deviceInfo = getDeviceInfo();
-    if (deviceInfo.deviceId == 0 && deviceInfo.bootState == DeviceBootState::APP) {
-      l.e() << "Unable to proceed. The connected device is not initially configured (blank). Please contact your supplier." << Logger::endl;
-      return -1;
+    auto candidates = findJetBeepDeviceCandidates();
+    vector<future<DeviceInfo>> infoReads;
+
+    devicesCount = candidates.size();
+    for (auto& candidate : candidates) {
+      infoReads.push_back(async(launch::async, getDeviceInfo, candidate));
+    }
+    // a device which can't be read fails alone, the other ones are updated anyway
+    for (size_t i = 0; i < infoReads.size(); i++) {
+      DeviceUpdate update;
+
+      try {
+        update.deviceInfo = infoReads[i].get();
+      } catch (const exception& e) {
+        update.error = e.what();
+      } catch (...) {
+        update.error = "Unknown error";
+      }
+      if (!update.error.empty()) {
+        update.name = "dfu " + candidates[i].path;
+        l.e() << update.name << ": " << update.error << Logger::endl;
+      } else if (update.deviceInfo.deviceId != 0) {
+        stringstream name;
+        name << "dfu " << hex << update.deviceInfo.deviceId;
+        update.name = name.str();
+      } else {
+        update.name = "dfu " + update.deviceInfo.systemPath;
+      }
+      if (update.error.empty() && update.deviceInfo.deviceId == 0 && update.deviceInfo.bootState == DeviceBootState::APP) {
+        update.error = "Unable to proceed. The connected device is not initially configured (blank). Please contact your supplier.";
+        l.e() << update.name << ": " << update.error << Logger::endl;
+      }
+      updates.push_back(update);
     }
   } catch (const exception& e) {
     return onError(e);
@@ -413,17 +732,10 @@ int main(int argc, char* argv[]) {
       if (zipPackages.size() == 0) {
         l.w() << "No firmware update packages were found!" << Logger::endl;
       } else {
-        string prevFwVersion = deviceInfo.version;
-        updateFirmwareProcedure(deviceInfo, zipPackages);
-        delay_boot();
-        deviceInfo = getDeviceInfo(true);
-        updateFwDone = prevFwVersion != deviceInfo.version;
-        if (!updateFwDone) {
-          l.i() << "The firmware version was not changed" << Logger::endl;
-        }
+        auto dfuPackages = openPackages(zipPackages);
+
+        updateFirmwareProcedure(updates, zipPackages, dfuPackages, devicesCount);
       }
-    } catch (const DFU::ExtendedError& e) {
-      return onError(e);
     } catch (const exception& e) {
       return onError(e);
     } catch (...) {
@@ -434,11 +746,7 @@ int main(int argc, char* argv[]) {
   if (doConfiguration) {
     try {
       l.i() << "Processing device configuration" << Logger::endl;
-      if (!isValidDeviceInfo(deviceInfo)) {
-        deviceInfo = getDeviceInfo(true);
-      }
-      updateDeviceConfig(deviceInfo, env);
-      updateConfigDone = true;
+      updateDevicesConfig(updates, env, devicesCount);
     } catch (const exception& e) {
       return onError(e);
     } catch (...) {
@@ -447,10 +755,26 @@ int main(int argc, char* argv[]) {
   }
 
   l.i() << "-----------------------------------------------" << Logger::endl;
-  l.i() << "Status: Firmware updated " << (updateFwDone ? "YES" : "NO") << ", Config updated "
-        << (updateConfigDone ? "YES" : "NO") << Logger::endl;
+  for (auto& update : updates) {
+    stringstream status;
+
+    status << update.name << " status: Firmware updated " << (update.updateFwDone ? "YES" : "NO");
+    if (update.updateFwDone) {
+      status << " (" << update.prevFwVersion << " -> " << update.deviceInfo.version << ")";
+    } else if (update.isFwUpToDate) {
+      status << " (up to date)";
+    } else if (update.isAppUpToDate) {
+      status << " (application up to date)";
+    }
+    status << ", Config updated " << (update.updateConfigDone ? "YES" : "NO");
+    l.i() << status.str() << Logger::endl;
+    if (!update.error.empty()) {
+      l.e() << update.name << " error: " << update.error << Logger::endl;
+      err_code = -1;
+    }
+  }
 
   waitFunc();
 
-  return 0;
+  return err_code;
 }
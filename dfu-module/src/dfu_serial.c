@@ -41,12 +41,11 @@
 #include <stdio.h>
 #include <string.h>
 #include "dfu_serial.h"
+#include "dfu_ctx.h"
 #include "crc32.h"
 #include "logging.h"
 #include "ext_error.h"
-
-// SLIP data log buffer size
-#define MAX_BUFF_SIZE           1024
+#include "delay_connect.h"
 
 /**
 * @brief DFU protocol operation.
@@ -107,16 +106,17 @@ typedef struct
 
 
 #define MIN(a,b) (((a) < (b)) ? (a) : (b))
+#define MAX(a,b) (((a) > (b)) ? (a) : (b))
 
+// receipts which may be outstanding at most while the writes go on
+#define DFU_SERIAL_WINDOW_MAX 8
 
-static uint8_t ping_id = 0;
-static uint16_t prn = 0;
-static uint16_t mtu = 0;
+// attempts to send a data object which fails its CRC check
+#define DFU_SERIAL_OBJECT_RETRIES 3
 
-static uint8_t send_data[UART_SLIP_SIZE_MAX];
-static uint8_t receive_data[UART_SLIP_SIZE_MAX];
+// data objects sent without an error before the receipts get less frequent
+#define DFU_SERIAL_CLEAN_OBJECTS 4
 
-static char logger_buff[MAX_BUFF_SIZE];
 
 static uint16_t get_uint16_le(const uint8_t *p_data)
 {
@@ -154,7 +154,7 @@ static void put_uint32_le(uint8_t *p_data, uint32_t data)
 	*(p_data + 3) = (uint8_t)(data >> 24);
 }
 
-static void uart_data_to_buff(const uint8_t *pData, uint32_t nSize)
+static void uart_data_to_buff(char *logger_buff, const uint8_t *pData, uint32_t nSize)
 {
 	uint32_t n;
 	char data_buff[6];
@@ -170,7 +170,7 @@ static void uart_data_to_buff(const uint8_t *pData, uint32_t nSize)
 		else
 			len = sprintf(data_buff, ", %u", *(pData + n));
 
-		if ((size_t)len + 1 < sizeof(logger_buff) - pos)
+		if ((size_t)len + 1 < (size_t)(DFU_CTX_LOGGER_BUFF_SIZE - pos))
 		{
 			strcat(logger_buff, data_buff);
 
@@ -190,8 +190,8 @@ static int dfu_serial_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nS
 
 	if (info_lvl >= LOGGER_INFO_LVL_3)
 	{
-		uart_data_to_buff(pData, nSize);
-		logger_info_3("SLIP: --> [%s]", logger_buff);
+		uart_data_to_buff(p_uart->p_ctx->logger_buff, pData, nSize);
+		logger_info_3("SLIP: --> [%s]", p_uart->p_ctx->logger_buff);
 	}
 
 	return uart_slip_send(p_uart, pData, nSize);
@@ -200,8 +200,9 @@ static int dfu_serial_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nS
 static int dfu_serial_get_rsp(uart_drv_t *p_uart, nrf_dfu_op_t oper, uint32_t *p_data_cnt)
 {
 	int err_code;
+	uint8_t *receive_data = p_uart->p_ctx->receive_data;
 
-	err_code = uart_slip_receive(p_uart, receive_data, sizeof(receive_data), p_data_cnt);
+	err_code = uart_slip_receive(p_uart, receive_data, UART_SLIP_SIZE_MAX, p_data_cnt);
 
 	if (!err_code)
 	{
@@ -209,8 +210,8 @@ static int dfu_serial_get_rsp(uart_drv_t *p_uart, nrf_dfu_op_t oper, uint32_t *p
 
 		if (info_lvl >= LOGGER_INFO_LVL_3)
 		{
-			uart_data_to_buff(receive_data, *p_data_cnt);
-			logger_info_3("SLIP: <-- [%s]", logger_buff);
+			uart_data_to_buff(p_uart->p_ctx->logger_buff, receive_data, *p_data_cnt);
+			logger_info_3("SLIP: <-- [%s]", p_uart->p_ctx->logger_buff);
 		}
 
 		if (*p_data_cnt >= 3 &&
@@ -222,7 +223,7 @@ static int dfu_serial_get_rsp(uart_drv_t *p_uart, nrf_dfu_op_t oper, uint32_t *p
 				uint16_t rsp_error = receive_data[2];
 
 				if (receive_data[2] == NRF_DFU_RES_CODE_EXT_ERROR) {
-					set_ext_error_code(receive_data[3]);
+					set_ext_error_code(p_uart, receive_data[3]);
 				}
 
 				// get 2-byte error code, if applicable
@@ -249,6 +250,7 @@ int dfu_serial_ping(uart_drv_t *p_uart, uint8_t id)
 {
 	int err_code;
 	uint8_t send_data[2] = { NRF_DFU_OP_PING };
+	const uint8_t *receive_data = p_uart->p_ctx->receive_data;
 
 	send_data[1] = id;
 	err_code = dfu_serial_send(p_uart, send_data, sizeof(send_data));
@@ -298,6 +300,7 @@ static int dfu_serial_get_mtu(uart_drv_t *p_uart, uint16_t *p_mtu)
 {
 	int err_code;
 	uint8_t send_data[1] = { NRF_DFU_OP_MTU_GET };
+	const uint8_t *receive_data = p_uart->p_ctx->receive_data;
 
 	err_code = dfu_serial_send(p_uart, send_data, sizeof(send_data));
 
@@ -331,6 +334,7 @@ static int dfu_serial_select_obj(uart_drv_t *p_uart, uint8_t obj_type, nrf_dfu_r
 {
 	int err_code;
 	uint8_t send_data[2] = { NRF_DFU_OP_OBJECT_SELECT };
+	const uint8_t *receive_data = p_uart->p_ctx->receive_data;
 
 	logger_info_2("Selecting Object: type:%u", obj_type);
 
@@ -384,68 +388,232 @@ static int dfu_serial_create_obj(uart_drv_t *p_uart, uint8_t obj_type, uint32_t
 	return err_code;
 }
 
-static int dfu_serial_stream_data(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size)
+// the bootloader decodes a write into a buffer of (mtu - 1) / 2 bytes, the opcode included: the MTU is the size of
+// the worst case SLIP frame of it. A frame of fewer escaped bytes doesn't leave room for more data
+static uint32_t dfu_serial_get_write_size(uint16_t mtu)
 {
-	int err_code = 0;
-	uint32_t pos, stp, stp_max;
+	return (mtu >= 5) ? (uint32_t)(mtu - 1) / 2 - 1 : 0;
+}
 
-	if (p_data == NULL || !data_size)
-	{
-		err_code = 1;
-	}
+static int dfu_serial_read_crc(uart_drv_t *p_uart, nrf_dfu_response_crc_t *p_crc_rsp)
+{
+	int err_code;
+	uint32_t data_cnt;
+	const uint8_t *receive_data = p_uart->p_ctx->receive_data;
+
+	err_code = dfu_serial_get_rsp(p_uart, NRF_DFU_OP_CRC_GET, &data_cnt);
 
 	if (!err_code)
 	{
-		if (mtu >= 5)
+		if (data_cnt == 11)
 		{
-			stp_max = (mtu - 1) / 2 - 1;
+			p_crc_rsp->offset = get_uint32_le(receive_data + 3);
+			p_crc_rsp->crc    = get_uint32_le(receive_data + 7);
 		}
 		else
 		{
-			logger_error("MTU is too small to send data!");
+			logger_error("Invalid CRC response!");
 
 			err_code = 1;
 		}
 	}
 
-	for (pos = 0; !err_code && pos < data_size; pos += stp)
+	return err_code;
+}
+
+static int dfu_serial_get_crc(uart_drv_t *p_uart, nrf_dfu_response_crc_t *p_crc_rsp)
+{
+	int err_code;
+	uint8_t send_data[1] = { NRF_DFU_OP_CRC_GET };
+
+	err_code = dfu_serial_send(p_uart, send_data, sizeof(send_data));
+
+	if (!err_code)
 	{
-		send_data[0] = NRF_DFU_OP_OBJECT_WRITE;
-		stp = MIN((data_size - pos), stp_max);
-		memcpy(send_data + 1, p_data + pos, stp);
-		err_code = dfu_serial_send(p_uart, send_data, stp + 1);
-		//(data_size, pos);
+		err_code = dfu_serial_read_crc(p_uart, p_crc_rsp);
 	}
 
 	return err_code;
 }
 
-static int dfu_serial_get_crc(uart_drv_t *p_uart, nrf_dfu_response_crc_t *p_crc_rsp)
+static int dfu_serial_check_crc(const nrf_dfu_response_crc_t *p_crc_rsp, uint32_t offset, uint32_t crc)
+{
+	int err_code = 0;
+
+	if (p_crc_rsp->offset != offset)
+	{
+		logger_error("Invalid offset (%u -> %u)!", offset, p_crc_rsp->offset);
+
+		err_code = 2;
+	}
+	if (p_crc_rsp->crc != crc)
+	{
+		logger_error("Invalid CRC (0x%08X -> 0x%08X)!", crc, p_crc_rsp->crc);
+
+		err_code = 2;
+	}
+
+	return err_code;
+}
+
+// a receipt, i.e. the CRC the bootloader sends by itself every prn writes
+typedef struct
+{
+	nrf_dfu_response_crc_t expected[DFU_SERIAL_WINDOW_MAX + 1];    //!< Oldest first.
+	uint32_t head;
+	uint32_t cnt;
+	uint32_t checked_offset;
+} dfu_serial_receipts_t;
+
+static int dfu_serial_check_receipt(uart_drv_t *p_uart, dfu_serial_receipts_t *p_receipts)
 {
 	int err_code;
-	uint8_t send_data[1] = { NRF_DFU_OP_CRC_GET };
+	nrf_dfu_response_crc_t rsp_crc;
+	const nrf_dfu_response_crc_t *p_expected = &p_receipts->expected[p_receipts->head];
+
+	err_code = dfu_serial_read_crc(p_uart, &rsp_crc);
+
+	if (!err_code)
+	{
+		err_code = dfu_serial_check_crc(&rsp_crc, p_expected->offset, p_expected->crc);
+		p_receipts->checked_offset = p_expected->offset;
+	}
+	else
+	{
+		// e.g. a write was lost and the receipt never comes
+		err_code = 2;
+	}
+
+	p_receipts->head = (p_receipts->head + 1) % (DFU_SERIAL_WINDOW_MAX + 1);
+	p_receipts->cnt--;
+
+	return err_code;
+}
 
+// skips the receipts of writes which were sent after a CRC error: the bootloader may have lost some of the writes,
+// so their number is unknown. Everything up to the response of a ping is dropped
+static int dfu_serial_resync(uart_drv_t *p_uart)
+{
+	int err_code;
+	uint32_t data_cnt, n;
+	dfu_ctx_t *p_ctx = p_uart->p_ctx;
+	uint8_t send_data[2] = { NRF_DFU_OP_PING };
+	const uint8_t *receive_data = p_ctx->receive_data;
+
+	send_data[1] = ++p_ctx->ping_id;
 	err_code = dfu_serial_send(p_uart, send_data, sizeof(send_data));
 
+	for (n = 0; !err_code && n < DFU_SERIAL_WINDOW_MAX + 2; n++)
+	{
+		err_code = uart_slip_receive(p_uart, p_ctx->receive_data, UART_SLIP_SIZE_MAX, &data_cnt);
+
+		if (!err_code &&
+			data_cnt == 4 &&
+			receive_data[0] == NRF_DFU_OP_RESPONSE &&
+			receive_data[1] == NRF_DFU_OP_PING &&
+			receive_data[3] == p_ctx->ping_id)
+		{
+			return 0;
+		}
+	}
+
 	if (!err_code)
 	{
-		uint32_t data_cnt;
+		logger_error("Cannot resync after CRC error!");
+
+		err_code = 1;
+	}
 
-		err_code = dfu_serial_get_rsp(p_uart, NRF_DFU_OP_CRC_GET, &data_cnt);
+	return err_code;
+}
+
+// writes the data and checks its CRC. With the receipt notification on, the bootloader sends the CRC every prn
+// writes by itself: the writes go on while up to prn_window receipts are outstanding, and a receipt at the end of the
+// data replaces the CRC request
+static int dfu_serial_stream_data_crc(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size, uint32_t pos, uint32_t *p_crc)
+{
+	int err_code = 0;
+	uint32_t n, stp, stp_max, writes = 0;
+	uint32_t last_write_ms = 0;
+	dfu_ctx_t *p_ctx = p_uart->p_ctx;
+	uint8_t *send_data = p_ctx->send_data;
+	nrf_dfu_response_crc_t rsp_crc;
+	dfu_serial_receipts_t receipts;
+
+	logger_info_2("Streaming Data: len:%u offset:%u crc:0x%08X", data_size, pos, *p_crc);
+
+	receipts.head = 0;
+	receipts.cnt = 0;
+	receipts.checked_offset = pos;
+	stp_max = dfu_serial_get_write_size(p_ctx->mtu);
+
+	if (p_data == NULL || !data_size)
+	{
+		err_code = 1;
+	}
+	else if (!stp_max)
+	{
+		logger_error("MTU is too small to send data!");
+
+		err_code = 1;
+	}
+
+	for (n = 0; !err_code && n < data_size; n += stp)
+	{
+		send_data[0] = NRF_DFU_OP_OBJECT_WRITE;
+		stp = MIN((data_size - n), stp_max);
+		memcpy(send_data + 1, p_data + n, stp);
+		err_code = dfu_serial_send(p_uart, send_data, stp + 1);
+
+		if (err_code)
+			break;
+
+		last_write_ms = delay_get_tick_ms();
+		*p_crc = crc32_compute(p_data + n, stp, p_crc);
+
+		if (p_ctx->prn && ++writes % p_ctx->prn == 0)
+		{
+			nrf_dfu_response_crc_t *p_expected = &receipts.expected[(receipts.head + receipts.cnt++) % (DFU_SERIAL_WINDOW_MAX + 1)];
+
+			p_expected->offset = pos + n + stp;
+			p_expected->crc    = *p_crc;
+		}
+
+		// the last receipts are read once all of the data is sent
+		while (!err_code && receipts.cnt > MAX(p_ctx->prn_window, 1) && n + stp < data_size)
+		{
+			err_code = dfu_serial_check_receipt(p_uart, &receipts);
+		}
+	}
+
+	while (!err_code && receipts.cnt)
+	{
+		err_code = dfu_serial_check_receipt(p_uart, &receipts);
+	}
+
+	if (!err_code && receipts.checked_offset != pos + data_size)
+	{
+		err_code = dfu_serial_get_crc(p_uart, &rsp_crc);
 
 		if (!err_code)
 		{
-			if (data_cnt == 11)
-			{
-				p_crc_rsp->offset = get_uint32_le(receive_data + 3);
-				p_crc_rsp->crc    = get_uint32_le(receive_data + 7);
-			}
-			else
-			{
-				logger_error("Invalid CRC response!");
+			err_code = dfu_serial_check_crc(&rsp_crc, pos + data_size, *p_crc);
+		}
+	}
 
-				err_code = 1;
-			}
+	if (!err_code)
+	{
+		uint32_t rtt_ms = delay_get_tick_ms() - last_write_ms;
+
+		p_ctx->rtt_ms = p_ctx->rtt_ms ? (p_ctx->rtt_ms * 7 + rtt_ms) / 8 : rtt_ms;
+	}
+	else if (err_code == 2 && p_ctx->prn)
+	{
+		err_code = dfu_serial_resync(p_uart);
+
+		if (!err_code)
+		{
+			err_code = 2;
 		}
 	}
 
@@ -469,35 +637,84 @@ static int dfu_serial_execute_obj(uart_drv_t *p_uart)
 	return err_code;
 }
 
-static int dfu_serial_stream_data_crc(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size, uint32_t pos, uint32_t *p_crc)
+// the bootloader answers the requests in their order: the create of the next object goes out together with the
+// execute of the current one, which saves a round trip per object. Their responses are read before the next object is
+// written, so the data of it is prepared while the bootloader writes the current one to the flash
+static int dfu_serial_execute_create_obj(uart_drv_t *p_uart, uint8_t obj_type, uint32_t obj_size)
 {
 	int err_code;
-	nrf_dfu_response_crc_t rsp_crc;
+	uint8_t send_data[7] = { NRF_DFU_OP_OBJECT_EXECUTE, NRF_DFU_OP_OBJECT_CREATE };
 
-	logger_info_2("Streaming Data: len:%u offset:%u crc:0x%08X", data_size, pos, *p_crc);
+	send_data[2] = obj_type;
+	put_uint32_le(send_data + 3, obj_size);
+	err_code = dfu_serial_send(p_uart, send_data, 1);
 
-	err_code = dfu_serial_stream_data(p_uart, p_data, data_size);
+	if (!err_code)
+	{
+		err_code = dfu_serial_send(p_uart, send_data + 1, 6);
+	}
+
+	return err_code;
+}
+
+static int dfu_serial_get_execute_create_rsp(uart_drv_t *p_uart)
+{
+	int err_code;
+	uint32_t data_cnt;
+
+	err_code = dfu_serial_get_rsp(p_uart, NRF_DFU_OP_OBJECT_EXECUTE, &data_cnt);
 
 	if (!err_code)
 	{
-		*p_crc = crc32_compute(p_data, data_size, p_crc);
+		err_code = dfu_serial_get_rsp(p_uart, NRF_DFU_OP_OBJECT_CREATE, &data_cnt);
+	}
 
-		err_code = dfu_serial_get_crc(p_uart, &rsp_crc);
+	return err_code;
+}
+
+// the receipts get more frequent after a CRC error, so a broken write is found before the whole object is sent, and
+// less frequent again after DFU_SERIAL_CLEAN_OBJECTS objects without one. On a clean link a single receipt at the end
+// of an object replaces the CRC request. The window lets the writes run ahead of the receipts by the round trip time
+static int dfu_serial_adapt_prn(uart_drv_t *p_uart, uint32_t object_size, int crc_error)
+{
+	int err_code = 0;
+	dfu_ctx_t *p_ctx = p_uart->p_ctx;
+	uint32_t stp_max = dfu_serial_get_write_size(p_ctx->mtu);
+	uint32_t writes, checkpoint_ms;
+	uint16_t prn;
+
+	if (!stp_max || !object_size)
+		return err_code;
+
+	writes = (object_size + stp_max - 1) / stp_max;
+
+	if (!p_ctx->prn_checkpoints)
+	{
+		p_ctx->prn_checkpoints = 1;
+	}
+	else if (crc_error)
+	{
+		p_ctx->prn_checkpoints = (uint16_t)MIN(p_ctx->prn_checkpoints * 2u, writes);
+		p_ctx->clean_objects = 0;
+	}
+	else if (++p_ctx->clean_objects >= DFU_SERIAL_CLEAN_OBJECTS)
+	{
+		p_ctx->prn_checkpoints = MAX(p_ctx->prn_checkpoints / 2, 1);
+		p_ctx->clean_objects = 0;
 	}
 
-	if (!err_code)
+	checkpoint_ms = MAX(p_ctx->object_ms / p_ctx->prn_checkpoints, 1);
+	p_ctx->prn_window = (uint16_t)MIN(p_ctx->rtt_ms / checkpoint_ms + 1, DFU_SERIAL_WINDOW_MAX);
+
+	prn = (uint16_t)MIN((writes + p_ctx->prn_checkpoints - 1) / p_ctx->prn_checkpoints, UINT16_MAX);
+
+	if (prn != p_ctx->prn)
 	{
-		if (rsp_crc.offset != pos + data_size)
-		{
-			logger_error("Invalid offset (%u -> %u)!", pos + data_size, rsp_crc.offset);
+		err_code = dfu_serial_set_prn(p_uart, prn);
 
-			err_code = 2;
-		}
-		if (rsp_crc.crc != *p_crc)
+		if (!err_code)
 		{
-			logger_error("Invalid CRC (0x%08X -> 0x%08X)!", *p_crc, rsp_crc.crc);
-
-			err_code = 2;
+			p_ctx->prn = prn;
 		}
 	}
 
@@ -556,96 +773,50 @@ static int dfu_serial_try_to_recover_ip(uart_drv_t *p_uart, const uint8_t *p_dat
 	return err_code;
 }
 
-static int dfu_serial_try_to_recover_fw(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size,
-										nrf_dfu_response_select_t *p_rsp_recover,
-										const nrf_dfu_response_select_t *p_rsp_select)
+int dfu_serial_open(uart_drv_t *p_uart)
 {
-	int err_code = 0;
-	uint32_t max_size, stp_size;
-	uint32_t pos_start, len_remain;
-	uint32_t crc_32;
-	int obj_exec = 1;
+	int err_code;
+	dfu_ctx_t *p_ctx = p_uart->p_ctx;
 
-	*p_rsp_recover = *p_rsp_select;
+	p_ctx->ping_id++;
 
-	pos_start = p_rsp_recover->offset;
+	err_code = dfu_serial_ping(p_uart, p_ctx->ping_id);
 
-	if (pos_start > data_size)
+	if (!err_code)
 	{
-		logger_error("Invalid firmware offset reported!");
-
-		err_code = 1;
+		err_code = dfu_serial_set_prn(p_uart, p_ctx->prn);
 	}
-	else if (pos_start > 0)
-	{
-		max_size = p_rsp_select->max_size;
-		crc_32 = crc32_compute(p_data, pos_start, NULL);
-		len_remain = pos_start % max_size;
-
-		if (p_rsp_select->crc != crc_32)
-		{
-			pos_start -= ((len_remain > 0) ? len_remain : max_size);
-			p_rsp_recover->offset = pos_start;
-
-			return err_code;
-		}
-
-		if (len_remain > 0)
-		{
-			stp_size = max_size - len_remain;
-
-			err_code = dfu_serial_stream_data_crc(p_uart, p_data + pos_start, stp_size, pos_start, &crc_32);
-			if (!err_code)
-			{
-				pos_start += stp_size;
-			}
-			else if (err_code == 2)
-			{
-				err_code = 0;
-
-				pos_start -= len_remain;
-
-				obj_exec = 0;
-			}
 
-			p_rsp_recover->offset = pos_start;
-		}
-
-		if (!err_code && obj_exec)
-		{
-			err_code = dfu_serial_execute_obj(p_uart);
-		}
+	if (!err_code)
+	{
+		err_code = dfu_serial_get_mtu(p_uart, &p_ctx->mtu);
 	}
 
 	return err_code;
 }
 
-int dfu_serial_open(uart_drv_t *p_uart)
+int dfu_serial_close(uart_drv_t *p_uart)
 {
-	int err_code;
+	return 0;
+}
 
-	ping_id++;
+int dfu_serial_abort(uart_drv_t *p_uart)
+{
+	int err_code;
+	uint8_t send_data[1] = { NRF_DFU_OP_ABORT };
 
-	err_code = dfu_serial_ping(p_uart, ping_id);
+	err_code = dfu_serial_send(p_uart, send_data, sizeof(send_data));
 
 	if (!err_code)
 	{
-		err_code = dfu_serial_set_prn(p_uart, prn);
-	}
+		uint32_t data_cnt;
 
-	if (!err_code)
-	{
-		err_code = dfu_serial_get_mtu(p_uart, &mtu);
+		err_code = dfu_serial_get_rsp(p_uart, NRF_DFU_OP_ABORT, &data_cnt);
 	}
 
 	return err_code;
 }
 
-int dfu_serial_close(uart_drv_t *p_uart)
-{
-	return 0;
-}
-
 int dfu_serial_send_init_packet(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size)
 {
 	int err_code = 0;
@@ -703,18 +874,15 @@ int dfu_serial_send_init_packet(uart_drv_t *p_uart, const uint8_t *p_data, uint3
 	return err_code;
 }
 
-int dfu_serial_send_firmware(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size)
+int dfu_serial_begin_firmware(uart_drv_t *p_uart, uint32_t data_size, uint32_t *p_max_size)
 {
 	int err_code = 0;
-	uint32_t max_size, stp_size, pos;
-	uint32_t crc_32 = 0;
+	dfu_ctx_t *p_ctx = p_uart->p_ctx;
 	nrf_dfu_response_select_t rsp_select;
-	nrf_dfu_response_select_t rsp_recover;
-	uint32_t pos_start;
 
 	logger_info_1("Sending firmware file... size: %u", data_size);
 
-	if (p_data == NULL || !data_size)
+	if (!data_size)
 	{
 		logger_error("Invalid firmware data!");
 
@@ -728,37 +896,147 @@ int dfu_serial_send_firmware(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t
 
 	if (!err_code)
 	{
-		err_code = dfu_serial_try_to_recover_fw(p_uart, p_data, data_size, &rsp_recover, &rsp_select);
+		if (rsp_select.offset > data_size)
+		{
+			logger_error("Invalid firmware offset reported!");
+
+			err_code = 1;
+		}
+		else if (!rsp_select.max_size || rsp_select.max_size > DFU_CTX_OBJECT_SIZE_MAX)
+		{
+			logger_error("Invalid data object size reported!");
+
+			err_code = 1;
+		}
 	}
 
 	if (!err_code)
 	{
-		max_size = rsp_select.max_size;
+		p_ctx->fw_size = data_size;
+		p_ctx->fw_max_size = rsp_select.max_size;
+		p_ctx->fw_pos = 0;
+		p_ctx->fw_crc = 0;
+		p_ctx->fw_recover_offset = rsp_select.offset;
+		p_ctx->fw_recover_crc = rsp_select.crc;
+		p_ctx->fw_pending = 0;
+		*p_max_size = rsp_select.max_size;
+
+		err_code = dfu_serial_adapt_prn(p_uart, rsp_select.max_size, 0);
+	}
+
+	return err_code;
+}
 
-		pos_start = rsp_recover.offset;
-		crc_32 = crc32_compute(p_data, pos_start, &crc_32);
+// the objects of the image the bootloader has got before an interrupted update are only added to the CRC. The one
+// it stopped in is completed when the CRC of the data it has matches, otherwise it is sent again
+int dfu_serial_send_firmware_object(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t obj_size)
+{
+	int err_code = 0;
+	dfu_ctx_t *p_ctx = p_uart->p_ctx;
+	uint32_t pos = p_ctx->fw_pos;
+	uint32_t crc_obj = p_ctx->fw_crc;
+	uint32_t retries = 0;
+	int is_created = 0, is_sent = 0;
+
+	if (p_data == NULL || pos >= p_ctx->fw_size || obj_size != MIN((p_ctx->fw_size - pos), p_ctx->fw_max_size))
+	{
+		logger_error("Invalid firmware data object!");
+
+		return 1;
+	}
+
+	if (p_ctx->fw_pending)
+	{
+		p_ctx->fw_pending = 0;
+		is_created = 1;
+
+		err_code = dfu_serial_get_execute_create_rsp(p_uart);
+	}
+
+	if (!err_code && p_ctx->fw_recover_offset > pos)
+	{
+		uint32_t offset = p_ctx->fw_recover_offset;
 
-		for (pos = pos_start; pos < data_size; pos += stp_size)
+		if (offset > pos + obj_size)
 		{
-			stp_size = MIN((data_size - pos), max_size);
+			p_ctx->fw_pos += obj_size;
+			p_ctx->fw_crc = crc32_compute(p_data, obj_size, &p_ctx->fw_crc);
 
-			err_code = dfu_serial_create_obj(p_uart, 0x02, stp_size);
+			return err_code;
+		}
 
-			if (!err_code)
-			{
-				err_code = dfu_serial_stream_data_crc(p_uart, p_data + pos, stp_size, pos, &crc_32);
-			}
+		p_ctx->fw_recover_offset = 0;
+		crc_obj = crc32_compute(p_data, offset - pos, &crc_obj);
 
-			if (!err_code)
+		if (crc_obj == p_ctx->fw_recover_crc)
+		{
+			is_sent = 1;
+
+			if (offset < pos + obj_size)
 			{
-				err_code = dfu_serial_execute_obj(p_uart);
+				err_code = dfu_serial_stream_data_crc(p_uart, p_data + (offset - pos), pos + obj_size - offset, offset, &crc_obj);
+
+				if (err_code == 2)
+				{
+					err_code = 0;
+					is_sent = 0;
+				}
 			}
+		}
+	}
 
-			logger_progress_log(data_size, pos);
+	while (!err_code && !is_sent)
+	{
+		uint32_t start_ms;
 
-			if (err_code)
-				break;
+		if (!is_created)
+		{
+			err_code = dfu_serial_create_obj(p_uart, 0x02, obj_size);
+			is_created = 1;
+
+			continue;
 		}
+
+		crc_obj = p_ctx->fw_crc;
+		start_ms = delay_get_tick_ms();
+
+		err_code = dfu_serial_stream_data_crc(p_uart, p_data, obj_size, pos, &crc_obj);
+		p_ctx->object_ms = delay_get_tick_ms() - start_ms;
+
+		if (err_code == 2 && retries < DFU_SERIAL_OBJECT_RETRIES)
+		{
+			logger_info_1("Resending data object: offset:%u", pos);
+
+			retries++;
+			is_created = 0;
+
+			// a new object starts over from the last executed one
+			err_code = dfu_serial_adapt_prn(p_uart, p_ctx->fw_max_size, 1);
+		}
+		else if (!err_code)
+		{
+			is_sent = 1;
+
+			err_code = dfu_serial_adapt_prn(p_uart, p_ctx->fw_max_size, 0);
+		}
+	}
+
+	if (!err_code)
+	{
+		p_ctx->fw_pos += obj_size;
+		p_ctx->fw_crc = crc_obj;
+
+		if (p_ctx->fw_pos < p_ctx->fw_size)
+		{
+			err_code = dfu_serial_execute_create_obj(p_uart, 0x02, MIN((p_ctx->fw_size - p_ctx->fw_pos), p_ctx->fw_max_size));
+			p_ctx->fw_pending = 1;
+		}
+		else
+		{
+			err_code = dfu_serial_execute_obj(p_uart);
+		}
+
+		logger_progress_log(p_ctx->fw_size, p_ctx->fw_pos);
 	}
 
 	return err_code;
@@ -1,15 +1,14 @@
 #include "ext_error.h"
+#include "dfu_ctx.h"
 #include "ext_error_string.hpp"
 
-static int lastErrorCode = 0;
-
-void set_ext_error_code(int code) {
-  lastErrorCode = code;
+void set_ext_error_code(uart_drv_t* p_uart, int code) {
+  p_uart->p_ctx->ext_error_code = code;
 }
 
-int get_ext_error_code() {
-  int code = lastErrorCode;
-  lastErrorCode = (int)NRF_DFU_EXT_ERROR::NO_ERROR_CODE; // reset code
+int get_ext_error_code(uart_drv_t* p_uart) {
+  int code = p_uart->p_ctx->ext_error_code;
+  p_uart->p_ctx->ext_error_code = (int)NRF_DFU_EXT_ERROR::NO_ERROR_CODE; // reset code
   return code;
 }
 
@@ -7,7 +7,9 @@
 
 #define MAX_BUF_LEN 512
 
-JetBeep::Logger* p_logger = nullptr;
+// several devices may be updated at the same time, each one by its own thread which logs with its own logger
+static thread_local JetBeep::Logger* p_logger = nullptr;
+static thread_local int prevProgress = -1;
 
 static std::string format_output(const char* format, va_list args_list) {
   char buffer[MAX_BUF_LEN];
@@ -70,12 +72,12 @@ int logger_get_info_level() {
 
 
 void logger_progress_start() {
+  prevProgress = -1;
   logger_info_1("---------------------");
   logger_info_1("Image upload started");
   logger_info_1("upload progress: 0%%");
 }
 void logger_progress_log(uint32_t size, uint32_t pos) {
-  static int prevProgress = -1;
   int progress = (int) (pos * 100 / size);
   if (prevProgress != progress) {
     prevProgress = progress;
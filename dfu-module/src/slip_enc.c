@@ -146,3 +146,63 @@ int decode_slip(uint8_t *pDestData, uint32_t *pDestSize, const uint8_t *pSrcData
 
 	return err_code;
 }
+
+void slip_decoder_init(slip_decoder_t *p_decoder, uint8_t *pDestData, uint32_t nDestSize)
+{
+	p_decoder->p_dest = pDestData;
+	p_decoder->dest_size = nDestSize;
+	p_decoder->size = 0;
+	p_decoder->is_escaped = false;
+}
+
+int slip_decoder_feed(slip_decoder_t *p_decoder, const uint8_t *pSrcData, uint32_t nSrcSize, uint32_t *pConsumed)
+{
+	int err_code = SLIP_DECODE_MORE;
+	uint32_t n;
+
+	for (n = 0; n < nSrcSize && err_code == SLIP_DECODE_MORE; n++)
+	{
+		uint8_t nSrcByte = *(pSrcData + n);
+
+		if (p_decoder->is_escaped)
+		{
+			p_decoder->is_escaped = false;
+
+			if (nSrcByte == SLIP_ESC_END)
+				nSrcByte = SLIP_END;
+			else if (nSrcByte == SLIP_ESC_ESC)
+				nSrcByte = SLIP_ESC;
+			else
+			{
+				err_code = SLIP_DECODE_ERROR;
+				break;
+			}
+		}
+		else if (nSrcByte == SLIP_END)
+		{
+			// an END in front of a frame only flushes the line noise
+			if (p_decoder->size)
+				err_code = SLIP_DECODE_DONE;
+
+			continue;
+		}
+		else if (nSrcByte == SLIP_ESC)
+		{
+			p_decoder->is_escaped = true;
+
+			continue;
+		}
+
+		if (p_decoder->size == p_decoder->dest_size)
+		{
+			err_code = SLIP_DECODE_ERROR;
+			break;
+		}
+
+		p_decoder->p_dest[p_decoder->size++] = nSrcByte;
+	}
+
+	*pConsumed = n;
+
+	return err_code;
+}
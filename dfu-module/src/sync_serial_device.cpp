@@ -11,6 +11,10 @@ using namespace boost::asio;
 #define ENDING "\r\n"
 #define ENDING_LEN 2
 
+// the bootloader answers once the flash is written, well below a second even for the biggest object, a device which
+// stays silent for this long is gone
+const std::chrono::milliseconds DFU::SyncSerialDevice::readTimeout(10000);
+
 DFU::SyncSerialDevice::SyncSerialDevice() : m_port(m_io_service), m_log("sync_serial_device") {
 }
 
@@ -22,18 +26,39 @@ DFU::SyncSerialDevice::~SyncSerialDevice() {
   }
 }
 
-size_t DFU::SyncSerialDevice::readBytes(void* p_buff, size_t read_size = 1) {
+size_t DFU::SyncSerialDevice::readBytes(void* p_buff, size_t read_size) {
   if (!m_port.is_open()) {
     throw runtime_error("readBytes: port closed");
   }
-  size_t resSize = asio::read(m_port, asio::buffer(p_buff, read_size));
-  auto logHandle = m_log.v();
+  boost::system::error_code readError = asio::error::would_block;
+  size_t resSize = 0;
+
+  m_port.async_read_some(asio::buffer(p_buff, read_size), [&](const boost::system::error_code& error, size_t size) {
+    readError = error;
+    resSize = size;
+  });
+  m_io_service.restart();
+  m_io_service.run_for(readTimeout);
+  if (readError == asio::error::would_block) {
+    // the cancelled read still has to complete before the buffer may be released
+    m_port.cancel();
+    m_io_service.restart();
+    m_io_service.run();
+  }
+  if (readError == asio::error::operation_aborted) {
+    throw runtime_error("readBytes: timeout");
+  } else if (readError) {
+    throw boost::system::system_error(readError);
+  }
+  if (Logger::isEnabled(LoggerLevel::verbose)) {
+    auto&& logHandle = m_log.v();
 
-  logHandle << "RX " << resSize << " bytes: [ ";
-  for (size_t i = 0; i < resSize; i++) {
-    logHandle << *((char*)(p_buff) + i) << " ";
+    logHandle << "RX " << resSize << " bytes: [ ";
+    for (size_t i = 0; i < resSize; i++) {
+      logHandle << *((char*)(p_buff) + i) << " ";
+    }
+    logHandle << "]" << Logger::endl;
   }
-  logHandle << "]" << Logger::endl;
   return resSize;
 }
 
@@ -68,13 +93,13 @@ void DFU::SyncSerialDevice::enterDFUMode() {
   string cmd = "ENTER_DFU_MODE" ENDING;
   write(m_port, asio::buffer(ENDING)); // to handle case with mcp2200 buffers issue after power on
   write(m_port, asio::buffer(cmd));
-  m_log.d() << "TX: " << cmd;
+  m_log.d() << "TX: " << cmd.substr(0, cmd.size() - ENDING_LEN) << Logger::endl;
 }
 
 void DFU::SyncSerialDevice::reset() {
   string cmd = "SOFT_RESET" ENDING;
   write(m_port, asio::buffer(cmd));
-  m_log.d() << "TX: " << cmd;
+  m_log.d() << "TX: " << cmd.substr(0, cmd.size() - ENDING_LEN) << Logger::endl;
 }
 
 string DFU::SyncSerialDevice::getResponseStr() {
@@ -88,7 +113,7 @@ string DFU::SyncSerialDevice::getResponseStr() {
 string DFU::SyncSerialDevice::getCmd(string prop) {
   string cmd = "GET " + prop + ENDING;
   write(m_port, asio::buffer(cmd));
-  m_log.d() << "TX: " << cmd;
+  m_log.d() << "TX: " << cmd.substr(0, cmd.size() - ENDING_LEN) << Logger::endl;
   string response = getResponseStr();
   auto responseParts = Utils::splitString(response);
   if (responseParts.size() != 3) {
@@ -6,8 +6,6 @@
 
 static JetBeep::Logger l("uart_drv");
 
-#define READ_CHUNK_SIZE 1
-
 using namespace DFU;
 
 int uart_drv_send(uart_drv_t* p_uart, const uint8_t* pData, uint32_t nSize) {
@@ -30,7 +28,7 @@ int uart_drv_receive(uart_drv_t* p_uart, uint8_t* pData, uint32_t nSize, uint32_
       throw std::runtime_error("uart_drv_t* p_uart is NULL");
     }
     SyncSerialDevice * p_sd = (SyncSerialDevice *) p_uart->p_serial_device;
-    *pSize = p_sd->readBytes((void *) pData, READ_CHUNK_SIZE);
+    *pSize = p_sd->readBytes((void *) pData, nSize);
   } catch (std::exception &e) {
     l.e() << e.what() << JetBeep::Logger::endl;
     return -1;
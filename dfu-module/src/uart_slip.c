@@ -41,16 +41,14 @@
 #include <string.h>
 #include "uart_slip.h"
 #include "slip_enc.h"
+#include "dfu_ctx.h"
 #include "logging.h"
 
-#define UART_SLIP_BUFF_SIZE		(UART_SLIP_SIZE_MAX * 2 + 1)
-
-static uint8_t uart_slip_buff[UART_SLIP_BUFF_SIZE];
-
 int uart_slip_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize)
 {
 	int err_code = 0;
 	uint32_t nSlipSize;
+	uint8_t *uart_slip_buff = p_uart->p_ctx->slip_buff;
 
 	if (nSize > UART_SLIP_SIZE_MAX)
 	{
@@ -71,42 +69,56 @@ int uart_slip_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize)
 int uart_slip_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize)
 {
 	int err_code = 0;
-	uint32_t sizeBuffer;
-	uint32_t length, slip_len = 0;
+	slip_decoder_t decoder;
+	uint32_t consumed;
+	// bytes are read in chunks, the ones following a frame are kept for the next uart_slip_receive
+	dfu_ctx_t *p_ctx = p_uart->p_ctx;
+
+	slip_decoder_init(&decoder, pData, nSize);
 
 	do
 	{
-		sizeBuffer = sizeof(uart_slip_buff) - slip_len;
-		if (!sizeBuffer)
+		if (p_ctx->slip_rx_pos == p_ctx->slip_rx_len)
 		{
-			logger_error("UART buffer overflow!");
+			p_ctx->slip_rx_pos = 0;
+			p_ctx->slip_rx_len = 0;
 
-			err_code = 1;
+			err_code = uart_drv_receive(p_uart, p_ctx->slip_rx_buff, sizeof(p_ctx->slip_rx_buff), &p_ctx->slip_rx_len);
+			if (err_code)
+				break;
 
-			break;
-		}
+			if (!p_ctx->slip_rx_len)
+			{
+				logger_error("Read no data from UART!");
 
-		length = 0;
-		err_code = uart_drv_receive(p_uart, uart_slip_buff + slip_len, sizeBuffer, &length);
-		if (err_code)
-			break;
+				err_code = 1;
 
-		if (!length)
-		{
-			logger_error("Read no data from UART!");
+				break;
+			}
+		}
 
-			err_code = 1;
+		switch (slip_decoder_feed(&decoder, p_ctx->slip_rx_buff + p_ctx->slip_rx_pos, p_ctx->slip_rx_len - p_ctx->slip_rx_pos, &consumed))
+		{
+			case SLIP_DECODE_DONE:
+				p_ctx->slip_rx_pos += consumed;
+				*pSize = decoder.size;
+				return 0;
 
-			break;
-		}
+			case SLIP_DECODE_MORE:
+				p_ctx->slip_rx_pos += consumed;
+				break;
 
-		slip_len += length;
+			default:
+				logger_error("Invalid SLIP frame!");
 
-		if (!decode_slip(pData, pSize, uart_slip_buff, slip_len))
-		{
-			break;
+				err_code = 1;
+				break;
 		}
 	} while (!err_code);
 
+	// the rest of a broken frame must not be taken for the next response
+	p_ctx->slip_rx_pos = 0;
+	p_ctx->slip_rx_len = 0;
+
 	return err_code;
 }
@@ -32,6 +32,8 @@ void Cmd::process(const std::string& cmd, const std::vector<std::string>& params
     cancelPayment();
   } else if (cmd == "connection_state" || cmd == "connectionstate") {
     connectionState();
+  } else if (cmd == "metrics") {
+    metrics();
   } else if (cmd == "multi_test" || cmd == "multitest") {
     multiTest();
   } else {
@@ -198,6 +200,10 @@ void Cmd::connectionState() {
   m_log.i() << "mobile connected: " << connectionState << Logger::endl;
 }
 
+void Cmd::metrics() {
+  m_log.i() << "metrics:\n" << m_autoDevice.metrics().toString() << Logger::endl;
+}
+
 void Cmd::multiTest() {
   try {
     m_autoDevice.openSession();
@@ -24,6 +24,7 @@ private:
   void confirmPayment();
   void cancelPayment();
   void connectionState();
+  void metrics();
   void multiTest();
 
   void onStateChange(JetBeep::AutoDeviceState state, std::exception_ptr error);
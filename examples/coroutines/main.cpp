@@ -0,0 +1,74 @@
+#include "../../lib/libjetbeep.hpp"
+
+#include <iostream>
+#include <string>
+
+using namespace JetBeep;
+using namespace std;
+
+Logger l("main");
+
+// the info commands of the device awaited one after another, instead of a chain of then() callbacks. The commands
+// settle on the io context of the device, the result is printed from the one passed in
+static Promise<void> printDeviceInfo(SerialDevice& device, IOContext printContext) {
+  auto version = co_await device.get(DeviceParameter::version);
+  auto deviceId = co_await device.get(DeviceParameter::deviceId);
+
+  co_await resumeOn(printContext);
+  l.i() << "device id: " << deviceId << ", firmware version: " << version << Logger::endl;
+
+  // a rejected command is thrown from co_await and rejects the promise of the coroutine
+  co_await device.openSession();
+  co_await device.closeSession();
+  l.i() << "session opened and closed" << Logger::endl;
+}
+
+static void run(SerialDevice& device, IOContext printContext, const string& path) {
+  try {
+    device.open(path);
+  } catch (const exception& e) {
+    l.e() << "unable to open " << path << ": " << e.what() << Logger::endl;
+    return;
+  }
+  printDeviceInfo(device, printContext).catchError([](const exception_ptr& error) {
+    try {
+      rethrow_exception(error);
+    } catch (const exception& e) {
+      l.e() << e.what() << Logger::endl;
+    }
+  });
+}
+
+// usage: coroutines_example [device path], the first detected device is used when no path is given
+int main(int argc, char* argv[]) {
+  Logger::coutEnabled = true;
+  Logger::level = LoggerLevel::info;
+
+  IOContext printContext(1);
+  SerialDevice device;
+  DeviceDetection detection;
+
+  if (argc > 1) {
+    run(device, printContext, argv[1]);
+  } else {
+    bool isOpened = false;
+
+    detection.callback = [&](DeviceDetectionEvent event, DeviceCandidate candidate) {
+      if (event == DeviceDetectionEvent::added && !isOpened) {
+        isOpened = true;
+        run(device, printContext, candidate.path);
+      }
+    };
+    l.i() << "waiting for a device.." << Logger::endl;
+    try {
+      detection.start();
+    } catch (const exception& e) {
+      l.e() << e.what() << Logger::endl;
+      return -1;
+    }
+  }
+
+  string input;
+  getline(cin, input);
+  return 0;
+}
@@ -115,7 +115,7 @@ int main() {
     }
   };
 
-  auto onRefundResult = [&](EasyPayResult result) {
+  auto onRefundResult = [&](const EasyPayResult& result) {
     l.i() << "refund status: " << (int)result.Status << Logger::endl;
     if (result.Status == PaymentStatus::Accepted) {
       l.i() << "REFUND SUCCESS!: " << (int)result.Status << Logger::endl;
@@ -124,7 +124,7 @@ int main() {
     }
   };
 
-  auto onPaymentStatusGet = [&](EasyPayResult result) {
+  auto onPaymentStatusGet = [&](const EasyPayResult& result) {
     l.i() << "payment get status result: " << (int)result.Status << Logger::endl;
     if (result.Status == PaymentStatus::Accepted) {
       l.i() << "PAYMENT SUCCESS CONFIRMED!: " << (int)result.Status << Logger::endl;
@@ -139,7 +139,7 @@ int main() {
     }
   };
 
-  auto onPaymentResult = [&](EasyPayResult result) {
+  auto onPaymentResult = [&](const EasyPayResult& result) {
     l.i() << "Request result: " << result._rawResponse << Logger::endl;
     if (result.Status == EasyPayAPI::PaymentStatus::Accepted) {
       l.i() << "PAYMENT SUCCESS" << Logger::endl;
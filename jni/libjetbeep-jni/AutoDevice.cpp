@@ -264,7 +264,7 @@ JNIEXPORT void JNICALL Java_com_jetbeep_AutoDevice_requestBarcodes(JNIEnv* env,
 
   try {
     device->requestBarcodes()
-      .then([device](vector<Barcode> barcodes) {
+      .then([device](const vector<Barcode>& barcodes) {
         std::lock_guard<recursive_mutex> lock(JniUtils::mutex);
         auto env = JniUtils::attachCurrentThread();
         if (env == nullptr) {
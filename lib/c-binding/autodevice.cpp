@@ -1,6 +1,7 @@
 #define JETBEEP_API_EXPORTS
 #include "../libjetbeep.h"
 #include "../libjetbeep.hpp"
+#include <algorithm>
 #include <cstring>
 
 using namespace JetBeep;
@@ -68,7 +69,7 @@ JETBEEP_API jetbeep_error_t jetbeep_autodevice_request_barcodes(jetbeep_autodevi
   auto autodevice = (AutoDevice*)handle;
   try {
     autodevice->requestBarcodes()
-      .then([callback, data](vector<Barcode> barcodes) {
+      .then([callback, data](const vector<Barcode>& barcodes) {
         jetbeep_barcode_t* barcodesT = (jetbeep_barcode_t*)malloc(sizeof(jetbeep_barcode_t) * barcodes.size());
         size_t i = 0;
         for (auto it = barcodes.begin(); it != barcodes.end(); ++it) {
@@ -209,6 +210,24 @@ JETBEEP_API unsigned long jetbeep_autodevice_device_id(jetbeep_autodevice_handle
   return autodevice->deviceId();
 }
 
+JETBEEP_API size_t jetbeep_autodevice_metrics(jetbeep_autodevice_handle_t handle, char* buffer, size_t size) {
+  auto autodevice = (AutoDevice*)handle;
+  auto metrics = autodevice->metrics().toString();
+
+  if (buffer != nullptr && size != 0) {
+    auto length = std::min(metrics.size(), size - 1);
+
+    memcpy(buffer, metrics.c_str(), length);
+    buffer[length] = '\0';
+  }
+  return metrics.size();
+}
+
+JETBEEP_API void jetbeep_autodevice_reset_metrics(jetbeep_autodevice_handle_t handle) {
+  auto autodevice = (AutoDevice*)handle;
+  autodevice->resetMetrics();
+}
+
 JETBEEP_API void* jetbeep_autodevice_get_opaque(jetbeep_autodevice_handle_t handle) {
   auto autodevice = (AutoDevice*)handle;
   return autodevice->opaque;
@@ -66,6 +66,10 @@ JETBEEP_API jetbeep_error_t jetbeep_autodevice_cancel_payment(jetbeep_autodevice
 JETBEEP_API bool jetbeep_autodevice_is_mobile_connected(jetbeep_autodevice_handle_t handle);
 JETBEEP_API const char* jetbeep_autodevice_version(jetbeep_autodevice_handle_t handle);
 JETBEEP_API unsigned long jetbeep_autodevice_device_id(jetbeep_autodevice_handle_t handle);
+// writes the metrics of the serial connection in Prometheus text format, truncated to the buffer size. Returns the
+// length of the whole text, so a bigger buffer may be passed when the result is not less than the size
+JETBEEP_API size_t jetbeep_autodevice_metrics(jetbeep_autodevice_handle_t handle, char* buffer, size_t size);
+JETBEEP_API void jetbeep_autodevice_reset_metrics(jetbeep_autodevice_handle_t handle);
 JETBEEP_API void* jetbeep_autodevice_get_opaque(jetbeep_autodevice_handle_t handle);
 JETBEEP_API void jetbeep_autodevice_set_opaque(jetbeep_autodevice_handle_t handle, void* opaque);
 JETBEEP_API jetbeep_state_t jetbeep_autodevice_state(jetbeep_autodevice_handle_t handle);
@@ -30,7 +30,7 @@ JETBEEP_API jetbeep_error_t jetbeep_easypay_make_payment(jetbeep_easypay_handle_
     auto paymentToken = string(payment_token);
     auto cashierId = string(cashier_id);
     backend->makePayment(merchantTransactionId, paymentToken, amount_in_coins, device_id, cashierId)
-      .then([callback, data](EasyPayResult result) {
+      .then([callback, data](const EasyPayResult& result) {
         jetbeep_easypay_payment_result_t payment_result;
         if (result.isError()) {
           memset(&payment_result, 0, sizeof(payment_result));
@@ -94,7 +94,7 @@ JETBEEP_API jetbeep_error_t jetbeep_easypay_make_payment_partials(jetbeep_easypa
     }
 
     backend->makePaymentPartials(merchantTransactionId, paymentToken, amount_in_coins, device_id, metaData, cashierId)
-      .then([callback, data](EasyPayResult result) {
+      .then([callback, data](const EasyPayResult& result) {
         jetbeep_easypay_payment_result_t payment_result;
         if (result.isError()) {
           memset(&payment_result, 0, sizeof(payment_result));
@@ -143,7 +143,7 @@ JETBEEP_API jetbeep_error_t jetbeep_easypay_make_refund(jetbeep_easypay_handle_t
   auto backend = (EasyPayBackend*)handle;
   try {
     backend->makeRefund(easypay_transaction_id, amount_in_coins, device_id)
-      .then([callback, data](EasyPayResult result) {
+      .then([callback, data](const EasyPayResult& result) {
         jetbeep_easypay_refund_result_t refund_result;
 
         if (result.isError()) {
@@ -190,7 +190,7 @@ JETBEEP_API jetbeep_error_t jetbeep_easypay_make_refund_partials(jetbeep_easypay
   try {
     auto paymentRequestId = string(payment_request_uid);
     backend->makeRefundPartials(payment_request_uid, amount_in_coins, device_id)
-      .then([callback, data](EasyPayResult result) {
+      .then([callback, data](const EasyPayResult& result) {
         jetbeep_easypay_refund_result_t refund_result;
 
         if (result.isError()) {
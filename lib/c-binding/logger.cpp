@@ -28,6 +28,15 @@ JETBEEP_API void jetbeep_logger_set_cerr_enabled(bool enabled) {
 JETBEEP_API void jetbeep_logger_set_external_output_enabled(bool enabled) {
   Logger::externalOutputEnabled = enabled;
 }
+JETBEEP_API bool jetbeep_logger_is_async_enabled() {
+  return Logger::asyncEnabled;
+}
+JETBEEP_API void jetbeep_logger_set_async_enabled(bool enabled) {
+  Logger::asyncEnabled = enabled;
+}
+JETBEEP_API void jetbeep_logger_flush() {
+  Logger::flush();
+}
 
 JETBEEP_API void jetbeep_logger_set_external_output_callback(jetbeep_logger_line_callback_t callback, void *data) {
   Logger::outputCallback = [callback, data](const std::string& line) { callback(line.c_str(), data); };
@@ -26,6 +26,9 @@ JETBEEP_API bool jetbeep_logger_is_external_output_enabled();
 JETBEEP_API void jetbeep_logger_set_cout_enabled(bool enabled);
 JETBEEP_API void jetbeep_logger_set_cerr_enabled(bool enabled);
 JETBEEP_API void jetbeep_logger_set_external_output_enabled(bool enabled);
+JETBEEP_API bool jetbeep_logger_is_async_enabled();
+JETBEEP_API void jetbeep_logger_set_async_enabled(bool enabled);
+JETBEEP_API void jetbeep_logger_flush();
 
 JETBEEP_API void jetbeep_logger_set_external_output_callback(jetbeep_logger_line_callback_t callback, void *data);
 
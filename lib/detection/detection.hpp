@@ -45,7 +45,7 @@ namespace JetBeep {
 
   private:
     class Impl;
-    std::unique_ptr<Impl> m_impl;
+    std::shared_ptr<Impl> m_impl;
   };
 } // namespace JetBeep
 
@@ -5,43 +5,61 @@
 #include "../utils/logger.hpp"
 #include "detection.hpp"
 
-#include <algorithm>
 #include <atomic>
+#include <cstdio>
 #include <libudev.h>
+#include <mutex>
 #include <stdexcept>
-#include <thread>
-#include <unistd.h>
+#include <vector>
+
+#include <boost/asio/posix/stream_descriptor.hpp>
 
 using namespace JetBeep;
 using namespace std;
 
 typedef struct udev_device uDev;
 
-class DeviceDetection::Impl {
+// the pending monitor wait and posted notifications keep the implementation alive, so it may outlive its detection
+class DeviceDetection::Impl : public std::enable_shared_from_this<DeviceDetection::Impl> {
 public:
   Impl(DeviceDetectionCallback* callback, IOContext context);
   void startMonitoring();
   void stopMonitoring();
+  void detach();
   void detectConnected();
   virtual ~Impl();
 
 private:
   IOContext m_context;
+  IOStrand m_strand;
+  // cleared by the destroyed detection, as notifications posted before may still run
+  std::mutex m_callbackMutex;
   DeviceDetectionCallback* m_callback = nullptr;
   Logger m_log;
   struct udev* udev = nullptr;
   std::atomic<bool> isMonActive;
-  std::thread m_thread;
-  int monitorFDPipe[2] = {-1, -1};
+  // guards the monitor, start and stop may be called on another thread than the one running its handler
+  std::mutex m_monitorMutex;
+  // the monitor socket is watched by the reactor of the io context, so detection doesn't need a thread of its own
+  struct udev_monitor* m_monitor = nullptr;
+  boost::asio::posix::stream_descriptor m_monitorDescriptor;
   bool checkTTYParent(uDev*, DeviceCandidate*);
   bool checkDevVIDPID(uDev*, DeviceCandidate*);
-  void udevMonitorLoop();
+  void waitMonitorEvents();
+  void handleMonitorEvents(const boost::system::error_code& error);
+  void handleMonitorDevice(uDev* dev);
+  void enumerateTTYs(uDev* usbDevice, const VidPid& vidPid, vector<DeviceCandidate>& candidates);
+  void notify(DeviceDetectionEvent event, const DeviceCandidate& candidate);
 };
 
 // DeviceDetection implementation
 
 DeviceDetection::Impl::Impl(DeviceDetectionCallback* callback, IOContext context)
-  : m_callback(callback), m_log("detection"), m_context(context) {
+  : m_callback(callback),
+    m_log("detection"),
+    m_context(context),
+    m_strand(context.m_impl->ioService),
+    m_monitorDescriptor(context.m_impl->ioService) {
   udev = udev_new();
   if (udev == nullptr) {
     throw runtime_error("Unable to initialize UDEV");
@@ -94,159 +112,197 @@ bool DeviceDetection::Impl::checkTTYParent(uDev* ttyDevice, DeviceCandidate* dev
 }
 
 void DeviceDetection::Impl::stopMonitoring() {
-  isMonActive.store(false);
+  lock_guard<mutex> guard(m_monitorMutex);
 
-  if (write(monitorFDPipe[1], "\n", 1) == -1) {
-    throw runtime_error("pipe write error");
+  if (!isMonActive.exchange(false)) {
+    return;
   }
 
-  if (m_thread.joinable()) {
-    m_thread.join();
-  }
+  // the descriptor belongs to the monitor, it is closed by udev_monitor_unref
+  boost::system::error_code error;
+  m_monitorDescriptor.cancel(error);
+  m_monitorDescriptor.release();
+  udev_monitor_unref(m_monitor);
+  m_monitor = nullptr;
 
   m_log.d() << "Udev mon stopped" << Logger::endl;
 }
 
+void DeviceDetection::Impl::detach() {
+  stopMonitoring();
+
+  lock_guard<mutex> guard(m_callbackMutex);
+  m_callback = nullptr;
+}
+
 void DeviceDetection::Impl::startMonitoring() {
+  lock_guard<mutex> guard(m_monitorMutex);
+
   if (isMonActive.load()) {
     return;
   }
 
-  if (pipe(monitorFDPipe) == -1) {
-    throw runtime_error("pipe error");
+  m_monitor = udev_monitor_new_from_netlink(udev, "udev");
+  if (!m_monitor) {
+    throw runtime_error("Unable to create udev monitor");
   }
+  udev_monitor_filter_add_match_subsystem_devtype(m_monitor, "tty", nullptr);
+  udev_monitor_enable_receiving(m_monitor);
+
+  int monitorFD = udev_monitor_get_fd(m_monitor);
 
+  if (monitorFD < 0) {
+    udev_monitor_unref(m_monitor);
+    m_monitor = nullptr;
+    throw runtime_error("Unable to udev_monitor_get_fd");
+  }
+
+  m_monitorDescriptor.assign(monitorFD);
   isMonActive.store(true);
+  waitMonitorEvents();
 
-  m_thread = thread(&DeviceDetection::Impl::udevMonitorLoop, this);
+  m_log.d() << "Udev mon started" << Logger::endl;
 }
 
-void DeviceDetection::Impl::udevMonitorLoop() {
-  struct udev_enumerate* enumerate = nullptr;
-  uDev* dev = nullptr;
-  struct udev_monitor* mon = nullptr;
+void DeviceDetection::Impl::waitMonitorEvents() {
+  m_monitorDescriptor.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+                                 m_strand.wrap([self = shared_from_this()](const boost::system::error_code& error) {
+                                   self->handleMonitorEvents(error);
+                                 }));
+}
+
+void DeviceDetection::Impl::handleMonitorEvents(const boost::system::error_code& error) {
+  lock_guard<mutex> guard(m_monitorMutex);
 
-  if (!udev) {
+  if (error == boost::asio::error::operation_aborted || !isMonActive.load()) {
     return;
   }
 
-  mon = udev_monitor_new_from_netlink(udev, "udev");
-  udev_monitor_filter_add_match_subsystem_devtype(mon, "tty", nullptr);
-  udev_monitor_enable_receiving(mon);
-  int monitorFD = udev_monitor_get_fd(mon);
-
-  if (monitorFD < 0) {
-    throw runtime_error("Unable to udev_monitor_get_fd");
+  if (error) {
+    m_log.e() << "Udev mon error: " << error << Logger::endl;
+    return;
   }
 
-  m_log.d() << "Udev mon started" << Logger::endl;
-
-  while (isMonActive.load()) {
-    fd_set fds;
+  // the monitor socket is non-blocking, a single wakeup may carry several events
+  while (auto dev = udev_monitor_receive_device(m_monitor)) {
+    handleMonitorDevice(dev);
+  }
+  waitMonitorEvents();
+}
 
-    FD_ZERO(&fds);
-    FD_SET(monitorFD, &fds);
-    FD_SET(monitorFDPipe[0], &fds);
+void DeviceDetection::Impl::handleMonitorDevice(uDev* dev) {
+  auto action = udev_device_get_action(dev);
+  auto devNode = udev_device_get_devnode(dev);
 
-    int ret = select(max(monitorFD, monitorFDPipe[0]) + 1, &fds, nullptr, nullptr, nullptr);
+  if (!action || !devNode) {
+    return;
+  }
 
-    if (ret > 0 && FD_ISSET(monitorFD, &fds)) {
-      dev = udev_monitor_receive_device(mon);
-      if (!dev) {
-        continue;
-      }
+  m_log.d() << "Udev mon event: " << action << Logger::endl;
 
-      string action(udev_device_get_action(dev));
+  DeviceCandidate candidate;
+  candidate.path = string(devNode);
 
-      m_log.d() << "Udev mon event: " << action << Logger::endl;
+  if (string(action) == "add") {
+    if (checkTTYParent(dev, &candidate)) {
+      notify(DeviceDetectionEvent::added, candidate);
+    }
+  } else if (string(action) == "remove") {
+    if (checkDevVIDPID(dev, &candidate)) {
+      notify(DeviceDetectionEvent::removed, candidate);
+    }
+  }
+  // udev_device_unref(dev); //This causes segmentation fault... in some cases
+}
 
-      DeviceCandidate candidate;
-      auto devNode = udev_device_get_devnode(dev);
-      if (!devNode) {
-        continue;
-      }
+void DeviceDetection::Impl::notify(DeviceDetectionEvent event, const DeviceCandidate& candidate) {
+  m_strand.post([self = shared_from_this(), event, candidate] {
+    DeviceDetectionCallback callback;
 
-      candidate.path = string(devNode);
-
-      if (action == "add") {
-        if (checkTTYParent(dev, &candidate)) {
-          m_context.m_impl->ioService.post([&, candidate] {
-            auto callback = *m_callback;
-
-            if (callback) {
-              callback(DeviceDetectionEvent::added, candidate);
-            }
-          });
-        }
-      } else if (action == "remove") {
-        if (checkDevVIDPID(dev, &candidate)) {
-          m_context.m_impl->ioService.post([&, candidate] {
-            auto callback = *m_callback;
-
-            if (callback) {
-              callback(DeviceDetectionEvent::removed, candidate);
-            }
-          });
-        }
+    {
+      lock_guard<mutex> guard(self->m_callbackMutex);
+      if (self->m_callback) {
+        callback = *self->m_callback;
       }
-      // udev_device_unref(dev); //This causes segmentation fault... in some cases
     }
-  }
-
-  udev_monitor_unref(mon);
+    if (callback) {
+      callback(event, candidate);
+    }
+  });
 }
 
-void DeviceDetection::Impl::detectConnected() {
-  uDev* dev = nullptr;
-  struct udev_enumerate* enumerate = nullptr;
+void DeviceDetection::Impl::enumerateTTYs(uDev* usbDevice, const VidPid& vidPid, vector<DeviceCandidate>& candidates) {
   struct udev_list_entry *devices = nullptr, *deviceEntry = nullptr;
+  auto enumerate = udev_enumerate_new(udev);
 
-  enumerate = udev_enumerate_new(udev);
   if (!enumerate) {
     throw runtime_error("UDEV: Unable to initialize UDEV enumerate");
   }
 
+  udev_enumerate_add_match_parent(enumerate, usbDevice);
   udev_enumerate_add_match_subsystem(enumerate, "tty");
   udev_enumerate_scan_devices(enumerate);
 
   devices = udev_enumerate_get_list_entry(enumerate);
-  if (!devices) {
-    throw runtime_error("UDEV: Unable to get devices list");
-  }
-
   udev_list_entry_foreach(deviceEntry, devices) {
-    const char *path, *tmp, *vendorId, *productId;
-
-    path = udev_list_entry_get_name(deviceEntry);
-    dev = udev_device_new_from_syspath(udev, path);
+    auto dev = udev_device_new_from_syspath(udev, udev_list_entry_get_name(deviceEntry));
     if (!dev) {
       continue;
     }
 
-    struct udev_list_entry* attrsAvailable = udev_device_get_sysattr_list_entry(dev);
-
-    const char* devNode = udev_device_get_devnode(dev);
-
-    if (!devNode) {
-      udev_device_unref(dev);
-      continue;
+    auto devNode = udev_device_get_devnode(dev);
+    if (devNode) {
+      candidates.push_back({vidPid.vid, vidPid.pid, string(devNode)});
     }
+    udev_device_unref(dev);
+  }
+  udev_enumerate_unref(enumerate);
+}
 
-    DeviceCandidate deviceCandidate = {0, 0, string(devNode)};
+void DeviceDetection::Impl::detectConnected() {
+  vector<DeviceCandidate> candidates;
+
+  // usb devices are looked up by their ids first and only their ttys are enumerated, instead of checking the usb
+  // parent of every tty of the system
+  for (size_t i = 0; i < DeviceDetection::vidPidCount; ++i) {
+    auto& vidPid = DeviceDetection::validVidPids[i];
+    struct udev_list_entry *devices = nullptr, *deviceEntry = nullptr;
+    char vendorId[5], productId[5];
+    auto enumerate = udev_enumerate_new(udev);
+
+    if (!enumerate) {
+      throw runtime_error("UDEV: Unable to initialize UDEV enumerate");
+    }
 
-    if (checkTTYParent(dev, &deviceCandidate)) {
-      m_context.m_impl->ioService.post([&, deviceCandidate] {
-        auto callback = *m_callback;
+    snprintf(vendorId, sizeof(vendorId), "%04x", vidPid.vid);
+    snprintf(productId, sizeof(productId), "%04x", vidPid.pid);
+    udev_enumerate_add_match_subsystem(enumerate, "usb");
+    udev_enumerate_add_match_sysattr(enumerate, "idVendor", vendorId);
+    udev_enumerate_add_match_sysattr(enumerate, "idProduct", productId);
+    udev_enumerate_scan_devices(enumerate);
+
+    devices = udev_enumerate_get_list_entry(enumerate);
+    udev_list_entry_foreach(deviceEntry, devices) {
+      auto usbDevice = udev_device_new_from_syspath(udev, udev_list_entry_get_name(deviceEntry));
+      if (!usbDevice) {
+        continue;
+      }
 
-        if (callback) {
-          callback(DeviceDetectionEvent::added, deviceCandidate);
-        }
-      });
+      try {
+        enumerateTTYs(usbDevice, vidPid, candidates);
+      } catch (...) {
+        udev_device_unref(usbDevice);
+        udev_enumerate_unref(enumerate);
+        throw;
+      }
+      udev_device_unref(usbDevice);
     }
+    udev_enumerate_unref(enumerate);
+  }
 
-    udev_device_unref(dev);
+  for (auto& candidate : candidates) {
+    notify(DeviceDetectionEvent::added, candidate);
   }
-  udev_enumerate_unref(enumerate);
 }
 
 // DeviceDetection
@@ -255,6 +311,7 @@ DeviceDetection::DeviceDetection(IOContext context) : m_impl(new Impl(&this->cal
 }
 
 DeviceDetection::~DeviceDetection() {
+  m_impl->detach();
 }
 
 void DeviceDetection::start() {
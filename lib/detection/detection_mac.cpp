@@ -30,6 +30,7 @@ public:
 private:
   bool m_started;
   IOContext m_context;
+  IOStrand m_strand;
   DeviceDetectionCallback* m_callback;
   Logger m_log;
   CFRunLoopRef m_loop;
@@ -48,7 +49,7 @@ private:
 };
 
 DeviceDetection::Impl::Impl(DeviceDetectionCallback* callback, IOContext context)
-  : m_callback(callback), m_loop(NULL), m_iterator(0), m_notifyPort(NULL), m_log("detection"), m_context(context), m_started(false) {
+  : m_callback(callback), m_loop(NULL), m_iterator(0), m_notifyPort(NULL), m_log("detection"), m_context(context), m_strand(context.m_impl->ioService), m_started(false) {
 }
 
 DeviceDetection::Impl::~Impl() {
@@ -106,7 +107,7 @@ void DeviceDetection::Impl::deviceAdded(void* refCon, io_iterator_t iterator) {
 
       detection->m_trackedDevices[device.path] = make_pair(device, remove_service);
 
-      detection->m_context.m_impl->ioService.post([=] {
+      detection->m_strand.post([=] {
         auto callback = *detection->m_callback;
         if (callback != nullptr) {
           callback(DeviceDetectionEvent::added, device);
@@ -140,7 +141,7 @@ void DeviceDetection::Impl::deviceRemoved(void* refCon, io_service_t service, na
     return;
   }
 
-  detection->m_context.m_impl->ioService.post([=] {
+  detection->m_strand.post([=] {
     auto callback = *detection->m_callback;
 
     if (callback != nullptr) {
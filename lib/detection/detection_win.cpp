@@ -76,6 +76,7 @@ public:
 
 private:
   IOContext m_context;
+  IOStrand m_strand;
   DeviceDetectionCallback* m_callback = nullptr;
   Logger m_log;
   std::atomic<bool> isMonActive;
@@ -122,7 +123,7 @@ _SetupDiOpenDevRegKey DeviceDetection::Impl::DllSetupDiOpenDevRegKey = nullptr;
 // DeviceDetection implementation
 
 DeviceDetection::Impl::Impl(DeviceDetectionCallback* callback, IOContext context)
-  : m_callback(callback), m_log("detection"), m_context(context) {
+  : m_callback(callback), m_log("detection"), m_context(context), m_strand(context.m_impl->ioService) {
   isMonActive.store(false);
   isMonLoopBlocked.store(false);
   if (!m_hInstLib) {
@@ -211,7 +212,7 @@ void DeviceDetection::Impl::monitorLoop() {
     if (msg.message == APP_DEVICE_EVENT_MSG && lastDetectedCandidate.pid != 0) {
       auto action = DeviceDetection::Impl::lastDetectedAction;
       auto candidat = DeviceDetection::Impl::lastDetectedCandidate;
-      m_context.m_impl->ioService.post([&, action, candidat] {
+      m_strand.post([&, action, candidat] {
         auto callback = *m_callback;
         if (callback) {
           callback(action, candidat);
@@ -265,7 +266,7 @@ void DeviceDetection::Impl::detectConnected() {
     string portName = findPortName(hDevInfo, pspDevInfoData);
     if (portName.length()) {
       candidate.path = COM_PATH_PREFIX + portName;
-      m_context.m_impl->ioService.post([&, candidate] {
+      m_strand.post([&, candidate] {
         auto callback = *m_callback;
         if (callback) {
           callback(DeviceDetectionEvent::added, candidate);
@@ -5,8 +5,11 @@
 using namespace std;
 using namespace JetBeep;
 
-AutoDevice::AutoDevice(IOContext context)
-  : m_impl(new AutoDevice::Impl(&stateCallback, &paymentErrorCallback, &mobileCallback, &nfcEventCallback, &nfcDetectionErrorCallback, context)), opaque(nullptr) {
+AutoDevice::AutoDevice(IOContext context) : AutoDevice(context, false) {
+}
+
+AutoDevice::AutoDevice(IOContext context, bool isManaged)
+  : m_impl(new AutoDevice::Impl(&stateCallback, &paymentErrorCallback, &mobileCallback, &nfcEventCallback, &nfcDetectionErrorCallback, context, isManaged)), opaque(nullptr) {
 }
 AutoDevice::~AutoDevice() {
 }
@@ -96,6 +99,14 @@ std::string AutoDevice::version() {
   return m_impl->version();
 }
 
+SerialDeviceMetrics AutoDevice::metrics() {
+  return m_impl->metrics();
+}
+
+void AutoDevice::resetMetrics() {
+  m_impl->resetMetrics();
+}
+
 NFC::MifareClassic::MifareClassicProvider AutoDevice::getNFCMifareApiProvider() {
   return m_impl->getNFCMifareApiProvider();
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 
 #include "../io/iocontext.hpp"
 #include "../utils/promise.hpp"
+#include "device_metrics.hpp"
 #include "device_types.hpp"
 #include "./nfc/mifare-classic/mfc-provider.hpp"
 #include "./nfc/nfc-api-provider.hpp"
@@ -66,6 +67,10 @@ namespace JetBeep {
     std::string version();
     unsigned long deviceId();
 
+    // metrics of the serial connection, kept across reattaches of the device
+    SerialDeviceMetrics metrics();
+    void resetMetrics();
+
     void* opaque;
 
     AutoDeviceStateCallback stateCallback;
@@ -89,6 +94,13 @@ namespace JetBeep {
   private:
     class Impl;
     std::unique_ptr<Impl> m_impl;
+
+    // device which is attached to a candidate by AutoDeviceManager instead of running its own detection
+    AutoDevice(IOContext context, bool isManaged);
+
+    friend class AutoDeviceManager;
+    // attaches a device to the pty of the simulator in the benchmarks
+    friend struct AutoDeviceBenchmark;
   };
 } // namespace JetBeep
 
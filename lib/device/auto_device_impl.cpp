@@ -5,19 +5,43 @@
 #include "device_errors.hpp"
 #include "./nfc/mifare-classic/mfc-provider.hpp"
 
+#include <algorithm>
 #include <functional>
 
 using namespace boost;
 using namespace std;
 using namespace JetBeep;
 
+// retries of a failed init or reset start short, as a reattached device is usually ready a moment later, and back off
+// exponentially for a device which keeps failing
+static const boost::posix_time::millisec firstRetryDelay(100);
+static const boost::posix_time::millisec maxRetryDelay(2000);
+
+const boost::posix_time::millisec AutoDevice::Impl::removalGraceDelay(500);
+
+namespace {
+  // the reader attached to a detached managed device reported another device id
+  class OtherDeviceAttached : public std::exception {
+  public:
+    OtherDeviceAttached(unsigned long deviceId) : deviceId(deviceId) {
+    }
+    virtual char const* what() const noexcept {
+      return "Another device is attached";
+    }
+
+    unsigned long deviceId;
+  };
+} // namespace
+
 AutoDevice::Impl::Impl(AutoDeviceStateCallback* stateCallback,
                        AutoDevicePaymentErrorCallback* paymentErrorCallback,
                        AutoDeviceMobileCallback* mobileCallback,
                        AutoDeviceNFCEventCallback*  nfcEventCallback,
                        AutoDeviceNFCDetectionErrorCallback * nfcDetectionErrorCallback,
-                       IOContext context)
+                       IOContext context,
+                       bool isManaged)
   : m_context(context),
+    m_isManaged(isManaged),
     m_stateCallback(stateCallback),
     m_paymentErrorCallback(paymentErrorCallback),
     m_mobileCallback(mobileCallback),
@@ -26,11 +50,20 @@ AutoDevice::Impl::Impl(AutoDeviceStateCallback* stateCallback,
     m_state(AutoDeviceState::invalid),
     m_log("autodevice"),
     m_timer(context.m_impl->ioService),
+    m_removalTimer(context.m_impl->ioService),
+    m_isRemovalPending(false),
+    m_isSessionToRestore(false),
+    m_expectedDeviceId(0),
+    m_retryDelay(firstRetryDelay),
+    m_strand(std::make_shared<IOStrand>(context.m_impl->ioService)),
     m_mobileConnected(false),
     m_started(false),
     m_deviceId(0) {
-  m_device_sp = std::shared_ptr<SerialDevice>(new SerialDevice());
-  m_detection.callback = std::bind(&AutoDevice::Impl::onDeviceEvent, this, std::placeholders::_1, std::placeholders::_2);
+  m_device_sp = std::shared_ptr<SerialDevice>(new SerialDevice(context, m_strand));
+  if (!m_isManaged) {
+    m_detection.reset(new DeviceDetection(context));
+    m_detection->callback = std::bind(&AutoDevice::Impl::onDeviceEvent, this, std::placeholders::_1, std::placeholders::_2);
+  }
   m_device_sp->barcodesCallback = std::bind(&AutoDevice::Impl::onBarcodes, this, std::placeholders::_1);
   m_device_sp->paymentErrorCallback = std::bind(&AutoDevice::Impl::onPaymentError, this, std::placeholders::_1);
   m_device_sp->paymentSuccessCallback = std::bind(&AutoDevice::Impl::onPaymentSuccess, this);
@@ -54,7 +87,9 @@ void AutoDevice::Impl::start() {
   if (m_started) {
     throw Errors::InvalidState();
   }
-  m_detection.start();
+  if (m_detection) {
+    m_detection->start();
+  }
   m_started = true;
 }
 
@@ -65,12 +100,21 @@ void AutoDevice::Impl::stop() {
     throw Errors::InvalidState();
   }
 
-  m_detection.stop();
+  if (m_detection) {
+    m_detection->stop();
+  }
   try {
     m_device_sp->close();
   } catch (...) {
   }
+  // after closing, as commands rejected by it may schedule a retry
+  m_timer.cancel();
+  m_removalTimer.cancel();
+  m_isRemovalPending = false;
+  m_isSessionToRestore = false;
+  m_expectedDeviceId = 0;
   m_candidate = DeviceCandidate();
+  m_spareCandidate = DeviceCandidate();
   rejectPendingOperations();
   changeState(AutoDeviceState::invalid);
   m_started = false;
@@ -80,9 +124,32 @@ void AutoDevice::Impl::onDeviceEvent(DeviceDetectionEvent event, DeviceCandidate
   std::lock_guard<recursive_mutex> guard(m_mutex);
 
   switch (event) {
-  case DeviceDetectionEvent::added:
-    if (m_state != AutoDeviceState::invalid && m_state != AutoDeviceState::firmwareVersionNotSupported) {
+  case DeviceDetectionEvent::added: {
+    auto isReattached = false;
+
+    // the path may change when the reader is enumerated again and every reader has the same vid/pid, so a reader of
+    // the same kind is initialized and only taken over if it reports the device id of the removed one
+    if (m_isRemovalPending && candidate.vid == m_candidate.vid && candidate.pid == m_candidate.pid) {
+      m_log.i() << "device added within the removal grace time, checking whether it is the same one: " << candidate.path
+                << Logger::endl;
+      m_isRemovalPending = false;
+      isReattached = true;
+      try {
+        m_device_sp->close();
+      } catch (...) {
+      }
+      // after closing, as commands rejected by it may schedule a retry
+      m_timer.cancel();
+      m_retryDelay = firstRetryDelay;
+      m_candidate.path.clear();
+      m_expectedDeviceId = m_deviceId;
+    } else if (m_isRemovalPending ||
+               (m_state != AutoDeviceState::invalid && m_state != AutoDeviceState::firmwareVersionNotSupported)) {
       m_log.w() << "detected additional device in the system, ignoring.." << Logger::endl;
+      // a device which changed its path may be added before the old path is removed
+      if (!m_isManaged) {
+        m_spareCandidate = candidate;
+      }
       return;
     }
 
@@ -90,48 +157,188 @@ void AutoDevice::Impl::onDeviceEvent(DeviceDetectionEvent event, DeviceCandidate
       m_log.d() << "Opening device path: " << candidate.path << Logger::endl;
       m_device_sp->open(candidate.path);
       m_candidate = candidate;
-      initDevice();
     } catch (std::exception &error) {
       m_log.e() << "unable to open device! " << error.what() << Logger::endl;
+      // the removed reader has the rest of the grace time to come back
+      if (isReattached) {
+        m_isRemovalPending = true;
+        m_expectedDeviceId = 0;
+      }
+      return;
+    }
+    if (isReattached) {
+      m_removalTimer.cancel();
+    }
+    try {
+      initDevice();
+    } catch (std::exception& error) {
+      m_log.e() << "unable to init device! " << error.what() << Logger::endl;
+      scheduleRetry(&AutoDevice::Impl::handleInitError);
     }
     break;
+  }
   case DeviceDetectionEvent::removed:
-    if (m_candidate != candidate) {
+    if (m_spareCandidate == candidate) {
+      m_spareCandidate = DeviceCandidate();
       return;
     }
-
-    try {
-      m_device_sp->close();
-    } catch (...) {
-      m_log.e() << "unable to close device!" << Logger::endl;
+    if (m_candidate != candidate || m_isRemovalPending) {
+      return;
     }
-    rejectPendingOperations();
-    changeState(AutoDeviceState::invalid, make_exception_ptr(Errors::DeviceLost()));
+    // a device which changed its path is replaced right away, otherwise it waits a moment for the lost one to come
+    // back before it is reported
+    if (!m_spareCandidate.path.empty()) {
+      loseDevice();
+      return;
+    }
+    // until the reader is back the device is invalid for callers, so no operation is queued against the lost port
+    m_isRemovalPending = true;
+    m_isSessionToRestore = m_state != AutoDeviceState::invalid && m_state != AutoDeviceState::firmwareVersionNotSupported &&
+                           m_state != AutoDeviceState::sessionClosed;
+    changeState(AutoDeviceState::invalid);
+    // the grace time of a managed device is run by AutoDeviceManager, which loses the device once it is over
+    if (m_isManaged) {
+      return;
+    }
+    m_removalTimer.expires_from_now(removalGraceDelay);
+    m_removalTimer.async_wait(
+      m_strand->wrap(boost::bind(&AutoDevice::Impl::handleRemoval, this, asio::placeholders::error)));
     break;
   }
 }
 
+void AutoDevice::Impl::handleRemoval(const boost::system::error_code& err) {
+  std::lock_guard<recursive_mutex> guard(m_mutex);
+
+  if (err == boost::asio::error::operation_aborted || !m_isRemovalPending) {
+    return;
+  }
+  m_isRemovalPending = false;
+  loseDevice();
+}
+
+void AutoDevice::Impl::loseDevice() {
+  std::lock_guard<recursive_mutex> guard(m_mutex);
+
+  m_isRemovalPending = false;
+  try {
+    m_device_sp->close();
+  } catch (...) {
+    m_log.e() << "unable to close device!" << Logger::endl;
+  }
+  m_timer.cancel();
+  m_retryDelay = firstRetryDelay;
+  m_isSessionToRestore = false;
+  m_expectedDeviceId = 0;
+  m_candidate = DeviceCandidate();
+  rejectPendingOperations();
+  changeState(AutoDeviceState::invalid, make_exception_ptr(Errors::DeviceLost()));
+
+  if (!m_spareCandidate.path.empty()) {
+    auto spareCandidate = m_spareCandidate;
+
+    m_spareCandidate = DeviceCandidate();
+    onDeviceEvent(DeviceDetectionEvent::added, spareCandidate);
+  }
+}
+
+bool AutoDevice::Impl::isRemovalPending() {
+  std::lock_guard<recursive_mutex> guard(m_mutex);
+
+  return m_isRemovalPending;
+}
+
+void AutoDevice::Impl::attach(const DeviceCandidate& candidate) {
+  onDeviceEvent(DeviceDetectionEvent::added, candidate);
+}
+
+void AutoDevice::Impl::detach(const DeviceCandidate& candidate) {
+  onDeviceEvent(DeviceDetectionEvent::removed, candidate);
+}
+
 void AutoDevice::Impl::initDevice() {
   m_pendingOperations.clear();
   rejectPendingOperations();
-  m_device_sp->get(DeviceParameter::version)
-    .thenPromise<std::string, Promise>([&](std::string version) {
+
+  // the init commands are written at once and validated as their responses arrive, so a (re)attached device is ready
+  // after a single round trip. A device with unsupported firmware is closed anyway, so resetting it early is harmless
+  Promise<std::string> version, deviceId;
+  Promise<void> reset;
+
+  m_device_sp->setPipelined(true);
+  try {
+    version = m_device_sp->get(DeviceParameter::version);
+    deviceId = m_device_sp->get(DeviceParameter::deviceId);
+    reset = m_device_sp->resetState();
+  } catch (...) {
+    m_device_sp->setPipelined(false);
+    throw;
+  }
+  m_device_sp->setPipelined(false);
+
+  version
+    .thenPromise<std::string, Promise>([&, deviceId](std::string version) {
       if (Utils::deviceFWVerToNumber(version) < Utils::deviceFWVerToNumber(JETBEEP_DEVICE_MIN_FW_VER)) {
         throw Errors::FirmwareVersionNotSupported();
       }
+      // read by version() from the threads of callers
+      std::lock_guard<recursive_mutex> guard(m_mutex);
       m_version = version;
-      return m_device_sp->get(DeviceParameter::deviceId);
+      return deviceId;
     })
-    .thenPromise([&](std::string strDeviceId) {
-      m_deviceId = std::strtoul(strDeviceId.c_str(), nullptr, 16);
-      return m_device_sp->resetState();
+    .thenPromise([&, reset](std::string strDeviceId) {
+      std::lock_guard<recursive_mutex> guard(m_mutex);
+      auto deviceId = std::strtoul(strDeviceId.c_str(), nullptr, 16);
+
+      if (m_expectedDeviceId != 0 && deviceId != m_expectedDeviceId) {
+        if (m_isManaged) {
+          throw OtherDeviceAttached(deviceId);
+        }
+        // the removed device is lost and the attached one is served as a new device
+        m_log.w() << "another device is attached in place of the removed one" << Logger::endl;
+        m_isSessionToRestore = false;
+        changeState(AutoDeviceState::invalid, make_exception_ptr(Errors::DeviceLost()));
+      }
+      m_expectedDeviceId = 0;
+      m_deviceId = deviceId;
+      return reset;
+    })
+    .then([&](...) {
+      m_retryDelay = firstRetryDelay;
+      changeState(AutoDeviceState::sessionClosed, nullptr);
+      if (m_isSessionToRestore) {
+        m_isSessionToRestore = false;
+        try {
+          openSession();
+        } catch (std::exception& error) {
+          m_log.e() << "unable to open the session of the reattached device: " << error.what() << Logger::endl;
+        }
+      }
     })
-    .then([&](...) { changeState(AutoDeviceState::sessionClosed, nullptr); })
     .catchError([&](const std::exception_ptr error) {
       try {
         std::rethrow_exception(error);
+      } catch (const OtherDeviceAttached& other) {
+        // the port is closed before the manager hands the reader to another device
+        auto candidate = m_candidate;
+        auto callback = otherDeviceCallback;
+
+        m_log.w() << "another device is attached in place of the removed one" << Logger::endl;
+        try {
+          m_device_sp->close();
+        } catch (...) {
+        }
+        m_timer.cancel();
+        m_candidate.path.clear();
+        m_isRemovalPending = true;
+        if (callback) {
+          auto deviceId = other.deviceId;
+          m_strand->post([callback, candidate, deviceId] { callback(candidate, deviceId); });
+        }
       } catch (const Errors::FirmwareVersionNotSupported& fwError) {
         m_log.w() << "Device firmware version too low" << Logger::endl;
+        m_expectedDeviceId = 0;
+        m_isSessionToRestore = false;
         if (m_state != AutoDeviceState::firmwareVersionNotSupported) {
           changeState(AutoDeviceState::firmwareVersionNotSupported, make_exception_ptr(fwError));
         }
@@ -144,8 +351,7 @@ void AutoDevice::Impl::initDevice() {
           changeState(AutoDeviceState::invalid, error);
         }
         m_log.e() << "unable to init device" << Logger::endl;
-        m_timer.expires_from_now(boost::posix_time::millisec(2000));
-        m_timer.async_wait(boost::bind(&AutoDevice::Impl::handleInitError, this, asio::placeholders::error));
+        scheduleRetry(&AutoDevice::Impl::handleInitError);
       }
     });
 }
@@ -154,14 +360,24 @@ void AutoDevice::Impl::resetState() {
   m_pendingOperations.clear();
   rejectPendingOperations();
 
-  m_device_sp->resetState().then([&]() { changeState(AutoDeviceState::sessionClosed, nullptr); }).catchError([&](exception_ptr exception) {
-    m_log.e() << "unable to reset state!" << Logger::endl;
-    if (m_state != AutoDeviceState::invalid) {
-      changeState(AutoDeviceState::invalid, exception);
-    }
-    m_timer.expires_from_now(boost::posix_time::millisec(2000));
-    m_timer.async_wait(boost::bind(&AutoDevice::Impl::handleTimeout, this, asio::placeholders::error));
-  });
+  m_device_sp->resetState()
+    .then([&]() {
+      m_retryDelay = firstRetryDelay;
+      changeState(AutoDeviceState::sessionClosed, nullptr);
+    })
+    .catchError([&](exception_ptr exception) {
+      m_log.e() << "unable to reset state!" << Logger::endl;
+      if (m_state != AutoDeviceState::invalid) {
+        changeState(AutoDeviceState::invalid, exception);
+      }
+      scheduleRetry(&AutoDevice::Impl::handleTimeout);
+    });
+}
+
+void AutoDevice::Impl::scheduleRetry(void (AutoDevice::Impl::*handler)(const boost::system::error_code&)) {
+  m_timer.expires_from_now(m_retryDelay);
+  m_timer.async_wait(m_strand->wrap(boost::bind(handler, this, asio::placeholders::error)));
+  m_retryDelay = std::min(m_retryDelay * 2, boost::posix_time::time_duration(maxRetryDelay));
 }
 
 void AutoDevice::Impl::handleTimeout(const boost::system::error_code& err) {
@@ -181,7 +397,12 @@ void AutoDevice::Impl::handleInitError(const boost::system::error_code& err) {
     return;
   }
   m_log.i() << "trying to init device one more time..." << Logger::endl;
-  initDevice();
+  try {
+    initDevice();
+  } catch (std::exception& error) {
+    m_log.e() << "unable to init device! " << error.what() << Logger::endl;
+    scheduleRetry(&AutoDevice::Impl::handleInitError);
+  }
 }
 
 void AutoDevice::Impl::openSession() {
@@ -190,15 +411,9 @@ void AutoDevice::Impl::openSession() {
   if (m_state != AutoDeviceState::sessionClosed) {
     throw Errors::InvalidState();
   }
+  enqueueOperation(AutoDeviceOperationType::openSession);
+  startOperation();
   changeState(AutoDeviceState::sessionOpened);
-  auto lambda = [&] {
-    m_device_sp->openSession().then([&] { executeNextOperation(); }).catchError([&](exception_ptr) {
-      m_log.e() << "open session error" << Logger::endl;
-      resetState();
-    });
-  };
-
-  enqueueOperation(lambda);
 }
 
 void AutoDevice::Impl::closeSession() {
@@ -207,15 +422,9 @@ void AutoDevice::Impl::closeSession() {
   if (m_state == AutoDeviceState::sessionClosed || m_state == AutoDeviceState::invalid) {
     throw Errors::InvalidState();
   }
+  enqueueOperation(AutoDeviceOperationType::closeSession);
+  startOperation();
   changeState(AutoDeviceState::sessionClosed);
-  auto lambda = [&] {
-    m_device_sp->closeSession().then([&] { executeNextOperation(); }).catchError([&](exception_ptr) {
-      m_log.e() << "close session error" << Logger::endl;
-      resetState();
-    });
-  };
-
-  enqueueOperation(lambda);
 }
 
 void AutoDevice::Impl::enableBluetooth() {
@@ -224,13 +433,8 @@ void AutoDevice::Impl::enableBluetooth() {
   if (m_state == AutoDeviceState::sessionOpened || m_state == AutoDeviceState::invalid) {
     throw Errors::InvalidState();
   }
-  auto operation = [&] {
-    m_device_sp->set(DeviceParameter::bluetooth, INTERFACE_ENABLED).then([&] { executeNextOperation(); }).catchError([&](exception_ptr) {
-      m_log.e() << "bluetooth enabling error" << Logger::endl;
-    });
-  };
-
-  enqueueOperation(operation);
+  enqueueOperation(AutoDeviceOperationType::enableBluetooth);
+  startOperation();
 }
 
 void AutoDevice::Impl::disableBluetooth() {
@@ -239,13 +443,8 @@ void AutoDevice::Impl::disableBluetooth() {
   if (m_state == AutoDeviceState::sessionOpened || m_state == AutoDeviceState::invalid) {
     throw Errors::InvalidState();
   }
-  auto operation = [&] {
-    m_device_sp->set(DeviceParameter::bluetooth, INTERFACE_DISABLED).then([&] { executeNextOperation(); }).catchError([&](exception_ptr) {
-      m_log.e() << "bluetooth disabling error" << Logger::endl;
-    });
-  };
-
-  enqueueOperation(operation);
+  enqueueOperation(AutoDeviceOperationType::disableBluetooth);
+  startOperation();
 }
 
 void AutoDevice::Impl::enableNFC() {
@@ -254,14 +453,9 @@ void AutoDevice::Impl::enableNFC() {
   if (m_state == AutoDeviceState::sessionOpened || m_state == AutoDeviceState::invalid) {
     throw Errors::InvalidState();
   }
-  auto operation = [&] {
-    m_device_sp->set(DeviceParameter::nfc, INTERFACE_ENABLED).then([&] { executeNextOperation(); }).catchError([&](exception_ptr) {
-      m_log.e() << "NFC enabling error" << Logger::endl;
-    });
-  };
   //TODO pass error to application, to handle cases when NFC is not available
-
-  enqueueOperation(operation);
+  enqueueOperation(AutoDeviceOperationType::enableNFC);
+  startOperation();
 }
 
 void AutoDevice::Impl::disableNFC() {
@@ -270,13 +464,8 @@ void AutoDevice::Impl::disableNFC() {
   if (m_state == AutoDeviceState::sessionOpened || m_state == AutoDeviceState::invalid) {
     throw Errors::InvalidState();
   }
-  auto operation = [&] {
-    m_device_sp->set(DeviceParameter::nfc, INTERFACE_DISABLED).then([&] { executeNextOperation(); }).catchError([&](exception_ptr) {
-      m_log.e() << "NFC disabling error" << Logger::endl;
-    });
-  };
-
-  enqueueOperation(operation);
+  enqueueOperation(AutoDeviceOperationType::disableNFC);
+  startOperation();
 }
 
 Promise<std::vector<Barcode>> AutoDevice::Impl::requestBarcodes() {
@@ -285,17 +474,10 @@ Promise<std::vector<Barcode>> AutoDevice::Impl::requestBarcodes() {
   if (m_state != AutoDeviceState::sessionOpened) {
     throw Errors::InvalidState();
   }
+  enqueueOperation(AutoDeviceOperationType::requestBarcodes);
+  startOperation();
   changeState(AutoDeviceState::waitingForBarcodes);
   m_barcodesPromise = Promise<std::vector<Barcode>>();
-
-  auto lambda = [&] {
-    m_device_sp->requestBarcodes().then([&] { executeNextOperation(); }).catchError([&](exception_ptr) {
-      m_log.e() << "close session error" << Logger::endl;
-      resetState();
-    });
-  };
-
-  enqueueOperation(lambda);
   return m_barcodesPromise;
 }
 
@@ -305,15 +487,9 @@ void AutoDevice::Impl::cancelBarcodes() {
   if (m_state != AutoDeviceState::waitingForBarcodes) {
     throw Errors::InvalidState();
   }
+  enqueueOperation(AutoDeviceOperationType::cancelBarcodes);
+  startOperation();
   changeState(AutoDeviceState::sessionOpened);
-  auto lambda = [&] {
-    m_device_sp->cancelBarcodes().then([&] { executeNextOperation(); }).catchError([&](exception_ptr) {
-      m_log.e() << "cancel barcodes error" << Logger::endl;
-      resetState();
-    });
-  };
-
-  enqueueOperation(lambda);
 }
 
 Promise<void> AutoDevice::Impl::createPayment(uint32_t amount,
@@ -326,17 +502,15 @@ Promise<void> AutoDevice::Impl::createPayment(uint32_t amount,
     throw Errors::InvalidState();
   }
 
+  auto& operation = enqueueOperation(AutoDeviceOperationType::createPayment);
+  operation.amount = amount;
+  operation.transactionId = transactionId;
+  operation.cashierId = cashierId;
+  operation.metadata = metadata;
+
+  startOperation();
   changeState(AutoDeviceState::waitingForPaymentResult);
   m_paymentPromise = Promise<void>();
-
-  auto lambda = [&, amount, transactionId, cashierId, metadata] {
-    m_device_sp->createPayment(amount, transactionId, cashierId, metadata).then([&] { executeNextOperation(); }).catchError([&](exception_ptr) {
-      m_log.e() << "create payment error" << Logger::endl;
-      resetState();
-    });
-  };
-
-  enqueueOperation(lambda);
   return m_paymentPromise;
 }
 
@@ -350,17 +524,15 @@ Promise<std::string> AutoDevice::Impl::createPaymentToken(uint32_t amount,
     throw Errors::InvalidState();
   }
 
+  auto& operation = enqueueOperation(AutoDeviceOperationType::createPaymentToken);
+  operation.amount = amount;
+  operation.transactionId = transactionId;
+  operation.cashierId = cashierId;
+  operation.metadata = metadata;
+
+  startOperation();
   changeState(AutoDeviceState::waitingForPaymentToken);
   m_paymentTokenPromise = Promise<string>();
-
-  auto lambda = [&, amount, transactionId, cashierId, metadata] {
-    m_device_sp->createPaymentToken(amount, transactionId, cashierId, metadata).then([&] { executeNextOperation(); }).catchError([&](exception_ptr) {
-      m_log.e() << "create payment token error" << Logger::endl;
-      resetState();
-    });
-  };
-
-  enqueueOperation(lambda);
   return m_paymentTokenPromise;
 }
 
@@ -371,15 +543,9 @@ void AutoDevice::Impl::confirmPayment() {
     throw Errors::InvalidState();
   }
 
+  enqueueOperation(AutoDeviceOperationType::confirmPayment);
+  startOperation();
   changeState(AutoDeviceState::sessionClosed);
-  auto lambda = [&] {
-    m_device_sp->confirmPayment().then([&] { executeNextOperation(); }).catchError([&](exception_ptr) {
-      m_log.e() << "confirm payment error" << Logger::endl;
-      resetState();
-    });
-  };
-
-  enqueueOperation(lambda);
 }
 
 void AutoDevice::Impl::cancelPayment() {
@@ -390,31 +556,147 @@ void AutoDevice::Impl::cancelPayment() {
     throw Errors::InvalidState();
   }
 
+  enqueueOperation(AutoDeviceOperationType::cancelPayment);
+  startOperation();
   changeState(AutoDeviceState::sessionOpened);
-  auto lambda = [&] {
-    m_device_sp->cancelPayment().then([&] { executeNextOperation(); }).catchError([&](exception_ptr) {
-      m_log.e() << "cancel payment error" << Logger::endl;
-      resetState();
-    });
-  };
+}
 
-  enqueueOperation(lambda);
+static bool isInterfaceToggle(AutoDeviceOperationType type) {
+  return type == AutoDeviceOperationType::enableBluetooth || type == AutoDeviceOperationType::disableBluetooth ||
+         type == AutoDeviceOperationType::enableNFC || type == AutoDeviceOperationType::disableNFC;
 }
 
-void AutoDevice::Impl::enqueueOperation(const std::function<void()>& callback) {
-  if (m_pendingOperations.empty()) {
-    callback();
+static bool isBluetoothToggle(AutoDeviceOperationType type) {
+  return type == AutoDeviceOperationType::enableBluetooth || type == AutoDeviceOperationType::disableBluetooth;
+}
+
+// the operation is only queued here, callers fill in its parameters and update the state once it is started
+AutoDeviceOperation& AutoDevice::Impl::enqueueOperation(AutoDeviceOperationType type) {
+  // toggling an interface which is already waiting to be toggled only changes what the waiting command sets. The
+  // front one is running and is never rewritten
+  if (m_pendingOperations.size() > 1 && isInterfaceToggle(type)) {
+    auto& last = m_pendingOperations.back();
+
+    if (isInterfaceToggle(last.type) && isBluetoothToggle(last.type) == isBluetoothToggle(type)) {
+      last.type = type;
+      return last;
+    }
+  }
+  if (m_pendingOperations.full()) {
+    m_log.e() << "too many pending operations, device does not respond?" << Logger::endl;
+    throw Errors::OperationInProgress();
+  }
+  auto& operation = m_pendingOperations.push();
+  operation.type = type;
+  return operation;
+}
+
+void AutoDevice::Impl::startOperation() {
+  // operation has to be queued before it is started, as it may complete (and dequeue itself) synchronously
+  if (m_pendingOperations.size() == 1) {
+    try {
+      executeOperation(m_pendingOperations.front());
+    } catch (...) {
+      // the command was not issued (e.g. port is closed), so nothing will ever dequeue it
+      m_pendingOperations.pop();
+      throw;
+    }
   }
-  m_pendingOperations.push_back(callback);
 }
 
 void AutoDevice::Impl::executeNextOperation() {
-  m_pendingOperations.erase(m_pendingOperations.begin());
-  if (!m_pendingOperations.empty()) {
-    m_pendingOperations.front()();
+  std::lock_guard<recursive_mutex> guard(m_mutex);
+
+  m_pendingOperations.pop();
+  if (m_pendingOperations.empty()) {
+    return;
+  }
+  try {
+    executeOperation(m_pendingOperations.front());
+  } catch (std::exception& error) {
+    // its caller has switched the state already, so the whole queue is dropped and the device is reset later on
+    m_log.e() << "unable to start queued operation: " << error.what() << Logger::endl;
+    m_pendingOperations.clear();
+    rejectPendingOperations();
+    if (m_state != AutoDeviceState::invalid) {
+      changeState(AutoDeviceState::invalid, std::current_exception());
+    }
+    scheduleRetry(&AutoDevice::Impl::handleTimeout);
   }
 }
 
+void AutoDevice::Impl::executeOperation(const AutoDeviceOperation& operation) {
+  Promise<void> command;
+  const char* error = nullptr;
+  auto isResetNeeded = true;
+
+  switch (operation.type) {
+  case AutoDeviceOperationType::openSession:
+    command = m_device_sp->openSession();
+    error = "open session error";
+    break;
+  case AutoDeviceOperationType::closeSession:
+    command = m_device_sp->closeSession();
+    error = "close session error";
+    break;
+  case AutoDeviceOperationType::enableBluetooth:
+    command = m_device_sp->set(DeviceParameter::bluetooth, INTERFACE_ENABLED);
+    error = "bluetooth enabling error";
+    isResetNeeded = false;
+    break;
+  case AutoDeviceOperationType::disableBluetooth:
+    command = m_device_sp->set(DeviceParameter::bluetooth, INTERFACE_DISABLED);
+    error = "bluetooth disabling error";
+    isResetNeeded = false;
+    break;
+  case AutoDeviceOperationType::enableNFC:
+    command = m_device_sp->set(DeviceParameter::nfc, INTERFACE_ENABLED);
+    error = "NFC enabling error";
+    isResetNeeded = false;
+    break;
+  case AutoDeviceOperationType::disableNFC:
+    command = m_device_sp->set(DeviceParameter::nfc, INTERFACE_DISABLED);
+    error = "NFC disabling error";
+    isResetNeeded = false;
+    break;
+  case AutoDeviceOperationType::requestBarcodes:
+    command = m_device_sp->requestBarcodes();
+    error = "request barcodes error";
+    break;
+  case AutoDeviceOperationType::cancelBarcodes:
+    command = m_device_sp->cancelBarcodes();
+    error = "cancel barcodes error";
+    break;
+  case AutoDeviceOperationType::createPayment:
+    command = m_device_sp->createPayment(operation.amount, operation.transactionId, operation.cashierId, operation.metadata);
+    error = "create payment error";
+    break;
+  case AutoDeviceOperationType::createPaymentToken:
+    command =
+      m_device_sp->createPaymentToken(operation.amount, operation.transactionId, operation.cashierId, operation.metadata);
+    error = "create payment token error";
+    break;
+  case AutoDeviceOperationType::confirmPayment:
+    command = m_device_sp->confirmPayment();
+    error = "confirm payment error";
+    break;
+  case AutoDeviceOperationType::cancelPayment:
+    command = m_device_sp->cancelPayment();
+    error = "cancel payment error";
+    break;
+  }
+
+  command.then([&] { executeNextOperation(); }).catchError([&, error, isResetNeeded](exception_ptr) {
+    m_log.e() << error << Logger::endl;
+    if (isResetNeeded) {
+      resetState();
+    } else {
+      // a failed interface toggle leaves the session as it was, so the operations queued after it still run
+      executeNextOperation();
+    }
+  });
+}
+
 void AutoDevice::Impl::onBarcodes(const std::vector<Barcode>& barcodes) {
   std::lock_guard<recursive_mutex> guard(m_mutex);
 
@@ -542,7 +824,7 @@ void AutoDevice::Impl::changeState(AutoDeviceState state, exception_ptr exceptio
   std::lock_guard<recursive_mutex> guard(m_mutex);
   m_state = state;
 
-  m_context.m_impl->ioService.post([&, state, exception] {
+  m_strand->post([&, state, exception] {
     auto stateCallback = *m_stateCallback;
     if (stateCallback) {
       stateCallback(state, exception);
@@ -551,6 +833,8 @@ void AutoDevice::Impl::changeState(AutoDeviceState state, exception_ptr exceptio
 }
 
 AutoDeviceState AutoDevice::Impl::state() {
+  std::lock_guard<recursive_mutex> guard(m_mutex);
+
   return m_state;
 }
 
@@ -563,13 +847,29 @@ bool AutoDevice::Impl::isNFCDetected() {
 }
 
 std::string AutoDevice::Impl::version() {
+  std::lock_guard<recursive_mutex> guard(m_mutex);
+
   return m_version;
 }
 
 unsigned long AutoDevice::Impl::deviceId() {
+  std::lock_guard<recursive_mutex> guard(m_mutex);
+
   return m_deviceId;
 }
 
+SerialDeviceMetrics AutoDevice::Impl::metrics() {
+  return m_device_sp->metrics();
+}
+
+void AutoDevice::Impl::resetMetrics() {
+  m_device_sp->resetMetrics();
+}
+
+std::shared_ptr<IOStrand> AutoDevice::Impl::strand() {
+  return m_strand;
+}
+
 NFC::MifareClassic::MifareClassicProvider AutoDevice::Impl::getNFCMifareApiProvider() {
   if (!m_nfcDetected) {
     throw Errors::InvalidState();
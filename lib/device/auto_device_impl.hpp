@@ -4,6 +4,7 @@
 #include "../detection/detection.hpp"
 #include "../utils/logger.hpp"
 #include "../utils/promise.hpp"
+#include "../utils/ring_queue.hpp"
 #include "auto_device.hpp"
 #include "serial_device.hpp"
 
@@ -17,6 +18,31 @@
 #include <vector>
 
 namespace JetBeep {
+  enum class AutoDeviceOperationType : uint8_t {
+    openSession,
+    closeSession,
+    enableBluetooth,
+    disableBluetooth,
+    enableNFC,
+    disableNFC,
+    requestBarcodes,
+    cancelBarcodes,
+    createPayment,
+    createPaymentToken,
+    confirmPayment,
+    cancelPayment
+  };
+
+  // command waiting for the previous ones to complete. Records are reused by the queue, so payment parameters are
+  // assigned into buffers which are already allocated after the first payments
+  typedef struct AutoDeviceOperation {
+    AutoDeviceOperationType type;
+    uint32_t amount;
+    std::string transactionId;
+    std::string cashierId;
+    PaymentMetadata metadata;
+  } AutoDeviceOperation;
+
   class AutoDevice::Impl {
   public:
     Impl(AutoDeviceStateCallback* stateCallback,
@@ -24,12 +50,28 @@ namespace JetBeep {
          AutoDeviceMobileCallback* mobileCallback,
          AutoDeviceNFCEventCallback*  nfcEventCallback,
          AutoDeviceNFCDetectionErrorCallback * nfcDetectionErrorCallback,
-         IOContext context);
+         IOContext context,
+         bool isManaged = false);
     virtual ~Impl();
 
     void start();
     void stop();
 
+    // managed mode: candidates come from AutoDeviceManager instead of the own DeviceDetection. A detached device waits
+    // to be attached again until the manager loses it
+    void attach(const DeviceCandidate& candidate);
+    void detach(const DeviceCandidate& candidate);
+    void loseDevice();
+    bool isRemovalPending();
+
+    // a reader removed by a USB glitch (a hub reset) is added back within this time, the removal is only reported
+    // after it
+    static const boost::posix_time::millisec removalGraceDelay;
+
+    // managed mode: the reader attached to a detached device reported another device id. The device keeps waiting for
+    // its own reader and the manager serves this one. Called on the strand of the device
+    std::function<void(const DeviceCandidate& candidate, unsigned long deviceId)> otherDeviceCallback;
+
     void openSession();
     void closeSession();
 
@@ -60,10 +102,16 @@ namespace JetBeep {
     NFC::DetectionEventData getNFCCardInfo();
     std::string version();
     unsigned long deviceId();
+    SerialDeviceMetrics metrics();
+    void resetMetrics();
     NFC::MifareClassic::MifareClassicProvider getNFCMifareApiProvider();
 
+    // handlers of the device and of its serial device are serialized by this strand
+    std::shared_ptr<IOStrand> strand();
+
   private:
     IOContext m_context;
+    bool m_isManaged;
     bool m_started;
     bool m_mobileConnected;
     bool m_nfcDetected;
@@ -80,13 +128,27 @@ namespace JetBeep {
     Promise<void> m_paymentPromise;
     Promise<std::string> m_paymentTokenPromise;
     DeviceCandidate m_candidate;
+    // another device which was plugged in while this one is attached, it takes over once the current one is lost
+    DeviceCandidate m_spareCandidate;
     Logger m_log;
     AutoDeviceState m_state;
-    DeviceDetection m_detection;
+    std::unique_ptr<DeviceDetection> m_detection;
     std::shared_ptr<SerialDevice> m_device_sp;
     boost::asio::deadline_timer m_timer;
+    // the removal of the own device waits on this timer for the device to be added back
+    boost::asio::deadline_timer m_removalTimer;
+    bool m_isRemovalPending;
+    // a session which was open when the device was removed is opened again once the same reader is back
+    bool m_isSessionToRestore;
+    // id of the reader which was removed, a reattached one is only taken over if it reports the same id
+    unsigned long m_expectedDeviceId;
+    boost::posix_time::time_duration m_retryDelay;
+    std::shared_ptr<IOStrand> m_strand;
     std::recursive_mutex m_mutex;
-    std::vector<std::function<void()>> m_pendingOperations;
+    // a cashier may only queue a few commands ahead, e.g. cancel payment and close session, once it is full the device
+    // stopped responding and new operations are refused with Errors::OperationInProgress
+    static constexpr size_t maxPendingOperations = 16;
+    RingQueue<AutoDeviceOperation, maxPendingOperations> m_pendingOperations;
     std::string m_version;
     unsigned long m_deviceId;
 
@@ -96,8 +158,12 @@ namespace JetBeep {
     void initDevice();
     void handleTimeout(const boost::system::error_code& err);
     void handleInitError(const boost::system::error_code& err);
+    void handleRemoval(const boost::system::error_code& err);
+    void scheduleRetry(void (AutoDevice::Impl::*handler)(const boost::system::error_code&));
     void executeNextOperation();
-    void enqueueOperation(const std::function<void()>& callback);
+    AutoDeviceOperation& enqueueOperation(AutoDeviceOperationType type);
+    void startOperation();
+    void executeOperation(const AutoDeviceOperation& operation);
     void onBarcodes(const std::vector<Barcode>& barcodes);
     void onPaymentError(const PaymentError& error);
     void onPaymentSuccess();
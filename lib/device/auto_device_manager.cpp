@@ -0,0 +1,283 @@
+#include "../utils/platform.hpp"
+#include "auto_device_manager.hpp"
+#include "../detection/detection.hpp"
+#include "../io/iocontext_impl.hpp"
+#include "../utils/logger.hpp"
+#include "auto_device_impl.hpp"
+#include "device_errors.hpp"
+
+#include <algorithm>
+#include <mutex>
+
+using namespace std;
+using namespace JetBeep;
+
+class AutoDeviceManager::Impl {
+public:
+  Impl(AutoDeviceManagerCallback* callback, IOContext context);
+  virtual ~Impl();
+
+  void start();
+  void stop();
+
+  std::vector<std::shared_ptr<AutoDevice>> devices();
+  std::shared_ptr<AutoDevice> device(unsigned long deviceId);
+
+private:
+  typedef struct ManagedDevice {
+    DeviceCandidate candidate;
+    std::shared_ptr<AutoDevice> device;
+    // set while the reader of a removed device may still be added back
+    std::shared_ptr<boost::asio::deadline_timer> removalTimer;
+  } ManagedDevice;
+
+  IOContext m_context;
+  AutoDeviceManagerCallback* m_callback;
+  Logger m_log;
+  DeviceDetection m_detection;
+  bool m_started;
+  std::recursive_mutex m_mutex;
+  std::vector<ManagedDevice> m_devices;
+
+  void onDeviceEvent(DeviceDetectionEvent event, DeviceCandidate candidate);
+  void onOtherDevice(AutoDevice* reporter, const DeviceCandidate& candidate, unsigned long deviceId);
+  void onRemovalTimeout(const boost::system::error_code& err, std::shared_ptr<boost::asio::deadline_timer> timer);
+  void addDevice(const DeviceCandidate& candidate);
+  void reattachDevice(std::vector<ManagedDevice>::iterator it, const DeviceCandidate& candidate);
+  void waitForDevice(ManagedDevice& managedDevice);
+  void removeDevice(std::vector<ManagedDevice>::iterator it);
+};
+
+AutoDeviceManager::Impl::Impl(AutoDeviceManagerCallback* callback, IOContext context)
+  : m_context(context), m_callback(callback), m_log("autodevice_manager"), m_detection(context), m_started(false) {
+  m_detection.callback = std::bind(&AutoDeviceManager::Impl::onDeviceEvent, this, std::placeholders::_1, std::placeholders::_2);
+}
+
+AutoDeviceManager::Impl::~Impl() {
+  try {
+    if (m_started) {
+      stop();
+    }
+  } catch (...) {
+  }
+}
+
+void AutoDeviceManager::Impl::start() {
+  lock_guard<recursive_mutex> guard(m_mutex);
+
+  if (m_started) {
+    throw Errors::InvalidState();
+  }
+  m_detection.start();
+  m_started = true;
+}
+
+void AutoDeviceManager::Impl::stop() {
+  lock_guard<recursive_mutex> guard(m_mutex);
+
+  if (!m_started) {
+    throw Errors::InvalidState();
+  }
+
+  m_detection.stop();
+  while (!m_devices.empty()) {
+    removeDevice(m_devices.begin());
+  }
+  m_started = false;
+}
+
+std::vector<std::shared_ptr<AutoDevice>> AutoDeviceManager::Impl::devices() {
+  lock_guard<recursive_mutex> guard(m_mutex);
+  vector<shared_ptr<AutoDevice>> result;
+
+  result.reserve(m_devices.size());
+  for (auto& managedDevice : m_devices) {
+    result.push_back(managedDevice.device);
+  }
+  return result;
+}
+
+std::shared_ptr<AutoDevice> AutoDeviceManager::Impl::device(unsigned long deviceId) {
+  lock_guard<recursive_mutex> guard(m_mutex);
+
+  for (auto& managedDevice : m_devices) {
+    if (deviceId != 0 && managedDevice.device->deviceId() == deviceId) {
+      return managedDevice.device;
+    }
+  }
+  throw Errors::DeviceNotFound();
+}
+
+void AutoDeviceManager::Impl::onDeviceEvent(DeviceDetectionEvent event, DeviceCandidate candidate) {
+  lock_guard<recursive_mutex> guard(m_mutex);
+
+  if (!m_started) {
+    return;
+  }
+
+  auto it = find_if(m_devices.begin(), m_devices.end(), [&candidate](ManagedDevice& managedDevice) {
+    return managedDevice.candidate == candidate;
+  });
+
+  switch (event) {
+  case DeviceDetectionEvent::added: {
+    if (it != m_devices.end() && !it->removalTimer) {
+      m_log.w() << "device is already managed: " << candidate.path << Logger::endl;
+      return;
+    }
+    // a removed device keeps its state and its lane until the grace time is over. Its reader may come back on another
+    // path, so the reader is given to any removed device, which only takes it over if the device id matches
+    if (it == m_devices.end()) {
+      it = find_if(m_devices.begin(), m_devices.end(), [&candidate](ManagedDevice& managedDevice) {
+        return managedDevice.removalTimer && managedDevice.candidate.vid == candidate.vid &&
+               managedDevice.candidate.pid == candidate.pid;
+      });
+    }
+    if (it != m_devices.end()) {
+      reattachDevice(it, candidate);
+    } else {
+      addDevice(candidate);
+    }
+    break;
+  }
+  case DeviceDetectionEvent::removed:
+    if (it == m_devices.end() || it->removalTimer) {
+      return;
+    }
+
+    m_log.i() << "device removed, waiting for it to be added back: " << candidate.path << Logger::endl;
+    it->device->m_impl->detach(candidate);
+    waitForDevice(*it);
+    break;
+  }
+}
+
+void AutoDeviceManager::Impl::addDevice(const DeviceCandidate& candidate) {
+  auto device = shared_ptr<AutoDevice>(new AutoDevice(m_context, true));
+
+  m_log.i() << "device added: " << candidate.path << Logger::endl;
+  m_devices.push_back({candidate, device, nullptr});
+  device->m_impl->otherDeviceCallback = std::bind(
+    &AutoDeviceManager::Impl::onOtherDevice, this, device.get(), std::placeholders::_1, std::placeholders::_2);
+  // callbacks of the device have to be assigned before it starts reporting states
+  auto callback = *m_callback;
+  if (callback) {
+    callback(AutoDeviceManagerEvent::added, device);
+  }
+  device->m_impl->start();
+  device->m_impl->attach(candidate);
+}
+
+void AutoDeviceManager::Impl::reattachDevice(std::vector<ManagedDevice>::iterator it, const DeviceCandidate& candidate) {
+  m_log.i() << "device added within the removal grace time: " << candidate.path << " (device "
+            << it->device->deviceId() << ")" << Logger::endl;
+  it->candidate = candidate;
+  it->device->m_impl->attach(candidate);
+  // the port is opened right away, the device keeps waiting if it could not be
+  if (!it->device->m_impl->isRemovalPending()) {
+    it->removalTimer->cancel();
+    it->removalTimer.reset();
+  }
+}
+
+void AutoDeviceManager::Impl::waitForDevice(ManagedDevice& managedDevice) {
+  auto timer = make_shared<boost::asio::deadline_timer>(m_context.m_impl->ioService);
+
+  managedDevice.removalTimer = timer;
+  timer->expires_from_now(AutoDevice::Impl::removalGraceDelay);
+  timer->async_wait([this, timer](const boost::system::error_code& err) { onRemovalTimeout(err, timer); });
+}
+
+void AutoDeviceManager::Impl::onRemovalTimeout(const boost::system::error_code& err,
+                                               std::shared_ptr<boost::asio::deadline_timer> timer) {
+  if (err == boost::asio::error::operation_aborted) {
+    return;
+  }
+  lock_guard<recursive_mutex> guard(m_mutex);
+
+  auto it = find_if(m_devices.begin(), m_devices.end(), [&timer](ManagedDevice& managedDevice) {
+    return managedDevice.removalTimer == timer;
+  });
+  if (it == m_devices.end()) {
+    return;
+  }
+  m_log.i() << "device was not added back: " << it->device->deviceId() << Logger::endl;
+  it->device->m_impl->loseDevice();
+  removeDevice(it);
+}
+
+// the reader is another removed device coming back or a new one, the reporting device waits for its own reader again
+void AutoDeviceManager::Impl::onOtherDevice(AutoDevice* reporter, const DeviceCandidate& candidate, unsigned long deviceId) {
+  lock_guard<recursive_mutex> guard(m_mutex);
+
+  if (!m_started) {
+    return;
+  }
+
+  auto reporterIt = find_if(m_devices.begin(), m_devices.end(), [reporter](ManagedDevice& managedDevice) {
+    return managedDevice.device.get() == reporter;
+  });
+  if (reporterIt != m_devices.end() && reporterIt->device->m_impl->isRemovalPending()) {
+    reporterIt->candidate.path.clear();
+    if (!reporterIt->removalTimer) {
+      waitForDevice(*reporterIt);
+    }
+  }
+
+  auto it = find_if(m_devices.begin(), m_devices.end(), [deviceId](ManagedDevice& managedDevice) {
+    return managedDevice.removalTimer && managedDevice.device->deviceId() == deviceId;
+  });
+  if (it != m_devices.end()) {
+    reattachDevice(it, candidate);
+  } else {
+    addDevice(candidate);
+  }
+}
+
+void AutoDeviceManager::Impl::removeDevice(std::vector<ManagedDevice>::iterator it) {
+  auto managedDevice = *it;
+  auto callback = *m_callback;
+
+  m_devices.erase(it);
+  if (managedDevice.removalTimer) {
+    managedDevice.removalTimer->cancel();
+  }
+  try {
+    managedDevice.device->m_impl->detach(managedDevice.candidate);
+    managedDevice.device->m_impl->stop();
+  } catch (std::exception& error) {
+    m_log.e() << "unable to stop device: " << error.what() << Logger::endl;
+  }
+
+  if (callback) {
+    callback(AutoDeviceManagerEvent::removed, managedDevice.device);
+  }
+
+  // state callbacks of the device are already posted to its strand, so it is kept alive until they are executed
+  auto device = managedDevice.device;
+  device->m_impl->strand()->post([device] {});
+}
+
+// AutoDeviceManager
+
+AutoDeviceManager::AutoDeviceManager(IOContext context) : m_impl(new Impl(&callback, context)) {
+}
+
+AutoDeviceManager::~AutoDeviceManager() {
+}
+
+void AutoDeviceManager::start() {
+  m_impl->start();
+}
+
+void AutoDeviceManager::stop() {
+  m_impl->stop();
+}
+
+std::vector<std::shared_ptr<AutoDevice>> AutoDeviceManager::devices() {
+  return m_impl->devices();
+}
+
+std::shared_ptr<AutoDevice> AutoDeviceManager::device(unsigned long deviceId) {
+  return m_impl->device(deviceId);
+}
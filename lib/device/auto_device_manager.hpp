@@ -0,0 +1,43 @@
+#ifndef JETBEEP_AUTODEVICE_MANAGER__H
+#define JETBEEP_AUTODEVICE_MANAGER__H
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "../io/iocontext.hpp"
+#include "auto_device.hpp"
+
+namespace JetBeep {
+  enum class AutoDeviceManagerEvent { added, removed };
+
+  /* added is called before the device is initialized, so per-device callbacks can be assigned in it. deviceId() and
+   * version() of the device are valid after it reported AutoDeviceState::sessionClosed for the first time.
+   * A removed reader is waited for a moment (a USB glitch), the device is invalid meanwhile and takes the reader over
+   * again if it reports the same device id. removed is only called once the reader did not come back */
+  typedef std::function<void(AutoDeviceManagerEvent event, std::shared_ptr<AutoDevice> device)>
+    AutoDeviceManagerCallback;
+
+  /* Serves every JetBeep device connected to the host: one DeviceDetection, one AutoDevice per detected device.
+   * All devices share the manager's IOContext */
+  class AutoDeviceManager {
+  public:
+    AutoDeviceManager(IOContext context = IOContext::context);
+    virtual ~AutoDeviceManager();
+
+    void start();
+    void stop();
+
+    std::vector<std::shared_ptr<AutoDevice>> devices();
+    // throws Errors::DeviceNotFound if there is no initialized device with such id
+    std::shared_ptr<AutoDevice> device(unsigned long deviceId);
+
+    AutoDeviceManagerCallback callback;
+
+  private:
+    class Impl;
+    std::unique_ptr<Impl> m_impl;
+  };
+} // namespace JetBeep
+
+#endif
@@ -2,6 +2,7 @@
 #define JETBEEP_DEVICE_ERRORS
 
 #include <exception>
+#include <string>
 
 namespace JetBeep {
   namespace Errors {
@@ -96,6 +97,13 @@ namespace JetBeep {
         return "Null pointer encounter";
       }
     };
+
+    class DeviceNotFound : public std::exception {
+    public:
+      virtual char const* what() const noexcept {
+        return "Device not found";
+      }
+    };
   } // namespace Errors
 } // namespace JetBeep
 
@@ -0,0 +1,182 @@
+#include "device_metrics.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace JetBeep;
+using namespace std;
+
+LatencyHistogram::LatencyHistogram() : m_count(0), m_sum(0), m_min(UINT64_MAX), m_max(0) {
+  m_buckets.fill(0);
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t value) {
+  if (value < subBucketsCount) {
+    return static_cast<size_t>(value);
+  }
+
+  unsigned int exponent = 0;
+#if defined(__GNUC__) || defined(__clang__)
+  exponent = 63 - __builtin_clzll(value);
+#else
+  for (auto rest = value >> 1; rest != 0; rest >>= 1) {
+    exponent++;
+  }
+#endif
+  auto subBucket = (value >> (exponent - subBucketBits)) & (subBucketsCount - 1);
+
+  return subBucketsCount + (exponent - subBucketBits) * subBucketsCount + static_cast<size_t>(subBucket);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) {
+  if (index < subBucketsCount) {
+    return index;
+  }
+
+  auto shift = (index - subBucketsCount) / subBucketsCount;
+  auto subBucket = (index - subBucketsCount) % subBucketsCount;
+
+  return ((subBucketsCount + subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(chrono::microseconds latency) {
+  // longer latencies land in the last bucket
+  auto value = static_cast<uint64_t>(std::min<int64_t>(std::max<int64_t>(latency.count(), 0), UINT32_MAX));
+
+  m_buckets[bucketIndex(value)]++;
+  m_count++;
+  m_sum += value;
+  m_min = std::min(m_min, value);
+  m_max = std::max(m_max, value);
+}
+
+uint64_t LatencyHistogram::count() const {
+  return m_count;
+}
+
+chrono::microseconds LatencyHistogram::min() const {
+  return chrono::microseconds(m_count == 0 ? 0 : m_min);
+}
+
+chrono::microseconds LatencyHistogram::max() const {
+  return chrono::microseconds(m_max);
+}
+
+chrono::microseconds LatencyHistogram::mean() const {
+  return chrono::microseconds(m_count == 0 ? 0 : m_sum / m_count);
+}
+
+chrono::microseconds LatencyHistogram::percentile(double percentile) const {
+  if (m_count == 0) {
+    return chrono::microseconds(0);
+  }
+
+  auto rank = static_cast<uint64_t>(percentile / 100 * m_count + 0.5);
+  uint64_t seen = 0;
+
+  rank = std::max<uint64_t>(rank, 1);
+  for (size_t i = 0; i < bucketsCount; i++) {
+    seen += m_buckets[i];
+    if (seen >= rank) {
+      return chrono::microseconds(std::min(bucketUpperBound(i), m_max));
+    }
+  }
+  return chrono::microseconds(m_max);
+}
+
+string SerialDeviceMetrics::toString() const {
+  ostringstream stream;
+
+  stream << "jetbeep_serial_duration_ms " << duration.count() << "\n";
+  stream << "jetbeep_serial_bytes_received_total " << bytesReceived << "\n";
+  stream << "jetbeep_serial_bytes_sent_total " << bytesSent << "\n";
+  stream << "jetbeep_serial_protocol_errors_total " << protocolErrors << "\n";
+
+  for (auto& command : commands) {
+    auto label = "{command=\"" + command.first + "\"";
+    auto& metrics = command.second;
+
+    stream << "jetbeep_serial_commands_total" << label << "} " << metrics.count << "\n";
+    stream << "jetbeep_serial_command_errors_total" << label << "} " << metrics.errors << "\n";
+    stream << "jetbeep_serial_command_timeouts_total" << label << "} " << metrics.timeouts << "\n";
+    for (auto quantile : {"0.5", "0.9", "0.99"}) {
+      stream << "jetbeep_serial_command_latency_us" << label << ",quantile=\"" << quantile << "\"} "
+             << metrics.latency.percentile(stod(quantile) * 100).count() << "\n";
+    }
+    stream << "jetbeep_serial_command_latency_us" << label << ",quantile=\"1\"} " << metrics.latency.max().count()
+           << "\n";
+  }
+
+  for (auto& event : events) {
+    stream << "jetbeep_serial_events_total{event=\"" << event.first << "\"} " << event.second << "\n";
+  }
+  return stream.str();
+}
+
+SerialMetricsRecorder::SerialMetricsRecorder() {
+  reset();
+}
+
+void SerialMetricsRecorder::reset() {
+  m_since = chrono::steady_clock::now();
+  m_commands.fill(CommandCounters());
+  m_events.fill(0);
+  m_bytesReceived = 0;
+  m_bytesSent = 0;
+  m_protocolErrors = 0;
+}
+
+void SerialMetricsRecorder::commandAnswered(DeviceResponses::ResponseId id, chrono::steady_clock::duration latency) {
+  m_commands[static_cast<size_t>(id)].latency.record(chrono::duration_cast<chrono::microseconds>(latency));
+}
+
+void SerialMetricsRecorder::commandFailed(DeviceResponses::ResponseId id) {
+  m_commands[static_cast<size_t>(id)].errors++;
+}
+
+void SerialMetricsRecorder::commandTimedOut(DeviceResponses::ResponseId id) {
+  m_commands[static_cast<size_t>(id)].timeouts++;
+}
+
+void SerialMetricsRecorder::eventReceived(DeviceResponses::ResponseId id) {
+  m_events[static_cast<size_t>(id)]++;
+}
+
+void SerialMetricsRecorder::protocolError() {
+  m_protocolErrors++;
+}
+
+void SerialMetricsRecorder::bytesReceived(size_t count) {
+  m_bytesReceived += count;
+}
+
+void SerialMetricsRecorder::bytesSent(size_t count) {
+  m_bytesSent += count;
+}
+
+SerialDeviceMetrics SerialMetricsRecorder::snapshot() const {
+  SerialDeviceMetrics metrics;
+
+  metrics.duration = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - m_since);
+  metrics.bytesReceived = m_bytesReceived;
+  metrics.bytesSent = m_bytesSent;
+  metrics.protocolErrors = m_protocolErrors;
+
+  for (size_t i = 1; i < idsCount; i++) {
+    auto name = string(DeviceResponses::name(static_cast<DeviceResponses::ResponseId>(i)));
+    auto& counters = m_commands[i];
+
+    if (counters.latency.count() != 0 || counters.timeouts != 0) {
+      auto& command = metrics.commands[name];
+
+      command.count = counters.latency.count();
+      command.errors = counters.errors;
+      command.timeouts = counters.timeouts;
+      command.latency = counters.latency;
+    }
+    if (m_events[i] != 0) {
+      metrics.events[name] = m_events[i];
+    }
+  }
+  return metrics;
+}
@@ -0,0 +1,104 @@
+#ifndef JETBEEP_DEVICE_METRICS__H
+#define JETBEEP_DEVICE_METRICS__H
+
+#include "device_responses.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace JetBeep {
+  // latency distribution in log-linear buckets: 8 buckets per power of two, so a percentile is reported within 12.5%
+  // of the recorded value from 1us up to an hour, at a fixed 1 KiB per histogram and no allocations when recording
+  class LatencyHistogram {
+  public:
+    LatencyHistogram();
+
+    void record(std::chrono::microseconds latency);
+
+    uint64_t count() const;
+    std::chrono::microseconds min() const;
+    std::chrono::microseconds max() const;
+    std::chrono::microseconds mean() const;
+    // the upper bound of the bucket holding the percentile (0 - 100)
+    std::chrono::microseconds percentile(double percentile) const;
+
+  private:
+    static constexpr unsigned int subBucketBits = 3;
+    static constexpr unsigned int subBucketsCount = 1 << subBucketBits;
+    static constexpr size_t bucketsCount = subBucketsCount + (32 - subBucketBits) * subBucketsCount;
+
+    static size_t bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(size_t index);
+
+    std::array<uint32_t, bucketsCount> m_buckets;
+    uint64_t m_count;
+    uint64_t m_sum;
+    uint64_t m_min;
+    uint64_t m_max;
+  };
+
+  typedef struct SerialCommandMetrics {
+    // commands which got a response, including error responses
+    uint64_t count = 0;
+    // responses with the error result
+    uint64_t errors = 0;
+    uint64_t timeouts = 0;
+    // from writing the command to its response
+    LatencyHistogram latency;
+  } SerialCommandMetrics;
+
+  typedef struct SerialDeviceMetrics {
+    // since the device was created or its metrics were reset, event rates are the counts over the duration
+    std::chrono::milliseconds duration = std::chrono::milliseconds(0);
+    uint64_t bytesReceived = 0;
+    uint64_t bytesSent = 0;
+    // unparsable or unexpected lines
+    uint64_t protocolErrors = 0;
+    // by command name, only commands which were executed at least once
+    std::map<std::string, SerialCommandMetrics> commands;
+    // by event name, e.g. BARCODES or NFC_DETECTED
+    std::map<std::string, uint64_t> events;
+
+    // Prometheus text format, one metric per line
+    std::string toString() const;
+  } SerialDeviceMetrics;
+
+  // the counters behind SerialDevice::metrics(), updated under the lock of the device. Indexed by response id, so
+  // recording is a few increments without lookups
+  class SerialMetricsRecorder {
+  public:
+    SerialMetricsRecorder();
+
+    void commandAnswered(DeviceResponses::ResponseId id, std::chrono::steady_clock::duration latency);
+    void commandFailed(DeviceResponses::ResponseId id);
+    void commandTimedOut(DeviceResponses::ResponseId id);
+    void eventReceived(DeviceResponses::ResponseId id);
+    void protocolError();
+    void bytesReceived(size_t count);
+    void bytesSent(size_t count);
+
+    SerialDeviceMetrics snapshot() const;
+    void reset();
+
+  private:
+    typedef struct CommandCounters {
+      uint64_t errors = 0;
+      uint64_t timeouts = 0;
+      LatencyHistogram latency;
+    } CommandCounters;
+
+    static constexpr size_t idsCount = DeviceResponses::entriesCount + 1;
+
+    std::chrono::steady_clock::time_point m_since;
+    std::array<CommandCounters, idsCount> m_commands;
+    std::array<uint64_t, idsCount> m_events;
+    uint64_t m_bytesReceived;
+    uint64_t m_bytesSent;
+    uint64_t m_protocolErrors;
+  };
+} // namespace JetBeep
+
+#endif
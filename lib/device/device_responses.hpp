@@ -0,0 +1,242 @@
+#ifndef JETBEEP_DEVICE_RESPONSES__H
+#define JETBEEP_DEVICE_RESPONSES__H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace DeviceResponses {
+  // the tokens as they are sent and received, the table below is built from them at compile time
+  namespace Tokens {
+    // responses
+    constexpr std::string_view openSession = "OPEN_SESSION";
+    constexpr std::string_view closeSession = "CLOSE_SESSION";
+    constexpr std::string_view requestBarcodes = "REQUEST_BARCODES";
+    constexpr std::string_view cancelBarcodes = "CANCEL_BARCODES";
+    constexpr std::string_view createPayment = "CREATE_PAYMENT";
+    constexpr std::string_view cancelPayment = "CANCEL_PAYMENT";
+    constexpr std::string_view confirmPayment = "CONFIRM_PAYMENT";
+    constexpr std::string_view createPaymentToken = "CREATE_PAYMENT_TOKEN";
+    constexpr std::string_view resetState = "RESET_STATE";
+    constexpr std::string_view get = "GET";
+    constexpr std::string_view set = "SET";
+    constexpr std::string_view beginPrivate = "BEGIN_PRIVATE";
+    constexpr std::string_view commit = "COMMIT";
+    constexpr std::string_view getState = "GETSTATE";
+
+    /* NFC api */
+    constexpr std::string_view nfcSecureReadMFC = "NFC_SECURE_READ_MFC";
+    constexpr std::string_view nfcReadMFC = "NFC_READ_MFC";
+    constexpr std::string_view nfcSecureWriteMFC = "NFC_SECURE_WRITE_MFC";
+    constexpr std::string_view nfcWriteMFC = "NFC_WRITE_MFC";
+
+    // events
+    constexpr std::string_view mobileConnected = "MOBILE_CONNECTED";
+    constexpr std::string_view mobileDisconnected = "MOBILE_DISCONNECTED";
+    constexpr std::string_view barcodes = "BARCODES";
+    constexpr std::string_view paymentSuccessful = "PAYMENT_SUCCESSFUL";
+    constexpr std::string_view paymentError = "PAYMENT_ERROR";
+    constexpr std::string_view paymentToken = "PAYMENT_TOKEN";
+    constexpr std::string_view nfcDetected = "NFC_DETECTED";
+    constexpr std::string_view nfcRemoved = "NFC_REMOVED";
+    constexpr std::string_view nfcDetectionError = "NFC_DETECTION_ERROR";
+
+    // system events
+    constexpr std::string_view systemReset = "SYSTEM_RESET";
+  } // namespace Tokens
+
+  // responses
+  const std::string openSession(Tokens::openSession);
+  const std::string closeSession(Tokens::closeSession);
+  const std::string requestBarcodes(Tokens::requestBarcodes);
+  const std::string cancelBarcodes(Tokens::cancelBarcodes);
+  const std::string createPayment(Tokens::createPayment);
+  const std::string cancelPayment(Tokens::cancelPayment);
+  const std::string confirmPayment(Tokens::confirmPayment);
+  const std::string createPaymentToken(Tokens::createPaymentToken);
+  const std::string resetState(Tokens::resetState);
+  const std::string get(Tokens::get);
+  const std::string set(Tokens::set);
+  const std::string beginPrivate(Tokens::beginPrivate);
+  const std::string commit(Tokens::commit);
+  const std::string getState(Tokens::getState);
+
+  /* NFC api */
+  const std::string nfcSecureReadMFC(Tokens::nfcSecureReadMFC);
+  const std::string nfcReadMFC(Tokens::nfcReadMFC);
+  const std::string nfcSecureWriteMFC(Tokens::nfcSecureWriteMFC);
+  const std::string nfcWriteMFC(Tokens::nfcWriteMFC);
+
+  // events
+  const std::string mobileConnected(Tokens::mobileConnected);
+  const std::string mobileDisconnected(Tokens::mobileDisconnected);
+  const std::string barcodes(Tokens::barcodes);
+  const std::string paymentSuccessful(Tokens::paymentSuccessful);
+  const std::string paymentError(Tokens::paymentError);
+  const std::string paymentToken(Tokens::paymentToken);
+  const std::string nfcDetected(Tokens::nfcDetected);
+  const std::string nfcRemoved(Tokens::nfcRemoved);
+  const std::string nfcDetectionError(Tokens::nfcDetectionError);
+
+  // system events
+  const std::string systemReset(Tokens::systemReset);
+
+  // the order must match the entries table below
+  enum class ResponseId : uint8_t {
+    unknown = 0,
+    openSession,
+    closeSession,
+    requestBarcodes,
+    cancelBarcodes,
+    createPayment,
+    cancelPayment,
+    confirmPayment,
+    createPaymentToken,
+    resetState,
+    get,
+    set,
+    beginPrivate,
+    commit,
+    getState,
+    nfcSecureReadMFC,
+    nfcReadMFC,
+    nfcSecureWriteMFC,
+    nfcWriteMFC,
+    mobileConnected,
+    mobileDisconnected,
+    barcodes,
+    paymentSuccessful,
+    paymentError,
+    paymentToken,
+    nfcDetected,
+    nfcRemoved,
+    nfcDetectionError,
+    systemReset
+  };
+
+  typedef struct ResponseEntry {
+    std::string_view name;
+    ResponseId id;
+  } ResponseEntry;
+
+  inline constexpr ResponseEntry entries[] = {{Tokens::openSession, ResponseId::openSession},
+                                              {Tokens::closeSession, ResponseId::closeSession},
+                                              {Tokens::requestBarcodes, ResponseId::requestBarcodes},
+                                              {Tokens::cancelBarcodes, ResponseId::cancelBarcodes},
+                                              {Tokens::createPayment, ResponseId::createPayment},
+                                              {Tokens::cancelPayment, ResponseId::cancelPayment},
+                                              {Tokens::confirmPayment, ResponseId::confirmPayment},
+                                              {Tokens::createPaymentToken, ResponseId::createPaymentToken},
+                                              {Tokens::resetState, ResponseId::resetState},
+                                              {Tokens::get, ResponseId::get},
+                                              {Tokens::set, ResponseId::set},
+                                              {Tokens::beginPrivate, ResponseId::beginPrivate},
+                                              {Tokens::commit, ResponseId::commit},
+                                              {Tokens::getState, ResponseId::getState},
+                                              {Tokens::nfcSecureReadMFC, ResponseId::nfcSecureReadMFC},
+                                              {Tokens::nfcReadMFC, ResponseId::nfcReadMFC},
+                                              {Tokens::nfcSecureWriteMFC, ResponseId::nfcSecureWriteMFC},
+                                              {Tokens::nfcWriteMFC, ResponseId::nfcWriteMFC},
+                                              {Tokens::mobileConnected, ResponseId::mobileConnected},
+                                              {Tokens::mobileDisconnected, ResponseId::mobileDisconnected},
+                                              {Tokens::barcodes, ResponseId::barcodes},
+                                              {Tokens::paymentSuccessful, ResponseId::paymentSuccessful},
+                                              {Tokens::paymentError, ResponseId::paymentError},
+                                              {Tokens::paymentToken, ResponseId::paymentToken},
+                                              {Tokens::nfcDetected, ResponseId::nfcDetected},
+                                              {Tokens::nfcRemoved, ResponseId::nfcRemoved},
+                                              {Tokens::nfcDetectionError, ResponseId::nfcDetectionError},
+                                              {Tokens::systemReset, ResponseId::systemReset}};
+
+  constexpr size_t entriesCount = sizeof(entries) / sizeof(entries[0]);
+
+  namespace Detail {
+    // table is ~4x larger than the number of entries, so a collision free seed is found after a few dozen attempts
+    // and the search stays well inside compilers' constexpr evaluation limits
+    constexpr size_t tableSize = 128;
+    static_assert((tableSize & (tableSize - 1)) == 0, "table size must be a power of 2");
+    static_assert(tableSize >= entriesCount * 2, "table is too small for the entries");
+
+    // multiplicative hash over the token length and a few sampled characters rather than the whole token: tokens are
+    // long and share prefixes, but these positions already tell all of them apart. The products are independent, so
+    // the hash costs about one multiplication latency
+    constexpr uint32_t hash(std::string_view str, uint32_t seed) {
+      uint32_t size = static_cast<uint32_t>(str.size());
+
+      if (size == 0) {
+        return seed;
+      }
+
+      uint32_t value = seed * 0x9E3779B1u + size * 0x85EBCA77u + static_cast<uint8_t>(str[0]) * 0xC2B2AE3Du +
+                       static_cast<uint8_t>(str[size > 1 ? 1 : 0]) * 0x27D4EB2Fu +
+                       static_cast<uint8_t>(str[size / 2]) * 0x165667B1u +
+                       static_cast<uint8_t>(str[size - 1]) * 0xD3A2646Du;
+      return value ^ (value >> 16);
+    }
+
+    constexpr bool isPerfectSeed(uint32_t seed) {
+      bool used[tableSize] = {};
+
+      for (const auto& entry : entries) {
+        auto index = hash(entry.name, seed) & (tableSize - 1);
+
+        if (used[index]) {
+          return false;
+        }
+        used[index] = true;
+      }
+      return true;
+    }
+
+    constexpr uint32_t findSeed() {
+      for (uint32_t seed = 0; seed < 10000; seed++) {
+        if (isPerfectSeed(seed)) {
+          return seed;
+        }
+      }
+      return UINT32_MAX;
+    }
+
+    constexpr uint32_t seed = findSeed();
+    static_assert(seed != UINT32_MAX, "unable to find perfect hash seed for device responses");
+
+    constexpr std::array<ResponseEntry, tableSize> makeTable() {
+      std::array<ResponseEntry, tableSize> table = {};
+
+      for (const auto& entry : entries) {
+        table[hash(entry.name, seed) & (tableSize - 1)] = entry;
+      }
+      return table;
+    }
+
+    inline constexpr std::array<ResponseEntry, tableSize> table = makeTable();
+  } // namespace Detail
+
+  // maps a command/event token received from the device to its id with a single hash and compare
+  constexpr ResponseId lookup(std::string_view token) {
+    const auto& entry = Detail::table[Detail::hash(token, Detail::seed) & (Detail::tableSize - 1)];
+
+    return entry.name == token ? entry.id : ResponseId::unknown;
+  }
+
+  constexpr std::string_view name(ResponseId id) {
+    return id == ResponseId::unknown ? std::string_view() : entries[static_cast<size_t>(id) - 1].name;
+  }
+
+  namespace Detail {
+    constexpr bool isValidTable() {
+      for (size_t i = 0; i < entriesCount; i++) {
+        if (static_cast<size_t>(entries[i].id) != i + 1 || lookup(entries[i].name) != entries[i].id) {
+          return false;
+        }
+      }
+      return true;
+    }
+  } // namespace Detail
+
+  static_assert(Detail::isValidTable(), "entries order must match ResponseId");
+} // namespace DeviceResponses
+
+#endif
@@ -1,5 +1,7 @@
 #include "device_utils.hpp"
 #include <stdexcept>
+#include <charconv>
+#include "../utils/enum_table.hpp"
 #include "../utils/utils.hpp"
 #include <string>
 #include <sstream>
@@ -8,158 +10,126 @@
 using namespace JetBeep;
 using namespace std;
 
-std::string DeviceUtils::parameterToString(const DeviceParameter& parameter) {
-  switch (parameter) {
-  case DeviceParameter::version:
-    return "version";
-  case DeviceParameter::shopId:
-    return "shopId";
-  case DeviceParameter::deviceId:
-    return "deviceId";
-  case DeviceParameter::mode:
-    return "mode";
-  case DeviceParameter::pubKey:
-    return "pubKey";
-  case DeviceParameter::chipId:
-    return "chipId";
-  case DeviceParameter::revision:
-    return "revision";
-  case DeviceParameter::paymentPubKey:
-    return "paymentPubKey";
-  case DeviceParameter::shopKey:
-    return "shopKey";
-  case DeviceParameter::cashierId:
-    return "cashierId";
-  case DeviceParameter::txPower:
-    return "txPower";
-  case DeviceParameter::tapSensitivity:
-    return "tapSensitivity";
-  case DeviceParameter::phoneConFeedback:
-    return "phoneConFeedback";
-  case DeviceParameter::proximitySensitivity:
-    return "proximitySensitivity";
-  case DeviceParameter::mobileAppsUUIDs:
-    return "mobileAppsUUIDs";
-  case DeviceParameter::mac:
-    return "mac";
-  case DeviceParameter::devEnv:
-    return "devEnv";
-  case DeviceParameter::connectionRole:
-    return "connectionRole";
-  case DeviceParameter::logLevel:
-    return "logLevel";
-  case DeviceParameter::merchantId:
-    return "merchantId";
-  case DeviceParameter::domainShopId:
-    return "domainShopId";
-  case DeviceParameter::virtKeyboard:
-    return "virtKeyboard";
-  case DeviceParameter::nfc:
-    return "nfc";
-  case DeviceParameter::bluetooth:
-    return "bluetooth";
-  default:
+namespace {
+  constexpr auto parameterNames = makeEnumTable<DeviceParameter>({
+    {DeviceParameter::version, "version"},
+    {DeviceParameter::shopId, "shopId"},
+    {DeviceParameter::deviceId, "deviceId"},
+    {DeviceParameter::mode, "mode"},
+    {DeviceParameter::pubKey, "pubKey"},
+    {DeviceParameter::chipId, "chipId"},
+    {DeviceParameter::revision, "revision"},
+    {DeviceParameter::paymentPubKey, "paymentPubKey"},
+    {DeviceParameter::shopKey, "shopKey"},
+    {DeviceParameter::cashierId, "cashierId"},
+    {DeviceParameter::txPower, "txPower"},
+    {DeviceParameter::tapSensitivity, "tapSensitivity"},
+    {DeviceParameter::phoneConFeedback, "phoneConFeedback"},
+    {DeviceParameter::proximitySensitivity, "proximitySensitivity"},
+    {DeviceParameter::mobileAppsUUIDs, "mobileAppsUUIDs"},
+    {DeviceParameter::mac, "mac"},
+    {DeviceParameter::devEnv, "devEnv"},
+    {DeviceParameter::connectionRole, "connectionRole"},
+    {DeviceParameter::logLevel, "logLevel"},
+    {DeviceParameter::merchantId, "merchantId"},
+    {DeviceParameter::domainShopId, "domainShopId"},
+    {DeviceParameter::virtKeyboard, "virtKeyboard"},
+    {DeviceParameter::nfc, "nfc"},
+    {DeviceParameter::bluetooth, "bluetooth"}
+  });
+
+  constexpr auto operationModeNames = makeEnumTable<DeviceOperationMode>(
+    {{DeviceOperationMode::scanner, "scanner"}, {DeviceOperationMode::driver, "driver"}});
+
+  constexpr auto connectionRoleNames = makeEnumTable<DeviceConnectionRole>(
+    {{DeviceConnectionRole::master, "master"}, {DeviceConnectionRole::slave, "slave"}});
+
+  constexpr auto paymentErrorNames = makeEnumTable<PaymentError>({
+    {PaymentError::network, "NETWORK"},
+    {PaymentError::timeout, "TIMEOUT"},
+    {PaymentError::server, "SERVER"},
+    {PaymentError::security, "SECURITY"},
+    {PaymentError::withdrawal, "WITHDRAWAL"},
+    {PaymentError::discarded, "DISCARDED"},
+    {PaymentError::unknown, "UNKNOWN"},
+    {PaymentError::invalidPin, "INVALID_PIN"}
+  });
+
+  constexpr auto nfcDetectionErrorReasonNames =
+    makeEnumTable<NFC::DetectionErrorReason>({{NFC::DetectionErrorReason::UNKNOWN, "unknown"},
+                                              {NFC::DetectionErrorReason::MULTIPLE_CARDS, "multiple_cards"},
+                                              {NFC::DetectionErrorReason::UNSUPPORTED, "unsupported_type"}});
+
+  static_assert(parameterNames.size() == static_cast<size_t>(DeviceParameter::bluetooth) + 1,
+                "every DeviceParameter must have a name");
+  static_assert(parameterNames.fromString("txPower") == DeviceParameter::txPower, "invalid parameter names table");
+} // namespace
+
+std::string_view DeviceUtils::parameterToString(const DeviceParameter& parameter) {
+  auto name = parameterNames.toString(parameter);
+
+  if (name.empty()) {
     throw runtime_error("invalid device parameter");
-    break;
   }
+  return name;
 }
 
-DeviceParameter DeviceUtils::stringToParameter(const std::string& parameter) {
-  if (parameter == "version") {
-    return DeviceParameter::version;
-  } else if (parameter == "shopId") {
-    return DeviceParameter::shopId;
-  } else if (parameter == "deviceId") {
-    return DeviceParameter::deviceId;
-  } else if (parameter == "mode") {
-    return DeviceParameter::mode;
-  } else if (parameter == "pubKey") {
-    return DeviceParameter::pubKey;
-  } else if (parameter == "chipId") {
-    return DeviceParameter::chipId;
-  } else if (parameter == "revision") {
-    return DeviceParameter::revision;
-  } else if (parameter == "paymentPubKey") {
-    return DeviceParameter::paymentPubKey;
-  } else if (parameter == "shopKey") {
-    return DeviceParameter::shopKey;
-  } else if (parameter == "cashierId") {
-    return DeviceParameter::cashierId;
-  } else if (parameter == "txPower") {
-    return DeviceParameter::txPower;
-  } else if (parameter == "tapSensitivity") {
-    return DeviceParameter::tapSensitivity;
-  } else if (parameter == "phoneConFeedback") {
-    return DeviceParameter::phoneConFeedback;
-  } else if (parameter == "proximitySensitivity") {
-    return DeviceParameter::proximitySensitivity;
-  } else if (parameter == "mobileAppsUUIDs") {
-    return DeviceParameter::mobileAppsUUIDs;
-  } else if (parameter == "mac") {
-    return DeviceParameter::mac;
-  } else if (parameter == "devEnv") {
-    return DeviceParameter::devEnv;
-  } else if (parameter == "connectionRole") {
-    return DeviceParameter::connectionRole;
-  } else if (parameter == "logLevel") {
-    return DeviceParameter::logLevel;
-  } else if (parameter == "merchantId") {
-    return DeviceParameter::merchantId;
-  } else if (parameter == "domainShopId") {
-    return DeviceParameter::domainShopId;
-  } else if (parameter == "virtKeyboard") {
-    return DeviceParameter::virtKeyboard;
-  } else if (parameter == "bluetooth") {
-    return DeviceParameter::bluetooth;
-  } else if (parameter == "nfc") {
-    return DeviceParameter::nfc;
-  } else {
+DeviceParameter DeviceUtils::stringToParameter(std::string_view parameter) {
+  auto value = parameterNames.fromString(parameter);
+
+  if (!value) {
     throw runtime_error("invalid input string");
   }
+  return *value;
 }
 
-std::string DeviceUtils::operationModeToString(const DeviceOperationMode& value) {
-  switch (value) {
-  case DeviceOperationMode::driver:
-    return "driver";
-  case DeviceOperationMode::scanner:
-    return "scanner";
-  default:
+std::string_view DeviceUtils::operationModeToString(const DeviceOperationMode& value) {
+  auto name = operationModeNames.toString(value);
+
+  if (name.empty()) {
     throw runtime_error("invalid DeviceOperationMode");
-    break;
   }
+  return name;
 }
 
-DeviceOperationMode DeviceUtils::stringToOperationMode(const std::string& value) {
-  if (value == "driver") {
-    return DeviceOperationMode::driver;
-  } else if (value == "scanner") {
-    return DeviceOperationMode::scanner;
-  } else {
+DeviceOperationMode DeviceUtils::stringToOperationMode(std::string_view value) {
+  auto mode = operationModeNames.fromString(value);
+
+  if (!mode) {
     throw runtime_error("invalid input string");
   }
+  return *mode;
 }
 
-std::string DeviceUtils::connectionRoleToString(const DeviceConnectionRole& value) {
-  switch (value) {
-  case DeviceConnectionRole::master:
-    return "master";
-  case DeviceConnectionRole::slave:
-    return "slave";
-  default:
+std::string_view DeviceUtils::connectionRoleToString(const DeviceConnectionRole& value) {
+  auto name = connectionRoleNames.toString(value);
+
+  if (name.empty()) {
     throw runtime_error("invalid DeviceConnectionRole");
-    break;
   }
+  return name;
 }
 
-DeviceConnectionRole DeviceUtils::stringToConnectionRole(const std::string& value) {
-  if (value == "master") {
-    return DeviceConnectionRole::master;
-  } else if (value == "slave") {
-    return DeviceConnectionRole::slave;
-  } else {
+DeviceConnectionRole DeviceUtils::stringToConnectionRole(std::string_view value) {
+  auto role = connectionRoleNames.fromString(value);
+
+  if (!role) {
     throw runtime_error("invalid input string");
   }
+  return *role;
+}
+
+PaymentError DeviceUtils::stringToPaymentError(std::string_view value) {
+  auto error = paymentErrorNames.fromString(value);
+
+  if (!error) {
+    throw runtime_error("invalid payment error string");
+  }
+  return *error;
+}
+
+NFC::DetectionErrorReason DeviceUtils::stringToNFCDetectionErrorReason(std::string_view value) {
+  return nfcDetectionErrorReasonNames.fromString(value).value_or(NFC::DetectionErrorReason::UNKNOWN);
 }
 
 std::string DeviceUtils::mobileAppsUUIDsToString(std::vector<uint32_t> list) {
@@ -178,24 +148,23 @@ std::string DeviceUtils::mobileAppsUUIDsToString(std::vector<uint32_t> list) {
 };
 
 
-NFC::DetectionEventData DeviceUtils::parseNFCDetectionEventData(const vector<string>& params) {
+NFC::DetectionEventData DeviceUtils::parseNFCDetectionEventData(const StringTokensRange& params) {
   if (params.size() != 2) {
     throw runtime_error("invalid NFC detection params count");
   }
   NFC::DetectionEventData eventData;
-  int typeId = std::stoi(params[0]);
-  switch (typeId) {
-    case 1: eventData.cardType = NFC::CardType::EMV_CARD; break;
-    case 2: eventData.cardType = NFC::CardType::MIFARE_CLASSIC_1K; break;
-    case 3: eventData.cardType = NFC::CardType::MIFARE_CLASSIC_4K; break;
-    case 4: eventData.cardType = NFC::CardType::MIFARE_PLUS_2K; break;
-    case 5: eventData.cardType = NFC::CardType::MIFARE_PLUS_4K; break;
-    case 6: eventData.cardType = NFC::CardType::MIFARE_DESFIRE_2K; break;
-    case 7: eventData.cardType = NFC::CardType::MIFARE_DESFIRE_4K; break;
-    case 8: eventData.cardType = NFC::CardType::MIFARE_DESFIRE_8K; break;
-    default: 
-      eventData.cardType = NFC::CardType::UNKNOWN;
+  int typeId = 0;
+  auto typeIdEnd = params[0].data() + params[0].size();
+  if (from_chars(params[0].data(), typeIdEnd, typeId).ec != errc()) {
+    throw invalid_argument("invalid NFC card type: " + string(params[0]));
+  }
+  // device sends the numeric value of CardType
+  if (typeId >= static_cast<int>(NFC::CardType::EMV_CARD) &&
+      typeId <= static_cast<int>(NFC::CardType::MIFARE_DESFIRE_8K)) {
+    eventData.cardType = static_cast<NFC::CardType>(typeId);
+  } else {
+    eventData.cardType = NFC::CardType::UNKNOWN;
   }
-  eventData.meta = params[1];
+  eventData.meta = string(params[1]);
   return eventData;
 }
\ No newline at end of file
@@ -8,14 +8,22 @@ using namespace std;
 
 // Device
 
-SerialDevice::SerialDevice(IOContext context) {
+SerialDevice::SerialDevice(IOContext context) : SerialDevice(context, nullptr) {
+}
+
+SerialDevice::SerialDevice(IOContext context, std::shared_ptr<IOStrand> strand) {
   SerialDeviceCallbacks callbacks = {&errorCallback,          &barcodesCallback,     &paymentErrorCallback,
                                      &paymentSuccessCallback, &paymentTokenCallback, &mobileCallback, &nfcEventCallback, &nfcDetectionErrorCallback};
 
-  m_impl.reset(new Impl(callbacks, context));
+  m_impl.reset(new Impl(callbacks, context, strand));
 }
 
 SerialDevice::~SerialDevice() {
+  // aborts the pending handlers, they release the implementation once executed
+  try {
+    m_impl->close();
+  } catch (...) {
+  }
 }
 
 void SerialDevice::open(const string& path) {
@@ -25,6 +33,22 @@ void SerialDevice::close() {
   m_impl->close();
 }
 
+void SerialDevice::setPipelined(bool pipelined) {
+  m_impl->setPipelined(pipelined);
+}
+
+bool SerialDevice::isPipelined() {
+  return m_impl->isPipelined();
+}
+
+SerialDeviceMetrics SerialDevice::metrics() {
+  return m_impl->metrics();
+}
+
+void SerialDevice::resetMetrics() {
+  m_impl->resetMetrics();
+}
+
 Promise<void> SerialDevice::openSession() {
   return m_impl->execute(DeviceResponses::openSession);
 }
@@ -107,7 +131,12 @@ Promise<string> SerialDevice::get(const DeviceParameter& parameter) {
   return m_impl->executeString(DeviceResponses::get, DeviceUtils::parameterToString(parameter));
 }
 Promise<void> SerialDevice::set(const DeviceParameter& parameter, const std::string& value) {
-  return m_impl->execute(DeviceResponses::set, DeviceUtils::parameterToString(parameter) + " " + value);
+  auto name = DeviceUtils::parameterToString(parameter);
+  string params;
+
+  params.reserve(name.size() + 1 + value.size());
+  params.append(name).append(" ").append(value);
+  return m_impl->execute(DeviceResponses::set, params);
 }
 Promise<void> SerialDevice::commit(const string& signature) {
   return m_impl->execute(DeviceResponses::commit, signature);
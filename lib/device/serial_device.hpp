@@ -5,6 +5,8 @@
 
 #include "../io/iocontext.hpp"
 #include "../utils/promise.hpp"
+#include "../utils/promise_coroutine.hpp"
+#include "device_metrics.hpp"
 #include "device_parameter.hpp"
 #include "device_types.hpp"
 
@@ -22,6 +24,15 @@ namespace JetBeep {
     void open(const std::string& path);
     void close();
 
+    // when enabled, a command can be executed while previous ones are still waiting for their responses instead of
+    // throwing Errors::OperationInProgress. Responses are matched to the commands in the order they were written
+    void setPipelined(bool pipelined);
+    bool isPipelined();
+
+    // counters and per-command latencies since the device was created or resetMetrics() was called
+    SerialDeviceMetrics metrics();
+    void resetMetrics();
+
     Promise<void> openSession();
     Promise<void> closeSession();
     Promise<void> requestBarcodes();
@@ -65,7 +76,12 @@ namespace JetBeep {
     SerialNFCDetectionErrorCallback nfcDetectionErrorCallback; 
   private:
     class Impl;
-    std::unique_ptr<Impl> m_impl;
+    std::shared_ptr<Impl> m_impl;
+
+    // serial device which dispatches its handlers through the strand of the owning AutoDevice
+    SerialDevice(IOContext context, std::shared_ptr<IOStrand> strand);
+
+    friend class AutoDevice;
   };
 } // namespace JetBeep
 
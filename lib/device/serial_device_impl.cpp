@@ -3,23 +3,27 @@
 #include "../io/iocontext_impl.hpp"
 #include "../utils/utils.hpp"
 #include "device_utils.hpp"
+#include <charconv>
 
 using namespace std;
 using namespace JetBeep;
 using namespace boost;
 using namespace boost::asio;
+using DeviceResponses::ResponseId;
 
-SerialDevice::Impl::Impl(const SerialDeviceCallbacks& callbacks, IOContext context)
+SerialDevice::Impl::Impl(const SerialDeviceCallbacks& callbacks, IOContext context, std::shared_ptr<IOStrand> strand)
   : m_context(context),
     m_port(context.m_impl->ioService),
     m_callbacks(callbacks),
     m_log("serial_device"),
-    m_state(SerialDeviceState::idle),
-    m_timer(context.m_impl->ioService) {
-  // These promises should be already resolved\rejected in constructor to make handleResponse, handleResult, etc functions work properly
-  m_executePromise.reject(make_exception_ptr(Errors::InvalidResponse()));
-  m_executeStringPromise.reject(make_exception_ptr(Errors::InvalidResponse()));
-  m_executeGetStatePromise.reject(make_exception_ptr(Errors::InvalidResponse()));
+    m_portGeneration(0),
+    m_pipelined(false),
+    m_writeInProgress(false),
+    m_timer(context.m_impl->ioService),
+    m_strand(strand) {
+  if (!m_strand) {
+    m_strand = std::make_shared<IOStrand>(context.m_impl->ioService);
+  }
 }
 
 SerialDevice::Impl::~Impl() {
@@ -32,6 +36,8 @@ SerialDevice::Impl::~Impl() {
 }
 
 void SerialDevice::Impl::open(const string& path) {
+  lock_guard<recursive_mutex> guard(m_mutex);
+
   m_port.open(path);
   m_port.set_option(serial_port_base::baud_rate(9600));
   m_port.set_option(serial_port_base::stop_bits(serial_port_base::stop_bits::one));
@@ -39,31 +45,80 @@ void SerialDevice::Impl::open(const string& path) {
   m_port.set_option(serial_port_base::flow_control(serial_port_base::flow_control::none));
   m_port.set_option(serial_port_base::character_size(8U));
   m_port_state = SerialPortState::open;
-  async_read_until(m_port, m_readBuffer, "\r\n", boost::bind(&SerialDevice::Impl::readCompleted, this, asio::placeholders::error));
+  m_portGeneration++;
+  startRead();
+}
+
+void SerialDevice::Impl::startRead() {
+  async_read_until(m_port,
+                   m_readBuffer,
+                   "\r\n",
+                   m_strand->wrap(boost::bind(
+                     &SerialDevice::Impl::readCompleted, shared_from_this(), asio::placeholders::error, m_portGeneration)));
 }
 
 void SerialDevice::Impl::close() {
+  // handlers may be running on another thread of the io context, the port is only touched under the lock
+  lock_guard<recursive_mutex> guard(m_mutex);
+
   m_port_state = SerialPortState::closing;
   m_port.close();
   m_port_state = SerialPortState::closed;
+
+  // nothing of the old connection may leak into the next one: a stale pending command or a partial line would make
+  // the first responses after reopening mismatch
+  m_queuedWriteData.clear();
+  m_readBuffer.consume(m_readBuffer.size());
+  rejectPendingPromises(make_exception_ptr(Errors::OperationCancelled()));
+}
+
+void SerialDevice::Impl::setPipelined(bool pipelined) {
+  lock_guard<recursive_mutex> guard(m_mutex);
+  m_pipelined = pipelined;
+}
+
+bool SerialDevice::Impl::isPipelined() {
+  lock_guard<recursive_mutex> guard(m_mutex);
+  return m_pipelined;
 }
 
 void SerialDevice::Impl::writeCompleted(const boost::system::error_code& error, std::size_t bytes_transferred) {
-  auto errorCallback = *m_callbacks.errorCallback;
+  auto& errorCallback = *m_callbacks.errorCallback;
+  unique_lock<recursive_mutex> lock(m_mutex);
+
+  m_writeInProgress = false;
+  if (m_port_state != SerialPortState::open) {
+    // aborted by close, the device may be already destroyed
+    return;
+  }
 
-  if (error) {
+  // a write aborted by close may complete after the port is already reopened, commands queued meanwhile are sent
+  if (error && error != asio::error::operation_aborted) {
+    m_queuedWriteData.clear();
+    lock.unlock();
     m_log.e() << "write error: " << error << Logger::endl;
     if (errorCallback) {
       errorCallback(make_exception_ptr(Errors::IOError()));
     }
     return;
   }
+
+  if (!m_queuedWriteData.empty()) {
+    flushWriteQueue();
+  }
 }
 
-void SerialDevice::Impl::readCompleted(const boost::system::error_code& error) {
-  auto errorCallback = *m_callbacks.errorCallback;
+void SerialDevice::Impl::readCompleted(const boost::system::error_code& error, uint32_t portGeneration) {
+  auto& errorCallback = *m_callbacks.errorCallback;
+  unique_lock<recursive_mutex> lock(m_mutex);
+
+  // a read aborted by close may complete after the port is already reopened, the new connection has its own read
+  if (portGeneration != m_portGeneration || m_port_state != SerialPortState::open) {
+    return;
+  }
 
-  if (error && m_port_state == SerialPortState::open) {
+  if (error && error != asio::error::operation_aborted) {
+    lock.unlock();
     m_log.e() << "read error: " << error << Logger::endl;
     if (errorCallback) {
       errorCallback(make_exception_ptr(Errors::IOError()));
@@ -74,136 +129,137 @@ void SerialDevice::Impl::readCompleted(const boost::system::error_code& error) {
     return;
   }
 
-  asio::streambuf::const_buffers_type bufs = m_readBuffer.data();
-  string response(asio::buffers_begin(bufs), asio::buffers_begin(bufs) + m_readBuffer.size());
+  // every complete line in the buffer is handled in place, only the unterminated tail is kept for the next read
+  auto bufs = m_readBuffer.data();
+  string_view received(static_cast<const char*>(bufs.data()), bufs.size());
+  size_t parsed = 0;
 
-  m_readBuffer.consume(m_readBuffer.size());
-  async_read_until(m_port, m_readBuffer, "\r\n", boost::bind(&SerialDevice::Impl::readCompleted, this, asio::placeholders::error));
+  for (auto end = received.find("\r\n"); end != string_view::npos; end = received.find("\r\n", parsed)) {
+    handleResponse(received.substr(parsed, end - parsed));
+    parsed = end + 2;
 
-  if (response.size() < 2) {
-    m_log.e() << "response size < 2" << Logger::endl;
-    if (errorCallback) {
-      errorCallback(make_exception_ptr(Errors::ProtocolError()));
+    // a callback closed the port: the buffer is cleared already and a reopened port reads by itself
+    if (portGeneration != m_portGeneration || m_port_state != SerialPortState::open) {
+      return;
     }
-    return;
   }
 
-  response = response.substr(0, response.size() - 2);
-  handleResponse(response);
+  m_metrics.bytesReceived(parsed);
+  m_readBuffer.consume(parsed);
+  startRead();
 }
 
-void SerialDevice::Impl::handleResponse(const string& response) {
-  auto errorCallback = *m_callbacks.errorCallback;
-  auto splitted = Utils::splitString(response);
+void SerialDevice::Impl::handleResponse(string_view response) {
+  StringTokens<> splitted(response);
   lock_guard<recursive_mutex> guard(m_mutex);
 
   m_log.d() << "nrf rx: " << response << Logger::endl;
 
   if (splitted.empty()) {
     m_log.e() << "unable to split string..." << Logger::endl;
-    if (errorCallback) {
-      errorCallback(make_exception_ptr(Errors::ProtocolError()));
-    }
-    return;
-  }
-
-  auto command = splitted.at(0);
-  splitted.erase(splitted.begin());
-
-  if (handleResult(command, splitted)) {
+    reportProtocolError();
     return;
   }
 
-  if (handleResultWithParams(command, splitted)) {
-    return;
-  }
+  auto id = DeviceResponses::lookup(splitted[0]);
+  auto params = splitted.tail(1);
+  bool isHandled = false;
 
-  if (handleEvent(command, splitted)) {
-    return;
+  switch (id) {
+  case ResponseId::get:
+  case ResponseId::getState:
+  case ResponseId::nfcReadMFC:
+  case ResponseId::nfcSecureReadMFC:
+    isHandled = handleResultWithParams(id, params);
+    break;
+  case ResponseId::mobileConnected:
+  case ResponseId::mobileDisconnected:
+  case ResponseId::barcodes:
+  case ResponseId::paymentSuccessful:
+  case ResponseId::paymentError:
+  case ResponseId::paymentToken:
+  case ResponseId::nfcDetected:
+  case ResponseId::nfcRemoved:
+  case ResponseId::nfcDetectionError:
+    isHandled = handleEvent(id, params);
+    break;
+  case ResponseId::systemReset:
+    isHandled = handleSystemEvent(id, params);
+    break;
+  case ResponseId::unknown:
+    break;
+  default:
+    isHandled = handleResult(id, params);
+    break;
   }
 
-  if (handleSystemEvent(command, splitted)) {
+  if (isHandled) {
+    // results of commands start with ok or error, events never start with error
+    if (!params.empty() && params[0] == "error") {
+      m_metrics.commandFailed(id);
+    }
     return;
   }
 
   // if we are here, then something wrong happened and we have to cancel all pending operations
-  m_state = SerialDeviceState::idle;
-  m_timer.cancel();
   rejectPendingPromises(make_exception_ptr(Errors::InvalidResponse()));
   m_log.e() << "unable to parse command: " << response << Logger::endl;
-  if (errorCallback) {
-    errorCallback(make_exception_ptr(Errors::ProtocolError()));
-  }
+  reportProtocolError();
 }
 
-bool SerialDevice::Impl::handleResult(const string& command, const vector<string>& params) {
-  if (m_state != SerialDeviceState::executeInProgress) {
+bool SerialDevice::Impl::handleResult(ResponseId id, const StringTokensRange& params) {
+  if (m_pendingCommands.empty() || m_pendingCommands.front().id != id ||
+      !std::holds_alternative<Promise<void>>(m_pendingCommands.front().promise)) {
     return false;
   }
 
-  if (command != m_executedCommand) {
-    return false;
-  }
-
-  if (m_executePromise.state() != PromiseState::undefined) {
-    return false;
-  }
-
-  m_state = SerialDeviceState::idle;
-  m_timer.cancel();
+  auto executePromise = std::get<Promise<void>>(popPendingCommand());
 
   if (params.size() == 0 || params.size() > 2 || (params.size() == 2 && params[0] != "error") ) {
     m_log.e() << "invalid response params size: " << params.size() << Logger::endl;
-    m_executePromise.reject(make_exception_ptr(Errors::InvalidResponse()));
+    executePromise.reject(make_exception_ptr(Errors::InvalidResponse()));
     return true;
   }
 
   auto result = params[0];
 
   if (result == "ok") {
-    m_executePromise.resolve();
+    executePromise.resolve();
   } else if (result == "error" && params.size() == 2 /* error with a reason */) {
     m_log.e() << "result is not ok: " << result << ", reason: " << params[1] << Logger::endl;
-    m_executePromise.reject(make_exception_ptr(Errors::InvalidResponseWithReason(params[1])));
+    executePromise.reject(make_exception_ptr(Errors::InvalidResponseWithReason(string(params[1]))));
   } else {
     m_log.e() << "result is not ok: " << result << Logger::endl;
-    m_executePromise.reject(make_exception_ptr(Errors::InvalidResponse()));
+    executePromise.reject(make_exception_ptr(Errors::InvalidResponse()));
   }
   return true;
 }
 
-bool SerialDevice::Impl::handleResultWithParams(const std::string& command, const vector<string>& params) {
-  auto errorCallback = *m_callbacks.errorCallback;
-
-  if (m_state != SerialDeviceState::executeInProgress) {
+bool SerialDevice::Impl::handleResultWithParams(ResponseId id, const StringTokensRange& params) {
+  if (m_pendingCommands.empty() || m_pendingCommands.front().id != id) {
     return false;
   }
 
-  if (command != m_executedCommand) {
-    return false;
-  }
+  auto& pendingPromise = m_pendingCommands.front().promise;
 
-  m_state = SerialDeviceState::idle;
-  m_timer.cancel();
-
-  if (command == DeviceResponses::get) {
-    if (m_executeStringPromise.state() != PromiseState::undefined) {
-      m_log.e() << "invalid promise state" << Logger::endl;
-      if (errorCallback) {
-        errorCallback(make_exception_ptr(Errors::ProtocolError()));
-      }
-      return true;
+  switch (id) {
+  case ResponseId::get: {
+    if (!std::holds_alternative<Promise<string>>(pendingPromise)) {
+      m_log.e() << "invalid promise type" << Logger::endl;
+      return false;
     }
 
+    auto executeStringPromise = std::get<Promise<string>>(popPendingCommand());
+
     if (!params.empty() && params[0] == "error") {
       m_log.e() << "get cmd error" << Logger::endl;
-      m_executeStringPromise.reject(make_exception_ptr(Errors::InvalidResponse()));
+      executeStringPromise.reject(make_exception_ptr(Errors::InvalidResponse()));
       return true;
     }
 
     if (params.size() != 2) { //also
       m_log.e() << "invalid get response split size: " << params.size() << Logger::endl;
-      m_executeStringPromise.reject(make_exception_ptr(Errors::InvalidResponse()));
+      executeStringPromise.reject(make_exception_ptr(Errors::InvalidResponse()));
       return true;
     }
 
@@ -212,24 +268,24 @@ bool SerialDevice::Impl::handleResultWithParams(const std::string& command, cons
 
     if (result != "ok") {
       m_log.e() << "result is not ok: " << result << Logger::endl;
-      m_executeStringPromise.reject(make_exception_ptr(Errors::InvalidResponse()));
+      executeStringPromise.reject(make_exception_ptr(Errors::InvalidResponse()));
       return true;
     }
 
-    m_executeStringPromise.resolve(value);
+    executeStringPromise.resolve(string(value));
     return true;
-  } else if (command == DeviceResponses::getState) {
-    if (m_executeGetStatePromise.state() != PromiseState::undefined) {
-      m_log.e() << "invalid promise state" << Logger::endl;
-      if (errorCallback) {
-        errorCallback(make_exception_ptr(Errors::ProtocolError()));
-      }
+  }
+  case ResponseId::getState: {
+    if (!std::holds_alternative<Promise<SerialGetStateResult>>(pendingPromise)) {
+      m_log.e() << "invalid promise type" << Logger::endl;
       return false;
     }
 
+    auto executeGetStatePromise = std::get<Promise<SerialGetStateResult>>(popPendingCommand());
+
     if (params.size() != 6) {
       m_log.e() << "invalid getState response split size: " << params.size() << Logger::endl;
-      m_executeGetStatePromise.reject(make_exception_ptr(Errors::InvalidResponse()));
+      executeGetStatePromise.reject(make_exception_ptr(Errors::InvalidResponse()));
       return true;
     }
 
@@ -240,20 +296,21 @@ bool SerialDevice::Impl::handleResultWithParams(const std::string& command, cons
     result.isWaitingForPaymentConfirmation = params[4] == "1";
     result.isRefundRequested = params[5] == "1";
 
-    m_executeGetStatePromise.resolve(result);
+    executeGetStatePromise.resolve(result);
     return true;
-  } else if (command == DeviceResponses::nfcReadMFC || command == DeviceResponses::nfcSecureReadMFC) {
-    if (m_executeStringPromise.state() != PromiseState::undefined) {
-      m_log.e() << "invalid promise state" << Logger::endl;
-      if (errorCallback) {
-        errorCallback(make_exception_ptr(Errors::ProtocolError()));
-      }
-      return true;
+  }
+  case ResponseId::nfcReadMFC:
+  case ResponseId::nfcSecureReadMFC: {
+    if (!std::holds_alternative<Promise<string>>(pendingPromise)) {
+      m_log.e() << "invalid promise type" << Logger::endl;
+      return false;
     }
 
+    auto executeStringPromise = std::get<Promise<string>>(popPendingCommand());
+
     if (params.size() != 2) {
       m_log.e() << "invalid response size: " << params.size() << Logger::endl;
-      m_executeStringPromise.reject(make_exception_ptr(Errors::InvalidResponse()));
+      executeStringPromise.reject(make_exception_ptr(Errors::InvalidResponse()));
       return true;
     }
 
@@ -262,51 +319,54 @@ bool SerialDevice::Impl::handleResultWithParams(const std::string& command, cons
 
     if (result  == "error") {
       m_log.e() << "nfcReadMFC(secure) error: " << value << Logger::endl;
-      m_executeStringPromise.reject(make_exception_ptr(Errors::InvalidResponseWithReason(value)));
+      executeStringPromise.reject(make_exception_ptr(Errors::InvalidResponseWithReason(string(value))));
       return true;
     }
 
     if (result == "ok") {
-      m_executeStringPromise.resolve(value);
+      executeStringPromise.resolve(string(value));
       return true;
     }
 
     m_log.e() << "unexpected nfcReadMFC(secure) response: " << result << Logger::endl;
-    m_executeStringPromise.reject(make_exception_ptr(Errors::InvalidResponse()));
+    executeStringPromise.reject(make_exception_ptr(Errors::InvalidResponse()));
     return true;
   }
-
-  return false;
+  default:
+    return false;
+  }
 }
 
-bool SerialDevice::Impl::handleEvent(const string& event, const vector<string>& params) {
-  auto errorCallback = *m_callbacks.errorCallback;
+bool SerialDevice::Impl::handleEvent(ResponseId id, const StringTokensRange& params) {
+  m_metrics.eventReceived(id);
 
-  if (event == DeviceResponses::mobileConnected) {
+  switch (id) {
+  case ResponseId::mobileConnected: {
     if (*m_callbacks.mobileCallback) {
       (*m_callbacks.mobileCallback)(SerialMobileEvent::connected);
     }
     return true;
-  } else if (event == DeviceResponses::mobileDisconnected) {
+  }
+  case ResponseId::mobileDisconnected: {
     if (*m_callbacks.mobileCallback) {
       (*m_callbacks.mobileCallback)(SerialMobileEvent::disconnected);
     }
     return true;
-  } else if (event == DeviceResponses::barcodes) {
+  }
+  case ResponseId::barcodes: {
     vector<Barcode> barcodes;
 
     if (params.size() % 2 != 0) {
       m_log.e() << "invalid params size when received barcodes: " << params.size() << Logger::endl;
-      if (errorCallback) {
-        errorCallback(make_exception_ptr(Errors::ProtocolError()));
-      }
+      reportProtocolError();
       return true;
     }
 
-    for (auto it = params.begin(), it2 = std::next(it); it != params.end(); it += 2) {
-      string value = *it;
-      int type = atoi((*it2).c_str());
-      Barcode barcode = {value, static_cast<BarcodeType>(type)};
+    barcodes.reserve(params.size() / 2);
+    for (size_t i = 0; i < params.size(); i += 2) {
+      int type = 0;
+      from_chars(params[i + 1].data(), params[i + 1].data() + params[i + 1].size(), type);
+      Barcode barcode = {string(params[i]), static_cast<BarcodeType>(type)};
 
       barcodes.push_back(barcode);
     }
@@ -315,52 +375,33 @@ bool SerialDevice::Impl::handleEvent(const string& event, const vector<string>&
       (*m_callbacks.barcodesCallback)(barcodes);
     }
     return true;
-  } else if (event == DeviceResponses::paymentToken) {
+  }
+  case ResponseId::paymentToken: {
     if (params.size() != 1) {
       m_log.e() << "invalid params count of payment token: " << params.size() << Logger::endl;
-      if (errorCallback) {
-        errorCallback(make_exception_ptr(Errors::ProtocolError()));
-      }
+      reportProtocolError();
       return true;
     }
 
-    auto paymentToken = params[0];
+    auto paymentToken = string(params[0]);
     if (*m_callbacks.paymentTokenCallback) {
       (*m_callbacks.paymentTokenCallback)(paymentToken);
     }
     return true;
-  } else if (event == DeviceResponses::paymentError) {
+  }
+  case ResponseId::paymentError: {
     if (params.size() != 1) {
       m_log.e() << "invalid params count of payment error: " << params.size() << Logger::endl;
-      if (errorCallback) {
-        errorCallback(make_exception_ptr(Errors::ProtocolError()));
-      }
+      reportProtocolError();
       return true;
     }
 
-    auto paymentErrorStr = params[0];
     PaymentError paymentError = PaymentError::unknown;
-    if (paymentErrorStr == "NETWORK") {
-      paymentError = PaymentError::network;
-    } else if (paymentErrorStr == "TIMEOUT") {
-      paymentError = PaymentError::timeout;
-    } else if (paymentErrorStr == "SERVER") {
-      paymentError = PaymentError::server;
-    } else if (paymentErrorStr == "SECURITY") {
-      paymentError = PaymentError::security;
-    } else if (paymentErrorStr == "WITHDRAWAL") {
-      paymentError = PaymentError::withdrawal;
-    } else if (paymentErrorStr == "DISCARDED") {
-      paymentError = PaymentError::discarded;
-    } else if (paymentErrorStr == "INVALID_PIN") {
-      paymentError = PaymentError::invalidPin;
-    } else if (paymentErrorStr == "UNKNOWN") {
-      paymentError = PaymentError::unknown;
-    } else {
+    try {
+      paymentError = DeviceUtils::stringToPaymentError(params[0]);
+    } catch (...) {
       m_log.e() << "unable to parse payment error" << Logger::endl;
-      if (errorCallback) {
-        errorCallback(make_exception_ptr(Errors::ProtocolError()));
-      }
+      reportProtocolError();
       return true;
     }
 
@@ -368,72 +409,69 @@ bool SerialDevice::Impl::handleEvent(const string& event, const vector<string>&
       (*m_callbacks.paymentErrorCallback)(paymentError);
     }
     return true;
-  } else if (event == DeviceResponses::paymentSuccessful) {
+  }
+  case ResponseId::paymentSuccessful: {
     if (*m_callbacks.paymentSuccessCallback) {
       (*m_callbacks.paymentSuccessCallback)();
     }
     return true;
-  } else if (event == DeviceResponses::nfcDetected) {
+  }
+  case ResponseId::nfcDetected: {
     NFC::DetectionEventData eventData;
     try {
       eventData = DeviceUtils::parseNFCDetectionEventData(params);
     } catch (std::exception &err) {
       m_log.e() << err.what() << Logger::endl;
-      if (errorCallback) {
-        errorCallback(make_exception_ptr(Errors::ProtocolError()));
-      }
+      reportProtocolError();
       return true;
     } 
     if (*m_callbacks.nfcEventCallback) {
       (*m_callbacks.nfcEventCallback)(SerialNFCEvent::detected, eventData);
     }
     return true;
-  } else if (event == DeviceResponses::nfcRemoved) {
+  }
+  case ResponseId::nfcRemoved: {
     if (*m_callbacks.nfcEventCallback) {
       (*m_callbacks.nfcEventCallback)(SerialNFCEvent::removed, NFC::DetectionEventData());
     }
     return true;
-  } else if (event == DeviceResponses::nfcDetectionError) {
+  }
+  case ResponseId::nfcDetectionError: {
     if (params.size() != 1) {
       m_log.e() << "invalid params count of nfc Detection Error: " << params.size() << Logger::endl;
-      if (errorCallback) {
-        errorCallback(make_exception_ptr(Errors::ProtocolError()));
-      }
+      reportProtocolError();
       return true;
     }
 
-    auto reasonStr = params[0];
-    auto reason = NFC::DetectionErrorReason::UNKNOWN;
-    if (reasonStr == "multiple_cards") {
-      reason = NFC::DetectionErrorReason::MULTIPLE_CARDS;
-    } else if (reasonStr == "unsupported_type") {
-      reason = NFC::DetectionErrorReason::UNSUPPORTED;
-    }
+    auto reason = DeviceUtils::stringToNFCDetectionErrorReason(params[0]);
     if (*m_callbacks.nfcDetectionErrorCallback) {
       (*m_callbacks.nfcDetectionErrorCallback)(reason);
     }
     return true;
   }
-
-  return false;
+  default:
+    return false;
+  }
 }
 
-bool SerialDevice::Impl::handleSystemEvent(const string& event, const vector<string>& params) {
-  auto errorCallback = *m_callbacks.errorCallback;
-
-  if (event == DeviceResponses::systemReset) {
-    //TODO 
+bool SerialDevice::Impl::handleSystemEvent(ResponseId id, const StringTokensRange& params) {
+  switch (id) {
+  case ResponseId::systemReset:
+    //TODO
     return true;
-  } 
-
-  return false;
+  default:
+    return false;
+  }
 }
 
 
-void SerialDevice::Impl::writeSerial(const string& cmd, unsigned int timeoutInMilliseconds) {
+void SerialDevice::Impl::writeSerial(string_view cmd,
+                                     string_view params,
+                                     const SerialCommandPromise& promise,
+                                     unsigned int timeoutInMilliseconds) {
   lock_guard<recursive_mutex> guard(m_mutex);
 
-  if (m_state != SerialDeviceState::idle) {
+  if (!m_pipelined && !m_pendingCommands.empty()) {
     throw Errors::OperationInProgress();
   }
 
@@ -441,52 +479,83 @@ void SerialDevice::Impl::writeSerial(const string& cmd, unsigned int timeoutInMi
     throw Errors::DeviceNotOpened();
   }
 
-  m_log.d() << "nrf tx: " << cmd.substr(0, cmd.size() - 2) << Logger::endl;
+  if (!params.empty()) {
+    m_log.d() << "nrf tx: " << cmd << " " << params << Logger::endl;
+  } else {
+    m_log.d() << "nrf tx: " << cmd << Logger::endl;
+  }
 
-  m_writeData = cmd;
-  auto buffer = asio::buffer(m_writeData.c_str(), m_writeData.size());
-  auto writeCallback = boost::bind(&SerialDevice::Impl::writeCompleted, this, asio::placeholders::error, asio::placeholders::bytes_transferred);
+  m_queuedWriteData.append(cmd);
+  if (!params.empty()) {
+    m_queuedWriteData.append(" ").append(params);
+  }
+  m_queuedWriteData.append("\r\n");
 
-  async_write(m_port, buffer, writeCallback);
+  auto deadline = posix_time::microsec_clock::universal_time() + posix_time::millisec(timeoutInMilliseconds);
+  m_pendingCommands.push_back({DeviceResponses::lookup(cmd), promise, deadline, std::chrono::steady_clock::now()});
+  if (m_pendingCommands.size() == 1) {
+    scheduleTimeout();
+  }
 
-  // NOTE: expires_from_now cancels all pending timeouts (according to docs)
-  m_timer.expires_from_now(boost::posix_time::millisec(timeoutInMilliseconds));
-  m_timer.async_wait(boost::bind(&SerialDevice::Impl::handleTimeout, this, asio::placeholders::error));
+  // only one async_write may be in flight on the port, commands issued meanwhile are sent with the next write
+  if (!m_writeInProgress) {
+    flushWriteQueue();
+  }
+}
+
+void SerialDevice::Impl::flushWriteQueue() {
+  m_writeData.swap(m_queuedWriteData);
+  m_queuedWriteData.clear();
+  m_writeInProgress = true;
+  m_metrics.bytesSent(m_writeData.size());
+
+  auto buffer = asio::buffer(m_writeData.c_str(), m_writeData.size());
+  auto writeCallback = boost::bind(&SerialDevice::Impl::writeCompleted, shared_from_this(), asio::placeholders::error, asio::placeholders::bytes_transferred);
 
-  m_state = SerialDeviceState::executeInProgress;
+  async_write(m_port, buffer, m_strand->wrap(writeCallback));
 }
 
-Promise<void> SerialDevice::Impl::execute(const string& cmd, const string& params, unsigned int timeoutInMilliseconds) {
-  if (params != "") {
-    writeSerial(cmd + " " + params + "\r\n", timeoutInMilliseconds);
-  } else {
-    writeSerial(cmd + "\r\n", timeoutInMilliseconds);
+void SerialDevice::Impl::scheduleTimeout() {
+  if (m_pendingCommands.empty()) {
+    m_timer.cancel();
+    return;
   }
-  m_executePromise = Promise<void>();
-  m_executedCommand = cmd;
-  return m_executePromise;
+
+  // NOTE: expires_at cancels all pending timeouts (according to docs)
+  m_timer.expires_at(m_pendingCommands.front().deadline);
+  m_timer.async_wait(m_strand->wrap(boost::bind(&SerialDevice::Impl::handleTimeout, shared_from_this(), asio::placeholders::error)));
 }
 
-Promise<string> SerialDevice::Impl::executeString(const string& cmd, const string& params, unsigned int timeoutInMilliseconds) {
-  if (params != "") {
-    writeSerial(cmd + " " + params + "\r\n", timeoutInMilliseconds);
-  } else {
-    writeSerial(cmd + "\r\n", timeoutInMilliseconds);
-  }
-  m_executeStringPromise = Promise<string>();
-  m_executedCommand = cmd;
-  return m_executeStringPromise;
+SerialCommandPromise SerialDevice::Impl::popPendingCommand() {
+  auto& command = m_pendingCommands.front();
+  auto promise = std::move(command.promise);
+
+  m_metrics.commandAnswered(command.id, std::chrono::steady_clock::now() - command.sentAt);
+
+  m_pendingCommands.pop_front();
+  scheduleTimeout();
+  return promise;
 }
 
-Promise<SerialGetStateResult> SerialDevice::Impl::executeGetState(const string& cmd, const string& params, unsigned int timeoutInMilliseconds) {
-  if (params != "") {
-    writeSerial(cmd + " " + params + "\r\n", timeoutInMilliseconds);
-  } else {
-    writeSerial(cmd + "\r\n", timeoutInMilliseconds);
-  }
-  m_executeGetStatePromise = Promise<SerialGetStateResult>();
-  m_executedCommand = cmd;
-  return m_executeGetStatePromise;
+Promise<void> SerialDevice::Impl::execute(string_view cmd, string_view params, unsigned int timeoutInMilliseconds) {
+  Promise<void> promise;
+
+  writeSerial(cmd, params, promise, timeoutInMilliseconds);
+  return promise;
+}
+
+Promise<string> SerialDevice::Impl::executeString(string_view cmd, string_view params, unsigned int timeoutInMilliseconds) {
+  Promise<string> promise;
+
+  writeSerial(cmd, params, promise, timeoutInMilliseconds);
+  return promise;
+}
+
+Promise<SerialGetStateResult> SerialDevice::Impl::executeGetState(string_view cmd, string_view params, unsigned int timeoutInMilliseconds) {
+  Promise<SerialGetStateResult> promise;
+
+  writeSerial(cmd, params, promise, timeoutInMilliseconds);
+  return promise;
 }
 
 void SerialDevice::Impl::handleTimeout(const boost::system::error_code& err) {
@@ -496,27 +565,61 @@ void SerialDevice::Impl::handleTimeout(const boost::system::error_code& err) {
     return;
   }
 
-  switch (m_state) {
-  case SerialDeviceState::executeInProgress:
-    m_state = SerialDeviceState::idle;
-    rejectPendingPromises(make_exception_ptr(Errors::OperationTimeout()));
-    break;
-  default:
+  if (m_pendingCommands.empty()) {
     m_log.e() << "handle timeout call, while no active operation in progress" << Logger::endl;
-    break;
+    return;
+  }
+
+  // the handler could be already queued when the timer was rescheduled for the next command
+  if (m_pendingCommands.front().deadline > posix_time::microsec_clock::universal_time()) {
+    return;
   }
+
+  // a late response would be matched against a wrong command, so the whole pipeline is rejected
+  m_log.e() << "command timeout: " << DeviceResponses::name(m_pendingCommands.front().id) << Logger::endl;
+  m_metrics.commandTimedOut(m_pendingCommands.front().id);
+  rejectPendingPromises(make_exception_ptr(Errors::OperationTimeout()));
 }
 
 void SerialDevice::Impl::rejectPendingPromises(std::exception_ptr exception) {
-  if (m_executePromise.state() == PromiseState::undefined) {
-    m_executePromise.reject(exception);
-  }
+  deque<SerialPendingCommand> pendingCommands;
 
-  if (m_executeStringPromise.state() == PromiseState::undefined) {
-    m_executeStringPromise.reject(exception);
+  // promise callbacks may issue new commands, so the queue is detached before rejecting
+  pendingCommands.swap(m_pendingCommands);
+  m_timer.cancel();
+
+  for (auto& pendingCommand : pendingCommands) {
+    std::visit(
+      [&](auto& promise) {
+        if (promise.state() != PromiseState::undefined) {
+          return;
+        }
+        // e.g. an error handler issuing a new command on a closed port, the rest of the commands are rejected anyway
+        try {
+          promise.reject(exception);
+        } catch (std::exception& error) {
+          m_log.e() << "error handler of a rejected command failed: " << error.what() << Logger::endl;
+        }
+      },
+      pendingCommand.promise);
   }
+}
 
-  if (m_executeGetStatePromise.state() == PromiseState::undefined) {
-    m_executeGetStatePromise.reject(exception);
+void SerialDevice::Impl::reportProtocolError() {
+  auto& errorCallback = *m_callbacks.errorCallback;
+
+  m_metrics.protocolError();
+  if (errorCallback) {
+    errorCallback(make_exception_ptr(Errors::ProtocolError()));
   }
-}
\ No newline at end of file
+}
+
+SerialDeviceMetrics SerialDevice::Impl::metrics() {
+  lock_guard<recursive_mutex> guard(m_mutex);
+  return m_metrics.snapshot();
+}
+
+void SerialDevice::Impl::resetMetrics() {
+  lock_guard<recursive_mutex> guard(m_mutex);
+  m_metrics.reset();
+}
@@ -3,10 +3,16 @@
 
 #include "../utils/logger.hpp"
 #include "../utils/promise.hpp"
+#include "../utils/string_tokens.hpp"
+#include "device_metrics.hpp"
+#include "device_responses.hpp"
 #include "serial_device.hpp"
+#include <deque>
 #include <iterator>
 #include <mutex>
+#include <string_view>
 #include <thread>
+#include <variant>
 
 #include <boost/asio.hpp>
 #include <boost/asio/serial_port.hpp>
@@ -26,48 +32,76 @@ namespace JetBeep {
 
   } SerialDeviceCallbacks;
 
-  enum class SerialDeviceState { idle, executeInProgress };
   enum class SerialPortState { open, closing, closed };
 
-  class SerialDevice::Impl {
+  typedef std::variant<Promise<void>, Promise<std::string>, Promise<SerialGetStateResult>> SerialCommandPromise;
+
+  // command which was written to the device and is waiting for its response. Device answers in the same order as
+  // commands are written, so the front of the queue is always the command the next response belongs to
+  typedef struct SerialPendingCommand {
+    DeviceResponses::ResponseId id;
+    SerialCommandPromise promise;
+    boost::posix_time::ptime deadline;
+    std::chrono::steady_clock::time_point sentAt;
+  } SerialPendingCommand;
+
+  // handlers of the port hold a reference, so the implementation outlives its device until they are aborted
+  class SerialDevice::Impl : public std::enable_shared_from_this<SerialDevice::Impl> {
   public:
-    Impl(const SerialDeviceCallbacks& callbacks, IOContext context);
+    Impl(const SerialDeviceCallbacks& callbacks, IOContext context, std::shared_ptr<IOStrand> strand = nullptr);
     virtual ~Impl();
 
     void open(const std::string& path);
     void close();
 
-    Promise<void> execute(const std::string& cmd, const std::string& params = "", unsigned int timeoutInMilliseconds = 2000);
-    Promise<std::string> executeString(const std::string& cmd, const std::string& params = "", unsigned int timeoutInMilliseconds = 2000);
-    Promise<SerialGetStateResult> executeGetState(const std::string& cmd, const std::string& params = "", unsigned int timeoutInMilliseconds = 2000);
+    Promise<void> execute(std::string_view cmd, std::string_view params = "", unsigned int timeoutInMilliseconds = 2000);
+    Promise<std::string> executeString(std::string_view cmd, std::string_view params = "", unsigned int timeoutInMilliseconds = 2000);
+    Promise<SerialGetStateResult> executeGetState(std::string_view cmd, std::string_view params = "", unsigned int timeoutInMilliseconds = 2000);
     void cancelPendingOperations();
 
+    void setPipelined(bool pipelined);
+    bool isPipelined();
+
+    SerialDeviceMetrics metrics();
+    void resetMetrics();
+
   private:
     IOContext m_context;
-    SerialDeviceState m_state;
     SerialPortState m_port_state;
-    Promise<void> m_executePromise;
-    Promise<std::string> m_executeStringPromise;
-    Promise<SerialGetStateResult> m_executeGetStatePromise;
-    std::string m_executedCommand;
+    // counts the opens of the port, so a read of a previous connection is told apart from the current one
+    uint32_t m_portGeneration;
+    bool m_pipelined;
+    std::deque<SerialPendingCommand> m_pendingCommands;
+    bool m_writeInProgress;
     std::string m_writeData;
+    std::string m_queuedWriteData;
     std::recursive_mutex m_mutex;
     boost::asio::streambuf m_readBuffer;
     Logger m_log;
     SerialDeviceCallbacks m_callbacks;
     boost::asio::serial_port m_port;
     boost::asio::deadline_timer m_timer;
-    void writeSerial(const std::string& cmd, unsigned int timeoutInMilliseconds);
+    std::shared_ptr<IOStrand> m_strand;
+    SerialMetricsRecorder m_metrics;
+    void writeSerial(std::string_view cmd,
+                     std::string_view params,
+                     const SerialCommandPromise& promise,
+                     unsigned int timeoutInMilliseconds);
+    void flushWriteQueue();
+    void scheduleTimeout();
+    SerialCommandPromise popPendingCommand();
 
     void handleTimeout(const boost::system::error_code& err);
     void writeCompleted(const boost::system::error_code& ec, std::size_t bytes_transferred);
-    void readCompleted(const boost::system::error_code& err);
-    void handleResponse(const std::string& response);
-    bool handleResult(const std::string& command, const std::vector<std::string>& params);
-    bool handleResultWithParams(const std::string& command, const std::vector<std::string>& params);
-    bool handleEvent(const std::string& event, const std::vector<std::string>& params);
-    bool handleSystemEvent(const std::string& event, const std::vector<std::string>& params);
+    void readCompleted(const boost::system::error_code& err, uint32_t portGeneration);
+    void startRead();
+    void handleResponse(std::string_view response);
+    bool handleResult(DeviceResponses::ResponseId id, const StringTokensRange& params);
+    bool handleResultWithParams(DeviceResponses::ResponseId id, const StringTokensRange& params);
+    bool handleEvent(DeviceResponses::ResponseId id, const StringTokensRange& params);
+    bool handleSystemEvent(DeviceResponses::ResponseId id, const StringTokensRange& params);
     void rejectPendingPromises(std::exception_ptr exception);
+    void reportProtocolError();
   };
 } // namespace JetBeep
 
@@ -25,7 +25,7 @@ public:
 class EasyPayBackend::Impl {
 public:
   Impl(string serverHost, string merchantSecretKey, IOContext context, int port = 8193)
-    : m_serverHost(serverHost), m_port(port), m_log("backend"), m_merchantSecretKey(merchantSecretKey), m_context(context){};
+    : m_serverHost(serverHost), m_port(port), m_log("backend"), m_merchantSecretKey(merchantSecretKey), m_context(context), m_httpsClient(context){};
 
   ~Impl();
 
@@ -59,6 +59,10 @@ EasyPayBackend::EasyPayBackend(EasyPayHostEnv env, string merchantSecretKey, IOC
   : m_impl(new Impl(env == EasyPayHostEnv::Production ? "sas.easypay.ua" : "sastest.easypay.ua", merchantSecretKey, context)) {
 }
 
+EasyPayBackend::EasyPayBackend(string serverHost, int port, string merchantSecretKey, IOContext context)
+  : m_impl(new Impl(serverHost, merchantSecretKey, context, port)) {
+}
+
 EasyPayBackend::~EasyPayBackend() = default;
 
 Promise<EasyPayResult> EasyPayBackend::makePayment(
@@ -97,7 +101,6 @@ RequestOptions EasyPayBackend::Impl::getRequestOptions(string path, RequestMetho
   options.host = m_serverHost;
   options.port = m_port;
   options.path = path;
-  options.ioContext = m_context;
   return options;
 }
 
@@ -123,7 +126,7 @@ Promise<EasyPayResult> EasyPayBackend::Impl::makePayment(string merchantTransact
   auto options = getRequestOptions(path, RequestMethod::POST);
   options.body = tokenPaymentReqToJSON(data);
 
-  return m_httpsClient.request(options).thenPromise<EasyPayResult, Promise>([&](Response res) {
+  return m_httpsClient.request(options).thenPromise<EasyPayResult, Promise>([&](const Response& res) {
     auto promise = Promise<EasyPayResult>();
     if (res.isHttpError) {
       promise.reject(make_exception_ptr(HttpErrors::ServerError(res.statusCode)));
@@ -137,7 +140,7 @@ Promise<EasyPayResult> EasyPayBackend::Impl::makePayment(string merchantTransact
         promise.reject(make_exception_ptr(HttpErrors::RequestError(result.primaryErrorMsg)));
         return promise;
       }
-      promise.resolve(result);
+      promise.resolve(std::move(result));
     } catch (...) {
       promise.reject(make_exception_ptr(HttpErrors::APIError()));
     }
@@ -160,7 +163,7 @@ Promise<EasyPayResult> EasyPayBackend::Impl::getPaymentStatus(string merchantTra
   auto options = getRequestOptions(path, RequestMethod::GET);
   options.body = tokenGetStatusReqToJSON(data);
 
-  return m_httpsClient.request(options).thenPromise<EasyPayResult, Promise>([=](Response res) {
+  return m_httpsClient.request(options).thenPromise<EasyPayResult, Promise>([=](const Response& res) {
     auto promise = Promise<EasyPayResult>();
     if (res.isHttpError) {
       promise.reject(make_exception_ptr(HttpErrors::ServerError(res.statusCode)));
@@ -176,7 +179,7 @@ Promise<EasyPayResult> EasyPayBackend::Impl::getPaymentStatus(string merchantTra
         return promise;
       }
 
-      promise.resolve(result);
+      promise.resolve(std::move(result));
     } catch (...) {
       promise.reject(make_exception_ptr(HttpErrors::APIError()));
     }
@@ -200,7 +203,7 @@ Promise<EasyPayResult> EasyPayBackend::Impl::makeRefund(TransactionIdWrap& pspTr
   auto options = getRequestOptions(path, RequestMethod::POST);
   options.body = tokenRefundReqToJSON(data);
 
-  return m_httpsClient.request(options).thenPromise<EasyPayResult, Promise>([=](Response res) {
+  return m_httpsClient.request(options).thenPromise<EasyPayResult, Promise>([=](const Response& res) {
     auto promise = Promise<EasyPayResult>();
     if (res.isHttpError) {
       promise.reject(make_exception_ptr(HttpErrors::ServerError(res.statusCode)));
@@ -214,7 +217,7 @@ Promise<EasyPayResult> EasyPayBackend::Impl::makeRefund(TransactionIdWrap& pspTr
         promise.reject(make_exception_ptr(HttpErrors::RequestError(result.primaryErrorMsg)));
         return promise;
       }
-      promise.resolve(result);
+      promise.resolve(std::move(result));
     } catch (...) {
       promise.reject(make_exception_ptr(HttpErrors::APIError()));
     }
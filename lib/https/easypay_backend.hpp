@@ -26,6 +26,8 @@ namespace JetBeep {
   public:
     ~EasyPayBackend();
     EasyPayBackend(EasyPayHostEnv env, string merchantSecretKey, IOContext context = IOContext::context);
+    // sends the requests to serverHost:port instead of the EasyPay servers, e.g. to a local stub
+    EasyPayBackend(string serverHost, int port, string merchantSecretKey, IOContext context = IOContext::context);
 
     Promise<EasyPayResult> makePayment(string merchantTransactionId,
                                        string paymentToken,
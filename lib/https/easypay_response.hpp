@@ -42,7 +42,7 @@ namespace JetBeep::EasyPayAPI {
     string PaymentRequestUid = "";
     string MerchantTransactionId = "";
 
-    bool isError() {
+    bool isError() const {
       return Errors.size() > 0;
     }
   };
@@ -0,0 +1,54 @@
+#include "./https_client.hpp"
+#include "../../io/iocontext_impl.hpp"
+
+using namespace JetBeep;
+using namespace std;
+
+HttpsClient::HttpsClient(IOContext context)
+  : m_context(context),
+    m_strand(make_shared<IOStrand>(context.m_impl->ioService)),
+    m_isCanceled(make_shared<atomic<bool>>(false)),
+    m_log("https_client") {
+}
+
+HttpsClient::~HttpsClient() {
+  m_isCanceled->store(true);
+}
+
+HttpsClient::PendingRequest HttpsClient::makePendingRequest() {
+  return PendingRequest(m_strand, m_isCanceled);
+}
+
+HttpsClient::PendingRequest::PendingRequest(std::shared_ptr<IOStrand> strand, std::shared_ptr<std::atomic<bool>> isCanceled)
+  : m_strand(strand), m_isCanceled(isCanceled) {
+}
+
+Promise<Response> HttpsClient::PendingRequest::promise() const {
+  return m_promise;
+}
+
+bool HttpsClient::PendingRequest::isCanceled() const {
+  return m_isCanceled->load();
+}
+
+void HttpsClient::PendingRequest::resolve(Response response) const {
+  auto promise = m_promise;
+  auto isCanceled = m_isCanceled;
+
+  m_strand->post([promise, isCanceled, response = std::move(response)]() mutable {
+    if (!isCanceled->load()) {
+      promise.resolve(std::move(response));
+    }
+  });
+}
+
+void HttpsClient::PendingRequest::reject(std::exception_ptr error) const {
+  auto promise = m_promise;
+  auto isCanceled = m_isCanceled;
+
+  m_strand->post([promise, isCanceled, error]() mutable {
+    if (!isCanceled->load()) {
+      promise.reject(error);
+    }
+  });
+}
@@ -20,8 +20,8 @@
 #include "../http_errors.hpp"
 #include <atomic>
 #include <map>
+#include <memory>
 #include <string>
-#include <thread>
 
 #ifdef HTTP_CLIENT_LIBCURL
   #include <curl/curl.h>
@@ -49,7 +49,6 @@ namespace JetBeep {
     map<string, string> queryParams; // TODO implement
     RequestContentType contentType = RequestContentType::JSON;
     int timeout = DEFAULT_TIMEOUT_MS;
-    IOContext ioContext;
   } RequestOptions;
 
   typedef struct {
@@ -58,34 +57,47 @@ namespace JetBeep {
     bool isHttpError;
   } Response;
 
+  // any number of requests can be in flight at once, each one completes through its own promise. Completions are
+  // posted to the strand of the client, so continuations of one client never run concurrently
   class HttpsClient {
   public:
-    Promise<Response> request(RequestOptions& options);
-    HttpsClient();
+    Promise<Response> request(const RequestOptions& options);
+    HttpsClient(IOContext context = IOContext::context);
     ~HttpsClient();
 
   private:
-    Promise<Response> m_pendingRequest;
-    std::thread m_thread;
-    std::atomic<bool> m_isCanceled;
-    std::atomic<bool> m_isPending;
+    // completion side of a single request. It doesn't refer to the client, so a request which finishes after the client
+    // was destroyed is dropped instead of touching freed memory
+    class PendingRequest {
+    public:
+      PendingRequest(std::shared_ptr<IOStrand> strand, std::shared_ptr<std::atomic<bool>> isCanceled);
+
+      Promise<Response> promise() const;
+      bool isCanceled() const;
+      void resolve(Response response) const;
+      void reject(std::exception_ptr error) const;
+
+    private:
+      Promise<Response> m_promise;
+      std::shared_ptr<IOStrand> m_strand;
+      std::shared_ptr<std::atomic<bool>> m_isCanceled;
+    };
+
+    IOContext m_context;
+    std::shared_ptr<IOStrand> m_strand;
+    std::shared_ptr<std::atomic<bool>> m_isCanceled;
     Logger m_log;
-    void doRequest(RequestOptions options);
+
+    PendingRequest makePendingRequest();
 
     static bool isErrorStatusCode(int statusCode) {
       int major = (int)(statusCode / 100);
       return major == 4 || major == 5;
     }
 
-    #ifdef HTTP_CLIENT_LIBCURL
-    CURL* m_curl = nullptr;
-    #endif
-
-    #ifdef HTTP_CLIENT_NSURLSESSION
-    void *m_task;
-    RequestOptions m_options;
-    void reject(std::exception_ptr exception);
-    void resolve(Response response);
+    #if defined(HTTP_CLIENT_WINHTTP) || defined(HTTP_CLIENT_BOOST_BEAST)
+    // a request in flight, it completes through asynchronous callbacks without holding a thread
+    class AsyncRequest;
     #endif
   };
 
@@ -7,13 +7,18 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ssl/error.hpp>
 #include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/ssl.hpp>
 #include <boost/beast/version.hpp>
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace beast = boost::beast;
 namespace http = beast::http;
@@ -24,74 +29,167 @@ using tcp = net::ip::tcp;
 using namespace JetBeep;
 using namespace std;
 
-HttpsClient::HttpsClient() : m_log("https_client") {
-  m_isCanceled.store(false);
-  m_isPending.store(false);
-};
+namespace {
+  typedef beast::ssl_stream<beast::tcp_stream> SslStream;
 
-HttpsClient::~HttpsClient() {
-  m_isCanceled.store(true);
-  if (m_thread.joinable()) {
-    m_thread.join();
-  }
-  m_isPending.store(false);
-}
+  // keep-alive TLS connections shared by all clients of the process, grouped by host:port. The last TLS session of
+  // every host:port is kept too, so a new connection resumes it instead of doing a full handshake
+  class ConnectionPool {
+  public:
+    ConnectionPool() : m_sslContext(ssl::context::tlsv12_client) {
+      // TODO add real verification. Suggestion https://github.com/djarek/certify
+      m_sslContext.set_verify_mode(ssl::verify_none);
+      SSL_CTX_set_session_cache_mode(m_sslContext.native_handle(), SSL_SESS_CACHE_CLIENT);
+    }
 
-Promise<Response> HttpsClient::request(RequestOptions& options) {
-  if (m_isPending.load() == true) {
-    throw runtime_error("previous request is not completed");
-  }
-  m_isCanceled.store(false);
-  m_isPending.store(true);
-  m_pendingRequest = Promise<Response>();
-  m_thread = thread(&HttpsClient::doRequest, this, options);
-  return m_pendingRequest;
-};
+    ~ConnectionPool() {
+      for (auto& session : m_sessions) {
+        SSL_SESSION_free(session.second);
+      }
+    }
 
-void HttpsClient::doRequest(RequestOptions options) {
-  m_thread.detach();
-  try {
-    net::io_context ioc;
-    ssl::context ctx(ssl::context::tlsv12_client);
+    ssl::context& sslContext() {
+      return m_sslContext;
+    }
 
-    m_log.d() << "HTTPS request to: " << options.host << ":" << options.port << options.path << Logger::endl;
+    // a stream runs its handlers on the io context it was created for, so only connections of that context are reused
+    std::unique_ptr<SslStream> acquire(const std::string& key, net::io_context& ioContext) {
+      lock_guard<mutex> guard(m_mutex);
+      auto& idle = m_idle[key];
+      auto now = chrono::steady_clock::now();
 
-    // TODO
-    // This holds the root certificate used for verification
-    // load_root_certificates(ctx);
+      for (auto it = idle.begin(); it != idle.end();) {
+        if (now - it->since >= idleTimeout) {
+          beast::error_code ec;
+          it->stream->next_layer().socket().close(ec);
+          it = idle.erase(it);
+        } else if (it->ioContext == &ioContext) {
+          auto stream = std::move(it->stream);
 
-    // Verify the remote server's certificate
-    ctx.set_verify_mode(ssl::verify_none); // TODO add real verification. Suggestion https://github.com/djarek/certify
+          idle.erase(it);
+          return stream;
+        } else {
+          ++it;
+        }
+      }
+      return nullptr;
+    }
 
-    tcp::resolver resolver(ioc);
-    beast::ssl_stream<beast::tcp_stream> stream(ioc, ctx);
+    void release(const std::string& key, net::io_context& ioContext, std::unique_ptr<SslStream> stream) {
+      lock_guard<mutex> guard(m_mutex);
+      auto& idle = m_idle[key];
 
-    if (options.timeout) {
-      stream.next_layer().expires_after(std::chrono::milliseconds(options.timeout));
+      if (idle.size() >= maxIdlePerHost) {
+        beast::error_code ec;
+        stream->next_layer().socket().close(ec);
+        return;
+      }
+      idle.push_back({std::move(stream), &ioContext, chrono::steady_clock::now()});
     }
 
-    auto closeStream = [&stream]() { stream.next_layer().close(); };
+    void resumeSession(const std::string& key, SSL* ssl) {
+      lock_guard<mutex> guard(m_mutex);
+      auto it = m_sessions.find(key);
 
-    if (!SSL_set_tlsext_host_name(stream.native_handle(), options.host.c_str())) {
-      beast::error_code ec{static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()};
-      throw beast::system_error{ec};
+      if (it != m_sessions.end()) {
+        SSL_set_session(ssl, it->second);
+      }
     }
 
-    auto const results = resolver.resolve(options.host, std::to_string(options.port));
-    if (m_isCanceled.load()) {
-      return;
+    void saveSession(const std::string& key, SSL* ssl) {
+      auto session = SSL_get1_session(ssl);
+
+      if (!session) {
+        return;
+      }
+
+      lock_guard<mutex> guard(m_mutex);
+      auto& saved = m_sessions[key];
+
+      if (saved) {
+        SSL_SESSION_free(saved);
+      }
+      saved = session;
     }
-    beast::get_lowest_layer(stream).connect(results);
-    if (m_isCanceled.load()) {
-      return closeStream();
+
+  private:
+    typedef struct IdleConnection {
+      std::unique_ptr<SslStream> stream;
+      net::io_context* ioContext;
+      chrono::steady_clock::time_point since;
+    } IdleConnection;
+
+    // servers usually drop idle keep-alive connections after a minute, the pool gives them up earlier
+    static constexpr chrono::seconds idleTimeout = chrono::seconds(30);
+    static constexpr size_t maxIdlePerHost = 4;
+
+    std::mutex m_mutex;
+    ssl::context m_sslContext;
+    std::map<std::string, std::vector<IdleConnection>> m_idle;
+    std::map<std::string, SSL_SESSION*> m_sessions;
+  };
+
+  ConnectionPool& connectionPool() {
+    static ConnectionPool pool;
+    return pool;
+  }
+
+  // errors of a pooled connection which was closed by the server while it was idle
+  bool isStaleConnectionError(const beast::error_code& ec) {
+    return ec == http::error::end_of_stream || ec == net::error::eof || ec == net::error::connection_reset ||
+           ec == net::error::broken_pipe || ec == net::ssl::error::stream_truncated;
+  }
+} // namespace
+
+// a single request, run by the handlers of the io context of its client. Every step keeps the request alive until the
+// next one is started, so nothing has to wait for it and any number of requests are in flight at once
+class HttpsClient::AsyncRequest : public std::enable_shared_from_this<HttpsClient::AsyncRequest> {
+public:
+  AsyncRequest(net::io_context& ioContext, const RequestOptions& options, const PendingRequest& pending)
+    : m_ioContext(ioContext),
+      m_strand(net::make_strand(ioContext)),
+      m_resolver(m_strand),
+      m_options(options),
+      m_pending(pending),
+      m_key(options.host + ":" + std::to_string(options.port)),
+      m_isPooled(false),
+      m_log("https_client") {
+  }
+
+  void start() {
+    try {
+      m_log.d() << "HTTPS request to: " << m_options.host << ":" << m_options.port << m_options.path << Logger::endl;
+      prepareRequest();
+    } catch (std::exception const& e) {
+      return fail(e.what());
     }
-    stream.handshake(ssl::stream_base::client);
-    if (m_isCanceled.load()) {
-      return closeStream();
+
+    m_stream = connectionPool().acquire(m_key, m_ioContext);
+    if (m_stream) {
+      m_isPooled = true;
+      write();
+    } else {
+      connect();
     }
+  }
+
+private:
+  net::io_context& m_ioContext;
+  net::strand<net::io_context::executor_type> m_strand;
+  tcp::resolver m_resolver;
+  RequestOptions m_options;
+  PendingRequest m_pending;
+  std::string m_key;
+  bool m_isPooled;
+  Logger m_log;
+  http::request<http::string_body> m_request;
+  std::unique_ptr<SslStream> m_stream;
+  beast::flat_buffer m_buffer;
+  std::unique_ptr<http::response_parser<http::dynamic_body>> m_parser;
 
+  void prepareRequest() {
     http::verb method;
-    switch (options.method) {
+    switch (m_options.method) {
     case RequestMethod::GET:
       method = http::verb::get;
       break;
@@ -105,55 +203,150 @@ void HttpsClient::doRequest(RequestOptions options) {
       throw runtime_error("HTTP method not supported");
     }
 
-    http::request<http::string_body> req{method, options.path, HTTP_VERSION};
-    req.set(http::field::host, options.host);
-    req.set(http::field::user_agent, HTTP_USER_AGENT);
+    m_request = http::request<http::string_body>{method, m_options.path, HTTP_VERSION};
+    m_request.set(http::field::host, m_options.host);
+    m_request.set(http::field::user_agent, HTTP_USER_AGENT);
+    m_request.keep_alive(true);
 
-    if (!options.body.empty()) {
-      switch (options.contentType) {
+    if (!m_options.body.empty()) {
+      switch (m_options.contentType) {
       case RequestContentType::JSON: {
-        req.set(beast::http::field::content_type, "application/json");
+        m_request.set(beast::http::field::content_type, "application/json");
         break;
       }
       default:
         throw runtime_error("Content type not supported");
       }
 
-      req.body() = options.body;
-      req.prepare_payload();
+      m_request.body() = m_options.body;
+      m_request.prepare_payload();
+    }
+  }
+
+  void connect() {
+    auto& pool = connectionPool();
+
+    m_isPooled = false;
+    m_buffer.clear();
+    m_stream.reset(new SslStream(m_strand, pool.sslContext()));
+    if (!SSL_set_tlsext_host_name(m_stream->native_handle(), m_options.host.c_str())) {
+      return fail(beast::error_code{static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()});
     }
+    pool.resumeSession(m_key, m_stream->native_handle());
+
+    m_resolver.async_resolve(m_options.host, std::to_string(m_options.port),
+                             beast::bind_front_handler(&AsyncRequest::onResolved, shared_from_this()));
+  }
+
+  void onResolved(beast::error_code ec, tcp::resolver::results_type results) {
+    if (ec) {
+      return fail(ec);
+    }
+    if (m_pending.isCanceled()) {
+      return;
+    }
+    beast::get_lowest_layer(*m_stream).expires_after(chrono::milliseconds(m_options.timeout));
+    beast::get_lowest_layer(*m_stream).async_connect(
+      results, beast::bind_front_handler(&AsyncRequest::onConnected, shared_from_this()));
+  }
+
+  void onConnected(beast::error_code ec, tcp::endpoint) {
+    if (ec) {
+      return fail(ec);
+    }
+    m_stream->async_handshake(ssl::stream_base::client,
+                              beast::bind_front_handler(&AsyncRequest::onHandshake, shared_from_this()));
+  }
+
+  void onHandshake(beast::error_code ec) {
+    if (ec) {
+      return fail(ec);
+    }
+    m_log.d() << "connected to " << m_key
+              << (SSL_session_reused(m_stream->native_handle()) ? " (TLS session resumed)" : "") << Logger::endl;
+    if (m_pending.isCanceled()) {
+      return;
+    }
+    write();
+  }
 
-    http::write(stream, req);
-    if (m_isCanceled.load()) {
-      return closeStream();
+  // every step of the exchange has its own deadline, also on a pooled connection, so a stalled server or a half-open
+  // keep-alive connection rejects the request with NetworkError (beast::error::timeout) instead of leaving it pending
+  void write() {
+    beast::get_lowest_layer(*m_stream).expires_after(chrono::milliseconds(m_options.timeout));
+    http::async_write(*m_stream, m_request, beast::bind_front_handler(&AsyncRequest::onWritten, shared_from_this()));
+  }
+
+  // a pooled connection which turned out to be closed by the server is replaced if the request can't have been
+  // processed: the write failed, or a GET got no byte of the response at all. A POST or PATCH (a payment, a refund)
+  // may be processed even if the connection drops before the response is read, so it is never sent twice
+  void onWritten(beast::error_code ec, size_t) {
+    if (ec) {
+      if (m_isPooled && isStaleConnectionError(ec)) {
+        return reconnect();
+      }
+      return fail(ec);
     }
 
-    beast::flat_buffer buffer;
+    m_parser.reset(new http::response_parser<http::dynamic_body>());
+    beast::get_lowest_layer(*m_stream).expires_after(chrono::milliseconds(m_options.timeout));
+    http::async_read(*m_stream, m_buffer, *m_parser, beast::bind_front_handler(&AsyncRequest::onRead, shared_from_this()));
+  }
 
-    http::response<http::dynamic_body> res;
+  void onRead(beast::error_code ec, size_t) {
+    if (ec) {
+      auto isNothingRead = !m_parser->got_some() && m_buffer.size() == 0;
 
-    // Receive the HTTP response
-    http::read(stream, buffer, res);
-    closeStream();
+      if (m_isPooled && isStaleConnectionError(ec) && isNothingRead) {
+        if (m_options.method == RequestMethod::GET) {
+          return reconnect();
+        }
+        m_log.e() << "pooled connection to " << m_key << " was closed after the request was sent, not resending it"
+                  << Logger::endl;
+      }
+      return fail(ec);
+    }
+
+    auto res = m_parser->release();
+    auto& pool = connectionPool();
+
+    // session tickets of TLS 1.3 arrive after the handshake, so the session is saved once the response is read
+    pool.saveSession(m_key, m_stream->native_handle());
+    if (res.keep_alive()) {
+      beast::get_lowest_layer(*m_stream).expires_never();
+      pool.release(m_key, m_ioContext, std::move(m_stream));
+    }
 
     Response response;
     response.body = boost::beast::buffers_to_string(res.body().data());
     response.statusCode = res.result_int();
     response.isHttpError = HttpsClient::isErrorStatusCode(response.statusCode);
 
-    m_isPending.store(false);
     m_log.d() << "API response (" << response.statusCode << "): " << response.body << Logger::endl;
 
-    options.ioContext.m_impl->ioService.post([this, response]{
-      m_pendingRequest.resolve(response); 
-    });
+    m_pending.resolve(std::move(response));
+  }
+
+  void reconnect() {
+    m_log.d() << "pooled connection to " << m_key << " was closed by the server, reconnecting" << Logger::endl;
+    connect();
+  }
+
+  void fail(const beast::error_code& ec) {
+    fail(ec.message());
+  }
 
-  } catch (std::exception const& e) {
-    m_log.e() << e.what() << Logger::endl;
-    options.ioContext.m_impl->ioService.post([this]{
-      m_pendingRequest.reject(make_exception_ptr(HttpErrors::NetworkError()));
-    });
+  void fail(const std::string& message) {
+    m_log.e() << message << Logger::endl;
+    m_pending.reject(make_exception_ptr(HttpErrors::NetworkError()));
   }
+};
+
+Promise<Response> HttpsClient::request(const RequestOptions& options) {
+  auto pending = makePendingRequest();
+
+  make_shared<AsyncRequest>(m_context.m_impl->ioService, options, pending)->start();
+  return pending.promise();
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -2,116 +2,291 @@
 
 #ifdef HTTP_CLIENT_LIBCURL
 
-#include "../../io/iocontext_impl.hpp"
+#include <condition_variable>
 #include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 using namespace JetBeep;
 using namespace std;
 
 typedef size_t(*CURL_WRITEFUNCTION_PTR)(void*, size_t, size_t,  std::string*);
 
-static bool isCurlInited = false;
+namespace {
+  // connection cache, TLS sessions and DNS entries shared by all clients of the process: a request to a host:port
+  // reuses an idle keep-alive connection of any client and a reconnect resumes the TLS session instead of doing a
+  // full handshake
+  class CurlShare {
+  public:
+    CurlShare() {
+      curl_global_init(CURL_GLOBAL_DEFAULT);
+      m_share = curl_share_init();
+      if (!m_share) {
+        return;
+      }
+      curl_share_setopt(m_share, CURLSHOPT_LOCKFUNC, &CurlShare::lock);
+      curl_share_setopt(m_share, CURLSHOPT_UNLOCKFUNC, &CurlShare::unlock);
+      curl_share_setopt(m_share, CURLSHOPT_USERDATA, this);
+      curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+      curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900 // 7.57.0
+      curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+    }
 
-HttpsClient::HttpsClient() : m_log("https_client") {
-  m_isCanceled.store(false);
-  m_isPending.store(false);
-  if (!isCurlInited) {
-    curl_global_init(CURL_GLOBAL_DEFAULT);
-    m_curl = curl_easy_init();
-    if (!m_curl) {
-      throw runtime_error("Unable to initializa curl");
+    ~CurlShare() {
+      if (m_share) {
+        curl_share_cleanup(m_share);
+      }
     }
-    isCurlInited = true;
-  }
-};
 
-HttpsClient::~HttpsClient() {
-  m_isCanceled.store(true);
-  if (m_thread.joinable()) {
-    m_thread.join();
-  }
-  m_isPending.store(false);
-  curl_easy_cleanup(m_curl);
-}
+    CURLSH* handle() {
+      return m_share;
+    }
+
+  private:
+    CURLSH* m_share;
+    std::mutex m_mutexes[CURL_LOCK_DATA_LAST];
+
+    static void lock(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+      static_cast<CurlShare*>(userptr)->m_mutexes[data].lock();
+    }
 
-Promise<Response> HttpsClient::request(RequestOptions& options) {
-  if (m_isPending.load() == true) {
-    throw runtime_error("previous request is not completed");
+    static void unlock(CURL*, curl_lock_data data, void* userptr) {
+      static_cast<CurlShare*>(userptr)->m_mutexes[data].unlock();
+    }
+  };
+
+  CurlShare& curlShare() {
+    static CurlShare share;
+    return share;
   }
-  m_isCanceled.store(false);
-  m_isPending.store(true);
-  m_pendingRequest = Promise<Response>();
-  if (m_thread.joinable()) {
-    m_thread.join();
+
+  typedef struct CurlTransfer {
+    CURL* easy = nullptr;
+    struct curl_slist* headers = nullptr;
+    char errorBuffer[CURL_ERROR_SIZE] = {};
+    std::string url;
+    std::string userAgent;
+    std::string receiveBuffer;
+    std::shared_ptr<std::atomic<bool>> isCanceled;
+    std::function<void(CurlTransfer& transfer, CURLcode result)> onCompleted;
+
+    ~CurlTransfer() {
+      if (easy) {
+        curl_easy_cleanup(easy);
+      }
+      curl_slist_free_all(headers);
+    }
+  } CurlTransfer;
+
+  // one multi handle drives the transfers of all clients from a single thread, so requests don't need a thread each
+  // and any number of them run concurrently. Transfers of destroyed clients are dropped
+  class CurlMulti {
+  public:
+    CurlMulti() : m_isStopped(false) {
+      curlShare();
+      m_multi = curl_multi_init();
+      if (!m_multi) {
+        throw runtime_error("Unable to initialize curl multi handle");
+      }
+      m_thread = std::thread(&CurlMulti::run, this);
+    }
+
+    ~CurlMulti() {
+      {
+        lock_guard<mutex> guard(m_mutex);
+        m_isStopped = true;
+      }
+      wakeup();
+      m_thread.join();
+      for (auto& transfer : m_running) {
+        curl_multi_remove_handle(m_multi, transfer.first);
+      }
+      m_running.clear();
+      curl_multi_cleanup(m_multi);
+    }
+
+    void add(std::unique_ptr<CurlTransfer> transfer) {
+      {
+        lock_guard<mutex> guard(m_mutex);
+        m_queued.push_back(std::move(transfer));
+      }
+      wakeup();
+    }
+
+  private:
+    // poll timeout while transfers are running, it bounds how late cancellation is noticed
+    static constexpr int pollTimeoutMs = 100;
+    // curl_multi_wakeup is not available, so new transfers are picked up on this period
+    static constexpr int fallbackPollTimeoutMs = 10;
+
+    CURLM* m_multi;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_isStopped;
+    std::vector<std::unique_ptr<CurlTransfer>> m_queued;
+    // accessed by the multi thread only
+    std::map<CURL*, std::unique_ptr<CurlTransfer>> m_running;
+
+    void wakeup() {
+      m_condition.notify_one();
+#if LIBCURL_VERSION_NUM >= 0x074400 // 7.68.0
+      curl_multi_wakeup(m_multi);
+#endif
+    }
+
+    void run() {
+      for (;;) {
+        {
+          unique_lock<mutex> lock(m_mutex);
+
+          // nothing to poll, sleep until a transfer is added
+          m_condition.wait(lock, [this] { return m_isStopped || !m_queued.empty() || !m_running.empty(); });
+          if (m_isStopped) {
+            return;
+          }
+          for (auto& transfer : m_queued) {
+            auto easy = transfer->easy;
+
+            curl_multi_add_handle(m_multi, easy);
+            m_running[easy] = std::move(transfer);
+          }
+          m_queued.clear();
+        }
+
+        for (auto it = m_running.begin(); it != m_running.end();) {
+          if (it->second->isCanceled->load()) {
+            curl_multi_remove_handle(m_multi, it->first);
+            it = m_running.erase(it);
+          } else {
+            ++it;
+          }
+        }
+
+        int runningCount = 0;
+        curl_multi_perform(m_multi, &runningCount);
+
+        CURLMsg* message;
+        int messagesLeft = 0;
+        while ((message = curl_multi_info_read(m_multi, &messagesLeft))) {
+          if (message->msg != CURLMSG_DONE) {
+            continue;
+          }
+
+          auto easy = message->easy_handle;
+          auto result = message->data.result;
+          auto it = m_running.find(easy);
+
+          curl_multi_remove_handle(m_multi, easy);
+          if (it == m_running.end()) {
+            continue;
+          }
+          auto transfer = std::move(it->second);
+          m_running.erase(it);
+          transfer->onCompleted(*transfer, result);
+        }
+
+        if (m_running.empty()) {
+          continue;
+        }
+#if LIBCURL_VERSION_NUM >= 0x074400 // 7.68.0
+        curl_multi_poll(m_multi, nullptr, 0, pollTimeoutMs, nullptr);
+#else
+        curl_multi_wait(m_multi, nullptr, 0, fallbackPollTimeoutMs, nullptr);
+#endif
+      }
+    }
+  };
+
+  CurlMulti& curlMulti() {
+    static CurlMulti multi;
+    return multi;
   }
-  m_thread = thread(&HttpsClient::doRequest, this, options);
-  return m_pendingRequest;
-};
-
-void HttpsClient::doRequest(RequestOptions options) {
-  char errorBuffer[CURL_ERROR_SIZE];
-  std::string receiveBuffer;
-  
+} // namespace
+
+Promise<Response> HttpsClient::request(const RequestOptions& options) {
+  auto pending = makePendingRequest();
+  auto transfer = std::unique_ptr<CurlTransfer>(new CurlTransfer());
+  auto log = m_log;
+
   try {
     /*CURLcode*/ int code;
-    CURLcode res;
-
-    struct curl_slist *headersList = nullptr;
 
     auto onDataReceived = [](void* ptr, size_t size, size_t nmemb, std::string* data) -> size_t {
       data->append(static_cast<char*>(ptr), size * nmemb);
       return size * nmemb;
     };
 
-    code = curl_easy_setopt(m_curl, CURLOPT_ERRORBUFFER, errorBuffer);
+    transfer->isCanceled = m_isCanceled;
+    // curl_global_init is not thread-safe, it must run before the first handle instead of lazily inside curl_easy_init
+    auto share = curlShare().handle();
+    transfer->easy = curl_easy_init();
+    if (!transfer->easy) {
+      throw runtime_error("Unable to initializa curl");
+    }
+
+    CURL* curl = transfer->easy;
+    code = curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, transfer->errorBuffer);
     if (code != CURLE_OK) {
       throw runtime_error("Failed to set error buffer");
     }
-    string url = "https://" + options.host + options.path;
-    code += curl_easy_setopt(m_curl, CURLOPT_URL, url.c_str());
-    code += curl_easy_setopt(m_curl, CURLOPT_PORT, options.port);
-    code += curl_easy_setopt(m_curl, CURLOPT_CONNECTTIMEOUT_MS, options.timeout);
+    transfer->url = "https://" + options.host + options.path;
+    code += curl_easy_setopt(curl, CURLOPT_URL, transfer->url.c_str());
+    code += curl_easy_setopt(curl, CURLOPT_PORT, options.port);
+    code += curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, options.timeout);
+    // the whole transfer is bounded too, a server stalled after connecting would keep it in the multi handle forever
+    code += curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, static_cast<long>(options.timeout));
+    code += curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
 
-    code += curl_easy_setopt(m_curl, CURLOPT_CUSTOMREQUEST, NULL); //reseting
+    if (share) {
+      code += curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    }
+    // idle pooled connections are kept open through NAT and firewalls
+    code += curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
 
-    string uaStr = HTTP_USER_AGENT;
-    code += curl_easy_setopt(m_curl, CURLOPT_USERAGENT, uaStr.c_str());
+    transfer->userAgent = HTTP_USER_AGENT;
+    code += curl_easy_setopt(curl, CURLOPT_USERAGENT, transfer->userAgent.c_str());
 
-    m_log.d() << "https request to " << url << " " + (options.method == RequestMethod::GET ? string("(GET)") : string("(POST)")) << Logger::endl;
+    m_log.d() << "https request to " << transfer->url << " " + (options.method == RequestMethod::GET ? string("(GET)") : string("(POST)")) << Logger::endl;
     
     if (!options.body.empty()) {
       switch (options.contentType) {
       case RequestContentType::JSON: {
-        headersList = curl_slist_append(headersList, "Content-Type: application/json");
-        headersList = curl_slist_append(headersList, "Accept: application/json");
+        transfer->headers = curl_slist_append(transfer->headers, "Content-Type: application/json");
+        transfer->headers = curl_slist_append(transfer->headers, "Accept: application/json");
         break;
       }
       default:
         throw runtime_error("Content type not supported");
       }
       
-      curl_easy_setopt(m_curl, CURLOPT_HTTPHEADER, headersList);
+      curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer->headers);
 
       m_log.d() << "---- request data -----" << Logger::endl;
       m_log.d() << options.body << Logger::endl << Logger::endl;
       
-      code += curl_easy_setopt(m_curl, CURLOPT_POSTFIELDSIZE, options.body.size());
-      //code += curl_easy_setopt(m_curl, CURLOPT_POSTFIELDS, options.body.c_str());
-      code += curl_easy_setopt(m_curl, CURLOPT_COPYPOSTFIELDS, options.body.c_str());
+      code += curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, options.body.size());
+      code += curl_easy_setopt(curl, CURLOPT_COPYPOSTFIELDS, options.body.c_str());
     }
     
     switch (options.method) {
     case RequestMethod::GET:
-      //code += curl_easy_setopt(m_curl, CURLOPT_HTTPGET, 1L);
-      code +=  curl_easy_setopt(m_curl, CURLOPT_CUSTOMREQUEST, "GET"); //used to hack: GET + body
+      //code += curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+      code +=  curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "GET"); //used to hack: GET + body
       break;
     case RequestMethod::POST:
-      code += curl_easy_setopt(m_curl, CURLOPT_POST, 1L);
+      code += curl_easy_setopt(curl, CURLOPT_POST, 1L);
       break;
     case RequestMethod::PATCH:
-      code +=  curl_easy_setopt(m_curl, CURLOPT_CUSTOMREQUEST, "PATCH");
+      code +=  curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PATCH");
       break;
     default:
       throw runtime_error("HTTP method not supported");
@@ -121,13 +296,13 @@ void HttpsClient::doRequest(RequestOptions options) {
       throw runtime_error("Unable to curl_easy_setopt for some options");
     }
 
-    code = curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, static_cast<CURL_WRITEFUNCTION_PTR>(onDataReceived));
+    code = curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, static_cast<CURL_WRITEFUNCTION_PTR>(onDataReceived));
     if (code != CURLE_OK) {
       throw runtime_error("Failed to set error buffer");
     }
 
     // set pointer which will be 4th param in writer func
-    code = curl_easy_setopt(m_curl, CURLOPT_WRITEDATA, &receiveBuffer);
+    code = curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer->receiveBuffer);
     if (code != CURLE_OK) {
       throw runtime_error("Failed to set error buffer");
     }
@@ -139,34 +314,34 @@ void HttpsClient::doRequest(RequestOptions options) {
 #ifdef SKIP_HOSTNAME_VERIFICATION
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
 #endif
-    
-    /* Perform the request */
-    res = curl_easy_perform(m_curl);
-    if (res != CURLE_OK) {
-      throw runtime_error(string(errorBuffer));
+  } catch (std::exception const& e) {
+    m_log.e() << e.what() << Logger::endl;
+    pending.reject(make_exception_ptr(HttpErrors::NetworkError()));
+    return pending.promise();
+  }
+
+  // executed on the thread of the multi handle
+  transfer->onCompleted = [pending, log](CurlTransfer& transfer, CURLcode result) mutable {
+    if (result != CURLE_OK) {
+      log.e() << (transfer.errorBuffer[0] ? transfer.errorBuffer : curl_easy_strerror(result)) << Logger::endl;
+      pending.reject(make_exception_ptr(HttpErrors::NetworkError()));
+      return;
     }
 
     long statusCode;
-    curl_easy_getinfo(m_curl, CURLINFO_RESPONSE_CODE, &statusCode);
+    curl_easy_getinfo(transfer.easy, CURLINFO_RESPONSE_CODE, &statusCode);
 
     Response response;
-    response.body = receiveBuffer;
+    response.body = std::move(transfer.receiveBuffer);
     response.statusCode = statusCode;
     response.isHttpError = HttpsClient::isErrorStatusCode(response.statusCode);
 
-    m_isPending.store(false);
+    log.d() << "API response (" << response.statusCode << "): " << response.body << Logger::endl;
+    pending.resolve(std::move(response));
+  };
 
-    m_log.d() << "API response (" << response.statusCode << "): " << response.body << Logger::endl;
-
-    options.ioContext.m_impl->ioService.post([this, response]{
-      m_pendingRequest.resolve(response); 
-    });
-  } catch (std::exception const& e) {
-    m_log.e() << e.what() << Logger::endl;
-    options.ioContext.m_impl->ioService.post([this]{
-      m_pendingRequest.reject(make_exception_ptr(HttpErrors::NetworkError()));
-    });
-  }
+  curlMulti().add(std::move(transfer));
+  return pending.promise();
 }
 
-#endif
\ No newline at end of file
+#endif
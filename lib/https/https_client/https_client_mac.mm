@@ -7,33 +7,8 @@
 using namespace JetBeep;
 using namespace std;
 
-HttpsClient::HttpsClient() : m_log("https_client"), m_task(nullptr) {
-  m_isCanceled.store(false);
-  m_isPending.store(false);
-};
-
-HttpsClient::~HttpsClient() {
-  m_isCanceled.store(true);
-  m_isPending.store(false);
-
-  NSURLSessionDataTask* oldTask = (NSURLSessionDataTask*)m_task;
-  if (oldTask != nullptr) {
-    [oldTask cancel];
-    [oldTask release];
-  }
-}
-
-Promise<Response> HttpsClient::request(RequestOptions& options) {
-  if (m_isPending.load() == true) {
-    throw runtime_error("previous request is not completed");
-  }
-  m_pendingRequest = Promise<Response>();
-  m_options = options;
-  NSURLSessionDataTask* oldTask = (NSURLSessionDataTask*)m_task;
-  if (oldTask != nullptr) {
-    [oldTask release];
-    m_task = nullptr;
-  }  
+Promise<Response> HttpsClient::request(const RequestOptions& options) {
+  auto pending = makePendingRequest();
 
   @autoreleasepool {
     NSURLComponents *components = [[[NSURLComponents alloc] init] autorelease];    
@@ -88,14 +63,17 @@ Promise<Response> HttpsClient::request(RequestOptions& options) {
 
     NSURLSession* session = [NSURLSession sharedSession];    
     NSURLSessionDataTask* task = [session dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
-      if (m_isCanceled.load() == true) {
+      if (pending.isCanceled()) {
         return;
       }
       @autoreleasepool {
         if (error) {
           const char* errorString = [[error localizedDescription] UTF8String];
-          m_log.e() << errorString << Logger::endl;
-          this->reject(make_exception_ptr(HttpErrors::NetworkError()));
+          // captured C++ objects are const inside the block, so it has a logger of its own
+          Logger log("https_client");
+
+          log.e() << errorString << Logger::endl;
+          pending.reject(make_exception_ptr(HttpErrors::NetworkError()));
           return;
         }
 
@@ -106,28 +84,13 @@ Promise<Response> HttpsClient::request(RequestOptions& options) {
         response.body = string([dataString UTF8String]);
         response.statusCode = [httpResponse statusCode];
         response.isHttpError = HttpsClient::isErrorStatusCode(response.statusCode);
-        this->resolve(response);
+        pending.resolve(response);
       }
     }];
-    m_task = [task retain];
-
     [task resume];
   }
 
-  
-  return m_pendingRequest;
-}
-
-void HttpsClient::reject(std::exception_ptr exception) {
-  m_options.ioContext.m_impl->ioService.post([this, exception] {
-     m_pendingRequest.reject(exception);
-  });
-}
-
-void HttpsClient::resolve(Response response) {
-  m_options.ioContext.m_impl->ioService.post([this, response] {
-     m_pendingRequest.resolve(response);
-  });
+  return pending.promise();
 }
 
 #endif
\ No newline at end of file
@@ -1,7 +1,6 @@
 #include "./https_client.hpp"
 
 #ifdef HTTP_CLIENT_WINHTTP
-#include "../../io/iocontext_impl.hpp"
 
 #include <windows.h>
 #include <winhttp.h>
@@ -18,70 +17,106 @@
 using namespace JetBeep;
 using namespace std;
 
-HttpsClient::HttpsClient() : m_log("https_client") {
-  m_isCanceled.store(false);
-  m_isPending.store(false);
-};
+namespace {
+  // WinHTTP keeps idle keep-alive connections (and TLS sessions) in a pool owned by the session handle, so a single
+  // session is shared by all clients of the process instead of opening and closing one per request. It is opened in
+  // asynchronous mode, requests complete on the threads of WinHTTP and none of them blocks a thread
+  class WinHttpSession {
+  public:
+    WinHttpSession() {
+      string uaStr = HTTP_USER_AGENT;
+      std::wstring stemp = std::wstring(uaStr.begin(), uaStr.end()); // only ASCII or ISO-8859-1
+
+      m_handle = WinHttpOpen(stemp.c_str(), WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY, WINHTTP_NO_PROXY_NAME,
+                             WINHTTP_NO_PROXY_BYPASS, WINHTTP_FLAG_ASYNC);
+    }
 
-HttpsClient::~HttpsClient() {
-  m_isCanceled.store(true);
-  if (m_thread.joinable()) {
-    m_thread.join();
-  }
-  m_isPending.store(false);
-}
+    ~WinHttpSession() {
+      if (m_handle) {
+        WinHttpCloseHandle(m_handle);
+      }
+    }
+
+    HINTERNET handle() const {
+      return m_handle;
+    }
 
-Promise<Response> HttpsClient::request(RequestOptions& options) {
-  if (m_isPending.load() == true) {
-    throw runtime_error("previous request is not completed");
+  private:
+    HINTERNET m_handle;
+  };
+
+  HINTERNET sharedSession() {
+    static WinHttpSession session;
+    return session.handle();
   }
-  m_isCanceled.store(false);
-  m_isPending.store(true);
-  m_pendingRequest = Promise<Response>();
-  if (m_thread.joinable()) {
-    m_thread.join();
+} // namespace
+
+// a single request, driven by the status callback of WinHTTP. It owns itself: once its request handle is closed it is
+// deleted from the last callback, so any number of requests are in flight at once
+class HttpsClient::AsyncRequest {
+public:
+  AsyncRequest(const RequestOptions& options, const PendingRequest& pending)
+    : m_options(options), m_pending(pending), m_log("https_client"), m_connect(nullptr), m_request(nullptr) {
   }
-  m_thread = thread(&HttpsClient::doRequest, this, options);
-  return m_pendingRequest;
-};
 
-void HttpsClient::doRequest(RequestOptions options) {
-  try {
-    /* */
-    DWORD dwSize = 0;
-    BOOL bResults = false;
-    HINTERNET hSession = nullptr, hConnect = nullptr, hRequest = nullptr;
-    auto handleSystemErrors = []() {
-      DWORD dw = GetLastError();
-      throw runtime_error("winHTTP error code: " + std::to_string(dw)); // WINHTTP_ERROR_BASE + code
-    };
+  ~AsyncRequest() {
+    if (m_connect) {
+      WinHttpCloseHandle(m_connect);
+    }
+  }
 
-    // Use WinHttpOpen to obtain a session handle.
-    string uaStr = HTTP_USER_AGENT;
-    std::wstring stemp = std::wstring(uaStr.begin(), uaStr.end()); // only ASCII or ISO-8859-1
-    LPCWSTR swUAStr = stemp.c_str();
-    hSession = WinHttpOpen(swUAStr, WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+  // takes the ownership of the request, it is deleted when the request completes
+  void start() {
+    try {
+      openRequest();
+    } catch (std::exception const& e) {
+      m_log.e() << e.what() << Logger::endl;
+      m_pending.reject(make_exception_ptr(HttpErrors::NetworkError()));
+      if (m_request) {
+        WinHttpCloseHandle(m_request);
+      }
+      delete this;
+      return;
+    }
 
-    if (!hSession) {
-      handleSystemErrors();
+    // from now on the request completes in the callbacks, also when it fails right away
+    LPVOID requestPayload = m_options.body.length() ? (LPVOID)m_options.body.c_str() : WINHTTP_NO_REQUEST_DATA;
+    if (!WinHttpSendRequest(m_request, WINHTTP_NO_ADDITIONAL_HEADERS, 0, requestPayload, (DWORD)m_options.body.length(),
+                            (DWORD)m_options.body.length(), (DWORD_PTR)this)) {
+      fail(GetLastError());
     }
+  }
 
-    DWORD timeout = (DWORD)options.timeout;
+private:
+  RequestOptions m_options;
+  PendingRequest m_pending;
+  Logger m_log;
+  HINTERNET m_connect;
+  HINTERNET m_request;
+  bool m_isClosing = false;
+  DWORD m_statusCode = 0;
+  string m_chunk;
+  string m_body;
+
+  void openRequest() {
+    auto throwSystemError = []() {
+      throw runtime_error("winHTTP error code: " + std::to_string(GetLastError())); // WINHTTP_ERROR_BASE + code
+    };
+    HINTERNET hSession = sharedSession();
 
-    bResults = WinHttpSetOption(hSession, WINHTTP_OPTION_CONNECT_TIMEOUT, &timeout, sizeof(DWORD));
-    if (!bResults) {
-      handleSystemErrors();
+    if (!hSession) {
+      throwSystemError();
     }
 
-    std::wstring hostWStr = std::wstring(options.host.begin(), options.host.end());
-    hConnect = WinHttpConnect(hSession, hostWStr.c_str(), options.port, 0);
-    if (!hConnect) {
-      handleSystemErrors();
+    std::wstring hostWStr = std::wstring(m_options.host.begin(), m_options.host.end());
+    m_connect = WinHttpConnect(hSession, hostWStr.c_str(), m_options.port, 0);
+    if (!m_connect) {
+      throwSystemError();
     }
 
     // Create an HTTP request handle.
     std::wstring method;
-    switch (options.method) {
+    switch (m_options.method) {
     case RequestMethod::GET:
       method = L"GET";
       break;
@@ -96,102 +131,138 @@ void HttpsClient::doRequest(RequestOptions options) {
     }
     std::wstring wsJsonMIME = L"application/json";
     LPCWSTR acceptTypes[] = {wsJsonMIME.c_str(), NULL};
-    std::wstring wsPath = std::wstring(options.path.begin(), options.path.end());
-    hRequest = WinHttpOpenRequest(hConnect, method.c_str(), wsPath.c_str(), L"HTTP/1.1", WINHTTP_NO_REFERER,
-                                  acceptTypes, WINHTTP_FLAG_REFRESH | WINHTTP_FLAG_SECURE);
-    if (!hRequest) {
-      handleSystemErrors();
+    std::wstring wsPath = std::wstring(m_options.path.begin(), m_options.path.end());
+    m_request = WinHttpOpenRequest(m_connect, method.c_str(), wsPath.c_str(), L"HTTP/1.1", WINHTTP_NO_REFERER,
+                                   acceptTypes, WINHTTP_FLAG_REFRESH | WINHTTP_FLAG_SECURE);
+    if (!m_request) {
+      throwSystemError();
+    }
+
+    // the session is shared, so the timeouts are set for the request only. Sending and each receive are bounded as
+    // well, a request stalled after connecting fails with ERROR_WINHTTP_TIMEOUT instead of never completing
+    int timeout = m_options.timeout;
+
+    if (!WinHttpSetTimeouts(m_request, timeout, timeout, timeout, timeout)) {
+      throwSystemError();
     }
 
     // add headers
-    bResults = WinHttpAddRequestHeaders(hRequest, L"Content-Type: application/json\r\n", (ULONG)-1L, WINHTTP_ADDREQ_FLAG_ADD);
-    if (!bResults) {
-      handleSystemErrors();
+    if (!WinHttpAddRequestHeaders(m_request, L"Content-Type: application/json\r\n", (ULONG)-1L, WINHTTP_ADDREQ_FLAG_ADD)) {
+      throwSystemError();
     }
 
     std::wstring contentLengthHeader = L"Content-Length: ";
-    contentLengthHeader += std::to_wstring(options.body.length()); // last header without CR/LF
-
-    bResults = WinHttpAddRequestHeaders(hRequest, contentLengthHeader.c_str(), (ULONG)-1L, WINHTTP_ADDREQ_FLAG_REPLACE);
-    if (!bResults) {
-      handleSystemErrors();
-    }
-
-    // Send a request.
-    LPVOID requestPayload = options.body.length() ? (LPVOID)options.body.c_str() : WINHTTP_NO_REQUEST_DATA;
-    bResults = WinHttpSendRequest(hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0, requestPayload, options.body.length(),
-                                  WINHTTP_IGNORE_REQUEST_TOTAL_LENGTH, 0);
-    if (!bResults) {
-      handleSystemErrors();
-    }
-
-    // End the request.
-    bResults = WinHttpReceiveResponse(hRequest, NULL);
-    if (!bResults) {
-      handleSystemErrors();
-    } 
-
-    // Keep checking for data until there is nothing left.
-    stringstream result;
-    do {
-      // Check for available data.
-      dwSize = 0;
-      if (!WinHttpQueryDataAvailable(hRequest, &dwSize)) {
-        m_log.e() << "WinHttpQueryDataAvailable error" << Logger::endl;
-        handleSystemErrors();
-      }
-
-      if (dwSize <= 0) {
-        break;
-      }
+    contentLengthHeader += std::to_wstring(m_options.body.length()); // last header without CR/LF
 
-      string receiveData = string();
-      receiveData.resize(dwSize);
+    if (!WinHttpAddRequestHeaders(m_request, contentLengthHeader.c_str(), (ULONG)-1L, WINHTTP_ADDREQ_FLAG_REPLACE)) {
+      throwSystemError();
+    }
 
-      auto cBuf = receiveData.c_str();
+    // the context reaches the callbacks also when sending fails right away and only the handle is closed
+    DWORD_PTR context = (DWORD_PTR)this;
+    if (!WinHttpSetOption(m_request, WINHTTP_OPTION_CONTEXT_VALUE, &context, sizeof(context))) {
+      throwSystemError();
+    }
 
-      DWORD bytesRecvd = 0;
+    auto callbackFlags = WINHTTP_CALLBACK_FLAG_ALL_COMPLETIONS | WINHTTP_CALLBACK_FLAG_HANDLES;
+    if (WinHttpSetStatusCallback(m_request, &AsyncRequest::onStatus, callbackFlags, 0) == WINHTTP_INVALID_STATUS_CALLBACK) {
+      throwSystemError();
+    }
+  }
 
-      if (!WinHttpReadData(hRequest, (LPVOID)cBuf, dwSize, &bytesRecvd)) {
-        m_log.e() << "WinHttpReadData error" << Logger::endl;
-        handleSystemErrors();
-      }
-      result << receiveData;
+  // WinHTTP calls it for one request at a time. A call which starts the next step may complete it (and even delete
+  // the request) before it returns, so the request is not touched after starting a step successfully
+  static void CALLBACK onStatus(HINTERNET handle, DWORD_PTR context, DWORD status, LPVOID info, DWORD infoLength) {
+    auto request = reinterpret_cast<AsyncRequest*>(context);
 
-    } while (dwSize > 0 && !m_isCanceled.load());
+    if (!request) {
+      return;
+    }
+    if (status == WINHTTP_CALLBACK_STATUS_HANDLE_CLOSING) {
+      delete request;
+      return;
+    }
+    if (request->m_isClosing) {
+      return;
+    }
+    if (request->m_pending.isCanceled()) {
+      request->close();
+      return;
+    }
 
-    DWORD dwStatusCode = 0;
-    DWORD dwStatusCodeSize = sizeof(dwStatusCode);
+    switch (status) {
+    case WINHTTP_CALLBACK_STATUS_SENDREQUEST_COMPLETE:
+      if (!WinHttpReceiveResponse(handle, NULL)) {
+        request->fail(GetLastError());
+      }
+      break;
+    case WINHTTP_CALLBACK_STATUS_HEADERS_AVAILABLE: {
+      DWORD statusCodeSize = sizeof(request->m_statusCode);
 
-    WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX,
-                        &dwStatusCode, &dwStatusCodeSize, WINHTTP_NO_HEADER_INDEX);
+      WinHttpQueryHeaders(handle, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX,
+                          &request->m_statusCode, &statusCodeSize, WINHTTP_NO_HEADER_INDEX);
+      request->queryData();
+      break;
+    }
+    case WINHTTP_CALLBACK_STATUS_DATA_AVAILABLE: {
+      auto size = *static_cast<LPDWORD>(info);
 
-    // Close any open handles.
-    if (hRequest) {
-      WinHttpCloseHandle(hRequest);
+      if (size == 0) {
+        request->complete();
+        break;
+      }
+      request->m_chunk.resize(size);
+      if (!WinHttpReadData(handle, &request->m_chunk[0], size, NULL)) {
+        request->fail(GetLastError());
+      }
+      break;
     }
-    if (hConnect) {
-      WinHttpCloseHandle(hConnect);
+    case WINHTTP_CALLBACK_STATUS_READ_COMPLETE:
+      request->m_body.append(static_cast<const char*>(info), infoLength);
+      request->queryData();
+      break;
+    case WINHTTP_CALLBACK_STATUS_REQUEST_ERROR:
+      request->fail(static_cast<WINHTTP_ASYNC_RESULT*>(info)->dwError);
+      break;
     }
-    if (hSession) {
-      WinHttpCloseHandle(hSession);
+  }
+
+  void queryData() {
+    if (!WinHttpQueryDataAvailable(m_request, NULL)) {
+      fail(GetLastError());
     }
+  }
 
+  void complete() {
     Response response;
-    response.body = result.str();
-    response.statusCode = dwStatusCode;
+    response.body = std::move(m_body);
+    response.statusCode = m_statusCode;
     response.isHttpError = HttpsClient::isErrorStatusCode(response.statusCode);
 
-    m_isPending.store(false);
-
     m_log.d() << "API response (" << response.statusCode << "): " << response.body << Logger::endl;
 
-    options.ioContext.m_impl->ioService.post([this, response] { m_pendingRequest.resolve(response); });
-  } catch (std::exception const& e) {
-    m_log.e() << e.what() << Logger::endl;
-    options.ioContext.m_impl->ioService.post(
-      [this] { m_pendingRequest.reject(make_exception_ptr(HttpErrors::NetworkError())); });
+    m_pending.resolve(std::move(response));
+    close();
+  }
+
+  void fail(DWORD error) {
+    m_log.e() << "winHTTP error code: " << error << Logger::endl; // WINHTTP_ERROR_BASE + code
+    m_pending.reject(make_exception_ptr(HttpErrors::NetworkError()));
+    close();
+  }
+
+  // the connection itself stays in the pool of the shared session. The request is deleted once the handle is closed
+  void close() {
+    m_isClosing = true;
+    WinHttpCloseHandle(m_request);
   }
+};
+
+Promise<Response> HttpsClient::request(const RequestOptions& options) {
+  auto pending = makePendingRequest();
+
+  (new AsyncRequest(options, pending))->start();
+  return pending.promise();
 }
 
-#endif
\ No newline at end of file
+#endif
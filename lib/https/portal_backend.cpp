@@ -16,7 +16,7 @@ using namespace std;
 class PortalBackend::Impl {
 public:
   Impl(string serverHost, IOContext context, int port = 443)
-    : m_serverHost(serverHost), m_port(port), m_log("portal"), m_context(context){};
+    : m_serverHost(serverHost), m_port(port), m_log("portal"), m_context(context), m_httpsClient(context){};
 
   ~Impl();
 
@@ -56,7 +56,6 @@ RequestOptions PortalBackend::Impl::getRequestOptions(string path, RequestMethod
   options.host = m_serverHost;
   options.port = m_port;
   options.path = path;
-  options.ioContext = m_context;
   return options;
 }
 
@@ -65,7 +64,7 @@ Promise<DeviceConfigResponse> PortalBackend::Impl::getDeviceConfig(DeviceConfigR
 
   auto options = getRequestOptions(path, RequestMethod::GET);
 
-  return m_httpsClient.request(options).thenPromise<DeviceConfigResponse, Promise>([&](Response res) {
+  return m_httpsClient.request(options).thenPromise<DeviceConfigResponse, Promise>([&](const Response& res) {
     auto promise = Promise<DeviceConfigResponse>();
     if (res.statusCode == 404) {
       promise.reject(make_exception_ptr(HttpErrors::RequestError("Server response: device not found")));
@@ -80,7 +79,7 @@ Promise<DeviceConfigResponse> PortalBackend::Impl::getDeviceConfig(DeviceConfigR
       result.config = parseDeviceConfigResult(res.body);
       result._rawResponse = res.body;
       result.statusCode = res.statusCode;
-      promise.resolve(result);
+      promise.resolve(std::move(result));
     } catch (...) {
       promise.reject(make_exception_ptr(HttpErrors::APIError()));
     }
@@ -94,7 +93,7 @@ Promise<void> PortalBackend::Impl::updateDeviceConfig(DeviceConfigUpdateRequest
   auto options = getRequestOptions(path, RequestMethod::PATCH);
   options.body = deviceConfigUpdateToJSON(requestData);
 
-  return m_httpsClient.request(options).thenPromise([&](Response res) {
+  return m_httpsClient.request(options).thenPromise([&](const Response& res) {
     auto promise = Promise<void>();
     if (res.statusCode == 404) {
       promise.reject(make_exception_ptr(HttpErrors::RequestError("device not found")));
@@ -7,7 +7,11 @@ using namespace JetBeep;
 
 IOContext IOContext::context = IOContext();
 
-IOContext::IOContext() : m_impl(new IOContext::Impl()) {
+IOContext::IOContext() : m_impl(new IOContext::Impl(1, vector<int>())) {
+}
+
+IOContext::IOContext(unsigned int threadsCount, const std::vector<int>& cpuAffinity)
+  : m_impl(new IOContext::Impl(threadsCount, cpuAffinity)) {
 }
 
 IOContext::IOContext(const IOContext& other) : m_impl(other.m_impl) {
@@ -16,4 +20,36 @@ IOContext::IOContext(const IOContext& other) : m_impl(other.m_impl) {
 IOContext& IOContext::operator=(const IOContext& other) {
   m_impl = other.m_impl;
   return *this;
-}
\ No newline at end of file
+}
+
+unsigned int IOContext::threadsCount() const {
+  return m_impl->threadsCount();
+}
+
+void IOContext::post(std::function<void()> handler) {
+  m_impl->ioService.post(std::move(handler));
+}
+
+std::function<void()> IOContext::runAfter(std::chrono::milliseconds delay, std::function<void()> handler,
+                                          std::shared_ptr<IOStrand> strand) {
+  // the timer is only touched through its strand, so cancelling it from another thread is safe
+  if (!strand) {
+    strand = make_shared<IOStrand>(m_impl->ioService);
+  }
+  auto timer = make_shared<boost::asio::steady_timer>(m_impl->ioService, delay);
+
+  timer->async_wait(strand->wrap([timer, handler](const boost::system::error_code& error) {
+    if (error != boost::asio::error::operation_aborted) {
+      handler();
+    }
+  }));
+
+  weak_ptr<boost::asio::steady_timer> weakTimer = timer;
+  return [strand, weakTimer] {
+    strand->post([weakTimer] {
+      if (auto timer = weakTimer.lock()) {
+        timer->cancel();
+      }
+    });
+  };
+}
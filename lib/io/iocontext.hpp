@@ -1,22 +1,43 @@
 #ifndef JETBEEP_IO_CONTEXT__H
 #define JETBEEP_IO_CONTEXT__H
 
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <vector>
 
 namespace JetBeep {
+  class IOStrand;
+
   class IOContext {
   public:
     IOContext();
+    // runs the io service on threadsCount worker threads. Thread N is pinned to cpuAffinity[N % cpuAffinity.size()]
+    // when cpuAffinity is not empty (pinning is not supported on Mac OS and is ignored there). Every device and
+    // backend serializes its own handlers, so independent devices are served in parallel by the pool
+    explicit IOContext(unsigned int threadsCount, const std::vector<int>& cpuAffinity = std::vector<int>());
     IOContext(const IOContext& other);
 
     static IOContext context;
     IOContext& operator=(const IOContext& other);
 
+    unsigned int threadsCount() const;
+
+    // runs the handler on a thread of the io context
+    void post(std::function<void()> handler);
+
+    // runs the handler on the io context once the delay elapses, through the strand when it is given (it must belong to
+    // this context) or through a strand of its own otherwise. The returned function cancels the timer and may be
+    // called from any thread, also after the handler was executed
+    std::function<void()> runAfter(std::chrono::milliseconds delay, std::function<void()> handler,
+                                   std::shared_ptr<IOStrand> strand = nullptr);
+
   private:
     class Impl;
     std::shared_ptr<Impl> m_impl;
 
     friend class AutoDevice;
+    friend class AutoDeviceManager;
     friend class SerialDevice;
     friend class DeviceDetection;
     friend class EasyPayBackend;
@@ -24,4 +45,4 @@ namespace JetBeep {
   };
 } // namespace JetBeep
 
-#endif
\ No newline at end of file
+#endif
@@ -1,17 +1,66 @@
 #include "../utils/platform.hpp"
 #include "iocontext_impl.hpp"
 
+#include <stdexcept>
+
+#ifdef PLATFORM_LINUX
+#include <pthread.h>
+#include <sched.h>
+#elif defined(PLATFORM_WIN)
+#include <windows.h>
+#endif
+
 using namespace JetBeep;
 using namespace std;
 
-IOContext::Impl::Impl() : m_thread(&IOContext::Impl::runLoop, this), m_work(ioService) {
+IOContext::Impl::Impl(unsigned int threadsCount, const std::vector<int>& cpuAffinity)
+  : m_service(make_shared<boost::asio::io_service>()), ioService(*m_service), m_work(ioService) {
+  if (threadsCount == 0) {
+    throw invalid_argument("io context requires at least one thread");
+  }
+
+  m_threads.reserve(threadsCount);
+  for (unsigned int i = 0; i < threadsCount; i++) {
+    m_threads.emplace_back([service = m_service] { service->run(); });
+    if (!cpuAffinity.empty()) {
+      setAffinity(m_threads.back(), cpuAffinity[i % cpuAffinity.size()]);
+    }
+  }
 }
 
 IOContext::Impl::~Impl() {
   ioService.stop();
-  m_thread.join();
+  for (auto& thread : m_threads) {
+    if (thread.get_id() == this_thread::get_id()) {
+      // the last reference was released by a handler: the worker can't join itself, it leaves run() as soon as
+      // the handler returns
+      thread.detach();
+    } else {
+      thread.join();
+    }
+  }
 }
 
-void IOContext::Impl::runLoop() {
-  ioService.run();
-}
\ No newline at end of file
+// affinity is a scheduling hint: a worker that can't be pinned keeps running on any cpu
+void IOContext::Impl::setAffinity(std::thread& thread, int cpu) {
+  if (cpu < 0) {
+    return;
+  }
+#ifdef PLATFORM_LINUX
+  if (cpu >= CPU_SETSIZE) {
+    return;
+  }
+  cpu_set_t cpuSet;
+
+  CPU_ZERO(&cpuSet);
+  CPU_SET(cpu, &cpuSet);
+  pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpuSet);
+#elif defined(PLATFORM_WIN)
+  if (cpu >= static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+    return;
+  }
+  SetThreadAffinityMask(thread.native_handle(), static_cast<DWORD_PTR>(1) << cpu);
+#else
+  (void)thread;
+#endif
+}
@@ -3,22 +3,41 @@
 
 #include "iocontext.hpp"
 #include <boost/asio.hpp>
+#include <memory>
 #include <thread>
+#include <vector>
 
 namespace JetBeep {
+  // handlers of a single device/backend are dispatched through its own strand, so they never run concurrently even
+  // when the io service is run by several threads
+  class IOStrand : public boost::asio::io_service::strand {
+  public:
+    explicit IOStrand(boost::asio::io_service& ioService) : boost::asio::io_service::strand(ioService) {
+    }
+  };
+
   class IOContext::Impl {
+  private:
+    // shared with the worker threads, so the service outlives a worker which releases the last context reference
+    std::shared_ptr<boost::asio::io_service> m_service;
+
   public:
-    Impl();
+    Impl(unsigned int threadsCount, const std::vector<int>& cpuAffinity);
     virtual ~Impl();
 
-    boost::asio::io_service ioService;
+    boost::asio::io_service& ioService;
+
+    unsigned int threadsCount() const {
+      return static_cast<unsigned int>(m_threads.size());
+    }
 
   private:
-    std::thread m_thread;
+    // must be constructed before the threads are started, otherwise run() may return before any work is queued
     boost::asio::io_service::work m_work;
+    std::vector<std::thread> m_threads;
 
-    void runLoop();
+    static void setAffinity(std::thread& thread, int cpu);
   };
 } // namespace JetBeep
 
-#endif
\ No newline at end of file
+#endif
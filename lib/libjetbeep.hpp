@@ -5,9 +5,11 @@
 #include "utils/logger.hpp"
 #include "utils/utils.hpp"
 #include "utils/promise.hpp"
+#include "utils/promise_coroutine.hpp"
 #include "utils/version.hpp"
 #include "device/serial_device.hpp"
 #include "device/auto_device.hpp"
+#include "device/auto_device_manager.hpp"
 #include "io/iocontext.hpp"
 #include "https/easypay_backend.hpp"
 #include "https/portal_backend.hpp"
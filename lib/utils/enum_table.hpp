@@ -0,0 +1,93 @@
+#ifndef JETBEEP_ENUM_TABLE__H
+#define JETBEEP_ENUM_TABLE__H
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+namespace JetBeep {
+  template <class Enum>
+  struct EnumTableEntry {
+    Enum value;
+    std::string_view name;
+  };
+
+  // constexpr enum <-> string_view table. Enum values must be dense (0..N-1 in any order), so toString is a single
+  // array access. fromString is a binary search over the names, which are sorted when the table is built at compile
+  // time. Names point to string literals, so nothing is allocated at runtime
+  template <class Enum, size_t N>
+  class EnumTable {
+  public:
+    constexpr EnumTable(const EnumTableEntry<Enum> (&entries)[N]) : m_names{}, m_sorted{} {
+      for (size_t i = 0; i < N; i++) {
+        auto index = static_cast<size_t>(entries[i].value);
+
+        if (index >= N || !m_names[index].empty()) {
+          throw std::logic_error("enum values must be unique and dense");
+        }
+        m_names[index] = entries[i].name;
+        m_sorted[i] = entries[i];
+      }
+
+      // insertion sort, tables are small and it is evaluated by the compiler
+      for (size_t i = 1; i < N; i++) {
+        auto entry = m_sorted[i];
+        size_t j = i;
+
+        for (; j > 0 && entry.name < m_sorted[j - 1].name; j--) {
+          m_sorted[j] = m_sorted[j - 1];
+        }
+        m_sorted[j] = entry;
+      }
+
+      for (size_t i = 1; i < N; i++) {
+        if (m_sorted[i - 1].name == m_sorted[i].name) {
+          throw std::logic_error("enum names must be unique");
+        }
+      }
+    }
+
+    constexpr std::string_view toString(Enum value) const {
+      auto index = static_cast<size_t>(value);
+
+      return index < N ? m_names[index] : std::string_view();
+    }
+
+    constexpr std::optional<Enum> fromString(std::string_view name) const {
+      size_t first = 0;
+      size_t last = N;
+
+      while (first < last) {
+        auto middle = first + (last - first) / 2;
+
+        if (m_sorted[middle].name < name) {
+          first = middle + 1;
+        } else {
+          last = middle;
+        }
+      }
+
+      if (first < N && m_sorted[first].name == name) {
+        return m_sorted[first].value;
+      }
+      return std::nullopt;
+    }
+
+    constexpr size_t size() const {
+      return N;
+    }
+
+  private:
+    std::array<std::string_view, N> m_names;
+    std::array<EnumTableEntry<Enum>, N> m_sorted;
+  };
+
+  template <class Enum, size_t N>
+  constexpr EnumTable<Enum, N> makeEnumTable(const EnumTableEntry<Enum> (&entries)[N]) {
+    return EnumTable<Enum, N>(entries);
+  }
+} // namespace JetBeep
+
+#endif
@@ -5,121 +5,320 @@
  *      Author: oleh
  */
 
-#include <boost/thread.hpp>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdio>
 #include <ctime>
 #include <iostream>
+#include <mutex>
 #include <stdint.h>
 #include <string>
+#include <thread>
 #include <utils/logger.hpp>
+#include <utils/mpsc_ring.hpp>
 
 using namespace JetBeep;
 using namespace std;
 using namespace std::chrono;
-using namespace boost;
 
 bool Logger::cerrEnabled = false;
 bool Logger::coutEnabled = false;
 bool Logger::externalOutputEnabled = false;
-std::ostringstream Logger::m_str;
+bool Logger::asyncEnabled = false;
 LoggerLineCallback Logger::outputCallback;
 
 LoggerLevel Logger::level = LoggerLevel::silent;
 thread_local LoggerLevel Logger::m_threadLevel = LoggerLevel::silent;
+thread_local bool Logger::m_lineEnabled = false;
 
-Logger& Logger::endl(Logger& a) {
-  if (Logger::m_threadLevel < Logger::level) {
-    return a;
+namespace {
+  // appends everything written to the stream to the line of the thread
+  class LineBuffer : public std::streambuf {
+  public:
+    std::string line;
+
+  protected:
+    int_type overflow(int_type ch) override {
+      if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        line.push_back(traits_type::to_char_type(ch));
+      }
+      return ch;
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize count) override {
+      line.append(s, static_cast<size_t>(count));
+      return count;
+    }
+  };
+
+  typedef struct ThreadLine {
+    LineBuffer buffer;
+    std::ostream stream;
+
+    ThreadLine() : stream(&buffer) {
+    }
+  } ThreadLine;
+
+  thread_local ThreadLine threadLine;
+
+  // localtime and strftime are called once per second, only the milliseconds are formatted for every line
+  typedef struct TimestampCache {
+    time_t second = -1;
+    char text[16];
+  } TimestampCache;
+
+  thread_local TimestampCache timestampCache;
+
+  const char* timestamp() {
+    auto now = system_clock::now();
+    auto second = system_clock::to_time_t(now);
+    auto ms = static_cast<unsigned int>(duration_cast<milliseconds>(now.time_since_epoch()).count() % 1000);
+    auto& cache = timestampCache;
+
+    if (cache.second != second) {
+      cache.second = second;
+      struct tm local;
+#ifdef _WIN32
+      localtime_s(&local, &second);
+#else
+      localtime_r(&second, &local);
+#endif
+      strftime(cache.text, sizeof(cache.text), "%H:%M:%S", &local);
+    }
+
+    cache.text[8] = '.';
+    cache.text[9] = static_cast<char>('0' + ms / 100);
+    cache.text[10] = static_cast<char>('0' + ms / 10 % 10);
+    cache.text[11] = static_cast<char>('0' + ms % 10);
+    cache.text[12] = ' ';
+    cache.text[13] = '\0';
+    return cache.text;
   }
-  if (Logger::coutEnabled) {
-    cout << std::endl;
-    cout.flush();
+
+  const char* levelString(LoggerLevel level) {
+    switch (level) {
+    case LoggerLevel::verbose:
+      return "[VERBOSE] ";
+    case LoggerLevel::debug:
+      return "[DEBUG]   ";
+    case LoggerLevel::info:
+      return "[INFO]    ";
+    case LoggerLevel::warning:
+      return "[WARNING] ";
+    case LoggerLevel::error:
+      return "[ERROR]   ";
+    case LoggerLevel::silent:
+      return "[SILENT]  ";
+    default:
+      return "[UNKNOWN] ";
+    }
   }
 
-  if (Logger::cerrEnabled) {
-    cerr << std::endl;
-    cerr.flush();
+  // line is terminated by '\n', which is not passed to outputCallback
+  void writeOutputs(std::string& line, bool flush) {
+    if (Logger::coutEnabled) {
+      cout.write(line.data(), line.size());
+      if (flush) {
+        cout.flush();
+      }
+    }
+
+    if (Logger::cerrEnabled) {
+      cerr.write(line.data(), line.size());
+      if (flush) {
+        cerr.flush();
+      }
+    }
+
+    if (Logger::externalOutputEnabled && Logger::outputCallback) {
+      line.pop_back();
+      Logger::outputCallback(line);
+    }
   }
 
-  if (Logger::externalOutputEnabled) {
-    if (outputCallback) {
-      outputCallback(m_str.str());
+  void flushOutputs() {
+    if (Logger::coutEnabled) {
+      cout.flush();
+    }
+    if (Logger::cerrEnabled) {
+      cerr.flush();
     }
-    m_str = ostringstream();
   }
 
-  return a;
-}
+  std::atomic<bool> asyncWriterStarted(false);
+  std::atomic<bool> asyncWriterStopped(false);
 
-Logger::Logger(const char* module_name) : m_module_name(module_name) {
-}
+  // drains lines queued by the logging threads. Logging threads never block: pushing a line is a single CAS on the
+  // ring. While lines keep coming the writer polls the ring every flushInterval, so no syscall is made on the
+  // logging thread. The writer is only signalled when it went idle or the ring is getting full
+  class AsyncWriter {
+  public:
+    AsyncWriter() : m_ring(4096), m_stopped(false), m_idle(false), m_queued(0), m_written(0), m_dropped(0) {
+      m_thread = std::thread(&AsyncWriter::run, this);
+      asyncWriterStarted.store(true);
+    }
 
-Logger& Logger::output() {
-  string level_str = "";
-  char time_str[40];
-  time_t now = time(nullptr);
-
-  switch (Logger::m_threadLevel) {
-  case LoggerLevel::verbose:
-    level_str = "[VERBOSE] ";
-    break;
-  case LoggerLevel::debug:
-    level_str = "[DEBUG]   ";
-    break;
-  case LoggerLevel::info:
-    level_str = "[INFO]    ";
-    break;
-  case LoggerLevel::warning:
-    level_str = "[WARNING] ";
-    break;
-  case LoggerLevel::error:
-    level_str = "[ERROR]   ";
-    break;
-  case LoggerLevel::silent:
-    level_str = "[SILENT]  ";
-    break;
-  default:
-    level_str = "[UNKNOWN] ";
-    break;
+    ~AsyncWriter() {
+      asyncWriterStopped.store(true);
+      m_stopped.store(true);
+      wakeUp();
+      m_thread.join();
+    }
+
+    void push(std::string& line) {
+      if (!m_ring.tryPush(line)) {
+        m_dropped.fetch_add(1, memory_order_relaxed);
+        line.clear();
+        return;
+      }
+      auto queued = m_queued.fetch_add(1, memory_order_relaxed) + 1;
+
+      // pairs with the fence of the writer: either the writer sees the line or the line's producer sees it idle
+      atomic_thread_fence(memory_order_seq_cst);
+      if (m_idle.load(memory_order_relaxed) && m_idle.exchange(false)) {
+        wakeUp();
+      } else if (queued - m_written.load(memory_order_relaxed) == m_ring.capacity() / 2) {
+        wakeUp();
+      }
+    }
+
+    void flush() {
+      auto queued = m_queued.load();
+      unique_lock<mutex> lock(m_mutex);
+
+      m_wakeUp.notify_one();
+      m_flushed.wait(lock, [&] { return m_written.load() >= queued || m_stopped.load(); });
+    }
+
+  private:
+    static constexpr milliseconds flushInterval = milliseconds(10);
+    // the writer stops polling after a second without lines
+    static constexpr unsigned int pollsBeforeIdle = 100;
+
+    MpscRing<std::string> m_ring;
+    std::atomic<bool> m_stopped;
+    std::atomic<bool> m_idle;
+    std::atomic<uint64_t> m_queued;
+    std::atomic<uint64_t> m_written;
+    std::atomic<uint64_t> m_dropped;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_flushed;
+    std::thread m_thread;
+
+    void wakeUp() {
+      lock_guard<mutex> guard(m_mutex);
+      m_wakeUp.notify_one();
+    }
+
+    void run() {
+      std::string line;
+      unsigned int emptyPolls = 0;
+
+      for (;;) {
+        uint64_t written = 0;
+
+        while (m_ring.tryPop(line)) {
+          writeOutputs(line, false);
+          line.clear();
+          written++;
+        }
+        bool hasWritten = written != 0;
+
+        auto dropped = m_dropped.exchange(0, memory_order_relaxed);
+        if (dropped != 0) {
+          line.append(timestamp()).append(levelString(LoggerLevel::warning)).append("(logger): ");
+          line.append(to_string(dropped)).append(" lines dropped, async writer is overloaded\n");
+          writeOutputs(line, false);
+          line.clear();
+          hasWritten = true;
+        }
+
+        if (hasWritten) {
+          emptyPolls = 0;
+          // output is flushed and the counter shared with the logging threads is updated once per batch
+          flushOutputs();
+          m_written.fetch_add(written);
+          {
+            lock_guard<mutex> guard(m_mutex);
+          }
+          m_flushed.notify_all();
+          continue;
+        }
+
+        if (m_stopped.load()) {
+          m_flushed.notify_all();
+          return;
+        }
+
+        unique_lock<mutex> lock(m_mutex);
+        if (++emptyPolls < pollsBeforeIdle) {
+          m_wakeUp.wait_for(lock, flushInterval);
+          continue;
+        }
+
+        m_idle.store(true);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (m_ring.empty() && !m_stopped.load()) {
+          // the timeout only guards against a missed wake up
+          m_wakeUp.wait_for(lock, milliseconds(1000));
+        }
+        m_idle.store(false);
+      }
+    }
+  };
+
+  AsyncWriter& asyncWriter() {
+    static AsyncWriter writer;
+    return writer;
   }
+} // namespace
 
-  strftime(time_str, 40, "%H:%M:%S", localtime(&now));
-  uint64_t ms =
-    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count() % 1000;
-  stringstream ms_ss;
-
-  if (ms < 10) {
-    ms_ss << "00" << ms;
-  } else if (ms < 100) {
-    ms_ss << "0" << ms;
-  } else {
-    ms_ss << ms;
+Logger& Logger::endl(Logger& a) {
+  if (!Logger::m_lineEnabled) {
+    return a;
   }
 
-  return *this << time_str << "." << ms_ss.str() << " " << level_str << "(" << m_module_name << "): ";
-}
+  auto& line = threadLine.buffer.line;
+
+  Logger::m_lineEnabled = false;
+  line.push_back('\n');
+  if (Logger::asyncEnabled && !asyncWriterStopped.load(memory_order_relaxed)) {
+    asyncWriter().push(line);
+    // the buffer taken back from the ring is empty until the ring has been cycled once
+    if (line.capacity() < 128) {
+      line.reserve(128);
+    }
+    return a;
+  }
 
-Logger& Logger::v() {
-  Logger::m_threadLevel = LoggerLevel::verbose;
-  return output();
+  writeOutputs(line, true);
+  line.clear();
+  return a;
 }
 
-Logger& Logger::d() {
-  Logger::m_threadLevel = LoggerLevel::debug;
-  return output();
+void Logger::flush() {
+  if (asyncWriterStarted.load() && !asyncWriterStopped.load()) {
+    asyncWriter().flush();
+  }
 }
 
-Logger& Logger::i() {
-  Logger::m_threadLevel = LoggerLevel::info;
-  return output();
+std::ostream& Logger::lineStream() {
+  return threadLine.stream;
 }
 
-Logger& Logger::w() {
-  Logger::m_threadLevel = LoggerLevel::warning;
-  return output();
+Logger::Logger(const char* module_name) : m_module_name(module_name) {
 }
 
-Logger& Logger::e() {
-  Logger::m_threadLevel = LoggerLevel::error;
-  return output();
+Logger& Logger::output() {
+  auto& line = threadLine.buffer.line;
+
+  // previous statement of the thread was not terminated by Logger::endl, it is written as a separate line
+  if (!line.empty()) {
+    Logger::m_lineEnabled = true;
+    endl(*this);
+    Logger::m_lineEnabled = true;
+  }
+  return *this << timestamp() << levelString(Logger::m_threadLevel) << "(" << m_module_name << "): ";
 }
@@ -12,31 +12,76 @@
 #include <string>
 #include <sstream>
 #include <functional>
+#include <type_traits>
+
+// statements of lower levels are compiled out (0 - verbose ... 5 - silent), see JETBEEP_LOG_MIN_LEVEL cmake option
+#ifndef JETBEEP_LOG_MIN_LEVEL
+#define JETBEEP_LOG_MIN_LEVEL 0
+#endif
 
 namespace JetBeep {
   enum class LoggerLevel : int { verbose = 0, debug, info, warning, error, silent };
 
   typedef std::function<void(const std::string&)> LoggerLineCallback;
 
+  // returned instead of the logger for levels compiled out by JETBEEP_LOG_MIN_LEVEL, so the whole statement is
+  // reduced to empty inline calls
+  class LoggerNullStream {
+  public:
+    template <class T>
+    const LoggerNullStream& operator<<(const T&) const {
+      return *this;
+    }
+  };
+
   class Logger {
   public:
+    template <LoggerLevel Level>
+    using LevelStream = typename std::conditional<(static_cast<int>(Level) >= JETBEEP_LOG_MIN_LEVEL), Logger&, LoggerNullStream>::type;
+
     Logger(const char* module_name);
 
-    Logger& v();
-    Logger& d();
-    Logger& i();
-    Logger& w();
-    Logger& e();
+    LevelStream<LoggerLevel::verbose> v() {
+      return begin<LoggerLevel::verbose>();
+    }
+
+    LevelStream<LoggerLevel::debug> d() {
+      return begin<LoggerLevel::debug>();
+    }
+
+    LevelStream<LoggerLevel::info> i() {
+      return begin<LoggerLevel::info>();
+    }
+
+    LevelStream<LoggerLevel::warning> w() {
+      return begin<LoggerLevel::warning>();
+    }
+
+    LevelStream<LoggerLevel::error> e() {
+      return begin<LoggerLevel::error>();
+    }
 
     static LoggerLevel level;
     static Logger& endl(Logger& a);
 
+    // true when a line of the level would be written, lets callers skip building expensive log data
+    static bool isEnabled(LoggerLevel lineLevel) {
+      return static_cast<int>(lineLevel) >= JETBEEP_LOG_MIN_LEVEL && lineLevel >= Logger::level && isOutputEnabled();
+    }
+
     static bool coutEnabled;
     static bool cerrEnabled;
     static bool externalOutputEnabled;
+    // lines are handed over to a background writer instead of being written by the logging thread. The writer is
+    // the thread which calls outputCallback in this mode. Lines are dropped (and the number of dropped lines is
+    // reported) when the writer can't keep up
+    static bool asyncEnabled;
 
     static LoggerLineCallback outputCallback;
 
+    // blocks until all lines queued for the background writer are written
+    static void flush();
+
     typedef Logger& (*logger_manipulator)(Logger&);
     Logger& operator<<(logger_manipulator manip) {
       // call the function, and return it's value
@@ -45,10 +90,8 @@ namespace JetBeep {
 
     template <class T>
     Logger& operator<<(const T& t) {
-      if (Logger::m_threadLevel >= Logger::level) {
-        coutValue(t);
-        cerrValue(t);
-        externalOutputValue(t);
+      if (Logger::m_lineEnabled) {
+        lineStream() << t;
       }
 
       return *this;
@@ -56,38 +99,34 @@ namespace JetBeep {
 
   private:
     std::string m_module_name;
-    static std::ostringstream m_str;
 
     Logger& output();
 
-    static thread_local LoggerLevel m_threadLevel;
-
-    template <class T>
-    void coutValue(T t) {
-      if (!coutEnabled) {
-        return;
+    // the level is checked once when the line is started, so values of a disabled line cost a single branch and
+    // the line prefix is not formatted at all
+    template <LoggerLevel Level>
+    LevelStream<Level> begin() {
+      if constexpr (static_cast<int>(Level) >= JETBEEP_LOG_MIN_LEVEL) {
+        Logger::m_threadLevel = Level;
+        Logger::m_lineEnabled = isEnabled(Level);
+        if (Logger::m_lineEnabled) {
+          output();
+        }
+        return *this;
+      } else {
+        return LoggerNullStream();
       }
-
-      std::cout << t;
     }
 
-    template <class T>
-    void cerrValue(T t) {
-      if (!cerrEnabled) {
-        return;
-      }
+    static thread_local LoggerLevel m_threadLevel;
+    static thread_local bool m_lineEnabled;
 
-      std::cerr << t;
+    static bool isOutputEnabled() {
+      return coutEnabled || cerrEnabled || externalOutputEnabled;
     }
 
-    template <class T>
-    void externalOutputValue(T t) {
-      if (!externalOutputEnabled) {
-        return;
-      }
-
-      Logger::m_str << t;
-    }
+    // the line is built in a buffer of the calling thread, so lines of different threads never interleave
+    static std::ostream& lineStream();
   };
 } // namespace JetBeep
 
@@ -0,0 +1,96 @@
+#ifndef JETBEEP_MPSC_RING__H
+#define JETBEEP_MPSC_RING__H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace JetBeep {
+  // bounded lock-free queue for many producers and a single consumer. Every cell carries a sequence number which
+  // tells whether it is free for the producer of a given position or filled for the consumer, so producers only
+  // contend on a single compare-and-swap of the enqueue position and never wait for each other.
+  // Values are swapped with the cells instead of being copied: a producer gets back the value the consumer left in
+  // the cell, which lets string buffers be recycled without allocations
+  template <class T>
+  class MpscRing {
+  public:
+    explicit MpscRing(size_t capacity) : m_cells(new Cell[capacity]), m_mask(capacity - 1), m_enqueuePos(0), m_dequeuePos(0) {
+      if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+        throw std::invalid_argument("ring capacity must be a power of 2");
+      }
+      for (size_t i = 0; i < capacity; i++) {
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+      }
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    // returns false when the ring is full, value is left untouched in that case
+    bool tryPush(T& value) {
+      Cell* cell;
+      size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+
+      for (;;) {
+        cell = &m_cells[pos & m_mask];
+        auto sequence = cell->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+        if (diff == 0) {
+          if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            break;
+          }
+        } else if (diff < 0) {
+          return false;
+        } else {
+          pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+      }
+
+      std::swap(cell->value, value);
+      cell->sequence.store(pos + 1, std::memory_order_release);
+      return true;
+    }
+
+    // must be called from the consumer thread only
+    bool tryPop(T& value) {
+      auto& cell = m_cells[m_dequeuePos & m_mask];
+      auto sequence = cell.sequence.load(std::memory_order_acquire);
+
+      if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(m_dequeuePos + 1) < 0) {
+        return false;
+      }
+
+      std::swap(cell.value, value);
+      cell.sequence.store(m_dequeuePos + m_mask + 1, std::memory_order_release);
+      m_dequeuePos++;
+      return true;
+    }
+
+    // must be called from the consumer thread only
+    bool empty() const {
+      return m_cells[m_dequeuePos & m_mask].sequence.load(std::memory_order_acquire) != m_dequeuePos + 1;
+    }
+
+    size_t capacity() const {
+      return m_mask + 1;
+    }
+
+  private:
+    typedef struct Cell {
+      std::atomic<size_t> sequence;
+      T value;
+    } Cell;
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask;
+    // producers and the consumer work on separate cache lines
+    alignas(64) std::atomic<size_t> m_enqueuePos;
+    alignas(64) size_t m_dequeuePos;
+  };
+} // namespace JetBeep
+
+#endif
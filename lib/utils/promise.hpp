@@ -7,263 +7,194 @@ namespace JetBeep {
   template <typename T>
   class Promise {
   public:
-    Promise() : m_impl(new Promise<T>::Impl()) {
+    Promise() : m_core(std::make_shared<Core>()) {
     }
 
-    Promise(const T& t) : m_impl(new Promise<T>::Impl()) {
+    Promise(const T& t) : m_core(std::make_shared<Core>()) {
       resolve(t);
     }
 
-    void resolve(const T& t) {
-      /* we have to copy shared_ptr as in case when *this* will be reassigned with other value
-       during execution of m_resolvedCallbacks and m_rejectCallbacks will be undefined (will cause EXC_BAD_ACCESS)
-      */
-      auto impl = m_impl;
-      if (impl->m_state != PromiseState::undefined) {
-        throw std::runtime_error("promise is already resolved");
-      }
-      impl->m_t = t;
-      impl->m_state = PromiseState::resolved;
-      for (auto it = impl->m_resolvedCallbacks.begin(); it != impl->m_resolvedCallbacks.end(); ++it) {
-        if (*it) {
-          (*it)();
-        }
-      }
-      impl->m_resolvedCallbacks.clear();
-      impl->m_rejectedCallbacks.clear();
+    Promise(T&& t) : m_core(std::make_shared<Core>()) {
+      resolve(std::move(t));
     }
 
-    void reject(std::exception_ptr error) {
+    void resolve(const T& t) {
       /* we have to copy shared_ptr as in case when *this* will be reassigned with other value
-       during execution of m_resolvedCallbacks and m_rejectCallbacks will be undefined (will cause EXC_BAD_ACCESS)
+       during execution of continuations the core will be undefined (will cause EXC_BAD_ACCESS)
       */
-      auto impl = m_impl;
-      if (impl->m_state != PromiseState::undefined) {
-        throw std::runtime_error("promise is already resolved");
-      }
+      auto core = m_core;
+      core->resolve(t);
+    }
 
-      impl->m_state = PromiseState::rejected;
-      impl->m_error = error;
-      for (auto it = impl->m_rejectedCallbacks.begin(); it != impl->m_rejectedCallbacks.end(); ++it) {
-        if (*it) {
-          (*it)();
-        }
-      }
+    void resolve(T&& t) {
+      auto core = m_core;
+      core->resolve(std::move(t));
+    }
 
-      impl->m_resolvedCallbacks.clear();
-      impl->m_rejectedCallbacks.clear();
+    void reject(std::exception_ptr error) {
+      auto core = m_core;
+      core->reject(error);
     }
 
     template <typename ReturnType, typename std::enable_if<!IsPromise<ReturnType>::value, ReturnType>::type* = nullptr>
-    Promise<ReturnType> then(std::function<ReturnType(T)> callback) {
-      auto promise = Promise<ReturnType>();
-      auto resolveLambda = [=, m_impl = m_impl]() mutable {
+    Promise<ReturnType> then(std::function<ReturnType(const T&)> callback) {
+      Promise<ReturnType> promise;
+      auto core = m_core.get();
+
+      core->subscribe([core, callback = std::move(callback), promise]() mutable {
+        if (core->m_state == PromiseState::rejected) {
+          promise.reject(core->m_error);
+          return;
+        }
+        std::optional<ReturnType> result;
         try {
-          auto result = callback(m_impl->m_t);
-          promise.resolve(result);
+          result.emplace(callback(*core->m_value));
         } catch (...) {
           auto error = std::current_exception();
           promise.reject(error);
+          return;
         }
-      };
-      auto rejectLambda = [=, m_impl = m_impl]() mutable { promise.reject(m_impl->m_error); };
-
-      switch (m_impl->m_state) {
-      case PromiseState::resolved:
-        resolveLambda();
-        break;
-      case PromiseState::rejected:
-        rejectLambda();
-        break;
-      case PromiseState::undefined:
-        m_impl->m_resolvedCallbacks.push_back(resolveLambda);
-        m_impl->m_rejectedCallbacks.push_back(rejectLambda);
-        break;
-      }
+        promise.release()->resolve(std::move(*result));
+      });
 
       return promise;
     }
 
-    Promise<void> then(std::function<void(T)> callback) {
-      auto promise = Promise<void>();
-      auto resolveLambda = [=, m_impl = m_impl]() mutable {
+    Promise<void> then(std::function<void(const T&)> callback) {
+      Promise<void> promise;
+      auto core = m_core.get();
+
+      core->subscribe([core, callback = std::move(callback), promise]() mutable {
+        if (core->m_state == PromiseState::rejected) {
+          promise.reject(core->m_error);
+          return;
+        }
         try {
-          callback(m_impl->m_t);
-          promise.resolve();
+          callback(*core->m_value);
         } catch (...) {
           auto error = std::current_exception();
           promise.reject(error);
+          return;
         }
-      };
-      auto rejectLambda = [=, m_impl = m_impl]() mutable { promise.reject(m_impl->m_error); };
-
-      switch (m_impl->m_state) {
-      case PromiseState::resolved:
-        resolveLambda();
-        break;
-      case PromiseState::rejected:
-        rejectLambda();
-        break;
-      case PromiseState::undefined:
-        m_impl->m_resolvedCallbacks.push_back(resolveLambda);
-        m_impl->m_rejectedCallbacks.push_back(rejectLambda);
-        break;
-      }
+        promise.release()->resolve();
+      });
 
       return promise;
     }
 
-    Promise<void> thenPromise(std::function<Promise<void>(T)> callback) {
+    Promise<void> thenPromise(std::function<Promise<void>(const T&)> callback) {
       Promise<void> promise;
+      auto core = m_core.get();
 
-      auto resolveLambda = [=, m_impl = m_impl]() mutable {
+      core->subscribe([core, callback = std::move(callback), promise]() mutable {
+        if (core->m_state == PromiseState::rejected) {
+          promise.reject(core->m_error);
+          return;
+        }
         try {
-          auto resultPromise = callback(m_impl->m_t);
+          auto resultPromise = callback(*core->m_value);
 
-          resultPromise.then([=]() mutable { promise.resolve(); }).catchError([=](std::exception_ptr error) mutable {
-            promise.reject(error);
-          });
+          resultPromise.forwardTo(std::move(promise));
         } catch (...) {
           auto error = std::current_exception();
           promise.reject(error);
         }
-      };
-
-      auto rejectLambda = [=, m_impl = m_impl]() mutable { promise.reject(m_impl->m_error); };
-
-      switch (m_impl->m_state) {
-      case PromiseState::resolved:
-        resolveLambda();
-        break;
-      case PromiseState::rejected:
-        rejectLambda();
-        break;
-      case PromiseState::undefined:
-        m_impl->m_resolvedCallbacks.push_back(resolveLambda);
-        m_impl->m_rejectedCallbacks.push_back(rejectLambda);
-        break;
-      }
+      });
 
       return promise;
     }
 
     template <typename ReturnType, template <typename> class PromiseType>
-    PromiseType<ReturnType> thenPromise(std::function<PromiseType<ReturnType>(T)> callback) {
+    PromiseType<ReturnType> thenPromise(std::function<PromiseType<ReturnType>(const T&)> callback) {
       Promise<ReturnType> promise;
+      auto core = m_core.get();
 
-      auto resolveLambda = [=, m_impl = m_impl]() mutable {
+      core->subscribe([core, callback = std::move(callback), promise]() mutable {
+        if (core->m_state == PromiseState::rejected) {
+          promise.reject(core->m_error);
+          return;
+        }
         try {
-          auto resultPromise = callback(m_impl->m_t);
+          auto resultPromise = callback(*core->m_value);
 
-          resultPromise.then([=](ReturnType result) mutable { promise.resolve(result); }).catchError([=](std::exception_ptr error) mutable {
-            promise.reject(error);
-          });
+          resultPromise.forwardTo(std::move(promise));
         } catch (...) {
           auto error = std::current_exception();
           promise.reject(error);
         }
-      };
-      auto rejectLambda = [=, m_impl = m_impl]() mutable { promise.reject(m_impl->m_error); };
-
-      switch (m_impl->m_state) {
-      case PromiseState::resolved:
-        resolveLambda();
-        break;
-      case PromiseState::rejected:
-        rejectLambda();
-        break;
-      case PromiseState::undefined:
-        m_impl->m_resolvedCallbacks.push_back(resolveLambda);
-        m_impl->m_rejectedCallbacks.push_back(rejectLambda);
-        break;
-      }
+      });
 
       return promise;
     }
 
     void catchError(std::function<void(const std::exception_ptr&)> callback) {
-      auto rejectLambda = [=, m_impl = m_impl] { callback(m_impl->m_error); };
-      switch (m_impl->m_state) {
-      case PromiseState::rejected:
-        rejectLambda();
-        break;
-      case PromiseState::undefined:
-        m_impl->m_rejectedCallbacks.push_back(rejectLambda);
-        break;
-      default:
-        break;
-      }
+      auto core = m_core.get();
+
+      core->subscribe([core, callback = std::move(callback)]() {
+        if (core->m_state == PromiseState::rejected) {
+          callback(core->m_error);
+        }
+      });
     }
 
     Promise<T> recover(std::function<T(const std::exception_ptr&)> callback) {
       Promise<T> promise;
-      auto resolveLambda = [=, m_impl = m_impl]() mutable { promise.resolve(m_impl->m_t); };
-      auto rejectLambda = [=, m_impl = m_impl]() mutable {
+      auto core = m_core.get();
+
+      core->subscribe([core, callback = std::move(callback), promise]() mutable {
+        if (core->m_state == PromiseState::resolved) {
+          promise.release()->resolve(core->takeValue());
+          return;
+        }
+        std::optional<T> result;
         try {
-          auto result = callback(m_impl->m_error);
-          promise.resolve(result);
+          result.emplace(callback(core->m_error));
         } catch (...) {
           auto error = std::current_exception();
           promise.reject(error);
+          return;
         }
-      };
-
-      switch (m_impl->m_state) {
-      case PromiseState::resolved:
-        resolveLambda();
-        break;
-      case PromiseState::rejected:
-        rejectLambda();
-        break;
-      case PromiseState::undefined:
-        m_impl->m_resolvedCallbacks.push_back(resolveLambda);
-        m_impl->m_rejectedCallbacks.push_back(rejectLambda);
-        break;
-      }
+        promise.release()->resolve(std::move(*result));
+      });
 
       return promise;
     }
 
     Promise<T> recoverPromise(std::function<Promise<T>(const std::exception_ptr&)> callback) {
       Promise<T> promise;
-      auto resolveLambda = [=, m_impl = m_impl]() mutable { promise.resolve(m_impl->m_t); };
-      auto rejectLambda = [=, m_impl = m_impl]() mutable {
+      auto core = m_core.get();
+
+      core->subscribe([core, callback = std::move(callback), promise]() mutable {
+        if (core->m_state == PromiseState::resolved) {
+          promise.release()->resolve(core->takeValue());
+          return;
+        }
         try {
-          auto resultPromise = callback(m_impl->m_error);
-          resultPromise.then([=](T result) mutable { promise.resolve(result); }).catchError([=](std::exception_ptr error) mutable {
-            promise.reject(error);
-          });
+          auto resultPromise = callback(core->m_error);
+
+          resultPromise.forwardTo(std::move(promise));
         } catch (...) {
           auto error = std::current_exception();
           promise.reject(error);
         }
-      };
-
-      switch (m_impl->m_state) {
-      case PromiseState::resolved:
-        resolveLambda();
-        break;
-      case PromiseState::rejected:
-        rejectLambda();
-        break;
-      case PromiseState::undefined:
-        m_impl->m_resolvedCallbacks.push_back(resolveLambda);
-        m_impl->m_rejectedCallbacks.push_back(rejectLambda);
-        break;
-      }
+      });
 
       return promise;
     }
 
-    Promise(const Promise& other) {
-      m_impl = other.m_impl;
+    // noexcept, so continuations holding a promise are stored inline
+    Promise(const Promise& other) noexcept : m_core(other.m_core) {
     }
 
-    Promise& operator=(const Promise& other) {
-      m_impl = other.m_impl;
+    Promise& operator=(const Promise& other) noexcept {
+      m_core = other.m_core;
       return *this;
     }
 
+    // a moved-from promise has no state, it may only be assigned or destroyed
+    Promise(Promise&& other) noexcept = default;
+    Promise& operator=(Promise&& other) noexcept = default;
+
     static Promise<T> rejected(std::exception_ptr error) {
       Promise<T> promise;
       promise.reject(error);
@@ -271,23 +202,176 @@ namespace JetBeep {
     }
 
     PromiseState state() {
-      return m_impl->m_state;
+      return m_core->m_state;
+    }
+
+    // rejects with Errors::OperationTimeout unless this promise settles within the timeout. On timeout the returned
+    // promise is rejected through the strand, which must be the strand settling this promise, so continuations of the
+    // result never run concurrently with its other handlers, whatever the number of threads of the context
+    Promise<T> withTimeout(std::chrono::milliseconds timeout, std::shared_ptr<IOStrand> strand,
+                           IOContext context = IOContext::context) {
+      if (!strand) {
+        throw std::invalid_argument("withTimeout needs the strand which settles the promise");
+      }
+
+      Promise<T> promise;
+      auto isSettled = std::make_shared<std::atomic<bool>>(false);
+      auto cancelTimer = context.runAfter(
+        timeout,
+        [promise, isSettled]() mutable {
+          if (!isSettled->exchange(true)) {
+            promise.reject(std::make_exception_ptr(Errors::OperationTimeout()));
+          }
+        },
+        std::move(strand));
+      auto core = m_core.get();
+
+      core->subscribe([core, promise, isSettled, cancelTimer = std::move(cancelTimer)]() mutable {
+        if (isSettled->exchange(true)) {
+          return;
+        }
+        cancelTimer();
+        if (core->m_state == PromiseState::resolved) {
+          promise.release()->resolve(core->takeValue());
+        } else {
+          promise.reject(core->m_error);
+        }
+      });
+
+      return promise;
+    }
+
+    // the combinators subscribe to the inputs, and subscribing to or settling a promise is not thread-safe: the inputs
+    // must be settled on the strand (or the thread) which calls the combinator. Their shared state is not locked either
+    // resolves with the values of all promises in their order, or rejects with the first error
+    static Promise<std::vector<T>> all(const std::vector<Promise<T>>& promises) {
+      typedef struct State {
+        bool isSettled = false;
+        size_t left;
+        std::vector<std::optional<T>> values;
+      } State;
+
+      Promise<std::vector<T>> promise;
+      auto state = std::make_shared<State>();
+
+      state->left = promises.size();
+      state->values.resize(promises.size());
+      if (promises.empty()) {
+        promise.resolve(std::vector<T>());
+        return promise;
+      }
+
+      for (size_t i = 0; i < promises.size(); i++) {
+        auto core = promises[i].m_core.get();
+
+        core->subscribe([core, i, state, promise]() mutable {
+          if (state->isSettled) {
+            return;
+          }
+          if (core->m_state == PromiseState::rejected) {
+            state->isSettled = true;
+            promise.reject(core->m_error);
+            return;
+          }
+
+          state->values[i].emplace(core->takeValue());
+          if (--state->left != 0) {
+            return;
+          }
+          state->isSettled = true;
+
+          std::vector<T> values;
+          values.reserve(state->values.size());
+          for (auto& value : state->values) {
+            values.push_back(std::move(*value));
+          }
+          promise.release()->resolve(std::move(values));
+        });
+      }
+      return promise;
+    }
+
+    // resolves with the first value, rejects with the last error once all of the promises are rejected
+    static Promise<T> any(const std::vector<Promise<T>>& promises) {
+      return settleFirst(promises, false);
+    }
+
+    // settles the same way as the first of the promises which settles
+    static Promise<T> race(const std::vector<Promise<T>>& promises) {
+      return settleFirst(promises, true);
     }
 
   private:
-    class Impl {
-    public:
-      PromiseState m_state;
-      std::exception_ptr m_error;
-      std::vector<std::function<void()>> m_resolvedCallbacks;
-      std::vector<std::function<void()>> m_rejectedCallbacks;
-      T m_t;
-
-      Impl() : m_state(PromiseState::undefined) {
+    template <typename U>
+    friend class Detail::PromiseAwaiter;
+
+    template <typename U>
+    friend class Promise;
+
+    typedef Detail::PromiseCore<T> Core;
+    std::shared_ptr<Core> m_core;
+
+    static Promise<T> settleFirst(const std::vector<Promise<T>>& promises, bool isRejectionFinal) {
+      typedef struct State {
+        bool isSettled = false;
+        size_t left;
+      } State;
+
+      Promise<T> promise;
+      auto state = std::make_shared<State>();
+
+      state->left = promises.size();
+      if (promises.empty()) {
+        promise.reject(std::make_exception_ptr(std::invalid_argument("no promises to wait for")));
+        return promise;
+      }
+
+      for (auto& input : promises) {
+        auto core = input.m_core.get();
+
+        core->subscribe([core, state, promise, isRejectionFinal]() mutable {
+          auto isLast = --state->left == 0;
+
+          if (state->isSettled || (core->m_state == PromiseState::rejected && !isRejectionFinal && !isLast)) {
+            return;
+          }
+          state->isSettled = true;
+
+          if (core->m_state == PromiseState::resolved) {
+            promise.release()->resolve(core->takeValue());
+          } else {
+            promise.reject(core->m_error);
+          }
+        });
       }
-    };
-    std::shared_ptr<Impl> m_impl;
+      return promise;
+    }
+
+    // drops the handle before the core is settled, so the last continuation of the core may take ownership of its
+    // value once no other handle is left
+    std::shared_ptr<Core> release() {
+      return std::move(m_core);
+    }
+
+    // settles the other promise with the result of this one, a single continuation instead of a then/catchError pair
+    void forwardTo(Promise<T> promise) {
+      auto core = m_core.get();
+
+      // already resolved and this is the last handle, e.g. a promise returned by a thenPromise callback
+      if (core->m_state == PromiseState::resolved && m_core.use_count() == 1) {
+        promise.release()->resolve(std::move(*core->m_value));
+        return;
+      }
+
+      core->subscribe([core, promise = std::move(promise)]() mutable {
+        if (core->m_state == PromiseState::resolved) {
+          promise.release()->resolve(core->takeValue());
+        } else {
+          promise.reject(core->m_error);
+        }
+      });
+    }
   };
 } // namespace JetBeep
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,236 @@
+#ifndef JETBEEP_PROMISE_CORE_HPP
+#define JETBEEP_PROMISE_CORE_HPP
+
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace JetBeep {
+  enum class PromiseState { undefined, resolved, rejected };
+
+  namespace Detail {
+    template <typename Signature, size_t Capacity = 64>
+    class InlineFunction;
+
+    template <typename T>
+    class PromiseAwaiter;
+
+    // move-only type-erased callable. Callables up to Capacity bytes are stored inside the object, so continuations of
+    // promise chains are registered without a heap allocation; bigger ones fall back to the heap
+    template <typename R, typename... Args, size_t Capacity>
+    class InlineFunction<R(Args...), Capacity> {
+    public:
+      InlineFunction() noexcept : m_ops(nullptr) {
+      }
+
+      template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, InlineFunction>::value>::type>
+      InlineFunction(F&& function) : m_ops(nullptr) {
+        typedef typename std::decay<F>::type Function;
+
+        if constexpr (isInline<Function>()) {
+          new (m_storage) Function(std::forward<F>(function));
+          m_ops = &InlineOps<Function>::ops;
+        } else {
+          *reinterpret_cast<Function**>(m_storage) = new Function(std::forward<F>(function));
+          m_ops = &HeapOps<Function>::ops;
+        }
+      }
+
+      InlineFunction(InlineFunction&& other) noexcept : m_ops(other.m_ops) {
+        if (m_ops) {
+          m_ops->move(other.m_storage, m_storage);
+          other.m_ops = nullptr;
+        }
+      }
+
+      InlineFunction& operator=(InlineFunction&& other) noexcept {
+        if (this != &other) {
+          reset();
+          m_ops = other.m_ops;
+          if (m_ops) {
+            m_ops->move(other.m_storage, m_storage);
+            other.m_ops = nullptr;
+          }
+        }
+        return *this;
+      }
+
+      InlineFunction(const InlineFunction&) = delete;
+      InlineFunction& operator=(const InlineFunction&) = delete;
+
+      ~InlineFunction() {
+        reset();
+      }
+
+      explicit operator bool() const noexcept {
+        return m_ops != nullptr;
+      }
+
+      R operator()(Args... args) {
+        return m_ops->invoke(m_storage, std::forward<Args>(args)...);
+      }
+
+      void reset() noexcept {
+        if (m_ops) {
+          m_ops->destroy(m_storage);
+          m_ops = nullptr;
+        }
+      }
+
+    private:
+      typedef struct Ops {
+        R (*invoke)(void* storage, Args&&... args);
+        // move constructs the callable at "to" and destroys the one at "from"
+        void (*move)(void* from, void* to) noexcept;
+        void (*destroy)(void* storage) noexcept;
+      } Ops;
+
+      template <typename Function>
+      static constexpr bool isInline() {
+        return sizeof(Function) <= Capacity && alignof(Function) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<Function>::value;
+      }
+
+      template <typename Function>
+      struct InlineOps {
+        static R invoke(void* storage, Args&&... args) {
+          return (*static_cast<Function*>(storage))(std::forward<Args>(args)...);
+        }
+
+        static void move(void* from, void* to) noexcept {
+          new (to) Function(std::move(*static_cast<Function*>(from)));
+          static_cast<Function*>(from)->~Function();
+        }
+
+        static void destroy(void* storage) noexcept {
+          static_cast<Function*>(storage)->~Function();
+        }
+
+        static constexpr Ops ops = {&invoke, &move, &destroy};
+      };
+
+      template <typename Function>
+      struct HeapOps {
+        static R invoke(void* storage, Args&&... args) {
+          return (**static_cast<Function**>(storage))(std::forward<Args>(args)...);
+        }
+
+        static void move(void* from, void* to) noexcept {
+          *static_cast<Function**>(to) = *static_cast<Function**>(from);
+        }
+
+        static void destroy(void* storage) noexcept {
+          delete *static_cast<Function**>(storage);
+        }
+
+        static constexpr Ops ops = {&invoke, &move, &destroy};
+      };
+
+      alignas(std::max_align_t) unsigned char m_storage[Capacity];
+      const Ops* m_ops;
+    };
+
+    template <typename T>
+    class PromiseValue {
+    public:
+      // optional, so payloads don't have to be default constructible
+      std::optional<T> m_value;
+    };
+
+    template <>
+    class PromiseValue<void> {};
+
+    // shared state of a promise: result and continuations live in one object created with make_shared, so a promise
+    // costs a single allocation. Every then/catchError/recover registers one continuation, which runs once the promise
+    // settles and checks the state itself. The first continuation is stored inline, as promises of a chain almost
+    // always have exactly one
+    template <typename T>
+    class PromiseCore : public PromiseValue<T>, public std::enable_shared_from_this<PromiseCore<T>> {
+    public:
+      typedef InlineFunction<void()> Continuation;
+
+      PromiseState m_state = PromiseState::undefined;
+      std::exception_ptr m_error;
+
+      template <typename... Value>
+      void resolve(Value&&... value) {
+        checkUndefined();
+        if constexpr (!std::is_void<T>::value) {
+          this->m_value.emplace(std::forward<Value>(value)...);
+        }
+        m_state = PromiseState::resolved;
+        runContinuations();
+      }
+
+      void reject(std::exception_ptr error) {
+        checkUndefined();
+        m_error = error;
+        m_state = PromiseState::rejected;
+        runContinuations();
+      }
+
+      // runs the continuation right away if the promise is already settled
+      template <typename F>
+      void subscribe(F&& continuation) {
+        if (m_state != PromiseState::undefined) {
+          continuation();
+          return;
+        }
+
+        if (!m_first) {
+          m_first = Continuation(std::forward<F>(continuation));
+        } else {
+          m_rest.emplace_back(std::forward<F>(continuation));
+        }
+      }
+
+      // the value for a consumer which keeps it: moved out when nobody is able to read it afterwards, i.e. the last
+      // continuation runs and no handle of the promise is left. Otherwise it is copied
+      template <typename U = T>
+      U takeValue() {
+        if constexpr (std::is_copy_constructible<U>::value) {
+          if (!m_isRunningLast || this->weak_from_this().use_count() != 1) {
+            return *this->m_value;
+          }
+        }
+        // move-only payloads always have a single consumer
+        return std::move(*this->m_value);
+      }
+
+    private:
+      Continuation m_first;
+      std::vector<Continuation> m_rest;
+      bool m_isRunningLast = false;
+
+      void checkUndefined() const {
+        if (m_state != PromiseState::undefined) {
+          throw std::runtime_error("promise is already resolved");
+        }
+      }
+
+      // continuations are taken out first: they may drop the last handle of a promise they belong to
+      void runContinuations() {
+        auto first = std::move(m_first);
+        auto rest = std::move(m_rest);
+
+        if (first) {
+          m_isRunningLast = rest.empty();
+          first();
+        }
+        for (size_t i = 0; i < rest.size(); i++) {
+          m_isRunningLast = i + 1 == rest.size();
+          rest[i]();
+        }
+        m_isRunningLast = false;
+      }
+    };
+  } // namespace Detail
+} // namespace JetBeep
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef JETBEEP_PROMISE_COROUTINE_HPP
+#define JETBEEP_PROMISE_COROUTINE_HPP
+
+// C++20 coroutine support, enabled with the JETBEEP_COROUTINES cmake option. Every Promise can be awaited and a function
+// returning a Promise may be a coroutine, so a chain of SerialDevice commands reads as:
+//
+//   Promise<void> openSession(SerialDevice& device) {
+//     auto version = co_await device.get(DeviceParameter::version);
+//     ...
+//     co_await device.openSession();
+//   }
+//
+// A coroutine continues on the thread which settles the awaited promise, for SerialDevice that is its IOContext.
+// co_await resumeOn(context) moves it onto a thread of another context
+#if defined(JETBEEP_COROUTINES) && defined(__cpp_impl_coroutine)
+
+#include "../io/iocontext.hpp"
+#include "promise.hpp"
+
+#include <coroutine>
+
+namespace JetBeep {
+  namespace Detail {
+    template <typename T>
+    class PromiseAwaiter {
+    public:
+      explicit PromiseAwaiter(Promise<T> promise) : m_promise(std::move(promise)) {
+      }
+
+      bool await_ready() {
+        return m_promise.m_core->m_state != PromiseState::undefined;
+      }
+
+      // the continuation may run right away on another thread, nothing of the awaiter is touched after subscribing
+      void await_suspend(std::coroutine_handle<> handle) {
+        m_promise.m_core->subscribe([handle] { handle.resume(); });
+      }
+
+      T await_resume() {
+        auto core = m_promise.release();
+
+        if (core->m_state == PromiseState::rejected) {
+          std::rethrow_exception(core->m_error);
+        }
+        if constexpr (!std::is_void<T>::value) {
+          // copied only when another handle of the awaited promise is able to read the value afterwards
+          if constexpr (std::is_copy_constructible<T>::value) {
+            if (core.use_count() != 1) {
+              return *core->m_value;
+            }
+          }
+          return std::move(*core->m_value);
+        }
+      }
+
+    private:
+      Promise<T> m_promise;
+    };
+
+    // the promise_type of a coroutine returning Promise<T>. The coroutine starts eagerly and its frame is destroyed
+    // once it finishes, the returned promise settles with its result
+    template <typename T>
+    class PromiseCoroutineBase {
+    public:
+      Promise<T> get_return_object() {
+        return m_promise;
+      }
+
+      std::suspend_never initial_suspend() noexcept {
+        return {};
+      }
+
+      std::suspend_never final_suspend() noexcept {
+        return {};
+      }
+
+      void unhandled_exception() {
+        m_promise.reject(std::current_exception());
+      }
+
+    protected:
+      Promise<T> m_promise;
+    };
+
+    template <typename T>
+    class PromiseCoroutine : public PromiseCoroutineBase<T> {
+    public:
+      void return_value(T value) {
+        this->m_promise.resolve(std::move(value));
+      }
+    };
+
+    template <>
+    class PromiseCoroutine<void> : public PromiseCoroutineBase<void> {
+    public:
+      void return_void() {
+        m_promise.resolve();
+      }
+    };
+  } // namespace Detail
+
+  template <typename T>
+  Detail::PromiseAwaiter<T> operator co_await(Promise<T> promise) {
+    return Detail::PromiseAwaiter<T>(std::move(promise));
+  }
+
+  // continues the coroutine on a thread of the context
+  inline auto resumeOn(IOContext context) {
+    typedef struct Awaiter {
+      IOContext context;
+
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) {
+        context.post([handle] { handle.resume(); });
+      }
+
+      void await_resume() const noexcept {
+      }
+    } Awaiter;
+
+    return Awaiter{context};
+  }
+} // namespace JetBeep
+
+template <typename T, typename... Args>
+struct std::coroutine_traits<JetBeep::Promise<T>, Args...> {
+  typedef JetBeep::Detail::PromiseCoroutine<T> promise_type;
+};
+
+#endif
+
+#endif
@@ -1,6 +1,12 @@
 #ifndef JETBEEP_PROMISE_VOID_HPP
 #define JETBEEP_PROMISE_VOID_HPP
 
+#include "../device/device_errors.hpp"
+#include "../io/iocontext.hpp"
+#include "promise_core.hpp"
+
+#include <atomic>
+#include <chrono>
 #include <exception>
 #include <functional>
 #include <iostream>
@@ -18,144 +24,89 @@ namespace JetBeep {
   template <typename T>
   struct IsPromise<Promise<T>> : std::true_type {};
 
-  enum class PromiseState { undefined, resolved, rejected };
-
   template <>
   class Promise<void> {
   public:
-    Promise() : m_impl(new Promise<void>::Impl()) {
+    Promise() : m_core(std::make_shared<Core>()) {
     }
 
     void resolve() {
       /* we have to copy shared_ptr as in case when *this* will be reassigned with other value
-       during execution of m_resolvedCallbacks and m_rejectCallbacks will be undefined (will cause EXC_BAD_ACCESS)
+       during execution of continuations the core will be undefined (will cause EXC_BAD_ACCESS)
       */
-      auto impl = m_impl;
-
-      if (impl->m_state != PromiseState::undefined) {
-        throw std::runtime_error("promise is already resolved");
-      }
-      impl->m_state = PromiseState::resolved;
-      for (auto it = impl->m_resolvedCallbacks.begin(); it != impl->m_resolvedCallbacks.end(); ++it) {
-        if (*it) {
-          (*it)();
-        }
-      }
-      impl->m_resolvedCallbacks.clear();
-      impl->m_rejectedCallbacks.clear();
+      auto core = m_core;
+      core->resolve();
     }
 
     void reject(std::exception_ptr error) {
-      /* we have to copy shared_ptr as in case when *this* will be reassigned with other value
-       during execution of m_resolvedCallbacks and m_rejectCallbacks will be undefined (will cause EXC_BAD_ACCESS)
-      */
-      auto impl = m_impl;
-
-      if (impl->m_state != PromiseState::undefined) {
-        throw std::runtime_error("promise is already resolved");
-      }
-
-      impl->m_state = PromiseState::rejected;
-      impl->m_error = error;
-      for (auto it = impl->m_rejectedCallbacks.begin(); it != impl->m_rejectedCallbacks.end(); ++it) {
-        if (*it) {
-          (*it)();
-        }
-      }
-
-      impl->m_resolvedCallbacks.clear();
-      impl->m_rejectedCallbacks.clear();
+      auto core = m_core;
+      core->reject(error);
     }
 
     template <typename ReturnType, typename std::enable_if<!IsPromise<ReturnType>::value, ReturnType>::type* = nullptr>
     Promise<ReturnType> then(std::function<ReturnType()> callback) {
-      auto promise = Promise<ReturnType>();
-      auto resolveLambda = [=, m_impl = m_impl]() mutable {
+      Promise<ReturnType> promise;
+      auto core = m_core.get();
+
+      core->subscribe([core, callback = std::move(callback), promise]() mutable {
+        if (core->m_state == PromiseState::rejected) {
+          promise.reject(core->m_error);
+          return;
+        }
+        std::optional<ReturnType> result;
         try {
-          callback();
-          promise.resolve();
+          result.emplace(callback());
         } catch (...) {
           auto error = std::current_exception();
           promise.reject(error);
+          return;
         }
-      };
-      auto rejectLambda = [=, m_impl = m_impl]() mutable { promise.reject(m_impl->m_error); };
-
-      switch (m_impl->m_state) {
-      case PromiseState::resolved:
-        resolveLambda();
-        break;
-      case PromiseState::rejected:
-        rejectLambda();
-        break;
-      case PromiseState::undefined:
-        m_impl->m_resolvedCallbacks.push_back(resolveLambda);
-        m_impl->m_rejectedCallbacks.push_back(rejectLambda);
-        break;
-      }
+        promise.release()->resolve(std::move(*result));
+      });
 
       return promise;
     }
 
     Promise<void> then(std::function<void()> callback) {
-      auto promise = Promise<void>();
-      auto resolveLambda = [=, m_impl = m_impl]() mutable {
+      Promise<void> promise;
+      auto core = m_core.get();
+
+      core->subscribe([core, callback = std::move(callback), promise]() mutable {
+        if (core->m_state == PromiseState::rejected) {
+          promise.reject(core->m_error);
+          return;
+        }
         try {
           callback();
-          promise.resolve();
         } catch (...) {
           auto error = std::current_exception();
           promise.reject(error);
+          return;
         }
-      };
-      auto rejectLambda = [=, m_impl = m_impl]() mutable { promise.reject(m_impl->m_error); };
-
-      switch (m_impl->m_state) {
-      case PromiseState::resolved:
-        resolveLambda();
-        break;
-      case PromiseState::rejected:
-        rejectLambda();
-        break;
-      case PromiseState::undefined:
-        m_impl->m_resolvedCallbacks.push_back(resolveLambda);
-        m_impl->m_rejectedCallbacks.push_back(rejectLambda);
-        break;
-      }
+        promise.release()->resolve();
+      });
 
       return promise;
     }
 
     Promise<void> thenPromise(std::function<Promise<void>()> callback) {
       Promise<void> promise;
+      auto core = m_core.get();
 
-      auto resolveLambda = [=, m_impl = m_impl]() mutable {
+      core->subscribe([core, callback = std::move(callback), promise]() mutable {
+        if (core->m_state == PromiseState::rejected) {
+          promise.reject(core->m_error);
+          return;
+        }
         try {
           auto resultPromise = callback();
 
-          resultPromise.then([=]() mutable { promise.resolve(); }).catchError([=](std::exception_ptr error) mutable {
-            promise.reject(error);
-          });
+          resultPromise.forwardTo(std::move(promise));
         } catch (...) {
           auto error = std::current_exception();
           promise.reject(error);
         }
-      };
-
-      auto rejectLambda = [=, m_impl = m_impl]() mutable { promise.reject(m_impl->m_error); };
-
-      switch (m_impl->m_state) {
-      case PromiseState::resolved:
-        resolveLambda();
-        break;
-      case PromiseState::rejected:
-        rejectLambda();
-        break;
-      case PromiseState::undefined:
-        m_impl->m_resolvedCallbacks.push_back(resolveLambda);
-        m_impl->m_rejectedCallbacks.push_back(rejectLambda);
-        break;
-      }
+      });
 
       return promise;
     }
@@ -163,120 +114,93 @@ namespace JetBeep {
     template <typename ReturnType, template <typename> class PromiseType>
     PromiseType<ReturnType> thenPromise(std::function<PromiseType<ReturnType>()> callback) {
       Promise<ReturnType> promise;
+      auto core = m_core.get();
 
-      auto resolveLambda = [=, m_impl = m_impl]() mutable {
+      core->subscribe([core, callback = std::move(callback), promise]() mutable {
+        if (core->m_state == PromiseState::rejected) {
+          promise.reject(core->m_error);
+          return;
+        }
         try {
           auto resultPromise = callback();
 
-          resultPromise.then([=](ReturnType result) mutable { promise.resolve(result); }).catchError([=](std::exception_ptr error) mutable {
-            promise.reject(error);
-          });
+          resultPromise.forwardTo(std::move(promise));
         } catch (...) {
           auto error = std::current_exception();
           promise.reject(error);
         }
-      };
-      auto rejectLambda = [=, m_impl = m_impl]() mutable { promise.reject(m_impl->m_error); };
-
-      switch (m_impl->m_state) {
-      case PromiseState::resolved:
-        resolveLambda();
-        break;
-      case PromiseState::rejected:
-        rejectLambda();
-        break;
-      case PromiseState::undefined:
-        m_impl->m_resolvedCallbacks.push_back(resolveLambda);
-        m_impl->m_rejectedCallbacks.push_back(rejectLambda);
-        break;
-      }
+      });
 
       return promise;
     }
 
     void catchError(std::function<void(const std::exception_ptr&)> callback) {
-      auto rejectLambda = [=, m_impl = m_impl] { callback(m_impl->m_error); };
-      switch (m_impl->m_state) {
-      case PromiseState::rejected:
-        rejectLambda();
-        break;
-      case PromiseState::undefined:
-        m_impl->m_rejectedCallbacks.push_back(rejectLambda);
-        break;
-      default:
-        break;
-      }
+      auto core = m_core.get();
+
+      core->subscribe([core, callback = std::move(callback)]() {
+        if (core->m_state == PromiseState::rejected) {
+          callback(core->m_error);
+        }
+      });
     }
 
     Promise<void> recover(std::function<void(const std::exception_ptr&)> callback) {
       Promise<void> promise;
-      auto resolveLambda = [=, m_impl = m_impl]() mutable { promise.resolve(); };
-      auto rejectLambda = [=, m_impl = m_impl]() mutable {
-        try {
-          callback(m_impl->m_error);
+      auto core = m_core.get();
+
+      core->subscribe([core, callback = std::move(callback), promise]() mutable {
+        if (core->m_state == PromiseState::resolved) {
           promise.resolve();
+          return;
+        }
+        try {
+          callback(core->m_error);
         } catch (...) {
           auto error = std::current_exception();
           promise.reject(error);
+          return;
         }
-      };
-
-      switch (m_impl->m_state) {
-      case PromiseState::resolved:
-        resolveLambda();
-        break;
-      case PromiseState::rejected:
-        rejectLambda();
-        break;
-      case PromiseState::undefined:
-        m_impl->m_resolvedCallbacks.push_back(resolveLambda);
-        m_impl->m_rejectedCallbacks.push_back(rejectLambda);
-        break;
-      }
+        promise.release()->resolve();
+      });
 
       return promise;
     }
 
     Promise<void> recoverPromise(std::function<Promise<void>(const std::exception_ptr&)> callback) {
       Promise<void> promise;
-      auto resolveLambda = [=, m_impl = m_impl]() mutable { promise.resolve(); };
-      auto rejectLambda = [=, m_impl = m_impl]() mutable {
+      auto core = m_core.get();
+
+      core->subscribe([core, callback = std::move(callback), promise]() mutable {
+        if (core->m_state == PromiseState::resolved) {
+          promise.resolve();
+          return;
+        }
         try {
-          auto resultPromise = callback(m_impl->m_error);
-          resultPromise.then([=]() mutable { promise.resolve(); }).catchError([=](std::exception_ptr error) mutable {
-            promise.reject(error);
-          });
+          auto resultPromise = callback(core->m_error);
+
+          resultPromise.forwardTo(std::move(promise));
         } catch (...) {
           auto error = std::current_exception();
           promise.reject(error);
         }
-      };
-
-      switch (m_impl->m_state) {
-      case PromiseState::resolved:
-        resolveLambda();
-        break;
-      case PromiseState::rejected:
-        rejectLambda();
-        break;
-      case PromiseState::undefined:
-        m_impl->m_resolvedCallbacks.push_back(resolveLambda);
-        m_impl->m_rejectedCallbacks.push_back(rejectLambda);
-        break;
-      }
+      });
 
       return promise;
     }
 
-    Promise(const Promise& other) {
-      m_impl = other.m_impl;
+    // noexcept, so continuations holding a promise are stored inline
+    Promise(const Promise& other) noexcept : m_core(other.m_core) {
     }
 
-    Promise& operator=(const Promise& other) {
-      m_impl = other.m_impl;
+    Promise& operator=(const Promise& other) noexcept {
+      m_core = other.m_core;
       return *this;
     }
 
+    // a moved-from promise has no state, it may only be assigned or destroyed
+    Promise(Promise&& other) noexcept = default;
+    Promise& operator=(Promise&& other) noexcept = default;
+
     static Promise<void> rejected(std::exception_ptr error) {
       Promise<void> promise;
       promise.reject(error);
@@ -284,22 +208,136 @@ namespace JetBeep {
     }
 
     PromiseState state() {
-      return m_impl->m_state;
+      return m_core->m_state;
+    }
+
+    // rejects with Errors::OperationTimeout unless this promise settles within the timeout. On timeout the returned
+    // promise is rejected through the strand, which must be the strand settling this promise, so continuations of the
+    // result never run concurrently with its other handlers, whatever the number of threads of the context
+    Promise<void> withTimeout(std::chrono::milliseconds timeout, std::shared_ptr<IOStrand> strand,
+                           IOContext context = IOContext::context) {
+      if (!strand) {
+        throw std::invalid_argument("withTimeout needs the strand which settles the promise");
+      }
+
+      Promise<void> promise;
+      auto isSettled = std::make_shared<std::atomic<bool>>(false);
+      auto cancelTimer = context.runAfter(
+        timeout,
+        [promise, isSettled]() mutable {
+          if (!isSettled->exchange(true)) {
+            promise.reject(std::make_exception_ptr(Errors::OperationTimeout()));
+          }
+        },
+        std::move(strand));
+
+      forwardTo(promise, [isSettled, cancelTimer = std::move(cancelTimer)]() mutable {
+        if (isSettled->exchange(true)) {
+          return false;
+        }
+        cancelTimer();
+        return true;
+      });
+      return promise;
+    }
+
+    // the combinators subscribe to the inputs, and subscribing to or settling a promise is not thread-safe: the inputs
+    // must be settled on the strand (or the thread) which calls the combinator. Their shared state is not locked either
+    // resolves once all of the promises are resolved, or rejects with the first error
+    static Promise<void> all(const std::vector<Promise<void>>& promises) {
+      return settleWhen(promises, promises.size(), 1);
+    }
+
+    // resolves with the first resolved promise, rejects with the last error once all of the promises are rejected
+    static Promise<void> any(const std::vector<Promise<void>>& promises) {
+      return settleWhen(promises, 1, promises.size());
+    }
+
+    // settles the same way as the first of the promises which settles
+    static Promise<void> race(const std::vector<Promise<void>>& promises) {
+      return settleWhen(promises, 1, 1);
     }
 
   private:
-    class Impl {
-    public:
-      PromiseState m_state;
-      std::exception_ptr m_error;
-      std::vector<std::function<void()>> m_resolvedCallbacks;
-      std::vector<std::function<void()>> m_rejectedCallbacks;
-
-      Impl() : m_state(PromiseState::undefined) {
+    template <typename U>
+    friend class Detail::PromiseAwaiter;
+
+    template <typename T>
+    friend class Promise;
+
+    typedef Detail::PromiseCore<void> Core;
+    std::shared_ptr<Core> m_core;
+
+    std::shared_ptr<Core> release() {
+      return std::move(m_core);
+    }
+
+    // settles the other promise with the result of this one, a single continuation instead of a then/catchError pair
+    void forwardTo(Promise<void> promise) {
+      forwardTo(std::move(promise), [] { return true; });
+    }
+
+    // same, but only when shouldForward() agrees at the time this promise settles
+    template <typename Predicate>
+    void forwardTo(Promise<void> promise, Predicate shouldForward) {
+      auto core = m_core.get();
+
+      core->subscribe([core, promise = std::move(promise), shouldForward = std::move(shouldForward)]() mutable {
+        if (!shouldForward()) {
+          return;
+        }
+        if (core->m_state == PromiseState::resolved) {
+          promise.resolve();
+        } else {
+          promise.reject(core->m_error);
+        }
+      });
+    }
+
+    // resolves after resolvedCount of the promises are resolved, rejects after rejectedCount of them are rejected
+    static Promise<void> settleWhen(const std::vector<Promise<void>>& promises, size_t resolvedCount, size_t rejectedCount) {
+      typedef struct State {
+        bool isSettled = false;
+        size_t resolvedLeft;
+        size_t rejectedLeft;
+      } State;
+
+      Promise<void> promise;
+      auto state = std::make_shared<State>();
+
+      state->resolvedLeft = resolvedCount;
+      state->rejectedLeft = rejectedCount;
+      if (promises.empty()) {
+        if (resolvedCount == 0) {
+          promise.resolve();
+        } else {
+          promise.reject(std::make_exception_ptr(std::invalid_argument("no promises to wait for")));
+        }
+        return promise;
+      }
+
+      for (auto& input : promises) {
+        auto core = input.m_core.get();
+
+        core->subscribe([core, state, promise]() mutable {
+          auto isResolved = core->m_state == PromiseState::resolved;
+          auto& left = isResolved ? state->resolvedLeft : state->rejectedLeft;
+
+          if (state->isSettled || --left != 0) {
+            return;
+          }
+          state->isSettled = true;
+
+          if (isResolved) {
+            promise.resolve();
+          } else {
+            promise.reject(core->m_error);
+          }
+        });
       }
-    };
-    std::shared_ptr<Impl> m_impl;
+      return promise;
+    }
   };
 } // namespace JetBeep
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,72 @@
+#ifndef JETBEEP_RING_QUEUE__H
+#define JETBEEP_RING_QUEUE__H
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+
+namespace JetBeep {
+  // fixed-capacity FIFO over an array of pre-constructed records. Records are never destroyed when popped: the next
+  // push hands the same record out again, so strings and containers inside it keep their buffers. Not thread safe,
+  // callers guard it with their own lock
+  template <class T, size_t Capacity>
+  class RingQueue {
+  public:
+    static_assert(Capacity > 0, "ring capacity must not be 0");
+
+    RingQueue() : m_head(0), m_size(0) {
+    }
+
+    size_t size() const {
+      return m_size;
+    }
+
+    bool empty() const {
+      return m_size == 0;
+    }
+
+    bool full() const {
+      return m_size == Capacity;
+    }
+
+    static constexpr size_t capacity() {
+      return Capacity;
+    }
+
+    // the record to fill in, it still holds the values of its previous use
+    T& push() {
+      if (full()) {
+        throw std::length_error("ring queue is full");
+      }
+      return m_records[(m_head + m_size++) % Capacity];
+    }
+
+    T& front() {
+      return m_records[m_head];
+    }
+
+    T& back() {
+      return m_records[(m_head + m_size - 1) % Capacity];
+    }
+
+    void pop() {
+      if (empty()) {
+        throw std::out_of_range("ring queue is empty");
+      }
+      m_head = (m_head + 1) % Capacity;
+      m_size--;
+    }
+
+    void clear() {
+      m_head = 0;
+      m_size = 0;
+    }
+
+  private:
+    std::array<T, Capacity> m_records;
+    size_t m_head;
+    size_t m_size;
+  };
+} // namespace JetBeep
+
+#endif
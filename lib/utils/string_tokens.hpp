@@ -0,0 +1,112 @@
+#ifndef JETBEEP_STRING_TOKENS__H
+#define JETBEEP_STRING_TOKENS__H
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace JetBeep {
+  // non-owning range of tokens, valid as long as the StringTokens it was taken from and the tokenized string are alive
+  class StringTokensRange {
+  public:
+    StringTokensRange(const std::string_view* data, size_t size) : m_data(data), m_size(size) {
+    }
+
+    size_t size() const {
+      return m_size;
+    }
+
+    bool empty() const {
+      return m_size == 0;
+    }
+
+    const std::string_view& operator[](size_t index) const {
+      return m_data[index];
+    }
+
+    const std::string_view* begin() const {
+      return m_data;
+    }
+
+    const std::string_view* end() const {
+      return m_data + m_size;
+    }
+
+  private:
+    const std::string_view* m_data;
+    size_t m_size;
+  };
+
+  // splits a string the same way as Utils::splitString does (empty tokens are kept), but the tokens are views into
+  // the original string. Up to InlineCapacity tokens are stored inside the object, so short lines are tokenized
+  // without any heap allocation. Longer lines spill into a vector
+  template <size_t InlineCapacity = 8>
+  class StringTokens {
+  public:
+    StringTokens(std::string_view str, char delimiter = ' ') : m_size(0) {
+      size_t start = 0;
+      auto end = str.find(delimiter);
+
+      while (end != std::string_view::npos) {
+        push(str.substr(start, end - start));
+        start = end + 1;
+        end = str.find(delimiter, start);
+      }
+      push(str.substr(start));
+    }
+
+    size_t size() const {
+      return m_size;
+    }
+
+    bool empty() const {
+      return m_size == 0;
+    }
+
+    const std::string_view& operator[](size_t index) const {
+      return data()[index];
+    }
+
+    const std::string_view* begin() const {
+      return data();
+    }
+
+    const std::string_view* end() const {
+      return data() + m_size;
+    }
+
+    // tokens starting from the given index, e.g. tail(1) are the params of a device response
+    StringTokensRange tail(size_t from) const {
+      if (from >= m_size) {
+        return StringTokensRange(end(), 0);
+      }
+      return StringTokensRange(data() + from, m_size - from);
+    }
+
+  private:
+    std::array<std::string_view, InlineCapacity> m_inline;
+    std::vector<std::string_view> m_spilled;
+    size_t m_size;
+
+    const std::string_view* data() const {
+      return m_spilled.empty() ? m_inline.data() : m_spilled.data();
+    }
+
+    void push(std::string_view token) {
+      if (m_size < InlineCapacity) {
+        m_inline[m_size++] = token;
+        return;
+      }
+
+      if (m_spilled.empty()) {
+        m_spilled.reserve(InlineCapacity * 2);
+        m_spilled.assign(m_inline.begin(), m_inline.end());
+      }
+      m_spilled.push_back(token);
+      m_size++;
+    }
+  };
+} // namespace JetBeep
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef SIMULATOR_APP_DEVICE__HPP
+#define SIMULATOR_APP_DEVICE__HPP
+
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace Simulator {
+  // the line protocol of the device firmware, as parsed by SerialDevice::Impl
+  class AppDevice {
+  public:
+    AppDevice();
+
+    // the response to a command line without the line ending, empty when the device doesn't answer it
+    std::string respond(std::string_view line);
+
+    void setParameter(const std::string& name, const std::string& value);
+    std::string parameter(const std::string& name) const;
+
+    // set by ENTER_DFU_MODE, the device reboots into the bootloader
+    bool isDfuModeRequested;
+
+  private:
+    void reset();
+
+    std::map<std::string, std::string> m_parameters;
+    bool m_isSessionOpened;
+    bool m_isBarcodesRequested;
+    bool m_isPaymentCreated;
+    bool m_isWaitingForPaymentConfirmation;
+    bool m_isPrivateMode;
+  };
+} // namespace Simulator
+
+#endif
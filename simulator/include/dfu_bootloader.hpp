@@ -0,0 +1,61 @@
+#ifndef SIMULATOR_DFU_BOOTLOADER__HPP
+#define SIMULATOR_DFU_BOOTLOADER__HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Simulator {
+  typedef std::vector<uint8_t> DfuPacket;
+  typedef std::function<void(const DfuPacket& packet)> DfuPacketCallback;
+
+  // decodes SLIP frames from a byte stream which may split them at any position
+  class SlipDecoder {
+  public:
+    SlipDecoder();
+
+    void feed(const uint8_t* data, size_t size, const DfuPacketCallback& callback);
+    void reset();
+
+  private:
+    DfuPacket m_packet;
+    bool m_isEscaped;
+  };
+
+  std::string slipEncode(const DfuPacket& packet);
+
+  // the serial transport of the Nordic secure bootloader, as driven by dfu-module/src/dfu_serial.c
+  class DfuBootloader {
+  public:
+    DfuBootloader(uint16_t mtu, uint32_t dataObjectMaxSize);
+
+    // the response packets to a request packet. OBJECT_WRITE is answered only by receipt notifications
+    std::vector<DfuPacket> handle(const DfuPacket& request);
+    void reset();
+
+    // set once a data object is executed, the real bootloader activates the firmware and reboots afterwards
+    bool isFirmwareExecuted;
+    uint32_t firmwareSize() const;
+
+  private:
+    typedef struct DfuObject {
+      uint32_t offset;
+      uint32_t crc;
+      uint32_t executedOffset;
+      uint32_t executedCrc;
+    } DfuObject;
+
+    DfuObject& object(uint8_t type);
+
+    uint16_t m_mtu;
+    uint32_t m_dataObjectMaxSize;
+    uint16_t m_prn;
+    uint16_t m_writesSinceReceipt;
+    uint8_t m_selectedType;
+    DfuObject m_command;
+    DfuObject m_data;
+  };
+} // namespace Simulator
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SIMULATOR_PTY_PORT__HPP
+#define SIMULATOR_PTY_PORT__HPP
+
+#include "utils/logger.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+
+#include <boost/asio.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+namespace Simulator {
+  typedef std::function<void(const uint8_t* data, size_t size)> PtyDataCallback;
+
+  // master side of a pseudo terminal, the slave side is the path SerialDevice::open is pointed at
+  class PtyPort {
+  public:
+    PtyPort(boost::asio::io_service& ioService);
+    virtual ~PtyPort();
+
+    // linkPath, when not empty, is a symlink to the slave which is created for a stable port name
+    void open(const std::string& linkPath = "");
+    void close();
+
+    const std::string& slavePath() const;
+
+    // writes are queued, so they may be issued while a previous one is in flight
+    void write(const std::string& data);
+
+    PtyDataCallback dataCallback;
+
+  private:
+    void read();
+    void flush();
+
+    boost::asio::posix::stream_descriptor m_master;
+    // kept open, so the master does not read EIO while no client has the port opened
+    int m_slave;
+    std::string m_slavePath;
+    std::string m_linkPath;
+    uint8_t m_readBuffer[4096];
+    std::deque<std::string> m_writeQueue;
+    JetBeep::Logger m_log;
+  };
+} // namespace Simulator
+
+#endif
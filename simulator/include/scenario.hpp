@@ -0,0 +1,36 @@
+#ifndef SIMULATOR_SCENARIO__HPP
+#define SIMULATOR_SCENARIO__HPP
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Simulator {
+  typedef struct ScenarioAction {
+    std::chrono::milliseconds delay;
+    std::string line;
+  } ScenarioAction;
+
+  // scripted device behaviour, one rule per line ('#' starts a comment):
+  //   at <ms> <line>                - sends the line once, the delay counts from the simulator start
+  //   every <ms> <line>             - sends the line periodically
+  //   on <COMMAND> <ms> <line>      - sends the line the delay after the response to the command
+  //   reply <COMMAND> <response>    - answers the command with the response instead of the default one
+  //   drop <COMMAND>                - leaves the command unanswered, e.g. to test timeouts
+  class Scenario {
+  public:
+    // throws std::runtime_error with the line number on invalid rules
+    static Scenario load(const std::string& path);
+
+    std::vector<ScenarioAction> startActions;
+    std::vector<ScenarioAction> periodicActions;
+    std::multimap<std::string, ScenarioAction> commandActions;
+    std::map<std::string, std::string> replies;
+    std::vector<std::string> droppedCommands;
+
+    bool isDropped(const std::string& command) const;
+  };
+} // namespace Simulator
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef SIMULATOR_SIMULATED_DEVICE__HPP
+#define SIMULATOR_SIMULATED_DEVICE__HPP
+
+#include "app_device.hpp"
+#include "dfu_bootloader.hpp"
+#include "pty_port.hpp"
+#include "scenario.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+namespace Simulator {
+  typedef struct SimulatorOptions {
+    std::string linkPath;
+    Scenario scenario;
+    // every response is delayed by latency +- jitter, responses are still sent in the order of the commands
+    std::chrono::milliseconds latency = std::chrono::milliseconds(0);
+    std::chrono::milliseconds jitter = std::chrono::milliseconds(0);
+    unsigned int seed = 0;
+    bool isBootloader = false;
+    uint16_t mtu = 131;
+    uint32_t dataObjectMaxSize = 4096;
+    // the bootloader reboots into the application once no packets arrive for this long after a data object is
+    // executed
+    std::chrono::milliseconds dfuRebootDelay = std::chrono::milliseconds(500);
+    // reported as the version parameter after a firmware update, the version stays the same when empty
+    std::string dfuVersion;
+    std::map<std::string, std::string> parameters;
+  } SimulatorOptions;
+
+  // a device on a pseudo terminal: the application line protocol or the DFU bootloader
+  class SimulatedDevice {
+  public:
+    SimulatedDevice(boost::asio::io_service& ioService, const SimulatorOptions& options);
+
+    void start();
+    void stop();
+
+    const std::string& path() const;
+    uint64_t commandsCount() const;
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    void onData(const uint8_t* data, size_t size);
+    void handleLine(const std::string& line);
+    void handleDfuPacket(const DfuPacket& packet);
+
+    void sendResponse(const std::string& data);
+    void sendResponses();
+    void sendEvent(const ScenarioAction& action);
+    void sendPeriodicEvent(const ScenarioAction& action);
+
+    void enterBootloader();
+    void rebootToApp();
+
+    boost::asio::io_service& m_ioService;
+    SimulatorOptions m_options;
+    PtyPort m_port;
+    AppDevice m_app;
+    DfuBootloader m_bootloader;
+    SlipDecoder m_slipDecoder;
+    bool m_isBootloader;
+    uint64_t m_commandsCount;
+    std::string m_lineBuffer;
+    std::deque<std::pair<Clock::time_point, std::string>> m_responses;
+    Clock::time_point m_lastResponseTime;
+    boost::asio::steady_timer m_responseTimer;
+    boost::asio::steady_timer m_rebootTimer;
+    std::mt19937 m_random;
+    JetBeep::Logger m_log;
+  };
+} // namespace Simulator
+
+#endif
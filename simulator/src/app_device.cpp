@@ -0,0 +1,159 @@
+#include "app_device.hpp"
+#include "device/device_responses.hpp"
+#include "utils/string_tokens.hpp"
+
+using namespace std;
+using namespace JetBeep;
+using namespace Simulator;
+using DeviceResponses::ResponseId;
+
+namespace {
+  constexpr string_view enterDfuMode = "ENTER_DFU_MODE";
+  constexpr string_view softReset = "SOFT_RESET";
+  // 16 zero bytes, the content of an empty mifare classic block
+  constexpr string_view emptyBlockBase64 = "AAAAAAAAAAAAAAAAAAAAAA==";
+
+  string line(string_view command, string_view params) {
+    string result(command);
+
+    result.append(" ").append(params);
+    return result;
+  }
+} // namespace
+
+AppDevice::AppDevice() : isDfuModeRequested(false) {
+  m_parameters = {{"version", "1.6.0"},
+                  {"deviceId", "1A2B"},
+                  {"chipId", "0123456789ABCDEF"},
+                  {"shopId", "1"},
+                  {"merchantId", "1"},
+                  {"domainShopId", "1"},
+                  {"mode", "driver"},
+                  {"connectionRole", "slave"},
+                  {"revision", "1"},
+                  {"mac", "00:00:00:00:00:00"},
+                  {"nfc", "1"},
+                  {"bluetooth", "1"}};
+  reset();
+}
+
+void AppDevice::setParameter(const string& name, const string& value) {
+  m_parameters[name] = value;
+}
+
+string AppDevice::parameter(const string& name) const {
+  auto it = m_parameters.find(name);
+
+  return it == m_parameters.end() ? string() : it->second;
+}
+
+void AppDevice::reset() {
+  m_isSessionOpened = false;
+  m_isBarcodesRequested = false;
+  m_isPaymentCreated = false;
+  m_isWaitingForPaymentConfirmation = false;
+  m_isPrivateMode = false;
+}
+
+string AppDevice::respond(string_view request) {
+  StringTokens<> tokens(request);
+
+  if (tokens.empty()) {
+    return string();
+  }
+
+  auto command = tokens[0];
+  auto params = tokens.tail(1);
+
+  if (command == enterDfuMode) {
+    isDfuModeRequested = true;
+    return string();
+  }
+  if (command == softReset) {
+    reset();
+    return string();
+  }
+
+  switch (DeviceResponses::lookup(command)) {
+  case ResponseId::openSession:
+    if (m_isSessionOpened) {
+      return line(command, "error session_opened");
+    }
+    m_isSessionOpened = true;
+    return line(command, "ok");
+  case ResponseId::closeSession:
+    reset();
+    return line(command, "ok");
+  case ResponseId::requestBarcodes:
+    if (!m_isSessionOpened) {
+      return line(command, "error session_closed");
+    }
+    m_isBarcodesRequested = true;
+    return line(command, "ok");
+  case ResponseId::cancelBarcodes:
+    m_isBarcodesRequested = false;
+    return line(command, "ok");
+  case ResponseId::createPayment:
+  case ResponseId::createPaymentToken:
+    if (!m_isSessionOpened) {
+      return line(command, "error session_closed");
+    }
+    if (params.size() < 2) {
+      return line(command, "error invalid_params");
+    }
+    m_isPaymentCreated = true;
+    m_isWaitingForPaymentConfirmation = DeviceResponses::lookup(command) == ResponseId::createPayment;
+    return line(command, "ok");
+  case ResponseId::confirmPayment:
+  case ResponseId::cancelPayment:
+    m_isPaymentCreated = false;
+    m_isWaitingForPaymentConfirmation = false;
+    return line(command, "ok");
+  case ResponseId::resetState:
+    reset();
+    return line(command, "ok");
+  case ResponseId::get: {
+    if (params.size() != 1) {
+      return line(command, "error");
+    }
+
+    auto it = m_parameters.find(string(params[0]));
+
+    if (it == m_parameters.end()) {
+      return line(command, "error");
+    }
+    return line(command, "ok " + it->second);
+  }
+  case ResponseId::set:
+    if (!m_isPrivateMode || params.size() < 2) {
+      return line(command, "error");
+    }
+    // values may contain spaces, e.g. the list of mobile apps
+    m_parameters[string(params[0])] = string(request.substr(params[1].data() - request.data()));
+    return line(command, "ok");
+  case ResponseId::beginPrivate:
+    m_isPrivateMode = true;
+    return line(command, "ok");
+  case ResponseId::commit:
+    m_isPrivateMode = false;
+    return line(command, "ok");
+  case ResponseId::getState: {
+    string state = "ok";
+
+    for (auto flag : {m_isSessionOpened, m_isBarcodesRequested, m_isPaymentCreated, m_isWaitingForPaymentConfirmation}) {
+      state.append(flag ? " 1" : " 0");
+    }
+    // refund is never requested
+    state.append(" 0");
+    return line(command, state);
+  }
+  case ResponseId::nfcReadMFC:
+  case ResponseId::nfcSecureReadMFC:
+    return line(command, string("ok ").append(emptyBlockBase64));
+  case ResponseId::nfcWriteMFC:
+  case ResponseId::nfcSecureWriteMFC:
+    return line(command, "ok");
+  default:
+    return line(command, "error unknown_command");
+  }
+}
@@ -0,0 +1,231 @@
+#include "dfu_bootloader.hpp"
+#include "crc32.h"
+#include "slip_enc.h"
+
+using namespace std;
+using namespace Simulator;
+
+namespace {
+  enum Opcode : uint8_t {
+    opProtocolVersion = 0x00,
+    opObjectCreate = 0x01,
+    opReceiptNotifSet = 0x02,
+    opCrcGet = 0x03,
+    opObjectExecute = 0x04,
+    opObjectSelect = 0x06,
+    opMtuGet = 0x07,
+    opObjectWrite = 0x08,
+    opPing = 0x09,
+    opAbort = 0x0C,
+    opResponse = 0x60
+  };
+
+  enum Result : uint8_t {
+    resultSuccess = 0x01,
+    resultOpCodeNotSupported = 0x02,
+    resultInvalidParameter = 0x03,
+    resultOperationNotPermitted = 0x08
+  };
+
+  constexpr uint8_t slipEnd = 0300;
+  constexpr uint8_t slipEsc = 0333;
+  constexpr uint8_t slipEscEnd = 0334;
+  constexpr uint8_t slipEscEsc = 0335;
+
+  constexpr uint8_t commandObject = 0x01;
+  constexpr uint8_t dataObject = 0x02;
+  constexpr uint32_t commandObjectMaxSize = 256;
+
+  void putUint16(DfuPacket& packet, uint16_t value) {
+    packet.push_back(static_cast<uint8_t>(value));
+    packet.push_back(static_cast<uint8_t>(value >> 8));
+  }
+
+  void putUint32(DfuPacket& packet, uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+      packet.push_back(static_cast<uint8_t>(value >> shift));
+    }
+  }
+
+  uint32_t getUint32(const uint8_t* data) {
+    return data[0] | data[1] << 8 | data[2] << 16 | static_cast<uint32_t>(data[3]) << 24;
+  }
+
+  DfuPacket makeResponse(uint8_t opcode, uint8_t result) {
+    return {opResponse, opcode, result};
+  }
+} // namespace
+
+SlipDecoder::SlipDecoder() : m_isEscaped(false) {
+}
+
+void SlipDecoder::reset() {
+  m_packet.clear();
+  m_isEscaped = false;
+}
+
+void SlipDecoder::feed(const uint8_t* data, size_t size, const DfuPacketCallback& callback) {
+  for (size_t i = 0; i < size; i++) {
+    auto byte = data[i];
+
+    if (byte == slipEnd) {
+      if (!m_packet.empty() && !m_isEscaped) {
+        callback(m_packet);
+      }
+      reset();
+    } else if (m_isEscaped) {
+      m_isEscaped = false;
+      m_packet.push_back(byte == slipEscEnd ? slipEnd : byte == slipEscEsc ? slipEsc : byte);
+    } else if (byte == slipEsc) {
+      m_isEscaped = true;
+    } else {
+      m_packet.push_back(byte);
+    }
+  }
+}
+
+string Simulator::slipEncode(const DfuPacket& packet) {
+  string encoded(packet.size() * 2 + 1, '\0');
+  uint32_t size = 0;
+
+  encode_slip(reinterpret_cast<uint8_t*>(&encoded[0]), &size, packet.data(), static_cast<uint32_t>(packet.size()));
+  encoded.resize(size);
+  return encoded;
+}
+
+DfuBootloader::DfuBootloader(uint16_t mtu, uint32_t dataObjectMaxSize)
+  : m_mtu(mtu), m_dataObjectMaxSize(dataObjectMaxSize) {
+  reset();
+}
+
+void DfuBootloader::reset() {
+  isFirmwareExecuted = false;
+  m_prn = 0;
+  m_writesSinceReceipt = 0;
+  m_selectedType = 0;
+  m_command = {0, 0, 0, 0};
+  m_data = {0, 0, 0, 0};
+}
+
+uint32_t DfuBootloader::firmwareSize() const {
+  return m_data.executedOffset;
+}
+
+DfuBootloader::DfuObject& DfuBootloader::object(uint8_t type) {
+  return type == commandObject ? m_command : m_data;
+}
+
+vector<DfuPacket> DfuBootloader::handle(const DfuPacket& request) {
+  auto opcode = request[0];
+  auto size = request.size();
+
+  switch (opcode) {
+  case opPing: {
+    if (size != 2) {
+      return {makeResponse(opcode, resultInvalidParameter)};
+    }
+
+    auto packet = makeResponse(opcode, resultSuccess);
+    packet.push_back(request[1]);
+    return {packet};
+  }
+  case opProtocolVersion: {
+    auto packet = makeResponse(opcode, resultSuccess);
+    packet.push_back(1);
+    return {packet};
+  }
+  case opReceiptNotifSet:
+    if (size != 3) {
+      return {makeResponse(opcode, resultInvalidParameter)};
+    }
+    m_prn = static_cast<uint16_t>(request[1] | request[2] << 8);
+    m_writesSinceReceipt = 0;
+    return {makeResponse(opcode, resultSuccess)};
+  case opMtuGet: {
+    auto packet = makeResponse(opcode, resultSuccess);
+    putUint16(packet, m_mtu);
+    return {packet};
+  }
+  case opObjectSelect: {
+    if (size != 2 || (request[1] != commandObject && request[1] != dataObject)) {
+      return {makeResponse(opcode, resultInvalidParameter)};
+    }
+    m_selectedType = request[1];
+
+    auto& selected = object(m_selectedType);
+    auto packet = makeResponse(opcode, resultSuccess);
+    putUint32(packet, m_selectedType == commandObject ? commandObjectMaxSize : m_dataObjectMaxSize);
+    putUint32(packet, selected.offset);
+    putUint32(packet, selected.crc);
+    return {packet};
+  }
+  case opObjectCreate: {
+    if (size != 6 || (request[1] != commandObject && request[1] != dataObject)) {
+      return {makeResponse(opcode, resultInvalidParameter)};
+    }
+
+    auto objectSize = getUint32(&request[2]);
+    if (objectSize > (request[1] == commandObject ? commandObjectMaxSize : m_dataObjectMaxSize)) {
+      return {makeResponse(opcode, resultInvalidParameter)};
+    }
+
+    // a new object drops what was written after the last executed one
+    m_selectedType = request[1];
+    auto& created = object(m_selectedType);
+    if (m_selectedType == commandObject) {
+      created = {0, 0, 0, 0};
+    } else {
+      created.offset = created.executedOffset;
+      created.crc = created.executedCrc;
+    }
+    m_writesSinceReceipt = 0;
+    return {makeResponse(opcode, resultSuccess)};
+  }
+  case opObjectWrite: {
+    if (m_selectedType == 0) {
+      return {makeResponse(opcode, resultOperationNotPermitted)};
+    }
+
+    auto& written = object(m_selectedType);
+    auto length = static_cast<uint32_t>(size - 1);
+    written.crc = crc32_compute(&request[1], length, written.offset == 0 ? nullptr : &written.crc);
+    written.offset += length;
+
+    if (m_prn == 0 || ++m_writesSinceReceipt < m_prn) {
+      return {};
+    }
+    m_writesSinceReceipt = 0;
+  }
+    // a receipt notification is the same packet as a CRC_GET opResponse
+    [[fallthrough]];
+  case opCrcGet: {
+    if (m_selectedType == 0) {
+      return {makeResponse(opCrcGet, resultOperationNotPermitted)};
+    }
+
+    auto& selected = object(m_selectedType);
+    auto packet = makeResponse(opCrcGet, resultSuccess);
+    putUint32(packet, selected.offset);
+    putUint32(packet, selected.crc);
+    return {packet};
+  }
+  case opObjectExecute: {
+    if (m_selectedType == 0) {
+      return {makeResponse(opcode, resultOperationNotPermitted)};
+    }
+
+    auto& executed = object(m_selectedType);
+    executed.executedOffset = executed.offset;
+    executed.executedCrc = executed.crc;
+    if (m_selectedType == dataObject) {
+      isFirmwareExecuted = true;
+    }
+    return {makeResponse(opcode, resultSuccess)};
+  }
+  case opAbort:
+    reset();
+    return {};
+  default:
+    return {makeResponse(opcode, resultOpCodeNotSupported)};
+  }
+}
@@ -0,0 +1,97 @@
+#include "simulated_device.hpp"
+
+#include <iostream>
+
+#include <boost/asio/signal_set.hpp>
+
+using namespace std;
+using namespace JetBeep;
+using namespace Simulator;
+
+static Logger l("main");
+
+static void printHelp() {
+  cout << "JetBeep device simulator on a pseudo terminal.\n\n";
+  cout << "Optional parameters:\n";
+  cout << "--link=<path>          - symlink to the device port, e.g. /tmp/ttyJetBeep\n";
+  cout << "--scenario=<file>      - scripted events and replies, see simulator/scenarios\n";
+  cout << "--latency=<ms>         - delay of every response\n";
+  cout << "--jitter=<ms>          - random deviation of the delay\n";
+  cout << "--seed=<n>             - seed of the jitter, runs with the same seed are repeatable\n";
+  cout << "--set=<name>=<value>   - value of a device parameter, e.g. --set=version=1.5.0\n";
+  cout << "--bootloader           - start in the DFU bootloader instead of the application\n";
+  cout << "--mtu=<bytes>          - MTU reported by the bootloader\n";
+  cout << "--dfu-version=<value>  - version reported after a firmware update\n";
+  cout << "--log=verbose or --log=debug - to log every command\n";
+  cout << "--help                 - display help info.\n";
+}
+
+int main(int argc, char* argv[]) {
+  Logger::coutEnabled = true;
+  Logger::level = LoggerLevel::info;
+  SimulatorOptions options;
+
+  try {
+    for (int i = 1; i < argc; i++) {
+      string param = string(argv[i]);
+      auto separator = param.find('=');
+      auto name = param.substr(0, separator);
+      auto value = separator == string::npos ? string() : param.substr(separator + 1);
+
+      if (name == "--help" || name == "-h") {
+        printHelp();
+        return 0;
+      } else if (name == "--link") {
+        options.linkPath = value;
+      } else if (name == "--scenario") {
+        options.scenario = Scenario::load(value);
+      } else if (name == "--latency") {
+        options.latency = chrono::milliseconds(stoul(value));
+      } else if (name == "--jitter") {
+        options.jitter = chrono::milliseconds(stoul(value));
+      } else if (name == "--seed") {
+        options.seed = stoul(value);
+      } else if (name == "--set" && value.find('=') != string::npos) {
+        options.parameters[value.substr(0, value.find('='))] = value.substr(value.find('=') + 1);
+      } else if (name == "--bootloader") {
+        options.isBootloader = true;
+      } else if (name == "--mtu") {
+        options.mtu = static_cast<uint16_t>(stoul(value));
+      } else if (name == "--dfu-version") {
+        options.dfuVersion = value;
+      } else if (param == "--log=verbose") {
+        Logger::level = LoggerLevel::verbose;
+      } else if (param == "--log=debug") {
+        Logger::level = LoggerLevel::debug;
+      } else {
+        cout << "Invalid parameter supplied: [" << param << "]\n";
+        return -1;
+      }
+    }
+  } catch (const runtime_error& e) {
+    cout << e.what() << "\n";
+    return -1;
+  } catch (const exception&) {
+    cout << "Invalid parameter value\n";
+    return -1;
+  }
+
+  boost::asio::io_service ioService;
+  boost::asio::signal_set signals(ioService, SIGINT, SIGTERM);
+
+  try {
+    SimulatedDevice device(ioService, options);
+
+    device.start();
+    signals.async_wait([&](const boost::system::error_code&, int) {
+      l.i() << "commands handled: " << device.commandsCount() << Logger::endl;
+      device.stop();
+      ioService.stop();
+    });
+    ioService.run();
+  } catch (const exception& e) {
+    l.e() << e.what() << Logger::endl;
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,123 @@
+#include "pty_port.hpp"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+using namespace std;
+using namespace JetBeep;
+using namespace Simulator;
+
+static void throwSystemError(const char* what) {
+  throw system_error(errno, generic_category(), what);
+}
+
+PtyPort::PtyPort(boost::asio::io_service& ioService) : m_master(ioService), m_slave(-1), m_log("pty") {
+}
+
+PtyPort::~PtyPort() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+void PtyPort::open(const string& linkPath) {
+  auto master = posix_openpt(O_RDWR | O_NOCTTY);
+
+  if (master < 0) {
+    throwSystemError("posix_openpt");
+  }
+  if (grantpt(master) != 0 || unlockpt(master) != 0) {
+    ::close(master);
+    throwSystemError("unable to unlock pty");
+  }
+
+  m_slavePath = ptsname(master);
+  m_slave = ::open(m_slavePath.c_str(), O_RDWR | O_NOCTTY);
+  if (m_slave < 0) {
+    ::close(master);
+    throwSystemError("unable to open pty slave");
+  }
+
+  // no echo and no line editing until the client configures the port itself
+  termios options;
+  tcgetattr(m_slave, &options);
+  cfmakeraw(&options);
+  tcsetattr(m_slave, TCSANOW, &options);
+
+  if (!linkPath.empty()) {
+    unlink(linkPath.c_str());
+    if (symlink(m_slavePath.c_str(), linkPath.c_str()) != 0) {
+      m_log.w() << "unable to create link " << linkPath << ": " << strerror(errno) << Logger::endl;
+    } else {
+      m_linkPath = linkPath;
+    }
+  }
+
+  m_master.assign(master);
+  read();
+}
+
+void PtyPort::close() {
+  if (!m_linkPath.empty()) {
+    unlink(m_linkPath.c_str());
+    m_linkPath.clear();
+  }
+  if (m_master.is_open()) {
+    m_master.close();
+  }
+  if (m_slave >= 0) {
+    ::close(m_slave);
+    m_slave = -1;
+  }
+}
+
+const string& PtyPort::slavePath() const {
+  return m_slavePath;
+}
+
+void PtyPort::write(const string& data) {
+  m_writeQueue.push_back(data);
+  if (m_writeQueue.size() == 1) {
+    flush();
+  }
+}
+
+void PtyPort::read() {
+  m_master.async_read_some(boost::asio::buffer(m_readBuffer), [this](const boost::system::error_code& error, size_t size) {
+    if (error == boost::asio::error::operation_aborted) {
+      return;
+    }
+    if (error) {
+      m_log.e() << "read error: " << error.message() << Logger::endl;
+      return;
+    }
+    if (dataCallback) {
+      dataCallback(m_readBuffer, size);
+    }
+    read();
+  });
+}
+
+void PtyPort::flush() {
+  auto& data = m_writeQueue.front();
+
+  boost::asio::async_write(m_master, boost::asio::buffer(data), [this](const boost::system::error_code& error, size_t) {
+    if (error == boost::asio::error::operation_aborted) {
+      return;
+    }
+    if (error) {
+      m_log.e() << "write error: " << error.message() << Logger::endl;
+    }
+    m_writeQueue.pop_front();
+    if (!m_writeQueue.empty()) {
+      flush();
+    }
+  });
+}
@@ -0,0 +1,98 @@
+#include "scenario.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace Simulator;
+
+namespace {
+  // the remainder of the stream without the separating whitespace
+  string rest(istringstream& stream) {
+    string value;
+
+    getline(stream >> ws, value);
+    return value;
+  }
+
+  chrono::milliseconds readDelay(istringstream& stream) {
+    long long delay = -1;
+
+    if (!(stream >> delay) || delay < 0) {
+      throw invalid_argument("invalid delay");
+    }
+    return chrono::milliseconds(delay);
+  }
+} // namespace
+
+Scenario Scenario::load(const string& path) {
+  ifstream file(path);
+  Scenario scenario;
+  string text;
+  int lineNumber = 0;
+
+  if (!file) {
+    throw runtime_error("unable to open scenario: " + path);
+  }
+
+  while (getline(file, text)) {
+    lineNumber++;
+
+    istringstream stream(text);
+    string rule;
+
+    if (!(stream >> rule) || rule[0] == '#') {
+      continue;
+    }
+
+    try {
+      if (rule == "at" || rule == "every") {
+        auto delay = readDelay(stream);
+        ScenarioAction action = {delay, rest(stream)};
+
+        if (action.line.empty() || (rule == "every" && delay.count() == 0)) {
+          throw invalid_argument("missing line or zero period");
+        }
+        (rule == "at" ? scenario.startActions : scenario.periodicActions).push_back(action);
+      } else if (rule == "on") {
+        string command;
+
+        stream >> command;
+        auto delay = readDelay(stream);
+        ScenarioAction action = {delay, rest(stream)};
+
+        if (action.line.empty()) {
+          throw invalid_argument("missing line");
+        }
+        scenario.commandActions.insert({command, action});
+      } else if (rule == "reply") {
+        string command;
+
+        stream >> command;
+        auto response = rest(stream);
+        if (command.empty() || response.empty()) {
+          throw invalid_argument("missing command or response");
+        }
+        scenario.replies[command] = response;
+      } else if (rule == "drop") {
+        string command;
+
+        if (!(stream >> command)) {
+          throw invalid_argument("missing command");
+        }
+        scenario.droppedCommands.push_back(command);
+      } else {
+        throw invalid_argument("unknown rule " + rule);
+      }
+    } catch (const invalid_argument& error) {
+      throw runtime_error(path + ":" + to_string(lineNumber) + ": " + error.what());
+    }
+  }
+  return scenario;
+}
+
+bool Scenario::isDropped(const string& command) const {
+  return find(droppedCommands.begin(), droppedCommands.end(), command) != droppedCommands.end();
+}
@@ -0,0 +1,232 @@
+#include "simulated_device.hpp"
+
+#include <memory>
+
+using namespace std;
+using namespace JetBeep;
+using namespace Simulator;
+
+SimulatedDevice::SimulatedDevice(boost::asio::io_service& ioService, const SimulatorOptions& options)
+  : m_ioService(ioService),
+    m_options(options),
+    m_port(ioService),
+    m_bootloader(options.mtu, options.dataObjectMaxSize),
+    m_isBootloader(options.isBootloader),
+    m_commandsCount(0),
+    m_responseTimer(ioService),
+    m_rebootTimer(ioService),
+    m_random(options.seed),
+    m_log("simulator") {
+  for (auto& parameter : m_options.parameters) {
+    m_app.setParameter(parameter.first, parameter.second);
+  }
+}
+
+void SimulatedDevice::start() {
+  m_port.dataCallback = [this](const uint8_t* data, size_t size) { onData(data, size); };
+  m_port.open(m_options.linkPath);
+  m_log.i() << "device port: " << m_port.slavePath() << (m_isBootloader ? " (bootloader)" : "") << Logger::endl;
+
+  for (auto& action : m_options.scenario.startActions) {
+    sendEvent(action);
+  }
+  for (auto& action : m_options.scenario.periodicActions) {
+    sendPeriodicEvent(action);
+  }
+}
+
+void SimulatedDevice::stop() {
+  m_responseTimer.cancel();
+  m_rebootTimer.cancel();
+  m_port.close();
+}
+
+const string& SimulatedDevice::path() const {
+  return m_port.slavePath();
+}
+
+uint64_t SimulatedDevice::commandsCount() const {
+  return m_commandsCount;
+}
+
+void SimulatedDevice::onData(const uint8_t* data, size_t size) {
+  if (m_isBootloader) {
+    m_slipDecoder.feed(data, size, [this](const DfuPacket& packet) { handleDfuPacket(packet); });
+    return;
+  }
+
+  m_lineBuffer.append(reinterpret_cast<const char*>(data), size);
+
+  size_t parsed = 0;
+  for (auto end = m_lineBuffer.find('\n'); end != string::npos; end = m_lineBuffer.find('\n', parsed)) {
+    auto line = m_lineBuffer.substr(parsed, end - parsed);
+
+    parsed = end + 1;
+    // SyncSerialDevice::enterDFUMode sends a terminating zero along with the line ending
+    line.erase(0, line.find_first_not_of('\0'));
+    while (!line.empty() && (line.back() == '\r' || line.back() == '\0')) {
+      line.pop_back();
+    }
+    if (!line.empty()) {
+      handleLine(line);
+    }
+
+    // the rest of the data is already meant for the bootloader
+    if (m_isBootloader) {
+      auto rest = m_lineBuffer.substr(parsed);
+
+      m_lineBuffer.clear();
+      onData(reinterpret_cast<const uint8_t*>(rest.data()), rest.size());
+      return;
+    }
+  }
+  m_lineBuffer.erase(0, parsed);
+}
+
+void SimulatedDevice::handleLine(const string& line) {
+  auto command = line.substr(0, line.find(' '));
+
+  m_commandsCount++;
+  m_log.d() << "rx: " << line << Logger::endl;
+
+  if (m_options.scenario.isDropped(command)) {
+    m_log.d() << "dropped: " << command << Logger::endl;
+    return;
+  }
+
+  auto reply = m_options.scenario.replies.find(command);
+  auto response = m_app.respond(line);
+
+  if (reply != m_options.scenario.replies.end()) {
+    response = command + " " + reply->second;
+  }
+  if (!response.empty()) {
+    sendResponse(response + "\r\n");
+  }
+
+  // events of the command follow its response
+  auto now = Clock::now();
+  auto responseDelay = chrono::duration_cast<chrono::milliseconds>(max(now, m_lastResponseTime) - now);
+  auto actions = m_options.scenario.commandActions.equal_range(command);
+
+  for (auto it = actions.first; it != actions.second; it++) {
+    auto action = it->second;
+
+    action.delay += responseDelay;
+    sendEvent(action);
+  }
+
+  if (m_app.isDfuModeRequested) {
+    m_app.isDfuModeRequested = false;
+    enterBootloader();
+  }
+}
+
+void SimulatedDevice::handleDfuPacket(const DfuPacket& packet) {
+  m_commandsCount++;
+  m_rebootTimer.cancel();
+
+  for (auto& response : m_bootloader.handle(packet)) {
+    sendResponse(slipEncode(response));
+  }
+
+  if (m_bootloader.isFirmwareExecuted) {
+    m_rebootTimer.expires_from_now(m_options.dfuRebootDelay);
+    m_rebootTimer.async_wait([this](const boost::system::error_code& error) {
+      if (!error) {
+        rebootToApp();
+      }
+    });
+  }
+}
+
+void SimulatedDevice::sendResponse(const string& data) {
+  auto delay = m_options.latency;
+
+  if (m_options.jitter.count() > 0) {
+    uniform_int_distribution<long long> distribution(-m_options.jitter.count(), m_options.jitter.count());
+    delay = max(chrono::milliseconds(0), delay + chrono::milliseconds(distribution(m_random)));
+  }
+
+  // the device answers commands in order, a response never overtakes the previous one
+  auto time = max(Clock::now() + delay, m_lastResponseTime);
+  m_lastResponseTime = time;
+
+  if (m_responses.empty() && delay.count() == 0) {
+    m_port.write(data);
+    return;
+  }
+
+  m_responses.push_back({time, data});
+  if (m_responses.size() == 1) {
+    m_responseTimer.expires_at(time);
+    m_responseTimer.async_wait([this](const boost::system::error_code& error) {
+      if (!error) {
+        sendResponses();
+      }
+    });
+  }
+}
+
+void SimulatedDevice::sendResponses() {
+  auto now = Clock::now();
+
+  while (!m_responses.empty() && m_responses.front().first <= now) {
+    m_port.write(m_responses.front().second);
+    m_responses.pop_front();
+  }
+  if (m_responses.empty()) {
+    return;
+  }
+
+  m_responseTimer.expires_at(m_responses.front().first);
+  m_responseTimer.async_wait([this](const boost::system::error_code& error) {
+    if (!error) {
+      sendResponses();
+    }
+  });
+}
+
+void SimulatedDevice::sendEvent(const ScenarioAction& action) {
+  auto timer = make_shared<boost::asio::steady_timer>(m_ioService, action.delay);
+
+  timer->async_wait([this, timer, line = action.line](const boost::system::error_code& error) {
+    if (error || m_isBootloader) {
+      return;
+    }
+    m_log.d() << "event: " << line << Logger::endl;
+    m_port.write(line + "\r\n");
+  });
+}
+
+void SimulatedDevice::sendPeriodicEvent(const ScenarioAction& action) {
+  auto timer = make_shared<boost::asio::steady_timer>(m_ioService, action.delay);
+
+  timer->async_wait([this, timer, action](const boost::system::error_code& error) {
+    if (error) {
+      return;
+    }
+    if (!m_isBootloader) {
+      m_log.d() << "event: " << action.line << Logger::endl;
+      m_port.write(action.line + "\r\n");
+    }
+    sendPeriodicEvent(action);
+  });
+}
+
+void SimulatedDevice::enterBootloader() {
+  m_log.i() << "rebooting into the bootloader" << Logger::endl;
+  m_isBootloader = true;
+  m_bootloader.reset();
+  m_slipDecoder.reset();
+}
+
+void SimulatedDevice::rebootToApp() {
+  m_log.i() << "firmware of " << m_bootloader.firmwareSize() << " bytes activated, rebooting" << Logger::endl;
+  if (!m_options.dfuVersion.empty()) {
+    m_app.setParameter("version", m_options.dfuVersion);
+  }
+  m_isBootloader = false;
+  m_lineBuffer.clear();
+  m_app.respond("SOFT_RESET");
+}